@@ -9,7 +9,7 @@
  *   - 管理节点资源故障：CPU/内存占用
  *   - 虚拟机操作故障：创建、迁移、资源分配故障
  *
- * 编译：gcc -o cloudstack_injector cloudstack_injector.c -lpthread
+ * 编译：gcc -I../../vm_injection -o cloudstack_injector cloudstack_injector.c ../../vm_injection/fi_stress.c -lpthread
  */
 
 #include <stdio.h>
@@ -25,6 +25,8 @@
 #include <fcntl.h>
 #include <dirent.h>
 
+#include "fi_stress.h"
+
 // === CloudStack组件进程名定义 ===
 #define CS_MANAGEMENT "cloudstack-management"
 #define CS_AGENT "cloudstack-agent"
@@ -90,11 +92,6 @@ typedef struct
     char params[128];   // 故障参数
 } CSFaultModel;
 
-// === 全局变量 ===
-static volatile int g_stress_running = 0;
-static pthread_t *g_stress_threads = NULL;
-static int g_stress_thread_count = 0;
-
 // === 辅助函数：获取进程名 ===
 const char *get_cs_component_name(CloudStackComponent component)
 {
@@ -652,55 +649,30 @@ int inject_sysvm_fault(int vm_type, int fault_type)
 }
 
 // === 模块8：CPU资源耗尽注入 ===
-void *cs_cpu_stress_worker(void *arg)
+// 压力在独立 cgroup 叶子中运行 (fi_stress)，管理节点、MySQL、sshd 始终保有 cpu.max 之外的 CPU
+int inject_cs_cpu_stress(int duration_sec, int num_threads, const char *limits)
 {
-    double x = 0.0;
-    while (g_stress_running)
+    FiStressConfig cfg;
+    fi_stress_defaults(&cfg, "cs_cpu");
+    if (limits && fi_stress_parse(&cfg, limits) < 0)
     {
-        x = x + 0.1;
-        if (x > 1000000)
-            x = 0;
+        printf(" [CPU Stress] 无法解析限额: %s (cpu=百分比,cpus=列表,mem=MB)\n", limits);
+        return -1;
     }
-    return NULL;
-}
-
-int inject_cs_cpu_stress(int duration_sec, int num_threads)
-{
-    if (num_threads <= 0)
+    if (num_threads > 0)
     {
-        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.threads = num_threads;
     }
 
-    printf(" [CPU Stress] 管理节点CPU压力测试: %d线程, %d秒\n",
-           num_threads, duration_sec);
+    printf(" [CPU Stress] 管理节点CPU压力测试: %d线程 (0=按可用CPU), %d秒, 上限 %d%%\n",
+           cfg.threads, duration_sec, cfg.cpu_pct);
     printf("   预期: 管理节点响应变慢，部分控制命令可能无法执行\n");
 
-    g_stress_running = 1;
-    g_stress_thread_count = num_threads;
-    g_stress_threads = malloc(num_threads * sizeof(pthread_t));
-
-    if (!g_stress_threads)
+    if (fi_stress_cpu(&cfg, duration_sec) < 0)
     {
-        perror("malloc failed");
         return -1;
     }
 
-    for (int i = 0; i < num_threads; i++)
-    {
-        pthread_create(&g_stress_threads[i], NULL, cs_cpu_stress_worker, NULL);
-    }
-
-    sleep(duration_sec);
-
-    g_stress_running = 0;
-    for (int i = 0; i < num_threads; i++)
-    {
-        pthread_join(g_stress_threads[i], NULL);
-    }
-
-    free(g_stress_threads);
-    g_stress_threads = NULL;
-
     printf(" [CPU Stress] 压力测试完成\n");
     return 0;
 }
@@ -816,7 +788,7 @@ void print_cs_usage(const char *prog)
     printf("  db-unlock                   解锁表\n\n");
 
     printf("【资源占用故障】\n");
-    printf("  cpu-stress <秒> [线程数]    CPU资源耗尽\n");
+    printf("  cpu-stress <秒> [线程数] [限额]  CPU资源耗尽 (限额: cpu=%%,cpus=列表,mem=MB)\n");
     printf("  mem-stress <MB>             内存资源耗尽\n");
     printf("  mem-stress-clear            清理内存占用\n\n");
 
@@ -837,6 +809,7 @@ void print_cs_usage(const char *prog)
     printf("  %s crash ms                  # 终止Management Server\n", prog);
     printf("  %s sysvm-crash ssvm          # 关闭二级存储虚拟机\n", prog);
     printf("  %s cpu-stress 30 4           # 30秒CPU压力(4线程)\n", prog);
+    printf("  %s cpu-stress 60 4 cpu=75    # 压力不超过 75%% CPU\n", prog);
     printf("  %s storage-ro /mnt/secondary # 设置二级存储只读\n", prog);
     printf("\n");
 }
@@ -1103,12 +1076,13 @@ int main(int argc, char *argv[])
     {
         if (argc < 3)
         {
-            printf(" 用法: %s cpu-stress <秒> [线程数]\n", argv[0]);
+            printf(" 用法: %s cpu-stress <秒> [线程数] [cpu=%%,cpus=列表,mem=MB]\n", argv[0]);
             return 1;
         }
         int duration = atoi(argv[2]);
         int threads = (argc >= 4) ? atoi(argv[3]) : 0;
-        inject_cs_cpu_stress(duration, threads);
+        const char *limits = (argc >= 5) ? argv[4] : NULL;
+        inject_cs_cpu_stress(duration, threads, limits);
     }
     else if (strcmp(command, "mem-stress") == 0)
     {
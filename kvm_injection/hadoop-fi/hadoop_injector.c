@@ -10,7 +10,7 @@
  *   - 心跳超时故障：模拟心跳检测失败
  *   - 分布式控制：支持在Master节点统一控制所有Slave节点
  *
- * 编译：gcc -o hadoop_injector hadoop_injector.c -lpthread
+ * 编译：gcc -I../../vm_injection -o hadoop_injector hadoop_injector.c ../../vm_injection/fi_stress.c -lpthread
  */
 
 #include <stdio.h>
@@ -25,6 +25,8 @@
 #include <pthread.h>
 #include <sys/sysinfo.h>
 
+#include "fi_stress.h"
+
 
 //集群配置
 const char *SLAVE_HOSTS[] = {
@@ -96,11 +98,6 @@ typedef enum
     COMPONENT_TASKTRACKER = 11
 } HadoopComponent;
 
-// === 全局变量：资源压力控制 ===
-static volatile int g_stress_running = 0;
-static pthread_t *g_stress_threads = NULL;
-static int g_stress_thread_count = 0;
-
 // === 核心：获取进程真实状态 ===
 char get_proc_state(int pid)
 {
@@ -256,13 +253,13 @@ int *find_mapreduce_pids(const char *task_type, int *count)
     {
         // 搜索包含 YarnChild 且 attempt 参数中有 _m_ 的进程
         snprintf(cmd, sizeof(cmd),
-                 "pgrep -f 'YarnChild.*attempt_.*_m_' 2>/dev/null");
+                 "pgrep -f '[Y]arnChild.*attempt_.*_m_' 2>/dev/null");
     }
     else
     {
         // 搜索包含 YarnChild 且 attempt 参数中有 _r_ 的进程
         snprintf(cmd, sizeof(cmd),
-                 "pgrep -f 'YarnChild.*attempt_.*_r_' 2>/dev/null");
+                 "pgrep -f '[Y]arnChild.*attempt_.*_r_' 2>/dev/null");
     }
 
     FILE *fp = popen(cmd, "r");
@@ -812,45 +809,21 @@ int inject_io_delay(int enable)
 }
 
 // === 模块6：CPU资源耗尽注入 ===
-void *cpu_stress_worker(void *arg)
+// 压力在独立 cgroup 叶子中运行 (fi_stress)，limits 形如 "cpu=80,cpus=1-3,mem=64"
+int inject_cpu_stress(int duration_sec, int num_threads, const char *limits)
 {
-    double x = 0.0;
-    while (g_stress_running)
+    FiStressConfig cfg;
+    fi_stress_defaults(&cfg, "hadoop_cpu");
+    if (limits && limits[0] && fi_stress_parse(&cfg, limits) < 0)
     {
-        x = x + 0.1;
-        if (x > 1000000)
-            x = 0;
-    }
-    return NULL;
-}
-
-int inject_cpu_stress(int duration_sec, int num_threads)
-{
-    if (num_threads <= 0)
-        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
-
-    printf(" [CPU Stress] 启动 %d 个线程, 持续 %d 秒\n", num_threads, duration_sec);
-
-    g_stress_running = 1;
-    g_stress_thread_count = num_threads;
-    g_stress_threads = malloc(num_threads * sizeof(pthread_t));
-
-    for (int i = 0; i < num_threads; i++)
-    {
-        pthread_create(&g_stress_threads[i], NULL, cpu_stress_worker, NULL);
-    }
-
-    sleep(duration_sec);
-
-    g_stress_running = 0;
-    for (int i = 0; i < num_threads; i++)
-    {
-        pthread_join(g_stress_threads[i], NULL);
+        printf(" [CPU Stress] 无法解析限额: %s (cpu=百分比,cpus=列表,mem=MB)\n", limits);
+        return -1;
     }
+    if (num_threads > 0)
+        cfg.threads = num_threads;
 
-    free(g_stress_threads);
-    g_stress_threads = NULL;
-    return 0;
+    printf(" [CPU Stress] 持续 %d 秒, 线程 %d (0=按可用CPU), 上限 %d%%\n", duration_sec, cfg.threads, cfg.cpu_pct);
+    return fi_stress_cpu(&cfg, duration_sec);
 }
 
 // === 模块7：内存资源耗尽注入 ===
@@ -876,6 +849,33 @@ int inject_memory_stress(int size_mb)
     return ret;
 }
 
+// 只对 YarnChild 施加回收压力：任务 JVM 置于 cgroup 中逐步压低 memory.high，直到 PSI stall 达到 stall_pct
+int inject_memory_pressure(double stall_pct, int duration_sec)
+{
+    pid_t pids[FI_MEMPRESS_MAX_PIDS];
+    const char *types[] = {"map", "reduce"};
+    int n = 0;
+
+    for (int t = 0; t < 2; t++)
+    {
+        int count;
+        int *found = find_mapreduce_pids(types[t], &count);
+        for (int i = 0; i < count && n < FI_MEMPRESS_MAX_PIDS; i++)
+            pids[n++] = found[i];
+    }
+    if (n == 0)
+    {
+        printf(" [Mem Pressure] 本节点没有运行中的 YarnChild 任务进程\n");
+        return -1;
+    }
+
+    FiMemPressConfig cfg;
+    fi_mempress_defaults(&cfg);
+    cfg.stall_pct = stall_pct;
+    printf(" [Mem Pressure] %d 个 YarnChild 进程, 目标 stall %.1f%%, 持续 %d 秒\n", n, stall_pct, duration_sec);
+    return fi_mempress(pids, n, &cfg, duration_sec, "hadoop_yarnchild");
+}
+
 // === 模块8：心跳超时模拟 ===
 int inject_heartbeat_timeout(const char *node_ip, int timeout_ms)
 {
@@ -916,7 +916,7 @@ void print_usage(const char *prog)
     printf("  crash-local <comp>\n");
     printf("  hang-local <comp>\n");
     printf("  resume-local <comp>\n");
-    printf("\n  ... (Other resource faults supported: cpu-stress, mem-stress, network, etc.)\n");
+    printf("\n  ... (Other resource faults supported: cpu-stress, mem-stress, mem-pressure, network, etc.)\n");
 }
 
 HadoopComponent parse_component(const char *arg)
@@ -1137,19 +1137,21 @@ int main(int argc, char *argv[])
         system("tc qdisc show dev eth1");
     }
     // cpu-stress 命令：支持远程分发
-    // 用法: ./hadoop_injector cpu-stress <target> <duration> [threads]
+    // 用法: ./hadoop_injector cpu-stress <target> <duration> [threads] [limits]
     else if (strcmp(action, "cpu-stress") == 0)
     {
         if (argc < 4)
         {
-            printf("Usage: %s cpu-stress <target_ip_or_name> <duration_sec> [threads]\n", argv[0]);
+            printf("Usage: %s cpu-stress <target_ip_or_name> <duration_sec> [threads] [cpu=%%,cpus=list,mem=MB]\n", argv[0]);
             printf("Example: %s cpu-stress slave1 10 2\n", argv[0]);
+            printf("Example: %s cpu-stress slave1 60 4 cpu=75,cpus=1-3\n", argv[0]);
             return 1;
         }
 
         const char *input_target = argv[2];
         int duration = atoi(argv[3]);
         int threads = (argc >= 5) ? atoi(argv[4]) : 0;
+        const char *limits = (argc >= 6) ? argv[5] : "";
 
         // --- 1. 定义主机名映射 (确保与 SLAVE_HOSTS 一致) ---
         const char *NODE_NAMES[] = {"slave1", "slave2"};
@@ -1175,10 +1177,10 @@ int main(int argc, char *argv[])
             {
                 is_remote = 1;
                 char remote_cmd[512];
-                // 构造远程命令: ssh ... cpu-stress-local <duration> <threads>
+                // 构造远程命令: ssh ... cpu-stress-local <duration> <threads> [limits]
                 snprintf(remote_cmd, sizeof(remote_cmd),
-                         "ssh root@%s '%s cpu-stress-local %d %d'",
-                         SLAVE_HOSTS[i], REMOTE_TOOL_PATH, duration, threads);
+                         "ssh root@%s '%s cpu-stress-local %d %d %s'",
+                         SLAVE_HOSTS[i], REMOTE_TOOL_PATH, duration, threads, limits);
 
                 printf("[Master] 正在向 %s 发送 CPU 压力指令 (持续%ds)...\n", input_target, duration);
                 // 异步执行 (加上 &)，防止Master一直卡着等Slave跑完
@@ -1194,7 +1196,7 @@ int main(int argc, char *argv[])
         if (!is_remote)
         {
             printf("[Local] 在本机执行 CPU 压力测试...\n");
-            inject_cpu_stress(duration, threads);
+            inject_cpu_stress(duration, threads, limits);
         }
     }
 
@@ -1202,14 +1204,15 @@ int main(int argc, char *argv[])
 
     else if (strcmp(action, "cpu-stress-local") == 0)
     {
-        // 参数: cpu-stress-local <duration> <threads>
+        // 参数: cpu-stress-local <duration> <threads> [limits]
         if (argc < 3)
             return 1;
         int duration = atoi(argv[2]);
         int threads = (argc >= 4) ? atoi(argv[3]) : 0;
+        const char *limits = (argc >= 5) ? argv[4] : "";
 
         printf("[Slave] 收到 CPU 压力指令: %d秒, %d线程\n", duration, threads);
-        inject_cpu_stress(duration, threads);
+        inject_cpu_stress(duration, threads, limits);
     }
     // mem-stress 命令：支持远程分发
     // 用法: ./hadoop_injector mem-stress <target> <size_mb>
@@ -1295,6 +1298,63 @@ int main(int argc, char *argv[])
         }
         printf("[Success] 内存压力已释放。\n");
     }
+    // mem-pressure 命令：只对 YarnChild 施加 cgroup 内存回收压力 (支持远程分发)
+    // 用法: ./hadoop_injector mem-pressure <target> <stall_pct> <duration>
+    else if (strcmp(action, "mem-pressure") == 0)
+    {
+        if (argc < 5)
+        {
+            printf("Usage: %s mem-pressure <target_ip_or_name> <stall_pct> <duration_sec>\n", argv[0]);
+            printf("Example: %s mem-pressure slave1 20 60  (YarnChild PSI stall 20%%)\n", argv[0]);
+            return 1;
+        }
+
+        const char *input_target = argv[2];
+        double stall = atof(argv[3]);
+        int duration = atoi(argv[4]);
+
+        const char *NODE_NAMES[] = {"slave1", "slave2"};
+        char target_ip[64];
+        strcpy(target_ip, input_target);
+        for (int i = 0; i < SLAVE_COUNT; i++)
+        {
+            if (strcmp(input_target, NODE_NAMES[i]) == 0)
+            {
+                strcpy(target_ip, SLAVE_HOSTS[i]);
+                break;
+            }
+        }
+
+        int is_remote = 0;
+        for (int i = 0; i < SLAVE_COUNT; i++)
+        {
+            if (strcmp(target_ip, SLAVE_HOSTS[i]) == 0)
+            {
+                is_remote = 1;
+                char remote_cmd[512];
+                snprintf(remote_cmd, sizeof(remote_cmd),
+                         "ssh root@%s '%s mem-pressure-local %.1f %d'",
+                         SLAVE_HOSTS[i], REMOTE_TOOL_PATH, stall, duration);
+                printf("[Master] 正在向 %s 的 YarnChild 施加内存回收压力 (stall %.1f%%, %ds)...\n", input_target, stall, duration);
+                system(remote_cmd);
+                break;
+            }
+        }
+
+        if (!is_remote)
+        {
+            printf("[Local] 在本机 YarnChild 上施加内存回收压力...\n");
+            inject_memory_pressure(stall, duration);
+        }
+    }
+    // mem-pressure-local：Slave 执行端
+    else if (strcmp(action, "mem-pressure-local") == 0)
+    {
+        if (argc < 4)
+            return 1;
+        printf("[Slave] 收到内存回收压力指令: stall %s%%, %s秒\n", argv[2], argv[3]);
+        inject_memory_pressure(atof(argv[2]), atoi(argv[3]));
+    }
     // loss 命令：网络丢包 (分布式)
     // 用法: ./hadoop_injector loss <target> <percent>
     else if (strcmp(action, "loss") == 0)
@@ -0,0 +1,532 @@
+/*
+ * cache_injector.c - 目标页缓存驱逐注入器
+ * 功能：枚举目标进程打开 (/proc/<pid>/fd) 与映射 (/proc/<pid>/maps) 的普通文件，
+ *       以 cachestat (6.5+，否则 mincore) 统计其驻留页，按周期用 posix_fadvise(POSIX_FADV_DONTNEED)
+ *       整体或按比例驱逐，只让目标 (HDFS DataNode、CloudStack 二级存储) 遭遇冷缓存，无需对整机 drop_caches；
+ *       每轮报告驱逐量与本进程探测的读延迟 (缓存命中 vs 驱逐后)，逐秒报告目标 /proc/<pid>/io 的实际读盘速率。
+ * 编译：gcc -o cache_injector cache_injector.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#ifndef SYS_cachestat
+#define SYS_cachestat 451
+#endif
+
+#define WIN_BYTES (1UL << 20) // 按比例驱逐的粒度：1MB 窗口均匀散布在每个文件中
+#define MAX_FILES 4096
+#define MAX_CODE 1024
+#define MAX_SEGS 65536
+#define PROBE_N 32 // 每轮探测读的页数
+
+volatile int keep_running = 1;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+// === 1. 枚举目标文件 ===
+
+typedef struct
+{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int fd;
+    char path[256];
+} CFile;
+
+static CFile files[MAX_FILES];
+static int nfiles = 0;
+
+static struct
+{
+    dev_t dev;
+    ino_t ino;
+} code[MAX_CODE]; // 以可执行权限映射的文件 (程序与共享库)
+static int ncode = 0;
+
+static const char *prefix = NULL; // -p 只处理该路径前缀下的文件
+static int with_code = 0;         // -x 连同程序与共享库一起驱逐
+
+static int is_code(dev_t dev, ino_t ino)
+{
+    for (int i = 0; i < ncode; i++)
+        if (code[i].dev == dev && code[i].ino == ino)
+            return 1;
+    return 0;
+}
+
+// open_path 用于打开 (对 fd 项为 /proc/<pid>/fd/N，已删除的文件也能打开)，path 用于显示与前缀过滤
+static void add_file(const char *open_path, const char *path)
+{
+    struct stat st;
+
+    if (nfiles >= MAX_FILES || (prefix && strncmp(path, prefix, strlen(prefix)) != 0))
+        return;
+    if (stat(open_path, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return;
+    if (!with_code && is_code(st.st_dev, st.st_ino))
+        return;
+    for (int i = 0; i < nfiles; i++)
+        if (files[i].dev == st.st_dev && files[i].ino == st.st_ino)
+            return;
+
+    int fd = open(open_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM); // 只关闭本进程这个打开实例的预读，探测读不会带回整段
+    CFile *f = &files[nfiles++];
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->size = st.st_size;
+    f->fd = fd;
+    snprintf(f->path, sizeof(f->path), "%s", path);
+}
+
+static void close_files(void)
+{
+    while (nfiles > 0)
+        close(files[--nfiles].fd);
+}
+
+// 每轮重新枚举：DataNode 随时打开新的块文件
+static int collect_files(pid_t pid)
+{
+    char path[64], line[512];
+    FILE *fp;
+
+    close_files();
+    ncode = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    if (!(fp = fopen(path, "r")))
+        return -1;
+    // 第一遍：记录可执行映射的文件
+    while (fgets(line, sizeof(line), fp))
+    {
+        char perms[8], name[256] = "";
+        unsigned long inode;
+        struct stat st;
+        if (sscanf(line, "%*x-%*x %7s %*x %*s %lu %255[^\n]", perms, &inode, name) < 2 || inode == 0 || perms[2] != 'x')
+            continue;
+        if (name[0] == '/' && ncode < MAX_CODE && stat(name, &st) == 0)
+        {
+            code[ncode].dev = st.st_dev;
+            code[ncode].ino = st.st_ino;
+            ncode++;
+        }
+    }
+    // 第二遍：映射的数据文件 (mmap 读的块文件、jar 等)
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp))
+    {
+        char name[256] = "";
+        unsigned long inode;
+        if (sscanf(line, "%*x-%*x %*s %*x %*s %lu %255[^\n]", &inode, name) < 1 || inode == 0 || name[0] != '/')
+            continue;
+        if (strstr(name, " (deleted)"))
+            continue;
+        add_file(name, name);
+    }
+    fclose(fp);
+
+    // 打开的文件描述符
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+    DIR *dir = opendir(path);
+    if (!dir)
+        return -1;
+    struct dirent *de;
+    while ((de = readdir(dir)))
+    {
+        char link[sizeof(path) + sizeof(de->d_name) + 1], target[256];
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(link, sizeof(link), "%s/%s", path, de->d_name);
+        ssize_t n = readlink(link, target, sizeof(target) - 1);
+        if (n <= 0)
+            continue;
+        target[n] = '\0';
+        if (target[0] == '/')
+            add_file(link, target);
+    }
+    closedir(dir);
+    return 0;
+}
+
+// === 2. 驻留统计 ===
+
+struct cachestat_range
+{
+    uint64_t off, len;
+};
+
+struct cachestat
+{
+    uint64_t nr_cache, nr_dirty, nr_writeback, nr_evicted, nr_recently_evicted;
+};
+
+static int use_cachestat = 1;
+static long page_size;
+
+// 文件驻留页数；dirty 为脏页 + 回写中页数 (mincore 无法区分时为 0)
+static long long resident_pages(const CFile *f, long long *dirty)
+{
+    *dirty = 0;
+    if (use_cachestat)
+    {
+        struct cachestat_range r = {0, 0}; // len 0 表示到文件末尾
+        struct cachestat cs;
+        if (syscall(SYS_cachestat, f->fd, &r, &cs, 0) == 0)
+        {
+            *dirty = cs.nr_dirty + cs.nr_writeback;
+            return cs.nr_cache;
+        }
+        if (errno != ENOSYS)
+            return 0;
+        use_cachestat = 0; // 内核早于 6.5，改用 mincore
+    }
+
+    size_t npages = (f->size + page_size - 1) / page_size;
+    void *p = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    unsigned char *vec = malloc(npages);
+    long long n = 0;
+    if (p != MAP_FAILED && vec && mincore(p, f->size, vec) == 0)
+        for (size_t i = 0; i < npages; i++)
+            n += vec[i] & 1;
+    free(vec);
+    if (p != MAP_FAILED)
+        munmap(p, f->size);
+    return n;
+}
+
+typedef struct
+{
+    long long cached, dirty; // 页数
+} Residency;
+
+static void residency(Residency *r)
+{
+    r->cached = r->dirty = 0;
+    for (int i = 0; i < nfiles; i++)
+    {
+        long long d;
+        r->cached += resident_pages(&files[i], &d);
+        r->dirty += d;
+    }
+}
+
+// === 3. 驱逐与探测 ===
+
+typedef struct
+{
+    int file;
+    off_t off, len;
+} Seg;
+
+static Seg segs[MAX_SEGS];
+static int nsegs = 0;
+static unsigned long long seg_bytes = 0;
+
+// 按比例在每个文件中均匀挑选 1MB 窗口，相邻窗口合并
+static void select_segments(double frac)
+{
+    unsigned long long k = 0;
+    nsegs = 0;
+    seg_bytes = 0;
+    for (int i = 0; i < nfiles; i++)
+    {
+        for (off_t w = 0; w < files[i].size; w += WIN_BYTES, k++)
+        {
+            off_t len = files[i].size - w < (off_t)WIN_BYTES ? files[i].size - w : (off_t)WIN_BYTES;
+            if ((unsigned long long)((k + 1) * frac) <= (unsigned long long)(k * frac))
+                continue;
+            if (nsegs > 0 && segs[nsegs - 1].file == i && segs[nsegs - 1].off + segs[nsegs - 1].len == w)
+                segs[nsegs - 1].len += len;
+            else if (nsegs < MAX_SEGS)
+                segs[nsegs++] = (Seg){i, w, len};
+            else
+                continue;
+            seg_bytes += len;
+        }
+    }
+}
+
+static void evict_segments(void)
+{
+    for (int i = 0; i < nsegs; i++)
+        posix_fadvise(files[segs[i].file].fd, segs[i].off, segs[i].len, POSIX_FADV_DONTNEED);
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 在选中区间内随机读 PROBE_N 个页，warm 为真时先读一次再计时第二次 (缓存命中延迟)；
+// 返回平均延迟 (us)，max_us 为最大值，无可探测页返回 -1
+static double probe_read(int warm, double *max_us)
+{
+    char buf[65536];
+    double sum = 0;
+    int n = 0;
+
+    *max_us = 0;
+    if (seg_bytes == 0)
+        return -1;
+    for (int i = 0; i < PROBE_N; i++)
+    {
+        unsigned long long pos = ((unsigned long long)rand() << 31 ^ rand()) % seg_bytes;
+        int s = 0;
+        while (s < nsegs - 1 && pos >= (unsigned long long)segs[s].len)
+            pos -= segs[s++].len;
+        int fd = files[segs[s].file].fd;
+        off_t off = (segs[s].off + pos) & ~(off_t)(page_size - 1);
+        size_t len = page_size < (long)sizeof(buf) ? page_size : sizeof(buf);
+
+        if (warm && pread(fd, buf, len, off) <= 0)
+            continue;
+        long long t0 = now_ns();
+        if (pread(fd, buf, len, off) <= 0)
+            continue;
+        double us = (now_ns() - t0) / 1000.0;
+        sum += us;
+        if (us > *max_us)
+            *max_us = us;
+        n++;
+    }
+    return n ? sum / n : -1;
+}
+
+// === 4. 目标 I/O ===
+
+typedef struct
+{
+    unsigned long long read_bytes; // /proc/<pid>/io：实际从存储读取的字节
+    unsigned long majflt;          // /proc/<pid>/stat：mmap 读文件未命中缓存
+} TargetIO;
+
+static int read_target(pid_t pid, TargetIO *t)
+{
+    char path[64], line[1024];
+    FILE *fp;
+
+    t->read_bytes = 0;
+    t->majflt = 0;
+    snprintf(path, sizeof(path), "/proc/%d/io", pid);
+    if ((fp = fopen(path, "r")))
+    {
+        while (fgets(line, sizeof(line), fp))
+            if (strncmp(line, "read_bytes:", 11) == 0)
+                t->read_bytes = strtoull(line + 11, NULL, 10);
+        fclose(fp);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    if (!(fp = fopen(path, "r")))
+        return -1;
+    if (!fgets(line, sizeof(line), fp))
+        line[0] = '\0';
+    fclose(fp);
+    char *p = strrchr(line, ')');
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %lu", &t->majflt) != 1)
+        return -1;
+    return 0;
+}
+
+// === 5. 主流程 ===
+
+int main(int argc, char *argv[])
+{
+    double pct = 100;
+    int interval_ms = 5000, list = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+f:i:p:xl")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            pct = atof(optarg);
+            break;
+        case 'i':
+            interval_ms = atoi(optarg);
+            break;
+        case 'p':
+            prefix = optarg;
+            break;
+        case 'x':
+            with_code = 1;
+            break;
+        case 'l':
+            list = 1;
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    if (argc < 3)
+    {
+        printf("用法: %s [-f 比例%%] [-i 周期ms] [-p 路径前缀] [-x] [-l] <PID> <Duration_Sec>\n", argv[0]);
+        printf("  -f 比例   每个文件驱逐的百分比，按 1MB 窗口均匀散布 (默认 100)\n");
+        printf("  -i 周期   重复驱逐的周期 (默认 5000ms)\n");
+        printf("  -p 前缀   只处理该路径前缀下的文件 (如 /data/hdfs)\n");
+        printf("  -x        连同以可执行权限映射的程序与共享库一起驱逐 (默认跳过)\n");
+        printf("  -l        列出每个文件的大小与驻留量\n");
+        printf("  Duration  总时长，0 为只驱逐一次\n");
+        printf("示例: sudo %s -p /data/dfs $(pgrep -f [D]ataNode) 60\n", argv[0]);
+        printf("      sudo %s -f 50 -i 1000 -l 1234 30\n", argv[0]);
+        return 1;
+    }
+
+    pid_t pid = atoi(argv[1]);
+    int duration = atoi(argv[2]);
+    if (pid <= 0 || pct <= 0 || pct > 100 || interval_ms < 100 || duration < 0)
+    {
+        printf("[错误] 比例需在 (0,100]，周期不少于 100ms，时长不能为负\n");
+        return 1;
+    }
+    page_size = sysconf(_SC_PAGESIZE);
+    srand(getpid());
+
+    if (collect_files(pid) < 0)
+    {
+        printf("[错误] 无法读取 /proc/%d (进程不存在或权限不足)\n", pid);
+        return 1;
+    }
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    select_segments(pct / 100.0);
+    Residency r0;
+    residency(&r0);
+    printf("=== 目标页缓存驱逐注入器 ===\n");
+    printf("目标 PID: %d，文件 %d 个%s%s，驻留 %.1f MB，驱逐比例 %.0f%% (%.1f MB)，驻留统计: %s\n", pid, nfiles,
+           prefix ? "，前缀 " : "", prefix ? prefix : "", r0.cached * page_size / 1048576.0, pct,
+           seg_bytes / 1048576.0, use_cachestat ? "cachestat" : "mincore");
+    if (list)
+    {
+        for (int i = 0; i < nfiles; i++)
+        {
+            long long d, c = resident_pages(&files[i], &d);
+            printf("  %10.1f MB  驻留 %8.1f MB  %s\n", files[i].size / 1048576.0, c * page_size / 1048576.0, files[i].path);
+        }
+    }
+    if (nfiles == 0)
+    {
+        printf("[提示] 目标没有可处理的普通文件\n");
+        return 0;
+    }
+
+    // 基线：目标 1 秒内的读盘量与缓存命中读延迟
+    TargetIO t0, prev, cur;
+    double hot_max, cold_max;
+    read_target(pid, &prev);
+    if (duration > 0)
+        sleep(1);
+    read_target(pid, &t0);
+    double hot = probe_read(1, &hot_max);
+    double base_rate = (t0.read_bytes - prev.read_bytes) / 1048576.0;
+    if (duration > 0)
+        printf("基线: 目标读盘 %.2f MB/s，缓存命中读延迟 平均 %.1f us / 最大 %.1f us\n", base_rate, hot, hot_max);
+    printf("\n");
+    prev = t0;
+
+    long long start = now_ns() / 1000000, next_round = start, end = start + duration * 1000LL;
+    long long evicted_total = 0;
+    double cold_sum = 0;
+    int rounds = 0, sec = 0, cold_n = 0;
+
+    while (keep_running)
+    {
+        long long now = now_ns() / 1000000;
+        if (now >= next_round)
+        {
+            Residency before, after;
+            if (rounds > 0)
+            {
+                if (collect_files(pid) < 0)
+                {
+                    printf("[提示] 目标进程 %d 已退出\n", pid);
+                    break;
+                }
+                select_segments(pct / 100.0);
+            }
+            residency(&before);
+            evict_segments();
+            residency(&after);
+            double cold = probe_read(0, &cold_max);
+            long long ev = before.cached > after.cached ? before.cached - after.cached : 0;
+            evicted_total += ev;
+            rounds++;
+            printf("[第 %d 轮] 文件 %d 个，驻留 %.1f -> %.1f MB，驱逐 %.1f MB", rounds, nfiles,
+                   before.cached * page_size / 1048576.0, after.cached * page_size / 1048576.0, ev * page_size / 1048576.0);
+            if (after.dirty > 0)
+                printf(" (脏页/回写中 %lld 页未能丢弃)", after.dirty);
+            if (cold >= 0)
+            {
+                printf("，驱逐后读延迟 平均 %.1f us / 最大 %.1f us", cold, cold_max);
+                cold_sum += cold;
+                cold_n++;
+            }
+            printf("\n");
+            fflush(stdout);
+            while (next_round <= now_ns() / 1000000)
+                next_round += interval_ms;
+            if (duration == 0)
+                break;
+            continue;
+        }
+
+        long long wake = start + (sec + 1) * 1000LL;
+        if (now < wake)
+        {
+            usleep(((wake < next_round ? wake : next_round) - now) * 1000);
+            continue;
+        }
+
+        sec++;
+        if (read_target(pid, &cur) < 0)
+        {
+            printf("[提示] 目标进程 %d 已退出\n", pid);
+            break;
+        }
+        printf("  %4d 秒  目标读盘 %8.2f MB/s  majflt %6lu/s\n", sec,
+               (cur.read_bytes - prev.read_bytes) / 1048576.0, cur.majflt - prev.majflt);
+        fflush(stdout);
+        prev = cur;
+        if (now >= end)
+            break;
+    }
+
+    printf("\n[结果] 共 %d 轮，驱逐 %.1f MB", rounds, evicted_total * page_size / 1048576.0);
+    if (sec > 0)
+        printf("，目标平均读盘 %.2f MB/s (基线 %.2f MB/s)", (prev.read_bytes - t0.read_bytes) / 1048576.0 / sec, base_rate);
+    if (cold_n > 0 && hot > 0)
+        printf("，探测读延迟 %.1f us -> %.1f us (%.0f 倍)", hot, cold_sum / cold_n, cold_sum / cold_n / hot);
+    printf("\n");
+    printf("注意：被进程 mmap 映射中的页与脏页不会被 POSIX_FADV_DONTNEED 丢弃。\n");
+    close_files();
+    return 0;
+}
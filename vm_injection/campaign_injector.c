@@ -0,0 +1,1125 @@
+/*
+ * campaign_injector.c - 并行注入战役
+ * 功能：读取故障空间描述 (靶子 × 位置 × 故障类型 × 位 × 触发时刻)，展开为实验列表并打乱顺序，
+ *       由绑定到各 CPU 的工作进程并发执行；每个工作进程为每个靶子维护一个 fork-server，
+ *       先做黄金运行，再逐个实验注入并分类为 masked/detected/sdc/crash/hang。
+ *       试验子进程全程由 fi_monitor 跟踪：致命信号、心跳停止、超时均为事件驱动检测。
+ *       运行期间实时显示吞吐、剩余队列与各类结果计数；设置 FI_RESULTS 时每次实验追加到结果库。
+ *       -m 开启序贯抽样：按 (靶子, 故障位置) 分层，某层各结果类别的置信区间都窄于误差限后，
+ *       该层剩余的实验直接跳过，全部收敛即提前结束。
+ *       靶子节给出 sites (fi_prune 生成的代表点文件) 时改为只注入代表点：断点精确定位注入时刻，
+ *       汇总时按代表点权重加上已证明 masked 的部分，还原出完整故障空间的结果分布。
+ *       -N 按节点列表经 ssh 把战役分发到多个节点 (fi_dist)：节点以 -W 服务模式运行同一战役文件，
+ *       按编号领取实验、把结果逐条流回协调端，空闲节点从繁忙节点窃取任务，失联节点的在途实验自动重试。
+ * 编译：gcc -o campaign_injector campaign_injector.c fi_forksrv.c fi_monitor.c fi_target.c fi_fault.c fi_trigger.c fi_sys.c fi_results.c fi_stats.c fi_trace.c fi_dist.c -lm
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/personality.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "fi_dist.h"
+#include "fi_forksrv.h"
+#include "fi_results.h"
+#include "fi_stats.h"
+#include "fi_trace.h"
+#include "fi_trigger.h"
+
+#define MAX_TARGETS 16
+#define MAX_ITEMS 64
+#define MAX_ARGS 32
+#define MAX_WORKERS 256
+
+// === 故障空间 ===
+typedef struct
+{
+    char name[64];
+    char *argv[MAX_ARGS + 1];
+    char *locs[MAX_ITEMS];
+    int nlocs;
+    FaultType types[MAX_ITEMS];
+    int ntypes;
+    int bits[MAX_ITEMS]; // -1 = 随机
+    int nbits;
+    long at_us[MAX_ITEMS];
+    int nat;
+    int repeat;
+    int timeout_ms;
+    int hb_timeout_ms;
+    // 代表点模式：locs 改为分层名 (每个寄存器一层，内存一层)
+    char *sites_path;
+    FiSite *sites;
+    size_t nsites;
+    uint64_t live_weight;   // 代表点 (live/out) 的权重之和
+    uint64_t masked_weight; // 已证明 masked 的注入点数
+} CampTarget;
+
+// 展开后的单个实验
+typedef struct
+{
+    uint8_t target;
+    uint8_t loc;
+    uint8_t type;
+    int8_t bit;
+    uint32_t at_us;
+    uint32_t site; // 代表点模式下的代表点下标
+} Experiment;
+
+typedef struct
+{
+    int id;
+    int cpu;
+    pid_t pid;
+    FiMonitor *mon;
+    FiForkServer fs[MAX_TARGETS];
+    FiTrialResult golden[MAX_TARGETS];
+    FiFaultLoc locs[MAX_TARGETS][MAX_ITEMS];
+    int state[MAX_TARGETS]; // 0=未启动, 1=就绪, -1=不可用
+} CampWorker;
+
+static CampTarget targets[MAX_TARGETS];
+static int ntargets = 0;
+static Experiment *exps = NULL;
+static long nexps = 0;
+
+// 工作进程间共享的进度与计数 (MAP_SHARED，原子操作)
+typedef struct
+{
+    long next_exp;
+    long done_exps;
+    long errors;
+    long outcome_count[MAX_TARGETS][FI_OUT_COUNT];
+    long detect_n;
+    uint64_t detect_ns_sum;
+    // 序贯抽样：分层 = (靶子, 故障位置)
+    long stratum_count[MAX_TARGETS][MAX_ITEMS][FI_OUT_COUNT];
+    int converged[MAX_TARGETS][MAX_ITEMS];
+    long nconverged;
+    long skipped;
+    // 代表点模式：各结果类别累计的代表点权重
+    uint64_t weighted[MAX_TARGETS][FI_OUT_COUNT];
+    // 服务模式 (-W)：主进程把协调端发来的编号追加到 queue，工作进程按 next_exp 依次领取
+    long q_tail;
+    int q_closed;
+} CampShared;
+
+static volatile int keep_running = 1;
+static CampShared *shared = NULL;
+static int csv_fd = -1;
+static unsigned int seed;
+
+// 分布式执行：serve_mode 为节点侧服务模式，node_label 为本机名；协调端结果写入 coord_results
+static int serve_mode = 0;
+static int reply_fd = STDOUT_FILENO;
+static char node_label[32];
+static long *queue = NULL;
+static FiResults *coord_results = NULL;
+
+// 序贯抽样参数 (margin <= 0 表示关闭)
+static double margin = 0.0;
+static double confidence = 0.95;
+static FiCiMethod ci_method = FI_CI_WILSON;
+static long min_samples = 30;
+static int nstrata = 0;
+
+void sigint_handler(int sig)
+{
+    keep_running = 0;
+}
+
+void print_help(const char *prog)
+{
+    printf("用法: %s [-j workers] [-o results.csv] [-s seed] [-m margin [-c conf] [-M wilson|cp] [-n min]] [-N nodes [-D dir]] <campaign.conf>\n", prog);
+    printf("选项:\n");
+    printf("  -j <workers>  工作进程数 (默认为 CPU 数，每个绑定一个 CPU)\n");
+    printf("  -o <file>     逐条实验结果 (CSV)\n");
+    printf("  -s <seed>     打乱实验顺序与随机位的种子\n");
+    printf("序贯抽样 (按 靶子×故障位置 分层，提前停止):\n");
+    printf("  -m <margin>   置信区间半宽上限，如 0.05 表示 ±5%%；每层样本上限为该层展开的实验数\n");
+    printf("                (type × bit × at × repeat；sites 靶子为该位置的代表点数 × type × bit × repeat)\n");
+    printf("  -c <conf>     置信度 (默认 0.95)\n");
+    printf("  -M <method>   wilson (默认) 或 cp (Clopper-Pearson 精确区间)\n");
+    printf("  -n <min>      每层最少样本数 (默认 30)\n");
+    printf("分布式执行 (工作窃取):\n");
+    printf("  -N <nodes>    节点列表 (名称,地址,SSH端口，同 kvm_injection/cluster.conf；地址 local 表示本机)\n");
+    printf("  -D <dir>      节点上 campaign_injector 与靶子所在目录 (默认为当前目录)\n");
+    printf("                此时 -j 为每个节点的工作进程数 (默认为节点 CPU 数)\n");
+    printf("                有在途实验却超过 10×最大 timeout (至少 60 秒) 没有输出的节点按失联处理\n");
+    printf("  -W            节点服务模式 (由协调端经 ssh 启动，战役文件为 - 时从标准输入读取)\n");
+    printf("故障空间文件 (每个 [节] 是一个靶子，节内各项做笛卡尔积):\n");
+    printf("  [target_reg]\n");
+    printf("  cmd     ./target_reg\n");
+    printf("  loc     reg:X19\n");
+    printf("  type    flip1 add1\n");
+    printf("  bit     0-63        (或 0,8,16 / 3 17 40 / rand)\n");
+    printf("  at      0 2000 4000 (fork 后注入时刻, 微秒)\n");
+    printf("  repeat  3\n");
+    printf("  timeout 1000        (毫秒)\n");
+    printf("  heartbeat 100       (心跳停止多久判定为 hang, 毫秒, 0=只看超时)\n");
+    printf("  sites   reg.sites   (fi_prune 的代表点文件，代替 loc/at；按寄存器/内存分层)\n");
+}
+
+// === 1. 故障空间解析 ===
+static int parse_bits(CampTarget *t, char *tok)
+{
+    if (strcmp(tok, "rand") == 0)
+    {
+        if (t->nbits < MAX_ITEMS)
+            t->bits[t->nbits++] = -1;
+        return 0;
+    }
+    // 外层按行分词仍在进行，这里只能用 strtok_r
+    char *save;
+    for (char *p = strtok_r(tok, ",", &save); p; p = strtok_r(NULL, ",", &save))
+    {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (end == p)
+            return -1;
+        if (*end == '-')
+        {
+            char *q = end + 1;
+            hi = strtol(q, &end, 10);
+            if (end == q)
+                return -1;
+        }
+        if (*end != '\0' || lo < 0 || hi > 63 || lo > hi)
+            return -1;
+        for (long b = lo; b <= hi && t->nbits < MAX_ITEMS; b++)
+            t->bits[t->nbits++] = (int)b;
+    }
+    return 0;
+}
+
+// 读入代表点：masked 行只计入权重，live/out 行按位置归入分层
+static int load_sites(CampTarget *t)
+{
+    FiSite *all;
+    size_t nall;
+    if (fi_trace_load_sites(t->sites_path, &all, &nall) < 0)
+    {
+        fprintf(stderr, "[-] [%s] 无法读取代表点文件: %s\n", t->name, t->sites_path);
+        return -1;
+    }
+    t->sites = all;
+    t->nsites = 0;
+    t->nlocs = 0;
+    for (size_t i = 0; i < nall; i++)
+    {
+        if (all[i].kind == FI_SITE_MASKED)
+        {
+            t->masked_weight += all[i].weight;
+            continue;
+        }
+        t->live_weight += all[i].weight;
+        t->sites[t->nsites++] = all[i];
+
+        const char *name = strncmp(all[i].loc, "mem:", 4) == 0 ? "mem" : all[i].loc;
+        int l;
+        for (l = 0; l < t->nlocs; l++)
+            if (strcmp(t->locs[l], name) == 0)
+                break;
+        if (l == t->nlocs && t->nlocs < MAX_ITEMS)
+            t->locs[t->nlocs++] = strdup(name);
+    }
+    if (t->nsites == 0)
+    {
+        fprintf(stderr, "[-] [%s] 代表点文件中没有需要实验的代表点\n", t->name);
+        return -1;
+    }
+    // 代表点自带注入时刻
+    t->nat = 1;
+    t->at_us[0] = 0;
+    return 0;
+}
+
+// 代表点所属的分层
+static int site_stratum(const CampTarget *t, const FiSite *site)
+{
+    const char *name = strncmp(site->loc, "mem:", 4) == 0 ? "mem" : site->loc;
+    for (int l = 0; l < t->nlocs; l++)
+        if (strcmp(t->locs[l], name) == 0)
+            return l;
+    return 0;
+}
+
+int load_campaign(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        perror("打开故障空间文件失败");
+        return -1;
+    }
+
+    char line[1024];
+    int lineno = 0;
+    CampTarget *t = NULL;
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        char *p = line;
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            continue;
+
+        if (*p == '[')
+        {
+            if (ntargets >= MAX_TARGETS)
+                break;
+            t = &targets[ntargets++];
+            memset(t, 0, sizeof(*t));
+            t->repeat = 1;
+            t->timeout_ms = 1000;
+            sscanf(p + 1, "%63[^]]", t->name);
+            continue;
+        }
+        if (!t)
+        {
+            fprintf(stderr, "[-] 第 %d 行: 缺少 [靶子] 节\n", lineno);
+            fclose(fp);
+            return -1;
+        }
+
+        char *key = strtok(p, " \t\r\n");
+        int nargs = 0;
+        for (char *tok = strtok(NULL, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n"))
+        {
+            if (strcmp(key, "cmd") == 0 && nargs < MAX_ARGS)
+                t->argv[nargs++] = strdup(tok);
+            else if (strcmp(key, "loc") == 0 && t->nlocs < MAX_ITEMS)
+                t->locs[t->nlocs++] = strdup(tok);
+            else if (strcmp(key, "type") == 0 && t->ntypes < MAX_ITEMS)
+                t->types[t->ntypes++] = fi_fault_parse(tok);
+            else if (strcmp(key, "at") == 0 && t->nat < MAX_ITEMS)
+                t->at_us[t->nat++] = atol(tok);
+            else if (strcmp(key, "repeat") == 0)
+                t->repeat = atoi(tok);
+            else if (strcmp(key, "timeout") == 0)
+                t->timeout_ms = atoi(tok);
+            else if (strcmp(key, "heartbeat") == 0)
+                t->hb_timeout_ms = atoi(tok);
+            else if (strcmp(key, "sites") == 0)
+                t->sites_path = strdup(tok);
+            else if (strcmp(key, "bit") == 0)
+            {
+                // parse_bits 会切开逗号，报错时用原文
+                char spec[64];
+                snprintf(spec, sizeof(spec), "%s", tok);
+                if (parse_bits(t, tok) < 0)
+                {
+                    fprintf(stderr, "[-] 第 %d 行: 无效的位: %s\n", lineno, spec);
+                    fclose(fp);
+                    return -1;
+                }
+            }
+        }
+    }
+    fclose(fp);
+
+    for (int i = 0; i < ntargets; i++)
+    {
+        t = &targets[i];
+        if (t->sites_path && load_sites(t) < 0)
+            return -1;
+        if (!t->argv[0] || t->nlocs == 0)
+        {
+            fprintf(stderr, "[-] [%s] 缺少 cmd 或 loc\n", t->name);
+            return -1;
+        }
+        if (t->ntypes == 0)
+            t->types[t->ntypes++] = FAULT_1_BIT_FLIP;
+        if (t->nbits == 0)
+            t->bits[t->nbits++] = -1;
+        if (t->nat == 0)
+            t->at_us[t->nat++] = 0;
+    }
+    return ntargets > 0 ? 0 : -1;
+}
+
+// 展开笛卡尔积并打乱，部分完成的战役也是整个空间的无偏样本
+int expand_campaign(void)
+{
+    nexps = 0;
+    for (int i = 0; i < ntargets; i++)
+    {
+        CampTarget *t = &targets[i];
+        if (t->sites)
+            nexps += (long)t->nsites * t->ntypes * t->nbits * t->repeat;
+        else
+            nexps += (long)t->nlocs * t->ntypes * t->nbits * t->nat * t->repeat;
+    }
+    exps = calloc(nexps, sizeof(Experiment));
+    if (!exps)
+        return -1;
+
+    long n = 0;
+    for (int i = 0; i < ntargets; i++)
+    {
+        CampTarget *t = &targets[i];
+        for (size_t s = 0; t->sites && s < t->nsites; s++)
+            for (int ty = 0; ty < t->ntypes; ty++)
+                for (int b = 0; b < t->nbits; b++)
+                    for (int r = 0; r < t->repeat; r++)
+                    {
+                        Experiment *e = &exps[n++];
+                        e->target = i;
+                        e->loc = site_stratum(t, &t->sites[s]);
+                        e->type = t->types[ty];
+                        e->bit = t->bits[b];
+                        e->site = (uint32_t)s;
+                    }
+        for (int l = 0; !t->sites && l < t->nlocs; l++)
+            for (int ty = 0; ty < t->ntypes; ty++)
+                for (int b = 0; b < t->nbits; b++)
+                    for (int a = 0; a < t->nat; a++)
+                        for (int r = 0; r < t->repeat; r++)
+                        {
+                            Experiment *e = &exps[n++];
+                            e->target = i;
+                            e->loc = l;
+                            e->type = t->types[ty];
+                            e->bit = t->bits[b];
+                            e->at_us = (uint32_t)t->at_us[a];
+                        }
+    }
+
+    for (long i = nexps - 1; i > 0; i--)
+    {
+        long j = ((long)rand() * RAND_MAX + rand()) % (i + 1);
+        Experiment tmp = exps[i];
+        exps[i] = exps[j];
+        exps[j] = tmp;
+    }
+    return 0;
+}
+
+// === 2. 序贯停止判定 ===
+// 分层内已注入的样本 (不含 nofault/unreached) 达到下限，且每个结果类别的区间半宽都不超过 margin
+static int stratum_converged(int ti, int li)
+{
+    const long *cnt = shared->stratum_count[ti][li];
+    long n = 0;
+    for (int o = 0; o < FI_OUT_COUNT; o++)
+        if (o < FI_OUT_NOFAULT)
+            n += cnt[o];
+
+    double max_half = 0.5;
+    if (n > 0)
+    {
+        max_half = 0.0;
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+        {
+            if (o >= FI_OUT_NOFAULT)
+                continue;
+            double lo, hi;
+            fi_stats_ci(ci_method, (uint64_t)cnt[o], (uint64_t)n, confidence, &lo, &hi);
+            if ((hi - lo) / 2 > max_half)
+                max_half = (hi - lo) / 2;
+        }
+    }
+    return n >= min_samples && max_half <= margin;
+}
+
+// === 3. 工作进程 ===
+// 下一个实验编号，-1 表示没有更多；服务模式下等待协调端派发
+static long next_experiment(void)
+{
+    long pos = __sync_fetch_and_add(&shared->next_exp, 1);
+    if (!serve_mode)
+        return pos < nexps ? pos : -1;
+    while (keep_running)
+    {
+        int closed = shared->q_closed;
+        __sync_synchronize();
+        if (pos < shared->q_tail)
+            return queue[pos];
+        if (closed)
+            return -1;
+        usleep(1000);
+    }
+    return -1;
+}
+
+// 向协调端回写一行 (服务模式)，单次 write 不超过 PIPE_BUF，多个工作进程不会交错
+static void serve_reply(const char *line, int len)
+{
+    if (write(reply_fd, line, len) != len)
+        keep_running = 0; // 协调端已断开
+}
+
+static void experiment_failed(long idx)
+{
+    if (serve_mode)
+    {
+        char line[32];
+        serve_reply(line, snprintf(line, sizeof(line), "E %ld\n", idx));
+        return;
+    }
+    __sync_fetch_and_add(&shared->errors, 1);
+    __sync_fetch_and_add(&shared->done_exps, 1);
+}
+
+// 记录一次实验结果：计数、分层收敛、结果库与 CSV (本地工作进程与协调端共用)
+static void record_result(long idx, const char *worker, const FiTrialResult *res, FiOutcome out,
+                          FiResults *results)
+{
+    Experiment *e = &exps[idx];
+    CampTarget *t = &targets[e->target];
+    const FiSite *site = t->sites ? &t->sites[e->site] : NULL;
+    const char *site_name = site ? site->loc : t->locs[e->loc];
+
+    __sync_fetch_and_add(&shared->outcome_count[e->target][out], 1);
+    if (site)
+        __sync_fetch_and_add(&shared->weighted[e->target][out], site->weight);
+    __sync_fetch_and_add(&shared->stratum_count[e->target][e->loc][out], 1);
+    if (margin > 0 && !shared->converged[e->target][e->loc] && stratum_converged(e->target, e->loc) &&
+        __sync_bool_compare_and_swap(&shared->converged[e->target][e->loc], 0, 1))
+        __sync_fetch_and_add(&shared->nconverged, 1);
+    // 只统计真正被发现的故障；masked/sdc 的"检测"只是子进程正常退出
+    if (res->detect_ns && (out == FI_OUT_DETECTED || out == FI_OUT_CRASH || out == FI_OUT_HANG))
+    {
+        __sync_fetch_and_add(&shared->detect_n, 1);
+        __sync_fetch_and_add(&shared->detect_ns_sum, res->detect_ns);
+    }
+    __sync_fetch_and_add(&shared->done_exps, 1);
+
+    FiResultRow row = {0};
+    row.dur_ns = res->elapsed_ns;
+    row.target = t->name;
+    row.site = site_name;
+    row.model = fi_fault_name((FaultType)e->type);
+    row.outcome = fi_outcome_name(out);
+    row.bit = e->bit;
+    row.addr = res->addr;
+    row.old_val = res->old_val;
+    row.new_val = res->new_val;
+    row.signal = res->fatal_sig;
+    fi_results_add(results, &row);
+
+    if (csv_fd >= 0)
+    {
+        // O_APPEND 下单次 write 整行，多个进程不会交错
+        char line[512];
+        int len = snprintf(line, sizeof(line), "%ld,%s,%s,%s,%d,%u,%s,%d,0x%lx,0x%lx,0x%lx,%s,%d,%.1f,%.1f\n",
+                           idx, t->name, site_name, fi_fault_name((FaultType)e->type), e->bit, e->at_us, worker,
+                           res->pid, (unsigned long)res->addr, (unsigned long)res->old_val,
+                           (unsigned long)res->new_val, fi_outcome_name(out), res->fatal_sig,
+                           res->detect_ns / 1000.0, res->elapsed_ns / 1000.0);
+        if (write(csv_fd, line, len) < 0)
+            perror("写结果文件失败");
+    }
+}
+
+// 按需为靶子启动 fork-server、做黄金运行并解析位置
+static int ensure_server(CampWorker *w, int ti)
+{
+    if (w->state[ti] != 0)
+        return w->state[ti];
+
+    CampTarget *t = &targets[ti];
+    w->state[ti] = -1;
+    if (fi_forksrv_start(&w->fs[ti], t->argv, w->cpu, 1) < 0)
+        return -1;
+    w->fs[ti].mon = w->mon;
+
+    // 代表点的位置在实验时逐个解析
+    for (int l = 0; !t->sites && l < t->nlocs; l++)
+    {
+        if (fi_fault_parse_loc(t->locs[l], w->fs[ti].server, &w->locs[ti][l]) < 0)
+        {
+            fprintf(stderr, "\n[-] [%s] 无法解析位置: %s\n", t->name, t->locs[l]);
+            fi_forksrv_stop(&w->fs[ti]);
+            return -1;
+        }
+    }
+
+    FiTrialSpec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.timeout_ms = t->timeout_ms;
+    spec.hb_timeout_ms = t->hb_timeout_ms;
+    FiTrialResult *g = &w->golden[ti];
+    if (fi_forksrv_trial(&w->fs[ti], &spec, g) < 0 || g->hang ||
+        !WIFEXITED(g->status) || WEXITSTATUS(g->status) != FI_EXIT_OK)
+    {
+        fprintf(stderr, "\n[-] [%s] 工作进程 %d 黄金运行失败\n", t->name, w->id);
+        fi_forksrv_stop(&w->fs[ti]);
+        return -1;
+    }
+    w->state[ti] = 1;
+    return 1;
+}
+
+static void worker_main(CampWorker *w)
+{
+    // 每个工作进程独立的随机序列 (随机位、随机内存字)
+    srand(seed ^ (unsigned int)(w->id * 2654435761U));
+    w->mon = fi_monitor_create();
+    if (!w->mon)
+    {
+        perror("创建监视器失败");
+        return;
+    }
+    FiResults *results = fi_results_open_env("campaign_injector");
+
+    char worker[48];
+    if (serve_mode)
+        snprintf(worker, sizeof(worker), "%s:%d", node_label, w->id);
+    else
+        snprintf(worker, sizeof(worker), "%d", w->id);
+
+    while (keep_running)
+    {
+        long idx = next_experiment();
+        if (idx < 0)
+            break;
+
+        Experiment *e = &exps[idx];
+        CampTarget *t = &targets[e->target];
+        // 实验顺序已打乱，跳过已收敛层的剩余实验不会使其他层的样本产生偏差
+        if (margin > 0 && shared->converged[e->target][e->loc])
+        {
+            __sync_fetch_and_add(&shared->skipped, 1);
+            __sync_fetch_and_add(&shared->done_exps, 1);
+            continue;
+        }
+        if (ensure_server(w, e->target) < 0)
+        {
+            experiment_failed(idx);
+            continue;
+        }
+
+        FiTrialSpec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.inject = 1;
+        spec.loc = w->locs[e->target][e->loc];
+        spec.type = (FaultType)e->type;
+        spec.bit = e->bit;
+        spec.delay_ns = (uint64_t)e->at_us * 1000ULL;
+        spec.timeout_ms = t->timeout_ms;
+        spec.hb_timeout_ms = t->hb_timeout_ms;
+        const FiSite *site = t->sites ? &t->sites[e->site] : NULL;
+        if (site)
+        {
+            if (fi_trace_site_loc(site, &spec.loc, &spec.sp_rel) < 0)
+            {
+                experiment_failed(idx);
+                continue;
+            }
+            spec.bp_pc = site->pc;
+            spec.bp_hit = site->hit;
+            spec.delay_ns = 0;
+        }
+
+        FiTrialResult res;
+        if (fi_forksrv_trial(&w->fs[e->target], &spec, &res) < 0)
+        {
+            // server 失效：下次用到该靶子时重新启动
+            fi_forksrv_stop(&w->fs[e->target]);
+            w->state[e->target] = 0;
+            experiment_failed(idx);
+            continue;
+        }
+        FiOutcome out = fi_forksrv_classify(&res, &w->golden[e->target]);
+
+        if (serve_mode)
+        {
+            char line[256];
+            int len = snprintf(line, sizeof(line), "R %ld %d %s %d %lx %lx %lx %d %lu %lu\n", idx, (int)out, worker,
+                               res.pid, (unsigned long)res.addr, (unsigned long)res.old_val,
+                               (unsigned long)res.new_val, res.fatal_sig, (unsigned long)res.detect_ns,
+                               (unsigned long)res.elapsed_ns);
+            serve_reply(line, len);
+            continue;
+        }
+        record_result(idx, worker, &res, out, results);
+    }
+
+    for (int i = 0; i < ntargets; i++)
+    {
+        if (w->state[i] == 1)
+            fi_forksrv_stop(&w->fs[i]);
+    }
+    fi_results_close(results);
+    fi_monitor_destroy(w->mon);
+}
+
+// === 4. 实时状态 ===
+static void print_status(double secs, long done, double rate)
+{
+    long total[FI_OUT_COUNT] = {0};
+    for (int i = 0; i < ntargets; i++)
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+            total[o] += shared->outcome_count[i][o];
+
+    printf("\r[%6.1fs] %ld/%ld (%5.1f%%) 队列 %-7ld %7.1f 次/秒 |", secs, done, nexps,
+           nexps ? 100.0 * done / nexps : 0.0, nexps - done, rate);
+    for (int o = 0; o < FI_OUT_COUNT; o++)
+        printf(" %s %ld", fi_outcome_name((FiOutcome)o), total[o]);
+    if (shared->errors)
+        printf(" error %ld", shared->errors);
+    if (margin > 0)
+        printf(" | 收敛 %ld/%d 跳过 %ld", shared->nconverged, nstrata, shared->skipped);
+    printf("   ");
+    fflush(stdout);
+}
+
+// 每秒刷新一次状态行，吞吐取最近一秒
+static uint64_t start_ns, last_ns;
+static long last_done;
+
+static void progress_tick(void)
+{
+    uint64_t now = fi_now_ns();
+    if (now - last_ns < 1000000000ULL)
+        return;
+    long done = shared->done_exps;
+    print_status((now - start_ns) / 1e9, done, (done - last_done) * 1e9 / (now - last_ns));
+    last_done = done;
+    last_ns = now;
+}
+
+// 工作进程而非线程：每个工作进程拥有独立的 SIGCHLD 与监视器
+static int start_workers(CampWorker *workers, int nworkers, long ncpu)
+{
+    fflush(stdout);
+    int alive = 0;
+    for (int i = 0; i < nworkers; i++)
+    {
+        workers[i].id = i;
+        workers[i].cpu = (int)(i % ncpu);
+        workers[i].pid = fork();
+        if (workers[i].pid == 0)
+        {
+            // 服务模式下节点主进程失联 (ssh 断开) 时工作进程随之结束
+            if (serve_mode)
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+            worker_main(&workers[i]);
+            _exit(0);
+        }
+        if (workers[i].pid > 0)
+            alive++;
+        else
+            perror("fork");
+    }
+    return alive;
+}
+
+// === 5. 分布式执行 ===
+static FiDist dist;
+static int distributed = 0;
+
+// 实验顺序已打乱，与本地模式相同，派发前跳过已收敛层的实验
+static int dist_skip(void *ctx, long idx)
+{
+    Experiment *e = &exps[idx];
+    if (margin <= 0 || !shared->converged[e->target][e->loc])
+        return 0;
+    shared->skipped++;
+    shared->done_exps++;
+    return 1;
+}
+
+static void dist_result(void *ctx, FiDistNode *node, long idx, const char *line)
+{
+    FiTrialResult res;
+    unsigned long addr, old_val, new_val, detect_ns, elapsed_ns;
+    char worker[48];
+    int out;
+    memset(&res, 0, sizeof(res));
+    if (sscanf(line, "%d %47s %d %lx %lx %lx %d %lu %lu", &out, worker, &res.pid, &addr, &old_val, &new_val,
+               &res.fatal_sig, &detect_ns, &elapsed_ns) != 9 ||
+        out < 0 || out >= FI_OUT_COUNT)
+    {
+        shared->errors++;
+        shared->done_exps++;
+        return;
+    }
+    res.addr = addr;
+    res.old_val = old_val;
+    res.new_val = new_val;
+    res.detect_ns = detect_ns;
+    res.elapsed_ns = elapsed_ns;
+    record_result(idx, worker, &res, (FiOutcome)out, coord_results);
+}
+
+static void dist_failed(void *ctx, long idx)
+{
+    shared->errors++;
+    shared->done_exps++;
+}
+
+static int dist_tick(void *ctx)
+{
+    progress_tick();
+    return !keep_running;
+}
+
+// 节点以服务模式运行同一战役文件 (经标准输入传入) 与同一种子，实验编号在两端一致
+static int run_distributed(const char *nodes_path, const char *dir, int node_workers, const char *conf)
+{
+    if (fi_dist_load_nodes(&dist, nodes_path) < 0)
+    {
+        fprintf(stderr, "[-] 节点列表为空: %s\n", nodes_path);
+        return -1;
+    }
+    // 每个实验至多持续各靶子的超时，留足余量后仍无结果的节点视为挂死
+    int max_ms = 0;
+    for (int i = 0; i < ntargets; i++)
+    {
+        if (targets[i].timeout_ms > max_ms)
+            max_ms = targets[i].timeout_ms;
+        if (targets[i].hb_timeout_ms > max_ms)
+            max_ms = targets[i].hb_timeout_ms;
+    }
+    dist.idle_ms = 10 * max_ms > 60000 ? 10 * max_ms : 60000;
+    FILE *fp = fopen(conf, "r");
+    if (!fp)
+        return -1;
+    static char preamble[65536];
+    size_t len = fread(preamble, 1, sizeof(preamble) - 4, fp);
+    fclose(fp);
+    if (len > 0 && preamble[len - 1] != '\n')
+        preamble[len++] = '\n';
+    memcpy(preamble + len, ".\n", 3);
+
+    char jopt[32] = "";
+    if (node_workers > 0)
+        snprintf(jopt, sizeof(jopt), " -j %d", node_workers);
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "cd '%s' && exec ./campaign_injector -W -s %u%s -", dir, seed, jopt);
+
+    printf(" 分布式执行: %d 个节点, 节点目录 %s\n", dist.nnodes, dir);
+    fflush(stdout);
+    distributed = 1;
+    coord_results = fi_results_open_env("campaign_injector");
+    if (fi_dist_start(&dist, cmd, preamble) < 0)
+        return -1;
+    FiDistOps ops = {NULL, dist_skip, dist_result, dist_failed, dist_tick};
+    int rc = fi_dist_run(&dist, nexps, &ops);
+    fi_dist_stop(&dist);
+    fi_results_close(coord_results);
+    return rc;
+}
+
+// 服务模式：把协调端发来的实验编号交给本机工作进程，结果逐行写回
+static int serve_main(const char *conf, int nworkers, long ncpu)
+{
+    // 协议输出使用原标准输出，靶子与各模块的输出一律改到标准错误
+    reply_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3); // 靶子不继承，节点退出时协调端才能读到 EOF
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    signal(SIGPIPE, SIG_IGN);
+    gethostname(node_label, sizeof(node_label) - 1);
+
+    char tmp[] = "/tmp/fi_campaign.XXXXXX";
+    char line[1024];
+    if (strcmp(conf, "-") == 0)
+    {
+        int fd = mkstemp(tmp);
+        if (fd < 0)
+            return 1;
+        FILE *fp = fdopen(fd, "w");
+        while (fgets(line, sizeof(line), stdin) && strcmp(line, ".\n") != 0)
+            fputs(line, fp);
+        fclose(fp);
+        conf = tmp;
+    }
+    srand(seed);
+    int rc = load_campaign(conf);
+    if (conf == tmp)
+        unlink(tmp);
+    if (rc < 0 || expand_campaign() < 0)
+        return 1;
+    for (int i = 0; i < ntargets; i++)
+        if (targets[i].sites)
+            personality(ADDR_NO_RANDOMIZE);
+
+    shared = mmap(NULL, sizeof(CampShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    // 同一编号在各节点合计最多派发 FI_DIST_MAX_TRIES 次 (执行失败后可能又派回本节点)
+    long qcap = (nexps > 0 ? nexps : 1) * FI_DIST_MAX_TRIES;
+    queue = mmap(NULL, qcap * sizeof(long), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CampWorker *workers = calloc(nworkers, sizeof(CampWorker));
+    if (shared == MAP_FAILED || queue == MAP_FAILED || !workers)
+        return 1;
+    memset(shared, 0, sizeof(CampShared));
+    int alive = start_workers(workers, nworkers, ncpu);
+
+    snprintf(line, sizeof(line), "H %d %ld\n", alive, nexps);
+    serve_reply(line, strlen(line));
+    while (keep_running && fgets(line, sizeof(line), stdin))
+    {
+        long idx = strtol(line, NULL, 10);
+        if (idx < 0 || idx >= nexps || shared->q_tail >= qcap)
+            continue;
+        queue[shared->q_tail] = idx;
+        __sync_synchronize();
+        shared->q_tail++;
+    }
+    shared->q_closed = 1;
+
+    for (int i = 0; i < nworkers; i++)
+        if (workers[i].pid > 0)
+            waitpid(workers[i].pid, NULL, 0);
+    free(workers);
+    return 0;
+}
+
+// === 6. 汇总 ===
+static void print_summary(double secs)
+{
+    long done_exps = shared->done_exps;
+
+    // 按靶子汇总
+    printf("------------------------------------------------------------------------\n");
+    printf(" %-16s", "靶子");
+    for (int o = 0; o < FI_OUT_COUNT; o++)
+        printf(" %9s", fi_outcome_name((FiOutcome)o));
+    printf("\n");
+    for (int i = 0; i < ntargets; i++)
+    {
+        long sum = 0;
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+            sum += shared->outcome_count[i][o];
+        printf(" %-16s", targets[i].name);
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+            printf(" %8.1f%%", sum ? 100.0 * shared->outcome_count[i][o] / sum : 0.0);
+        printf("  (%ld)\n", sum);
+
+        // 按权重还原：代表点结果代表各自的等价类，再并入已证明 masked 的部分
+        if (!targets[i].sites)
+            continue;
+        uint64_t wsum = 0;
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+            wsum += shared->weighted[i][o];
+        double wtot = (double)(targets[i].live_weight + targets[i].masked_weight);
+        double live_frac = wtot > 0 ? targets[i].live_weight / wtot : 0.0;
+        printf(" %-16s", "  按权重还原");
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+        {
+            double p = wsum ? live_frac * shared->weighted[i][o] / wsum : 0.0;
+            if (o == FI_OUT_MASKED && wtot > 0)
+                p += targets[i].masked_weight / wtot;
+            printf(" %8.1f%%", 100.0 * p);
+        }
+        printf("  (%.0f)\n", wtot);
+    }
+    printf("------------------------------------------------------------------------\n");
+
+    // 分层明细：各结果类别的比例与区间半宽
+    if (margin > 0)
+    {
+        printf(" %-16s %-16s %6s", "靶子", "位置", "n");
+        for (int o = 0; o < FI_OUT_COUNT; o++)
+            if (o < FI_OUT_NOFAULT)
+                printf(" %14s", fi_outcome_name((FiOutcome)o));
+        printf("  状态\n");
+        for (int ti = 0; ti < ntargets; ti++)
+        {
+            for (int li = 0; li < targets[ti].nlocs; li++)
+            {
+                const long *cnt = shared->stratum_count[ti][li];
+                long n = 0;
+                for (int o = 0; o < FI_OUT_COUNT; o++)
+                    if (o < FI_OUT_NOFAULT)
+                        n += cnt[o];
+                printf(" %-16s %-16s %6ld", targets[ti].name, targets[ti].locs[li], n);
+                for (int o = 0; o < FI_OUT_COUNT; o++)
+                {
+                    if (o >= FI_OUT_NOFAULT)
+                        continue;
+                    double lo, hi;
+                    fi_stats_ci(ci_method, (uint64_t)cnt[o], (uint64_t)n, confidence, &lo, &hi);
+                    printf(" %5.1f%%±%5.1f%%", n ? 100.0 * cnt[o] / n : 0.0, 100.0 * (hi - lo) / 2);
+                }
+                printf("  %s\n", stratum_converged(ti, li) ? "收敛" : "未收敛");
+            }
+        }
+        printf("------------------------------------------------------------------------\n");
+        long ran = done_exps - shared->skipped;
+        printf(" 序贯抽样: 收敛 %ld/%d 层, 实际执行 %ld 次, 跳过 %ld 次 (节省 %.1f%%)\n", shared->nconverged,
+               nstrata, ran, shared->skipped, done_exps ? 100.0 * shared->skipped / done_exps : 0.0);
+    }
+
+    // 各节点的完成数与窃取数
+    if (distributed)
+    {
+        printf(" %-16s %8s %10s %10s  %s\n", "节点", "工作进程", "完成", "窃取", "状态");
+        for (int i = 0; i < dist.nnodes; i++)
+        {
+            const FiDistNode *nd = &dist.nodes[i];
+            printf(" %-16s %8d %10ld %10ld  %s\n", nd->name, nd->nworkers, nd->done, nd->stolen,
+                   nd->state < 0 ? "失联" : "正常");
+        }
+        if (dist.lost)
+            printf(" 因节点失联重新派发 %ld 个实验\n", dist.lost);
+        printf("------------------------------------------------------------------------\n");
+    }
+    printf(" 完成 %ld/%ld 个实验, 用时 %.2f 秒, 平均 %.1f 次/秒\n", done_exps, nexps, secs, done_exps / secs);
+    if (shared->detect_n)
+        printf(" 平均检测延迟 (注入到 detected/crash/hang) %.1f 微秒 (%ld 次)\n", shared->detect_ns_sum / 1000.0 / shared->detect_n,
+               shared->detect_n);
+}
+
+int main(int argc, char *argv[])
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nworkers = (int)ncpu, jset = 0;
+    const char *csv_path = NULL;
+    const char *conf = NULL;
+    const char *nodes_path = NULL;
+    char dir[512];
+    if (!getcwd(dir, sizeof(dir)))
+        strcpy(dir, ".");
+    seed = (unsigned int)time(NULL);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            nworkers = atoi(argv[++i]);
+            jset = 1;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            csv_path = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            margin = atof(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            confidence = atof(argv[++i]);
+        else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc)
+        {
+            int m = fi_stats_parse_method(argv[++i]);
+            if (m < 0)
+            {
+                print_help(argv[0]);
+                return 1;
+            }
+            ci_method = (FiCiMethod)m;
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            min_samples = atol(argv[++i]);
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc)
+            nodes_path = argv[++i];
+        else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc)
+            snprintf(dir, sizeof(dir), "%s", argv[++i]);
+        else if (strcmp(argv[i], "-W") == 0)
+            serve_mode = 1;
+        else
+            conf = argv[i];
+    }
+    if (!conf || nworkers < 1 || nworkers > MAX_WORKERS || margin < 0 || margin >= 0.5 ||
+        confidence <= 0 || confidence >= 1 || (serve_mode && nodes_path))
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+    if (serve_mode)
+        return serve_main(conf, nworkers, ncpu);
+
+    srand(seed);
+    if (load_campaign(conf) < 0 || expand_campaign() < 0)
+        return 1;
+    // 代表点的指令与数据地址来自关闭 ASLR 的黄金运行 (fi_prune)，靶子须继承同样的布局
+    for (int i = 0; i < ntargets; i++)
+        if (targets[i].sites)
+            personality(ADDR_NO_RANDOMIZE);
+
+    shared = mmap(NULL, sizeof(CampShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    memset(shared, 0, sizeof(CampShared));
+
+    if (csv_path)
+    {
+        csv_fd = open(csv_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (csv_fd < 0)
+        {
+            perror("打开结果文件失败");
+            return 1;
+        }
+        const char *hdr = "id,target,loc,type,bit,at_us,worker,pid,addr,old,new,outcome,signal,detect_us,elapsed_us\n";
+        if (write(csv_fd, hdr, strlen(hdr)) < 0)
+            perror("写结果文件失败");
+    }
+
+    signal(SIGINT, sigint_handler);
+
+    printf("=== 并行注入战役 ===\n");
+    for (int i = 0; i < ntargets; i++)
+    {
+        CampTarget *t = &targets[i];
+        if (t->sites)
+            printf(" [%s] %s: %zu 代表点 × %d 类型 × %d 位 × %d 次 (故障空间 %lu 个注入点, 已证明 masked %lu)\n",
+                   t->name, t->argv[0], t->nsites, t->ntypes, t->nbits, t->repeat,
+                   (unsigned long)(t->live_weight + t->masked_weight), (unsigned long)t->masked_weight);
+        else
+            printf(" [%s] %s: %d 位置 × %d 类型 × %d 位 × %d 时刻 × %d 次\n", t->name, t->argv[0],
+                   t->nlocs, t->ntypes, t->nbits, t->nat, t->repeat);
+    }
+    if (nodes_path)
+        printf(" 实验总数: %ld, 种子: %u\n", nexps, seed);
+    else
+        printf(" 实验总数: %ld, 工作进程: %d, 种子: %u\n", nexps, nworkers, seed);
+    for (int i = 0; i < ntargets; i++)
+        nstrata += targets[i].nlocs;
+    if (margin > 0)
+        printf(" 序贯抽样: %d 层, %s 区间, 置信度 %.3g, 半宽 ≤ %.3g, 每层至少 %ld 次\n", nstrata,
+               fi_stats_method_name(ci_method), confidence, margin, min_samples);
+
+    start_ns = last_ns = fi_now_ns();
+    if (nodes_path)
+    {
+        if (run_distributed(nodes_path, dir, jset ? nworkers : 0, conf) < 0 && shared->done_exps == 0)
+            return 1;
+    }
+    else
+    {
+        CampWorker *workers = calloc(nworkers, sizeof(CampWorker));
+        if (!workers)
+            return 1;
+        int alive = start_workers(workers, nworkers, ncpu);
+        while (alive > 0)
+        {
+            usleep(200000);
+            for (int i = 0; i < nworkers; i++)
+            {
+                if (workers[i].pid > 0 && waitpid(workers[i].pid, NULL, WNOHANG) == workers[i].pid)
+                {
+                    workers[i].pid = 0;
+                    alive--;
+                }
+            }
+            progress_tick();
+        }
+        free(workers);
+    }
+
+    double secs = (fi_now_ns() - start_ns) / 1e9;
+    print_status(secs, shared->done_exps, shared->done_exps / secs);
+    printf("\n");
+    print_summary(secs);
+
+    if (csv_fd >= 0)
+        close(csv_fd);
+    free(exps);
+    return 0;
+}
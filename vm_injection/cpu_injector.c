@@ -2,7 +2,16 @@
  * cpu_injector.c - CPU 高负载故障注入器 (增强版)
  * 功能：创建高强度计算线程，争抢 CPU 资源 (Resource Exhaustion)
  * 增强：支持 CPU 亲和性绑定、高优先级、多种压力模式
- * 编译：gcc -o cpu_injector cpu_injector.c -lpthread -lm
+ *       占空比模式 (-u/-p)：每个线程以 1ms 为周期交替忙/睡，忙时长由反馈控制器
+ *       根据线程实际 CPU 时间 (CLOCK_THREAD_CPUTIME_ID) 修正，按负载曲线输出部分利用率
+ *       干扰核 (-k)：LLC/内存带宽/TLB/分支预测/SIMD/上下文切换，分别报告达到的速率
+ *       放置策略 (-a)：按目标线程实际运行的 CPU 与拓扑，把压力线程放在同核/SMT 兄弟/同 LLC/同节点/远端节点
+ *       窃取模式 (-D)：线程以 SCHED_DEADLINE 运行，每周期恰好占用 runtime，由内核 CBS 保证上限，
+ *       并读取目标各线程 schedstat 的运行队列等待时间验证被窃取的 CPU；
+ *       线程运行在独立 cpuset 分区中，准入控制按分区计算，不改整机 sched_rt_runtime_us (-R 除外)
+ *       受限模式 (-g)：压力线程在独立 cgroup v2 叶子中运行，cpu.max/cpuset.cpus/memory.max 限额，
+ *       运行中可经标准输入调整强度、暂停、停止，结束时按 cpu.stat 报告实际消耗
+ * 编译：gcc -o cpu_injector cpu_injector.c fi_topo.c fi_stress.c fi_mark.c -lpthread -lm
  */
 
 #define _GNU_SOURCE
@@ -16,30 +25,57 @@
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
 #include <sys/syscall.h>
+#include <stdint.h>
+#include <dirent.h>
+
+#include "fi_topo.h"
+#include "fi_stress.h"
+#include "fi_mark.h"
 
 // 全局标志位，控制线程运行
 volatile int keep_running = 1;
 
+// 放置策略 (-a) 给出的 CPU，线程 i 绑定到 place_cpus[i % nplace]；未指定时按 i % 核心数
+static int place_cpus[FI_TOPO_MAX_CPUS];
+static int nplace = 0;
+
+// 受限模式 (-g) 下不提升优先级：实时线程不受 cpu.max 约束
+static int confined = 0;
+
+// 注入起止标记的标签 (fi_mark_write)，带上模式与参数
+static char mark_label[96] = "cpu_injector";
+
+static void pin_worker(pthread_t th, int id)
+{
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(nplace ? place_cpus[id % nplace] : id % sysconf(_SC_NPROCESSORS_ONLN), &cpuset);
+    pthread_setaffinity_np(th, sizeof(cpu_set_t), &cpuset);
+#endif
+}
+
 // 压力测试线程函数 - 增强版
 // 混合整数、浮点、内存访问，最大化 CPU 占用
 void *stress_worker(void *arg)
 {
     int core_id = *(int *)arg;
 
-    // 尝试绑定到指定 CPU 核心 (Linux)
-#ifdef __linux__
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core_id % sysconf(_SC_NPROCESSORS_ONLN), &cpuset);
-    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-#endif
+    // 尝试绑定到指定 CPU 核心
+    pin_worker(pthread_self(), core_id);
 
     // 尝试提高线程优先级
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (!confined)
+    {
+        struct sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
 
     // 分配一些内存用于缓存压力
     volatile double *arr = malloc(sizeof(double) * 10000);
@@ -80,6 +116,8 @@ void *stress_worker(void *arg)
 void *simple_stress(void *arg)
 {
     volatile double x = 0.0;
+    if (nplace)
+        pin_worker(pthread_self(), *(int *)arg);
     while (keep_running)
     {
         x = sqrt(rand() % 100000) * tan(rand() % 100000);
@@ -89,17 +127,1236 @@ void *simple_stress(void *arg)
     return NULL;
 }
 
+// ---------------- 干扰核 ----------------
+// 每个核针对一种共享资源，step() 做几微秒的工作并返回完成的操作数，
+// 满载模式循环调用，占空比模式在忙时段内调用，主线程按秒汇总速率
+
+typedef struct
+{
+    int id;
+    long param;              // 核参数 (工作集 KB / 页数等)，0 表示默认
+    char *buf;
+    size_t size;
+    size_t *perm;            // 随机访问顺序
+    size_t n, pos;
+    unsigned long long rng;
+    double acc;
+    int fd_ping[2], fd_pong[2];
+    pthread_t peer;
+    clockid_t peer_clk;
+    int has_peer;
+    volatile long long ops;
+    volatile int err;        // 线程启动失败的 errno (窃取模式设置调度策略失败)
+} KernelCtx;
+
+typedef struct
+{
+    const char *name;
+    const char *unit;        // 速率单位 (ops 乘以 scale 后)
+    double scale;
+    const char *desc;
+    int (*init)(KernelCtx *k);
+    long (*step)(KernelCtx *k);
+    void (*fini)(KernelCtx *k);
+} StressKernel;
+
+static const StressKernel *stress_kernel;
+static long kernel_param;
+static int kernel_threads = 1;
+
+static unsigned long long xorshift(unsigned long long *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// 读取最后一级缓存大小 (sysfs)，失败时按 8MB
+static size_t llc_size(void)
+{
+    size_t best = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        char path[128], buf[32];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            break;
+        if (fgets(buf, sizeof(buf), fp))
+        {
+            char *end;
+            size_t v = strtoul(buf, &end, 10);
+            if (*end == 'K')
+                v <<= 10;
+            else if (*end == 'M')
+                v <<= 20;
+            if (v > best)
+                best = v;
+        }
+        fclose(fp);
+    }
+    return best ? best : (8UL << 20);
+}
+
+static void *map_buffer(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    memset(p, 1, size);
+    return p;
+}
+
+static void unmap_buffer(KernelCtx *k)
+{
+    if (k->buf)
+        munmap(k->buf, k->size);
+    free(k->perm);
+}
+
+// fpu：原 stress_worker 的混合浮点运算
+static long fpu_step(KernelCtx *k)
+{
+    volatile double x = k->acc;
+    for (int i = 0; i < 256; i++)
+    {
+        x = sqrt(x + 1.0) * sin(x) + cos(x * 0.1);
+        x = (x > 1e10 || x < -1e10) ? 1.0 : x;
+    }
+    k->acc = x;
+    return 256;
+}
+
+// llc：按随机环形链表逐行追指针，硬件预取无效；默认各线程合计 2 倍 LLC
+static int llc_init(KernelCtx *k)
+{
+    k->size = k->param > 0 ? (size_t)k->param << 10 : 2 * llc_size() / kernel_threads;
+    if (k->size < (1UL << 20))
+        k->size = 1UL << 20;
+    k->n = k->size / 64;
+    if (k->n < 2)
+        return -1;
+    k->size = k->n * 64;
+    k->buf = map_buffer(k->size);
+    if (!k->buf)
+        return -1;
+    // Sattolo 洗牌生成单环排列，每行首字存下一行编号
+    size_t *next = (size_t *)k->buf;
+    for (size_t i = 0; i < k->n; i++)
+        next[i * 8] = i;
+    k->rng = 0x9E3779B97F4A7C15ULL + k->id;
+    for (size_t i = k->n - 1; i > 0; i--)
+    {
+        size_t j = xorshift(&k->rng) % i;
+        size_t t = next[i * 8];
+        next[i * 8] = next[j * 8];
+        next[j * 8] = t;
+    }
+    return 0;
+}
+
+static long llc_step(KernelCtx *k)
+{
+    const size_t *next = (const size_t *)k->buf;
+    size_t p = k->pos;
+    for (int i = 0; i < 64; i++)
+        p = next[p * 8];
+    k->pos = p;
+    return 64;
+}
+
+// stream：三数组 triad a = b + s*c 顺序扫描，默认每线程 64MB
+static int stream_init(KernelCtx *k)
+{
+    k->size = k->param > 0 ? (size_t)k->param << 20 : (64UL << 20);
+    k->n = k->size / (3 * sizeof(double));
+    k->n &= ~(size_t)511;
+    if (k->n == 0)
+        return -1;
+    k->buf = map_buffer(k->size);
+    return k->buf ? 0 : -1;
+}
+
+static long stream_step(KernelCtx *k)
+{
+    double *a = (double *)k->buf, *b = a + k->n, *c = b + k->n;
+    size_t base = k->pos;
+    for (size_t i = base; i < base + 512; i++)
+        a[i] = b[i] + 3.0 * c[i];
+    k->pos = (base + 512) % k->n;
+    return 512 * 3 * sizeof(double);
+}
+
+// tlb：每页只碰一行、按随机页序追指针，默认 16384 页 (64MB)，禁用透明大页
+static int tlb_init(KernelCtx *k)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    k->n = k->param > 0 ? (size_t)k->param : 16384;
+    k->size = k->n * page;
+    k->buf = mmap(NULL, k->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (k->buf == MAP_FAILED)
+    {
+        k->buf = NULL;
+        return -1;
+    }
+    madvise(k->buf, k->size, MADV_NOHUGEPAGE);
+    k->perm = malloc(k->n * sizeof(size_t));
+    if (!k->perm)
+        return -1;
+    k->rng = 0xD1B54A32D192ED03ULL + k->id;
+    for (size_t i = 0; i < k->n; i++)
+    {
+        // 行偏移随页错开，避免所有访问落在同一缓存组
+        k->perm[i] = i * page + ((i * 7) % (page / 64)) * 64;
+        k->buf[k->perm[i]] = 1;
+    }
+    for (size_t i = k->n - 1; i > 0; i--)
+    {
+        size_t j = xorshift(&k->rng) % (i + 1);
+        size_t t = k->perm[i];
+        k->perm[i] = k->perm[j];
+        k->perm[j] = t;
+    }
+    // 串成环形链表：每次访问依赖上一次的结果，测到的是页表遍历延迟而非并行吞吐
+    for (size_t i = 0; i < k->n; i++)
+        *(size_t *)(k->buf + k->perm[i]) = k->perm[(i + 1) % k->n];
+    k->pos = k->perm[0];
+    return 0;
+}
+
+static long tlb_step(KernelCtx *k)
+{
+    size_t p = k->pos;
+    for (int i = 0; i < 64; i++)
+        p = *(volatile size_t *)(k->buf + p);
+    k->pos = p;
+    return 64;
+}
+
+// branch：按伪随机位分支，两侧各含编译屏障阻止转成条件传送，约一半预测失败
+static long branch_step(KernelCtx *k)
+{
+    unsigned long long r = k->rng ? k->rng : 88172645463325252ULL;
+    long acc = (long)k->acc;
+    for (int i = 0; i < 1024; i++)
+    {
+        if (xorshift(&r) & 1)
+        {
+            __asm__ volatile("" ::: "memory");
+            acc += i;
+        }
+        else
+        {
+            __asm__ volatile("" ::: "memory");
+            acc ^= i;
+        }
+    }
+    k->rng = r;
+    k->acc = (double)(acc & 0xFFFF);
+    return 1024;
+}
+
+// simd：16 路宽向量乘加，编译器按目标 ISA 拆成 AVX-512/AVX2/SSE/NEON 指令
+typedef float vf16 __attribute__((vector_size(64)));
+
+#if defined(__x86_64__)
+__attribute__((target_clones("arch=skylake-avx512", "arch=haswell", "default")))
+#endif
+static long simd_step(KernelCtx *k)
+{
+    vf16 a0 = {0}, a1 = {0}, a2 = {0}, a3 = {0};
+    const vf16 m = {0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f,
+                    0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f, 0.999f};
+    const vf16 c = m * 0.001f;
+    for (int i = 0; i < 256; i++)
+    {
+        a0 = a0 * m + c;
+        a1 = a1 * m + c;
+        a2 = a2 * m + c;
+        a3 = a3 * m + c;
+    }
+    vf16 s = a0 + a1 + a2 + a3;
+    k->acc += s[0];
+    return 256 * 4 * 16 * 2; // 浮点运算数 (乘、加各计一次)
+}
+
+// pingpong：同核上的伙伴线程经两根管道往返传递 1 字节，每次往返两次上下文切换
+static void *pingpong_peer(void *arg)
+{
+    KernelCtx *k = (KernelCtx *)arg;
+    char c;
+    while (read(k->fd_ping[0], &c, 1) == 1)
+    {
+        if (write(k->fd_pong[1], &c, 1) != 1)
+            break;
+    }
+    return NULL;
+}
+
+static int pingpong_init(KernelCtx *k)
+{
+    if (pipe(k->fd_ping) < 0)
+        return -1;
+    if (pipe(k->fd_pong) < 0)
+        return -1;
+    if (pthread_create(&k->peer, NULL, pingpong_peer, k) != 0)
+        return -1;
+    k->has_peer = 1;
+    pthread_getcpuclockid(k->peer, &k->peer_clk);
+    pin_worker(k->peer, k->id);
+    return 0;
+}
+
+static long pingpong_step(KernelCtx *k)
+{
+    char c = 0;
+    if (write(k->fd_ping[1], &c, 1) != 1 || read(k->fd_pong[0], &c, 1) != 1)
+        return 0;
+    return 2;
+}
+
+static void pingpong_fini(KernelCtx *k)
+{
+    if (!k->has_peer)
+        return;
+    close(k->fd_ping[1]); // 伙伴读到 EOF 后退出
+    pthread_join(k->peer, NULL);
+    close(k->fd_ping[0]);
+    close(k->fd_pong[0]);
+    close(k->fd_pong[1]);
+}
+
+static const StressKernel kernels[] = {
+    {"fpu", "M 次运算/秒", 1e-6, "混合浮点运算 (原激进模式)", NULL, fpu_step, NULL},
+    {"llc", "M 次访问/秒", 1e-6, "LLC 抖动，参数=每线程工作集 KB (默认合计 2 倍 LLC)", llc_init, llc_step, unmap_buffer},
+    {"stream", "GB/秒", 1e-9, "流式内存带宽，参数=每线程 MB (默认 64)", stream_init, stream_step, unmap_buffer},
+    {"tlb", "M 次访问/秒", 1e-6, "TLB 抖动，参数=页数 (默认 16384)", tlb_init, tlb_step, unmap_buffer},
+    {"branch", "M 次分支/秒", 1e-6, "随机分支，约 50% 预测失败", NULL, branch_step, NULL},
+    {"simd", "GFLOP/秒", 1e-9, "宽向量乘加 (功耗/降频)", NULL, simd_step, NULL},
+    {"pingpong", "K 次切换/秒", 1e-3, "同核线程管道往返 (上下文切换)", pingpong_init, pingpong_step, pingpong_fini},
+};
+
+// 解析 "名称[:参数]"
+static const StressKernel *find_kernel(const char *spec, long *param)
+{
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+    *param = colon ? atol(colon + 1) : 0;
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+    {
+        if (strlen(kernels[i].name) == len && strncmp(kernels[i].name, spec, len) == 0)
+            return &kernels[i];
+    }
+    return NULL;
+}
+
+static int kernel_init(KernelCtx *k)
+{
+    k->rng = 0x2545F4914F6CDD1DULL + k->id;
+    k->acc = 1.0;
+    if (stress_kernel->init && stress_kernel->init(k) < 0)
+    {
+        fprintf(stderr, "[线程 %d] 初始化干扰核 %s 失败: %s\n", k->id, stress_kernel->name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void kernel_fini(KernelCtx *k)
+{
+    if (stress_kernel->fini)
+        stress_kernel->fini(k);
+}
+
+// 线程 (含伙伴线程) 的 CPU 时间
+static long long kernel_cpu_ns(KernelCtx *k, clockid_t self)
+{
+    struct timespec ts;
+    long long ns;
+    clock_gettime(self, &ts);
+    ns = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    if (k->has_peer)
+    {
+        clock_gettime(k->peer_clk, &ts);
+        ns += (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+    return ns;
+}
+
+// 满载干扰线程：不提升调度优先级，测量的是共享资源竞争而不是调度抢占
+void *kernel_worker(void *arg)
+{
+    KernelCtx *k = (KernelCtx *)arg;
+
+    pin_worker(pthread_self(), k->id);
+
+    if (kernel_init(k) < 0)
+        return NULL;
+    while (keep_running)
+        k->ops += stress_kernel->step(k);
+    kernel_fini(k);
+    return NULL;
+}
+
+// ---------------- 占空比模式 ----------------
+
+#define DUTY_KI 0.5          // 每周期补回一半累计误差 (对利用率误差即积分控制)
+#define DUTY_WINDUP 4        // 累计误差上限 (周期数)，防止被抢占后集中补偿
+#define DUTY_HIST_BINS 2001  // 每周期误差直方图：-100%~+100%，0.1% 一格
+#define TRACE_MAX 100000
+
+enum { PROF_CONST, PROF_RAMP, PROF_SQUARE, PROF_TRACE };
+
+typedef struct
+{
+    int kind;
+    double a, b;             // const: a; ramp: a -> b; square: 低 a / 高 b
+    long long span_ns;       // ramp 持续时间 / square 周期
+    int n;                   // trace 点数
+    long long *t_ns;         // trace 时刻 (相对开始)
+    double *u;               // trace 利用率
+} LoadProfile;
+
+typedef struct
+{
+    int id;
+    pthread_t tid;
+    clockid_t clk;
+    volatile long long target_ns;  // 按曲线应消耗的 CPU 时间
+    volatile long long periods;
+    volatile long long overruns;   // 周期末仍未完成忙时段的次数 (唤醒延迟或被抢占)
+    unsigned int err_hist[DUTY_HIST_BINS]; // 每周期实际占空比与目标之差，线程结束后汇总
+    KernelCtx k;
+} DutyWorker;
+
+static LoadProfile profile;
+static long long duty_period_ns = 1000000;
+static struct timespec duty_t0;
+
+static long long ts_ns(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static long long clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return ts_ns(&ts);
+}
+
+// 解析负载曲线：const:U | ramp:起:止[:秒] | square:低:高:周期ms | trace:文件 (每行 "毫秒 百分比")
+static int parse_profile(const char *spec, int duration)
+{
+    memset(&profile, 0, sizeof(profile));
+    profile.span_ns = (long long)duration * 1000000000LL;
+
+    if (strncmp(spec, "const:", 6) == 0)
+    {
+        profile.kind = PROF_CONST;
+        profile.a = atof(spec + 6);
+    }
+    else if (strncmp(spec, "ramp:", 5) == 0)
+    {
+        double secs = 0;
+        profile.kind = PROF_RAMP;
+        if (sscanf(spec + 5, "%lf:%lf:%lf", &profile.a, &profile.b, &secs) < 2)
+            return -1;
+        if (secs > 0)
+            profile.span_ns = (long long)(secs * 1e9);
+    }
+    else if (strncmp(spec, "square:", 7) == 0)
+    {
+        double ms = 0;
+        profile.kind = PROF_SQUARE;
+        if (sscanf(spec + 7, "%lf:%lf:%lf", &profile.a, &profile.b, &ms) != 3 || ms <= 0)
+            return -1;
+        profile.span_ns = (long long)(ms * 1e6);
+    }
+    else if (strncmp(spec, "trace:", 6) == 0)
+    {
+        FILE *fp = fopen(spec + 6, "r");
+        if (!fp)
+        {
+            perror("打开负载轨迹失败");
+            return -1;
+        }
+        profile.kind = PROF_TRACE;
+        profile.t_ns = malloc(TRACE_MAX * sizeof(long long));
+        profile.u = malloc(TRACE_MAX * sizeof(double));
+        if (!profile.t_ns || !profile.u)
+        {
+            fclose(fp);
+            return -1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), fp) && profile.n < TRACE_MAX)
+        {
+            double ms, u;
+            if (line[0] == '#' || sscanf(line, "%lf %lf", &ms, &u) != 2)
+                continue;
+            profile.t_ns[profile.n] = (long long)(ms * 1e6);
+            profile.u[profile.n] = u;
+            profile.n++;
+        }
+        fclose(fp);
+        if (profile.n == 0)
+        {
+            printf("[错误] 负载轨迹为空: %s\n", spec + 6);
+            return -1;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// 曲线在 t 时刻的目标利用率 (0~1)
+static double profile_at(long long t)
+{
+    double u = 0;
+
+    switch (profile.kind)
+    {
+    case PROF_CONST:
+        u = profile.a;
+        break;
+    case PROF_RAMP:
+        if (t >= profile.span_ns)
+            u = profile.b;
+        else
+            u = profile.a + (profile.b - profile.a) * (double)t / profile.span_ns;
+        break;
+    case PROF_SQUARE:
+        u = (t % profile.span_ns) < profile.span_ns / 2 ? profile.b : profile.a;
+        break;
+    case PROF_TRACE:
+    {
+        // 阶梯保持：取最后一个时刻不晚于 t 的采样点，轨迹结束后保持末值
+        int lo = 0, hi = profile.n - 1;
+        if (t < profile.t_ns[0])
+        {
+            u = profile.u[0];
+            break;
+        }
+        while (lo < hi)
+        {
+            int mid = (lo + hi + 1) / 2;
+            if (profile.t_ns[mid] <= t)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        u = profile.u[lo];
+        break;
+    }
+    }
+
+    u /= 100.0;
+    return u < 0 ? 0 : (u > 1 ? 1 : u);
+}
+
+// 占空比线程：每周期忙时长 = 曲线值 × 周期 + 累计误差修正，剩余时间睡到周期末
+void *duty_worker(void *arg)
+{
+    DutyWorker *w = (DutyWorker *)arg;
+
+    pin_worker(pthread_self(), w->id);
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0); // 默认 50us 的定时器松弛对 1ms 周期误差太大
+
+    if (kernel_init(&w->k) < 0)
+        return NULL;
+
+    long long t0 = ts_ns(&duty_t0);
+    long long cpu0 = kernel_cpu_ns(&w->k, CLOCK_THREAD_CPUTIME_ID);
+    long long ideal = 0; // 控制器跟踪的 CPU 时间 (超出补偿上限的欠账被丢弃)
+    long long deadline = t0;
+    long long prev_used = 0, prev_wall = 0;
+    double prev_u = 0;
+
+    while (keep_running)
+    {
+        long long start = deadline;
+        deadline = start + duty_period_ns;
+        double u = profile_at(start - t0);
+        ideal += (long long)(u * duty_period_ns);
+        w->target_ns += (long long)(u * duty_period_ns);
+
+        // 累计误差 = 应消耗 - 实际消耗 (含睡眠唤醒等开销)，按 KI 分摊到后续周期
+        long long used = kernel_cpu_ns(&w->k, CLOCK_THREAD_CPUTIME_ID) - cpu0;
+
+        // 上一周期 (越过周期末时为跨越的整段) 实际达到的占空比；
+        // 越过周期末后不睡眠直接进入下一周期，不足半个周期的窗口并入下一次采样
+        long long wall = clock_ns(CLOCK_MONOTONIC);
+        if (prev_wall == 0 || wall - prev_wall >= duty_period_ns / 2)
+        {
+            if (prev_wall)
+            {
+                double e = ((double)(used - prev_used) / (wall - prev_wall) - prev_u) * 1000.0;
+                int bin = (int)lround(e) + DUTY_HIST_BINS / 2;
+                w->err_hist[bin < 0 ? 0 : (bin >= DUTY_HIST_BINS ? DUTY_HIST_BINS - 1 : bin)]++;
+            }
+            prev_used = used;
+            prev_wall = wall;
+            prev_u = u;
+        }
+        long long err = ideal - used;
+        if (err > DUTY_WINDUP * duty_period_ns)
+        {
+            ideal = used + DUTY_WINDUP * duty_period_ns;
+            err = DUTY_WINDUP * duty_period_ns;
+        }
+        else if (err < -DUTY_WINDUP * duty_period_ns)
+        {
+            ideal = used - DUTY_WINDUP * duty_period_ns;
+            err = -DUTY_WINDUP * duty_period_ns;
+        }
+
+        long long busy = (long long)(u * duty_period_ns + DUTY_KI * err);
+        if (busy > duty_period_ns)
+            busy = duty_period_ns;
+        if (busy > 0)
+        {
+            // 忙时段可以越过周期末 (唤醒延迟、被抢占)，但不超过下一个周期
+            long long c0 = kernel_cpu_ns(&w->k, CLOCK_THREAD_CPUTIME_ID);
+            while (kernel_cpu_ns(&w->k, CLOCK_THREAD_CPUTIME_ID) - c0 < busy)
+            {
+                w->k.ops += stress_kernel->step(&w->k);
+                if (clock_ns(CLOCK_MONOTONIC) >= deadline + duty_period_ns)
+                    break;
+            }
+        }
+        w->periods++;
+
+        long long now = clock_ns(CLOCK_MONOTONIC);
+        if (now < deadline)
+        {
+            struct timespec next = {deadline / 1000000000LL, deadline % 1000000000LL};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+            continue;
+        }
+        w->overruns++;
+        // 错过的整周期照常计入目标，欠账由积分项在补偿上限内追回
+        while (now - deadline >= duty_period_ns)
+        {
+            u = profile_at(deadline - t0);
+            ideal += (long long)(u * duty_period_ns);
+            w->target_ns += (long long)(u * duty_period_ns);
+            deadline += duty_period_ns;
+        }
+    }
+    kernel_fini(&w->k);
+    return NULL;
+}
+
+// 直方图第 q 分位所在的格
+static int hist_quantile(const long long *hist, int nbins, long long total, double q)
+{
+    long long need = (long long)ceil(q * total), acc = 0;
+    for (int b = 0; b < nbins; b++)
+    {
+        acc += hist[b];
+        if (acc >= need)
+            return b;
+    }
+    return nbins - 1;
+}
+
+// 占空比模式主循环：每秒汇总各线程 CPU 时间，对比曲线目标
+static int run_duty(int num_threads, int duration)
+{
+    DutyWorker *ws = calloc(num_threads, sizeof(DutyWorker));
+    if (!ws)
+    {
+        perror("malloc failed");
+        return 1;
+    }
+
+    fi_mark_write("start", mark_label);
+    clock_gettime(CLOCK_MONOTONIC, &duty_t0);
+    for (int i = 0; i < num_threads; i++)
+    {
+        ws[i].id = i;
+        ws[i].k.id = i;
+        ws[i].k.param = kernel_param;
+        if (pthread_create(&ws[i].tid, NULL, duty_worker, &ws[i]) != 0)
+        {
+            perror("创建线程失败");
+            num_threads = i;
+            break;
+        }
+        pthread_getcpuclockid(ws[i].tid, &ws[i].clk);
+    }
+
+    printf("[*] 开始施压! (控制周期 %.1f ms)\n\n", duty_period_ns / 1e6);
+    printf("  秒    目标%%   实际%%   误差    %s 速率 (%s)\n", stress_kernel->name, stress_kernel->unit);
+
+    long long last_cpu = 0, last_ideal = 0, last_ops = 0, last_wall = ts_ns(&duty_t0);
+    long long wall0 = last_wall;
+    double max_err = 0, sum_err = 0;
+    int samples = 0;
+    struct timespec tick = duty_t0;
+
+    for (int s = 1; s <= duration; s++)
+    {
+        tick.tv_sec++;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+
+        long long cpu = 0, ideal = 0, ops = 0;
+        for (int i = 0; i < num_threads; i++)
+        {
+            cpu += kernel_cpu_ns(&ws[i].k, ws[i].clk);
+            ideal += ws[i].target_ns;
+            ops += ws[i].k.ops;
+        }
+        long long wall = clock_ns(CLOCK_MONOTONIC);
+        double denom = (double)(wall - last_wall) * num_threads;
+        double real = (cpu - last_cpu) / denom * 100.0;
+        double want = (ideal - last_ideal) / denom * 100.0;
+        double err = real - want;
+
+        double rate = (ops - last_ops) * stress_kernel->scale * 1e9 / (wall - last_wall);
+
+        printf("  %-4d  %6.2f  %6.2f  %+6.2f  %10.2f\n", s, want, real, err, rate);
+        fflush(stdout);
+
+        if (fabs(err) > max_err)
+            max_err = fabs(err);
+        sum_err += fabs(err);
+        samples++;
+        last_cpu = cpu;
+        last_ideal = ideal;
+        last_ops = ops;
+        last_wall = wall;
+    }
+
+    keep_running = 0;
+    fi_mark_write("stop", mark_label);
+    printf("\n[*] 停止施压...\n");
+
+    long long periods = 0, overruns = 0;
+    long long abs_hist[DUTY_HIST_BINS / 2 + 1] = {0}, nper = 0, within2 = 0;
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(ws[i].tid, NULL);
+        periods += ws[i].periods;
+        overruns += ws[i].overruns;
+        for (int b = 0; b < DUTY_HIST_BINS; b++)
+        {
+            int d = abs(b - DUTY_HIST_BINS / 2);
+            abs_hist[d] += ws[i].err_hist[b];
+            nper += ws[i].err_hist[b];
+            if (d <= 20)
+                within2 += ws[i].err_hist[b];
+        }
+    }
+    if (samples > 0)
+        printf("[结果] %s 平均速率 %.2f %s\n", stress_kernel->name,
+               last_ops * stress_kernel->scale * 1e9 / (last_wall - wall0), stress_kernel->unit);
+
+    if (samples > 0)
+    {
+        printf("[结果] 每秒误差: 平均 %.2f%%, 最大 %.2f%%\n", sum_err / samples, max_err);
+        printf("[结果] 控制周期 %lld 个, 忙时段越过周期末 %lld 个 (%.2f%%)\n",
+               periods, overruns, periods ? overruns * 100.0 / periods : 0);
+        if (nper > 0)
+            printf("[结果] 每周期误差 (绝对值): p50 %.1f%%, p99 %.1f%%, ±2%% 以内 %.1f%% 的周期\n",
+                   hist_quantile(abs_hist, DUTY_HIST_BINS / 2 + 1, nper, 0.50) / 10.0,
+                   hist_quantile(abs_hist, DUTY_HIST_BINS / 2 + 1, nper, 0.99) / 10.0, within2 * 100.0 / nper);
+        if (max_err > 2.0)
+            printf("[提示] 误差超过 ±2%%：CPU 可能已被其他负载占满，或线程数多于核心数\n");
+    }
+
+    free(ws);
+    free(profile.t_ns);
+    free(profile.u);
+    printf("[✓] CPU 注入结束\n");
+    return 0;
+}
+
+// 干扰核满载模式：每秒汇总各线程操作数
+static int run_kernels(int num_threads, int duration)
+{
+    KernelCtx *ks = calloc(num_threads, sizeof(KernelCtx));
+    pthread_t *tids = calloc(num_threads, sizeof(pthread_t));
+    if (!ks || !tids)
+    {
+        perror("malloc failed");
+        return 1;
+    }
+
+    printf("[*] 启动 %d 个 %s 干扰线程...\n", num_threads, stress_kernel->name);
+    fi_mark_write("start", mark_label);
+    for (int i = 0; i < num_threads; i++)
+    {
+        ks[i].id = i;
+        ks[i].param = kernel_param;
+        if (pthread_create(&tids[i], NULL, kernel_worker, &ks[i]) != 0)
+        {
+            perror("创建线程失败");
+            num_threads = i;
+            break;
+        }
+    }
+
+    printf("[*] 开始施压!\n\n");
+    printf("  秒    速率 (%s)    每线程\n", stress_kernel->unit);
+
+    long long t0 = clock_ns(CLOCK_MONOTONIC), last_wall = t0, last_ops = 0;
+    struct timespec tick;
+    clock_gettime(CLOCK_MONOTONIC, &tick);
+    for (int s = 1; s <= duration; s++)
+    {
+        tick.tv_sec++;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+
+        long long ops = 0;
+        for (int i = 0; i < num_threads; i++)
+            ops += ks[i].ops;
+        long long wall = clock_ns(CLOCK_MONOTONIC);
+        double rate = (ops - last_ops) * stress_kernel->scale * 1e9 / (wall - last_wall);
+        printf("  %-4d  %12.2f  %10.2f\n", s, rate, num_threads ? rate / num_threads : 0);
+        fflush(stdout);
+        last_ops = ops;
+        last_wall = wall;
+    }
+
+    keep_running = 0;
+    fi_mark_write("stop", mark_label);
+    printf("\n[*] 停止施压...\n");
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(tids[i], NULL);
+
+    if (last_wall > t0 && num_threads > 0)
+    {
+        double per = last_ops * 1e9 / (last_wall - t0) / num_threads; // 每线程原始操作数/秒
+        printf("[结果] %s 平均速率 %.2f %s (每线程 %.2f)\n", stress_kernel->name,
+               per * num_threads * stress_kernel->scale, stress_kernel->unit, per * stress_kernel->scale);
+        if (stress_kernel->step == llc_step || stress_kernel->step == tlb_step)
+            printf("[结果] 平均访问延迟 %.1f ns\n", per > 0 ? 1e9 / per : 0);
+    }
+
+    free(ks);
+    free(tids);
+    printf("[✓] CPU 注入结束\n");
+    return 0;
+}
+
+// ---------------- SCHED_DEADLINE 窃取模式 ----------------
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+// 与内核 struct sched_attr 布局一致 (旧 glibc 未提供)
+struct dl_attr
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+static long long dl_runtime_ns, dl_period_ns;
+static int dl_partition = 0; // 窃取线程运行在独立 cpuset 分区中 (默认)
+static int dl_global_rt = 0; // -R：改为临时关闭整机准入控制并逐线程绑核
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+// 窃取线程：切到 SCHED_DEADLINE 后一直忙，超出 runtime 由内核节流到下一周期。
+// 分区中亲和性保持为整个分区 (准入控制的要求)，由全局 EDF 在分区 CPU 间调度；-R 时逐线程绑核
+void *steal_worker(void *arg)
+{
+    KernelCtx *k = (KernelCtx *)arg;
+    struct dl_attr attr;
+
+    if (!dl_partition)
+        pin_worker(pthread_self(), k->id);
+    if (kernel_init(k) < 0)
+    {
+        k->err = errno ? errno : EINVAL;
+        return NULL;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = dl_runtime_ns;
+    attr.sched_deadline = dl_period_ns;
+    attr.sched_period = dl_period_ns;
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) < 0)
+    {
+        k->err = errno;
+        kernel_fini(k);
+        return NULL;
+    }
+
+    while (keep_running)
+        k->ops += stress_kernel->step(k);
+    kernel_fini(k);
+    return NULL;
+}
+
+// 目标全部线程 schedstat 之和：运行时间与运行队列等待时间 (纳秒)
+static int target_schedstat(int pid, long long *run, long long *wait)
+{
+    char path[300];
+    DIR *d;
+    struct dirent *e;
+
+    *run = *wait = 0;
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    if (!(d = opendir(path)))
+        return -1;
+    while ((e = readdir(d)))
+    {
+        if (e->d_name[0] < '0' || e->d_name[0] > '9')
+            continue;
+        snprintf(path, sizeof(path), "/proc/%d/task/%s/schedstat", pid, e->d_name);
+        FILE *fp = fopen(path, "r");
+        long long r, w;
+        if (!fp)
+            continue;
+        if (fscanf(fp, "%lld %lld", &r, &w) == 2)
+        {
+            *run += r;
+            *wait += w;
+        }
+        fclose(fp);
+    }
+    closedir(d);
+    return 0;
+}
+
+// 读写 sched_rt_runtime_us：-1 表示关闭实时/deadline 带宽准入控制
+static long read_rt_runtime(void)
+{
+    long v = 0;
+    FILE *fp = fopen("/proc/sys/kernel/sched_rt_runtime_us", "r");
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%ld", &v) != 1)
+        v = 0;
+    fclose(fp);
+    return v;
+}
+
+static int write_rt_runtime(long v)
+{
+    FILE *fp = fopen("/proc/sys/kernel/sched_rt_runtime_us", "w");
+    if (!fp)
+        return -1;
+    fprintf(fp, "%ld\n", v);
+    return fclose(fp);
+}
+
+// 修改 sched_rt_runtime_us 前的原值，atexit 兜底恢复 (早退的错误路径也走 exit)；-2 表示无需恢复
+static long rt_restore = -2;
+
+static void restore_rt_runtime(void)
+{
+    if (rt_restore >= 0)
+        write_rt_runtime(rt_restore);
+    rt_restore = -2;
+}
+
+static int run_steal(int num_threads, int duration, int pid)
+{
+    KernelCtx *ks = calloc(num_threads, sizeof(KernelCtx));
+    pthread_t *tids = calloc(num_threads, sizeof(pthread_t));
+    clockid_t *clks = calloc(num_threads, sizeof(clockid_t));
+    if (!ks || !tids || !clks)
+    {
+        perror("malloc failed");
+        return 1;
+    }
+
+    // 开启准入控制时内核要求 deadline 线程的亲和性覆盖整个根域，无法绑核；
+    // -R 时暂时关闭准入控制 (每个线程的 runtime 上限仍由 CBS 强制)，结束时恢复
+    long saved_rt = dl_partition ? -1 : read_rt_runtime();
+    if (saved_rt >= 0)
+    {
+        if (write_rt_runtime(-1) < 0)
+        {
+            printf("[错误] 无法关闭 SCHED_DEADLINE 准入控制 (需要 root): %s\n", strerror(errno));
+            return 1;
+        }
+        rt_restore = saved_rt;
+        atexit(restore_rt_runtime);
+        printf("[提示] 暂时关闭 SCHED_DEADLINE 准入控制以便绑核 (sched_rt_runtime_us: %ld -> -1)\n", saved_rt);
+        printf("[警告] 这是整机设置：注入器被 SIGKILL 或崩溃时无法自动恢复，需手动执行\n"
+               "       echo %ld > /proc/sys/kernel/sched_rt_runtime_us\n", saved_rt);
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    // 基线：注入前 1 秒目标的等待速率
+    long long run0, wait0, run1, wait1;
+    int have_target = pid > 0 && target_schedstat(pid, &run0, &wait0) == 0;
+    long long w0 = clock_ns(CLOCK_MONOTONIC);
+    double base_wait = 0;
+    if (have_target)
+    {
+        sleep(1);
+        target_schedstat(pid, &run1, &wait1);
+        base_wait = (wait1 - wait0) / 1e6 / ((clock_ns(CLOCK_MONOTONIC) - w0) / 1e9);
+        printf("[基线] 目标运行队列等待 %.2f ms/秒\n", base_wait);
+    }
+
+    printf("[*] 启动 %d 个窃取线程 (runtime %.2f ms / period %.2f ms)...\n",
+           num_threads, dl_runtime_ns / 1e6, dl_period_ns / 1e6);
+    int started = 0;
+    fi_mark_write("start", mark_label);
+    for (int i = 0; i < num_threads; i++)
+    {
+        ks[i].id = i;
+        ks[i].param = kernel_param;
+        if (pthread_create(&tids[i], NULL, steal_worker, &ks[i]) != 0)
+        {
+            perror("创建线程失败");
+            break;
+        }
+        pthread_getcpuclockid(tids[i], &clks[i]);
+        started++;
+    }
+    num_threads = started;
+
+    usleep(100000);
+    int failed = 0;
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (ks[i].err)
+        {
+            printf("[错误] 线程 %d (CPU %d) 设置 SCHED_DEADLINE 失败: %s\n",
+                   i, nplace ? place_cpus[i % nplace] : i, strerror(ks[i].err));
+            failed++;
+        }
+    }
+
+    double expect = (double)dl_runtime_ns / dl_period_ns * 1000.0 * (num_threads - failed);
+    long long last_cpu = 0, last_wall = clock_ns(CLOCK_MONOTONIC), t0 = last_wall;
+    long long total_wait = 0, last_run = 0, last_wait = 0;
+    if (have_target)
+        target_schedstat(pid, &last_run, &last_wait);
+    for (int i = 0; i < num_threads; i++)
+        last_cpu += clock_ns(clks[i]);
+    long long cpu_start = last_cpu, wait_start = last_wait;
+
+    if (failed < num_threads)
+    {
+        printf("[*] 开始窃取!\n\n");
+        printf("  秒    窃取 ms/秒  期望 ms/秒  目标运行 ms/秒  目标等待 ms/秒\n");
+        struct timespec tick;
+        clock_gettime(CLOCK_MONOTONIC, &tick);
+        for (int s = 1; s <= duration && keep_running; s++)
+        {
+            tick.tv_sec++;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL) == EINTR && keep_running)
+                ;
+            long long cpu = 0, r = 0, w = 0;
+            for (int i = 0; i < num_threads; i++)
+                cpu += clock_ns(clks[i]);
+            long long wall = clock_ns(CLOCK_MONOTONIC);
+            double secs = (wall - last_wall) / 1e9;
+            if (have_target && target_schedstat(pid, &r, &w) < 0)
+                have_target = 0;
+            printf("  %-4d  %10.2f  %10.2f", s, (cpu - last_cpu) / 1e6 / secs, expect);
+            if (have_target)
+                printf("  %14.2f  %14.2f", (r - last_run) / 1e6 / secs, (w - last_wait) / 1e6 / secs);
+            printf("\n");
+            fflush(stdout);
+            last_cpu = cpu;
+            last_wall = wall;
+            last_run = r;
+            last_wait = w;
+            total_wait = w - wait_start;
+        }
+    }
+
+    keep_running = 0;
+    fi_mark_write("stop", mark_label);
+    printf("\n[*] 停止窃取...\n");
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(tids[i], NULL);
+    restore_rt_runtime();
+
+    double secs = (last_wall - t0) / 1e9;
+    if (secs > 0 && failed < num_threads)
+    {
+        printf("[结果] 窃取 %.2f ms/秒 (期望 %.2f)\n", (last_cpu - cpu_start) / 1e6 / secs, expect);
+        if (have_target)
+            printf("[结果] 目标等待 %.2f ms/秒，比基线增加 %.2f ms/秒\n",
+                   total_wait / 1e6 / secs, total_wait / 1e6 / secs - base_wait);
+    }
+
+    free(ks);
+    free(tids);
+    free(clks);
+    printf("[✓] CPU 注入结束\n");
+    return failed == num_threads;
+}
+
+// 按策略计算放置 CPU；threads 非空时把线程数设为放置 CPU 数
+static int place_threads(int pid, int policy, int *threads)
+{
+    FiTopo topo;
+    cpu_set_t used, allowed, set;
+    char a[256], b[256];
+
+    if (pid <= 0)
+    {
+        printf("[错误] 放置策略需要目标 PID\n");
+        return -1;
+    }
+    if (fi_topo_load(&topo) < 0)
+    {
+        perror("读取 CPU 拓扑失败");
+        return -1;
+    }
+    int n = fi_topo_target_cpus(pid, 200, &used, &allowed);
+    if (n <= 0)
+    {
+        printf("[错误] 无法读取目标 %d 的线程\n", pid);
+        return -1;
+    }
+    printf("[放置] 目标 %d 个线程，运行过的 CPU: %s (亲和性允许: %s)\n",
+           n, fi_topo_format(&used, a, sizeof(a)), fi_topo_format(&allowed, b, sizeof(b)));
+
+    nplace = fi_topo_place(&topo, &used, policy, place_cpus, FI_TOPO_MAX_CPUS);
+    if (nplace == 0)
+    {
+        printf("[错误] 拓扑中没有满足 %s 策略的 CPU (无 SMT/单 LLC/单节点?)\n", fi_topo_place_name(policy));
+        return -1;
+    }
+    CPU_ZERO(&set);
+    for (int i = 0; i < nplace; i++)
+        CPU_SET(place_cpus[i], &set);
+    printf("[放置] 策略 %s -> CPU %s\n", fi_topo_place_name(policy), fi_topo_format(&set, a, sizeof(a)));
+    if (threads)
+        *threads = nplace;
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    const char *prof_spec = NULL;
+    const char *kernel_spec = NULL;
+    int place = -1;
+    const char *cpu_list = NULL;
+    FiStressConfig stress_cfg;
+    int opt;
+    fi_stress_defaults(&stress_cfg, "cpu_injector");
+    while ((opt = getopt(argc, argv, "+u:p:P:k:a:c:D:Rg:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            if (fi_stress_parse(&stress_cfg, optarg) < 0)
+            {
+                printf("[错误] -g 格式为 cpu=百分比,cpus=列表,mem=MB，例如 cpu=50,cpus=2-3,mem=512\n");
+                return 1;
+            }
+            confined = 1;
+            break;
+        case 'c':
+            cpu_list = optarg;
+            break;
+        case 'D':
+        {
+            double r, per;
+            if (sscanf(optarg, "%lf/%lf", &r, &per) != 2 || r <= 0 || per <= 0 || r > per)
+            {
+                printf("[错误] -D 格式为 runtime_ms/period_ms，例如 20/100\n");
+                return 1;
+            }
+            dl_runtime_ns = (long long)(r * 1e6);
+            dl_period_ns = (long long)(per * 1e6);
+            break;
+        }
+        case 'R':
+            dl_global_rt = 1;
+            break;
+        case 'a':
+            place = fi_topo_parse_place(optarg);
+            if (place < 0)
+            {
+                printf("[错误] 未知放置策略: %s (core/smt/llc/node/remote)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k':
+            kernel_spec = optarg;
+            break;
+        case 'u':
+        {
+            static char buf[64];
+            snprintf(buf, sizeof(buf), "const:%s", optarg);
+            prof_spec = buf;
+            break;
+        }
+        case 'p':
+            prof_spec = optarg;
+            break;
+        case 'P':
+            duty_period_ns = (long long)(atof(optarg) * 1e6);
+            if (duty_period_ns < 100000)
+                duty_period_ns = 100000;
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
     if (argc < 3)
     {
-        printf("用法: %s <PID> <Duration_Sec> [Threads] [Mode]\n", argv[0]);
+        printf("用法: %s [-g cgroup限额] [-a 放置策略 | -c CPU列表] [-D runtime/period [-R]] [-k 干扰核[:参数]] [-u 利用率%% | -p 负载曲线] [-P 周期ms] <PID> <Duration_Sec> [Threads] [Mode]\n", argv[0]);
         printf("参数:\n");
         printf("  PID      - 目标进程 (用于日志)\n");
         printf("  Duration - 持续秒数\n");
         printf("  Threads  - 线程数 (默认=CPU核心数x2)\n");
         printf("  Mode     - 模式: 1=普通 2=激进 (默认2)\n");
+        printf("占空比模式 (每线程部分利用率，线程默认=CPU核心数):\n");
+        printf("  -u U                   恒定利用率 U%%\n");
+        printf("  -p const:U             同 -u\n");
+        printf("  -p ramp:起:止[:秒]     线性变化 (默认持续整个注入时长)\n");
+        printf("  -p square:低:高:周期ms 方波\n");
+        printf("  -p trace:文件          按轨迹回放，每行 \"毫秒 利用率%%\"\n");
+        printf("  -P ms                  控制周期 (默认 1ms)\n");
+        printf("放置策略 (-a，按目标线程实际运行的 CPU，线程默认=每个放置 CPU 一个):\n");
+        printf("  core    与目标线程同一 CPU      smt     同一物理核的 SMT 兄弟\n");
+        printf("  llc     共享 LLC 的其他物理核   node    同 NUMA 节点、不共享 LLC\n");
+        printf("  remote  其他 NUMA 节点\n");
+        printf("  -c 2-3,6  直接指定 CPU 列表\n");
+        printf("窃取模式 (-D runtime_ms/period_ms，SCHED_DEADLINE，默认 -a core):\n");
+        printf("  每个线程每周期恰好占用 runtime，并按目标 schedstat 报告其等待时间的增加\n");
+        printf("  线程运行在放置 CPU 组成的 cpuset 分区中 (cgroup v2)，准入控制只在分区内计算\n");
+        printf("  -R  不建分区，改为运行期间关闭整机 sched_rt_runtime_us 并逐线程绑核 (影响全部实时任务)\n");
+        printf("受限模式 (-g cpu=百分比[,cpus=列表][,mem=MB]，cpus 含逗号时写作 0-1:4):\n");
+        printf("  压力线程在 cgroup v2 叶子中运行，默认 cpu=90、继承 cpuset、mem=物理内存 1/4\n");
+        printf("  运行中标准输入: cpu N 调整强度 / pause / resume / stop，结束时按 cpu.stat 报告消耗\n");
+        printf("干扰核 (-k，指定后忽略 Mode，逐秒报告各自速率):\n");
+        for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+            printf("  %-22s %s\n", kernels[i].name, kernels[i].desc);
         printf("\n示例: %s 1234 30 8 2\n", argv[0]);
+        printf("      %s -u 60 1234 30 4\n", argv[0]);
+        printf("      %s -k llc:32768 1234 30 4\n", argv[0]);
+        printf("      %s -a smt -k simd 1234 30\n", argv[0]);
+        printf("      %s -D 20/100 -c 2-3 1234 30\n", argv[0]);
+        printf("      %s -g cpu=50,cpus=1-3,mem=256 -k stream 1234 60\n", argv[0]);
         return 1;
     }
 
@@ -115,9 +1372,58 @@ int main(int argc, char *argv[])
         mode = atoi(argv[4]);
 
     if (num_threads <= 0)
-        num_threads = num_cpus * 2;
+        num_threads = prof_spec ? num_cpus : num_cpus * 2;
+    if (prof_spec && argc < 4)
+        num_threads = num_cpus; // 部分利用率按每核一个线程计算
+
+    stress_kernel = &kernels[0];
+    if (kernel_spec && !(stress_kernel = find_kernel(kernel_spec, &kernel_param)))
+    {
+        printf("[错误] 未知干扰核: %s\n", kernel_spec);
+        return 1;
+    }
+    if (prof_spec && parse_profile(prof_spec, duration) < 0)
+    {
+        printf("[错误] 无法解析负载曲线: %s\n", prof_spec);
+        return 1;
+    }
+    if (dl_runtime_ns && confined)
+    {
+        printf("[错误] -D 与 -g 不能同时使用 (SCHED_DEADLINE 线程不受 cpu.max 约束)\n");
+        return 1;
+    }
+    if (dl_runtime_ns && place < 0 && !cpu_list)
+        place = FI_PLACE_CORE; // 窃取线程必须绑在目标旁边
+    if (confined && stress_cfg.cpus[0] && place < 0 && !cpu_list)
+        cpu_list = stress_cfg.cpus;
+    if (cpu_list)
+    {
+        cpu_set_t set;
+        if (fi_topo_parse_list(cpu_list, &set) < 0)
+        {
+            printf("[错误] 无法解析 CPU 列表: %s\n", cpu_list);
+            return 1;
+        }
+        nplace = 0;
+        for (int c = 0; c < FI_TOPO_MAX_CPUS; c++)
+            if (CPU_ISSET(c, &set))
+                place_cpus[nplace++] = c;
+        if (argc < 4)
+            num_threads = nplace;
+    }
+    else if (place >= 0 && place_threads(target_pid, place, argc < 4 ? &num_threads : NULL) < 0)
+        return 1;
     if (num_threads > 256)
         num_threads = 256;
+    if (confined && !stress_cfg.cpus[0] && nplace > 0)
+    {
+        // cpuset 与放置 CPU 一致，线程绑核才不会落空
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < nplace; i++)
+            CPU_SET(place_cpus[i], &set);
+        fi_topo_format(&set, stress_cfg.cpus, sizeof(stress_cfg.cpus));
+    }
 
     printf("╔═══════════════════════════════════════════════╗\n");
     printf("║     CPU 高负载注入器 (增强版)                 ║\n");
@@ -125,11 +1431,87 @@ int main(int argc, char *argv[])
     printf("║ 目标 PID: %-6d                              ║\n", target_pid);
     printf("║ 持续时间: %-3d 秒                              ║\n", duration);
     printf("║ 压力线程: %-3d 个 (CPU核心: %d)                ║\n", num_threads, num_cpus);
-    printf("║ 压力模式: %s                            ║\n", mode == 2 ? "激进" : "普通");
+    if (dl_runtime_ns)
+        printf("║ 压力模式: SCHED_DEADLINE %.1f/%.1f ms        ║\n", dl_runtime_ns / 1e6, dl_period_ns / 1e6);
+    else if (prof_spec)
+        printf("║ 压力模式: 占空比 %-28s ║\n", prof_spec);
+    else if (kernel_spec)
+        printf("║ 压力模式: 干扰核 %-28s ║\n", kernel_spec);
+    else
+        printf("║ 压力模式: %s                            ║\n", mode == 2 ? "激进" : "普通");
     printf("╚═══════════════════════════════════════════════╝\n\n");
 
+    // 受限模式：父进程留在原 cgroup 负责控制与计量，子进程进入叶子继续执行下面的压力流程
+    if (confined)
+    {
+        FiStress stress;
+        fi_stress_create(&stress, &stress_cfg);
+        pid_t pid = fi_stress_fork(&stress);
+        if (pid < 0)
+        {
+            fi_stress_destroy(&stress);
+            return 1;
+        }
+        if (pid > 0)
+        {
+            int status = fi_stress_wait(&stress, 0, 0);
+            fi_stress_destroy(&stress);
+            return status;
+        }
+    }
+
+    // 窃取模式：默认在独立 cpuset 分区中运行，准入控制只在分区的根域内计算，不改整机设置。
+    // 父进程留在原 cgroup 等待并在结束后删除分区，子进程进入分区继续执行
+    if (dl_runtime_ns && !dl_global_rt)
+    {
+        FiStressConfig part_cfg;
+        FiStress part;
+        cpu_set_t set;
+        fi_stress_defaults(&part_cfg, "cpu_injector_dl");
+        part_cfg.partition = 1;
+        CPU_ZERO(&set);
+        for (int i = 0; i < nplace; i++)
+            CPU_SET(place_cpus[i], &set);
+        fi_topo_format(&set, part_cfg.cpus, sizeof(part_cfg.cpus));
+        if (fi_stress_create(&part, &part_cfg) < 0)
+        {
+            printf("[错误] 无法为窃取线程建立 cpuset 分区 (需要 root、cgroup v2 cpuset，且须为其他任务留下 CPU)\n");
+            printf("       可加 -R 改为临时关闭整机 sched_rt_runtime_us (主机上全部实时任务都不再节流)\n");
+            return 1;
+        }
+        pid_t pid = fi_stress_fork(&part);
+        if (pid < 0)
+        {
+            fi_stress_destroy(&part);
+            return 1;
+        }
+        if (pid > 0)
+        {
+            int status = fi_stress_wait(&part, 0, 0);
+            fi_stress_destroy(&part);
+            return status;
+        }
+        dl_partition = 1;
+    }
+
+    snprintf(mark_label, sizeof(mark_label), "cpu_injector:%.63s",
+             dl_runtime_ns ? "deadline" : prof_spec ? prof_spec : kernel_spec ? kernel_spec : "stress");
+
+    // 占空比模式不提高优先级：睡眠时段必须让给目标，结果才是"目标失去 U% 的 CPU"
+    kernel_threads = num_threads;
+    if (dl_runtime_ns)
+        return run_steal(num_threads, duration, target_pid);
+    if (prof_spec)
+        return run_duty(num_threads, duration);
+    if (kernel_spec)
+        return run_kernels(num_threads, duration);
+
     // 尝试提高进程优先级
-    if (setpriority(PRIO_PROCESS, 0, -20) < 0)
+    if (confined)
+    {
+        printf("[提示] 受限模式，保持普通优先级\n");
+    }
+    else if (setpriority(PRIO_PROCESS, 0, -20) < 0)
     {
         printf("[提示] 无法提高优先级 (需要 root)\n");
     }
@@ -149,6 +1531,7 @@ int main(int argc, char *argv[])
     printf("[*] 启动 %d 个压力线程...\n", num_threads);
 
     // 启动压力线程
+    fi_mark_write("start", mark_label);
     for (int i = 0; i < num_threads; i++)
     {
         core_ids[i] = i;
@@ -180,6 +1563,7 @@ int main(int argc, char *argv[])
 
     // 停止
     keep_running = 0;
+    fi_mark_write("stop", mark_label);
     printf("[*] 停止施压...\n");
 
     for (int i = 0; i < num_threads; i++)
@@ -220,7 +220,7 @@ void inject_cpu_wrapper(const char *target)
     if (access("./cpu_injector", F_OK) != 0)
     {
         printf(" [Info] 自动编译 cpu_injector...\n");
-        system("gcc -o cpu_injector cpu_injector.c -lpthread -lm");
+        system("make -s cpu_injector"); // 源文件列表只在 Makefile 中维护
     }
 
     snprintf(cmd, sizeof(cmd), "./cpu_injector %d %d %d", pid, duration, threads);
@@ -0,0 +1,429 @@
+/*
+ * fi_dist.c - 跨节点分布式执行实现
+ *
+ * 每个节点的待派发任务是一段连续区间 [lo, hi)：自己从 lo 端取，窃取者从 hi 端切走一半，
+ * 切分后两段仍是连续区间，因此不需要显式的双端队列。
+ * 在途任务记录在 owner[] 中，节点失联时按 owner 找回并放入重试栈。
+ */
+
+#define _GNU_SOURCE
+#include "fi_dist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        *--e = '\0';
+    return s;
+}
+
+int fi_dist_load_nodes(FiDist *d, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        perror("打开节点列表失败");
+        return -1;
+    }
+    memset(d, 0, sizeof(*d));
+    char line[256];
+    while (fgets(line, sizeof(line), fp) && d->nnodes < FI_DIST_MAX_NODES)
+    {
+        char *p = trim(line);
+        if (*p == '\0' || *p == '#')
+            continue;
+        char *name = strtok(p, ",");
+        char *host = strtok(NULL, ",");
+        char *port = strtok(NULL, ",");
+        if (!name || !host)
+            continue;
+        FiDistNode *nd = &d->nodes[d->nnodes++];
+        snprintf(nd->name, sizeof(nd->name), "%s", trim(name));
+        snprintf(nd->host, sizeof(nd->host), "%s", trim(host));
+        nd->port = port ? atoi(trim(port)) : 22;
+        nd->in_fd = nd->out_fd = -1;
+    }
+    fclose(fp);
+    return d->nnodes > 0 ? 0 : -1;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t w = write(fd, buf, len);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return -1;
+        buf += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+int fi_dist_start(FiDist *d, const char *cmd, const char *preamble)
+{
+    // 节点失联时写端会收到 EPIPE，而不是让协调端被信号终止
+    signal(SIGPIPE, SIG_IGN);
+
+    int started = 0;
+    for (int i = 0; i < d->nnodes; i++)
+    {
+        FiDistNode *nd = &d->nodes[i];
+        int to_node[2], from_node[2];
+        // O_CLOEXEC：后启动的节点不继承之前节点的管道，否则失联时读不到 EOF
+        if (pipe2(to_node, O_CLOEXEC) < 0 || pipe2(from_node, O_CLOEXEC) < 0)
+        {
+            perror("pipe2");
+            nd->state = -1;
+            continue;
+        }
+
+        nd->pid = fork();
+        if (nd->pid == 0)
+        {
+            dup2(to_node[0], STDIN_FILENO);
+            dup2(from_node[1], STDOUT_FILENO);
+            if (strcmp(nd->host, "local") == 0)
+            {
+                execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+            }
+            else
+            {
+                char port[16], dest[96];
+                snprintf(port, sizeof(port), "%d", nd->port);
+                snprintf(dest, sizeof(dest), "root@%s", nd->host);
+                execlp("ssh", "ssh", "-o", "StrictHostKeyChecking=no", "-o", "ConnectTimeout=5", "-o",
+                       "BatchMode=yes", "-o", "ServerAliveInterval=5", "-o", "ServerAliveCountMax=3", "-p", port,
+                       dest, cmd, (char *)NULL);
+            }
+            _exit(127);
+        }
+        close(to_node[0]);
+        close(from_node[1]);
+        if (nd->pid < 0)
+        {
+            perror("fork");
+            close(to_node[1]);
+            close(from_node[0]);
+            nd->state = -1;
+            continue;
+        }
+        nd->in_fd = to_node[1];
+        nd->out_fd = from_node[0];
+        nd->last_ms = now_ms();
+        fcntl(nd->out_fd, F_SETFL, fcntl(nd->out_fd, F_GETFL) | O_NONBLOCK);
+        if (preamble && write_all(nd->in_fd, preamble, strlen(preamble)) < 0)
+        {
+            fprintf(stderr, "[-] 节点 %s 启动失败\n", nd->name);
+            nd->state = -1;
+            continue;
+        }
+        started++;
+    }
+    return started > 0 ? 0 : -1;
+}
+
+// === 1. 派发与窃取 ===
+static void requeue(FiDist *d, long idx, const FiDistOps *ops)
+{
+    if (d->tries[idx] >= FI_DIST_MAX_TRIES)
+    {
+        d->remaining--;
+        if (ops->failed)
+            ops->failed(ops->ctx, idx);
+        return;
+    }
+    d->retry[d->nretry++] = idx;
+}
+
+static void lose_node(FiDist *d, int ni, const FiDistOps *ops)
+{
+    FiDistNode *nd = &d->nodes[ni];
+    if (nd->state < 0)
+        return;
+    long moved = 0;
+    for (long i = 0; i < d->n; i++)
+    {
+        if (d->owner[i] == ni + 1)
+        {
+            d->owner[i] = 0;
+            requeue(d, i, ops);
+            moved++;
+        }
+    }
+    d->lost += moved;
+    fprintf(stderr, "\n[!] 节点 %s 失联，%ld 个在途任务重新派发，%ld 个未派发任务留待窃取\n", nd->name, moved,
+            nd->hi - nd->lo);
+    nd->state = -1;
+    nd->inflight = 0;
+    close(nd->in_fd);
+    close(nd->out_fd);
+    nd->in_fd = nd->out_fd = -1;
+    if (nd->pid > 0)
+        kill(nd->pid, SIGTERM);
+}
+
+// 下一个任务：重试栈优先，其次自己的分片，最后从剩余最多的分片尾部窃取一半
+static long take(FiDist *d, FiDistNode *nd)
+{
+    if (d->nretry > 0)
+        return d->retry[--d->nretry];
+    if (nd->lo < nd->hi)
+        return nd->lo++;
+
+    FiDistNode *victim = NULL;
+    for (int i = 0; i < d->nnodes; i++)
+    {
+        FiDistNode *v = &d->nodes[i];
+        if (v != nd && v->hi > v->lo && (!victim || v->hi - v->lo > victim->hi - victim->lo))
+            victim = v;
+    }
+    if (!victim)
+        return -1;
+    long n = (victim->hi - victim->lo + 1) / 2;
+    nd->hi = victim->hi;
+    nd->lo = victim->hi - n;
+    victim->hi -= n;
+    nd->stolen += n;
+    return nd->lo++;
+}
+
+static void dispatch(FiDist *d, int ni, const FiDistOps *ops)
+{
+    FiDistNode *nd = &d->nodes[ni];
+    char out[4096];
+    size_t len = 0;
+    long credit = 2L * (nd->nworkers > 0 ? nd->nworkers : 1);
+    while (nd->inflight < credit)
+    {
+        long idx = take(d, nd);
+        if (idx < 0)
+            break;
+        if (ops->skip && ops->skip(ops->ctx, idx))
+        {
+            d->remaining--;
+            continue;
+        }
+        d->owner[idx] = (int16_t)(ni + 1);
+        d->tries[idx]++;
+        if (nd->inflight++ == 0)
+            nd->last_ms = now_ms(); // 空闲期间没有输出是正常的，从开始有在途任务起计时
+        len += (size_t)snprintf(out + len, sizeof(out) - len, "%ld\n", idx);
+        if (len > sizeof(out) - 32)
+        {
+            if (write_all(nd->in_fd, out, len) < 0)
+            {
+                lose_node(d, ni, ops);
+                return;
+            }
+            len = 0;
+        }
+    }
+    if (len > 0 && write_all(nd->in_fd, out, len) < 0)
+        lose_node(d, ni, ops);
+}
+
+// === 2. 结果流 ===
+static void handle_line(FiDist *d, int ni, char *line, const FiDistOps *ops)
+{
+    FiDistNode *nd = &d->nodes[ni];
+    char *rest;
+    long idx;
+    switch (line[0])
+    {
+    case 'H':
+    {
+        long n = -1;
+        if (sscanf(line, "H %d %ld", &nd->nworkers, &n) != 2 || n != d->n)
+        {
+            fprintf(stderr, "\n[-] 节点 %s 的任务总数 (%ld) 与协调端 (%ld) 不一致，请检查节点上的文件\n", nd->name, n,
+                    d->n);
+            lose_node(d, ni, ops);
+            return;
+        }
+        nd->state = 1;
+        return;
+    }
+    case 'R':
+    case 'E':
+        idx = strtol(line + 2, &rest, 10);
+        // 只接受当前确实在该节点在途的任务，重复或过期的结果丢弃
+        if (idx < 0 || idx >= d->n || d->owner[idx] != ni + 1)
+            return;
+        d->owner[idx] = 0;
+        nd->inflight--;
+        if (line[0] == 'E')
+        {
+            requeue(d, idx, ops);
+            return;
+        }
+        nd->done++;
+        d->remaining--;
+        while (*rest == ' ')
+            rest++;
+        if (ops->result)
+            ops->result(ops->ctx, nd, idx, rest);
+        return;
+    }
+}
+
+static void read_node(FiDist *d, int ni, const FiDistOps *ops)
+{
+    FiDistNode *nd = &d->nodes[ni];
+    while (nd->state >= 0)
+    {
+        ssize_t r = read(nd->out_fd, nd->buf + nd->blen, sizeof(nd->buf) - 1 - nd->blen);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && errno == EAGAIN)
+            return;
+        if (r <= 0)
+        {
+            lose_node(d, ni, ops);
+            return;
+        }
+        nd->blen += (size_t)r;
+        nd->buf[nd->blen] = '\0';
+        nd->last_ms = now_ms();
+
+        char *p = nd->buf, *nl;
+        while (nd->state >= 0 && (nl = strchr(p, '\n')) != NULL)
+        {
+            *nl = '\0';
+            handle_line(d, ni, p, ops);
+            p = nl + 1;
+        }
+        if (nd->state < 0)
+            return;
+        nd->blen -= (size_t)(p - nd->buf);
+        memmove(nd->buf, p, nd->blen);
+        if (nd->blen == sizeof(nd->buf) - 1) // 超长行：丢弃
+            nd->blen = 0;
+    }
+}
+
+int fi_dist_run(FiDist *d, long n, const FiDistOps *ops)
+{
+    d->n = n;
+    d->remaining = n;
+    d->owner = calloc(n > 0 ? n : 1, sizeof(int16_t));
+    d->tries = calloc(n > 0 ? n : 1, sizeof(uint8_t));
+    d->retry = calloc(n > 0 ? n : 1, sizeof(long));
+    if (!d->owner || !d->tries || !d->retry)
+        return -1;
+
+    // 初始分片：按节点数均分，失败的节点分片之后被其他节点窃取
+    for (int i = 0; i < d->nnodes; i++)
+    {
+        d->nodes[i].lo = n * i / d->nnodes;
+        d->nodes[i].hi = n * (i + 1) / d->nnodes;
+    }
+
+    int rc = 0;
+    while (d->remaining > 0)
+    {
+        if (ops->tick && ops->tick(ops->ctx))
+        {
+            rc = -1;
+            break;
+        }
+
+        struct pollfd pfd[FI_DIST_MAX_NODES];
+        int map[FI_DIST_MAX_NODES], npfd = 0;
+        for (int i = 0; i < d->nnodes; i++)
+        {
+            if (d->nodes[i].state == 1)
+                dispatch(d, i, ops);
+            if (d->nodes[i].state == 0 || d->nodes[i].state == 1)
+            {
+                pfd[npfd].fd = d->nodes[i].out_fd;
+                pfd[npfd].events = POLLIN;
+                map[npfd++] = i;
+            }
+        }
+        if (d->remaining <= 0)
+            break;
+        if (npfd == 0)
+        {
+            fprintf(stderr, "\n[-] 所有节点均已失联，剩余 %ld 个任务未完成\n", d->remaining);
+            rc = -1;
+            break;
+        }
+        if (poll(pfd, npfd, 200) > 0)
+        {
+            for (int k = 0; k < npfd; k++)
+            {
+                if (pfd[k].revents)
+                    read_node(d, map[k], ops);
+            }
+        }
+
+        // 进程仍在但不再产出结果 (靶子挂死、节点卡住) 的节点按失联处理
+        if (d->idle_ms <= 0)
+            continue;
+        int64_t now = now_ms();
+        for (int i = 0; i < d->nnodes; i++)
+        {
+            FiDistNode *nd = &d->nodes[i];
+            if ((nd->state == 0 || (nd->state == 1 && nd->inflight > 0)) && now - nd->last_ms > d->idle_ms)
+            {
+                fprintf(stderr, "\n[!] 节点 %s 已 %d 秒没有输出\n", nd->name, d->idle_ms / 1000);
+                lose_node(d, i, ops);
+            }
+        }
+    }
+    return rc;
+}
+
+void fi_dist_stop(FiDist *d)
+{
+    // 关闭输入即通知节点没有更多任务，节点做完手头的实验后退出
+    for (int i = 0; i < d->nnodes; i++)
+    {
+        FiDistNode *nd = &d->nodes[i];
+        if (nd->in_fd >= 0)
+            close(nd->in_fd);
+        nd->in_fd = -1;
+    }
+    for (int i = 0; i < d->nnodes; i++)
+    {
+        FiDistNode *nd = &d->nodes[i];
+        if (nd->pid > 0)
+            waitpid(nd->pid, NULL, 0);
+        if (nd->out_fd >= 0)
+            close(nd->out_fd);
+        nd->out_fd = -1;
+        nd->pid = 0;
+        if (nd->state >= 0)
+            nd->state = 2;
+    }
+    free(d->owner);
+    free(d->tries);
+    free(d->retry);
+    d->owner = NULL;
+    d->tries = NULL;
+    d->retry = NULL;
+}
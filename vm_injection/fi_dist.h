@@ -0,0 +1,77 @@
+/*
+ * fi_dist.h - 跨节点分布式执行 (工作窃取)
+ * 功能：协调端经 ssh 在各节点启动服务进程，把编号为 [0, n) 的任务分片派发给节点：
+ *       - 初始按节点数切成连续分片，节点从自己分片的头部按需取任务 (在途任务数不超过 2×工作进程数)；
+ *       - 自己的分片取完后，从剩余最多的节点分片尾部窃取一半；
+ *       - 节点失联 (ssh 断开/进程退出，或有在途任务却超过 idle_ms 没有任何输出) 时，其在途任务进入重试队列
+ *         由其他节点优先领取，未派发的分片照常被窃取；
+ *       - 结果行实时流回协调端，由回调汇总。
+ *       任务顺序由调用者预先打乱，连续分片即为均匀样本，窃取不引入偏差。
+ * 协议 (文本行)：协调端先发送前导文本 (如战役文件)，之后每行一个任务编号，关闭输入表示没有更多任务；
+ *       节点回复 "H <工作进程数> <任务总数>" 表示就绪，"R <编号> <结果>" 表示完成，"E <编号>" 表示执行失败。
+ */
+
+#ifndef FI_DIST_H
+#define FI_DIST_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FI_DIST_MAX_NODES 32
+#define FI_DIST_MAX_TRIES 3 // 同一任务最多尝试次数 (节点失联或执行失败都计一次)
+
+typedef struct
+{
+    char name[32];
+    char host[64]; // "local" 表示在本机直接运行，不经 ssh
+    int port;
+    pid_t pid;
+    int in_fd;     // 向节点写任务编号
+    int out_fd;    // 读取节点结果行
+    int state;     // 0=启动中, 1=就绪, 2=已结束, -1=失联
+    int nworkers;
+    long lo, hi;   // 尚未派发的分片 [lo, hi)
+    long inflight;
+    long done;
+    long stolen;   // 窃取来的任务数
+    int64_t last_ms; // 最近一次收到输出 (或开始等待) 的时刻
+    char buf[8192];
+    size_t blen;
+} FiDistNode;
+
+typedef struct
+{
+    void *ctx;
+    int (*skip)(void *ctx, long idx);                                  // 派发前返回非 0 则跳过 (序贯抽样)
+    void (*result)(void *ctx, FiDistNode *node, long idx, const char *line); // 完成，line 为 "R <编号> " 之后的部分
+    void (*failed)(void *ctx, long idx);                               // 尝试次数用完
+    int (*tick)(void *ctx);                                            // 约每 200ms 调用，返回非 0 则中止
+} FiDistOps;
+
+typedef struct
+{
+    FiDistNode nodes[FI_DIST_MAX_NODES];
+    int nnodes;
+    long n;
+    long remaining; // 尚未完成、失败或跳过的任务数
+    int16_t *owner; // 任务 -> 在途节点 + 1
+    uint8_t *tries;
+    long *retry;
+    long nretry;
+    long lost;      // 因节点失联重新派发的任务数
+    int idle_ms;    // 节点无输出超时 (毫秒)，0 表示不限；须在 fi_dist_load_nodes 之后设置
+} FiDist;
+
+// 读取节点列表 (kvm_injection/cluster.conf 格式：名称,地址,SSH端口[,角色...])
+int fi_dist_load_nodes(FiDist *d, const char *path);
+
+// 在各节点执行 cmd (经 ssh 或本机 sh -c)，写入前导文本后开始等待就绪
+int fi_dist_start(FiDist *d, const char *cmd, const char *preamble);
+
+// 派发 [0, n) 直到全部完成/失败/跳过：0 完成，-1 全部节点失联或被中止
+int fi_dist_run(FiDist *d, long n, const FiDistOps *ops);
+
+// 关闭所有节点并回收进程
+void fi_dist_stop(FiDist *d);
+
+#endif
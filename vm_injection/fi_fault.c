@@ -0,0 +1,220 @@
+/*
+ * fi_fault.c - 故障模型与故障位置实现
+ */
+
+#define _GNU_SOURCE
+#include "fi_fault.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+
+static const char *fault_names[] = {
+    "flip1", "flip2", "zero1", "zero2", "set1", "set2",
+    "low0", "low1", "lowerr", "add1", "add2", "add3", "add4", "add5"};
+
+static int rand_bit(void) { return rand() % 64; }
+
+uint64_t fi_fault_apply(uint64_t original, FaultType type, int bit)
+{
+    uint64_t corrupted = original;
+    int bit1 = (bit >= 0) ? bit : rand_bit();
+    int bit2 = rand_bit();
+    uint64_t mask_low_8 = 0xFFFFFFFFFFFFFF00;
+
+    switch (type)
+    {
+    case FAULT_1_BIT_FLIP:
+        corrupted ^= (1UL << bit1);
+        break;
+    case FAULT_2_BIT_FLIP:
+        corrupted ^= (1UL << bit1);
+        corrupted ^= (1UL << bit2);
+        break;
+    case FAULT_1_BIT_0:
+        corrupted &= ~(1UL << bit1);
+        break;
+    case FAULT_2_BIT_0:
+        corrupted &= ~(1UL << bit1);
+        corrupted &= ~(1UL << bit2);
+        break;
+    case FAULT_1_BIT_1:
+        corrupted |= (1UL << bit1);
+        break;
+    case FAULT_2_BIT_1:
+        corrupted |= (1UL << bit1);
+        corrupted |= (1UL << bit2);
+        break;
+    case FAULT_8_LOW_0:
+        corrupted &= mask_low_8;
+        break;
+    case FAULT_8_LOW_1:
+        corrupted |= 0xFF;
+        break;
+    case FAULT_8_LOW_ERROR:
+        corrupted ^= ((uint64_t)rand() & 0xFF);
+        break;
+    case FAULT_PLUS_1:
+        corrupted += 1;
+        break;
+    case FAULT_PLUS_2:
+        corrupted += 2;
+        break;
+    case FAULT_PLUS_3:
+        corrupted += 3;
+        break;
+    case FAULT_PLUS_4:
+        corrupted += 4;
+        break;
+    case FAULT_PLUS_5:
+        corrupted += 5;
+        break;
+    default:
+        break;
+    }
+    return corrupted;
+}
+
+FaultType fi_fault_parse(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(fault_names) / sizeof(fault_names[0])); i++)
+    {
+        if (strcmp(name, fault_names[i]) == 0)
+            return (FaultType)i;
+    }
+    return FAULT_1_BIT_FLIP;
+}
+
+const char *fi_fault_name(FaultType type)
+{
+    if ((int)type < 0 || type > FAULT_PLUS_5)
+        return "?";
+    return fault_names[type];
+}
+
+uint64_t *fi_fault_reg(fi_regs_t *regs, const char *name)
+{
+    if (strcasecmp(name, "PC") == 0)
+        return &FI_REG_PC(regs);
+    if (strcasecmp(name, "SP") == 0)
+        return &FI_REG_SP(regs);
+#if defined(__x86_64__)
+    static const struct
+    {
+        const char *name;
+        size_t off;
+    } x86_regs[] = {
+        {"rax", offsetof(fi_regs_t, rax)}, {"rbx", offsetof(fi_regs_t, rbx)},
+        {"rcx", offsetof(fi_regs_t, rcx)}, {"rdx", offsetof(fi_regs_t, rdx)},
+        {"rsi", offsetof(fi_regs_t, rsi)}, {"rdi", offsetof(fi_regs_t, rdi)},
+        {"rbp", offsetof(fi_regs_t, rbp)}, {"rsp", offsetof(fi_regs_t, rsp)},
+        {"rip", offsetof(fi_regs_t, rip)}, {"r8", offsetof(fi_regs_t, r8)},
+        {"r9", offsetof(fi_regs_t, r9)}, {"r10", offsetof(fi_regs_t, r10)},
+        {"r11", offsetof(fi_regs_t, r11)}, {"r12", offsetof(fi_regs_t, r12)},
+        {"r13", offsetof(fi_regs_t, r13)}, {"r14", offsetof(fi_regs_t, r14)},
+        {"r15", offsetof(fi_regs_t, r15)}, {"eflags", offsetof(fi_regs_t, eflags)}};
+    for (int i = 0; i < (int)(sizeof(x86_regs) / sizeof(x86_regs[0])); i++)
+    {
+        if (strcasecmp(name, x86_regs[i].name) == 0)
+            return (uint64_t *)((char *)regs + x86_regs[i].off);
+    }
+#else
+    if (name[0] == 'X' || name[0] == 'x')
+    {
+        int idx = atoi(name + 1);
+        if (idx >= 0 && idx <= 30)
+            return &regs->regs[idx];
+    }
+#endif
+    return NULL;
+}
+
+// 从 /proc/<pid>/maps 找 [heap] / [stack] 区间
+static int find_region(pid_t pid, const char *tag, uint64_t *start, uint64_t *len)
+{
+    char path[64], line[512];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    int found = -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long s, e;
+        if (strstr(line, tag) && sscanf(line, "%lx-%lx", &s, &e) == 2)
+        {
+            *start = s;
+            *len = e - s;
+            found = 0;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+int fi_fault_parse_loc(const char *spec, pid_t pid, FiFaultLoc *loc)
+{
+    memset(loc, 0, sizeof(*loc));
+    if (strncmp(spec, "reg:", 4) == 0)
+    {
+        loc->kind = FI_LOC_REG;
+        snprintf(loc->reg, sizeof(loc->reg), "%s", spec + 4);
+        fi_regs_t probe;
+        memset(&probe, 0, sizeof(probe));
+        return fi_fault_reg(&probe, loc->reg) ? 0 : -1;
+    }
+    if (strncmp(spec, "mem:", 4) != 0)
+        return -1;
+
+    loc->kind = FI_LOC_MEM;
+    const char *what = spec + 4;
+    if (strcmp(what, "heap") == 0)
+        return find_region(pid, "[heap]", &loc->addr, &loc->len);
+    if (strcmp(what, "stack") == 0)
+        return find_region(pid, "[stack]", &loc->addr, &loc->len);
+
+    char *end;
+    loc->addr = strtoull(what, &end, 16);
+    loc->len = (*end == '+') ? strtoull(end + 1, NULL, 0) : 8;
+    return (loc->addr && loc->len >= 8) ? 0 : -1;
+}
+
+int fi_fault_inject(pid_t tid, const FiFaultLoc *loc, FaultType type, int bit,
+                    uint64_t *addr, uint64_t *old_val, uint64_t *new_val)
+{
+    if (loc->kind == FI_LOC_REG)
+    {
+        fi_regs_t regs;
+        if (fi_get_regs(tid, &regs) < 0)
+            return -1;
+        uint64_t *reg = fi_fault_reg(&regs, loc->reg);
+        if (!reg)
+            return -2;
+        *addr = 0;
+        *old_val = *reg;
+        *new_val = fi_fault_apply(*old_val, type, bit);
+        *reg = *new_val;
+        return fi_set_regs(tid, &regs);
+    }
+
+    uint64_t words = loc->len / 8;
+    uint64_t target = (loc->addr & ~7UL) + (words > 1 ? ((uint64_t)rand() % words) * 8 : 0);
+
+    errno = 0;
+    long word = ptrace(PTRACE_PEEKDATA, tid, (void *)target, NULL);
+    if (errno != 0)
+        return -1;
+    *addr = target;
+    *old_val = (uint64_t)word;
+    *new_val = fi_fault_apply(*old_val, type, bit);
+    if (ptrace(PTRACE_POKEDATA, tid, (void *)target, (void *)*new_val) < 0)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * fi_fault.h - 故障模型与故障位置
+ * 功能：寄存器/内存字的故障模型 (位翻转、置0/1、低8位、加法扰动)，
+ *       跨架构寄存器名解析，以及对已停住线程的一次注入。
+ *       reg_injector、trial_injector 共用同一套故障模型。
+ */
+
+#ifndef FI_FAULT_H
+#define FI_FAULT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "fi_sys.h"
+
+// === 故障类型 ===
+typedef enum
+{
+    FAULT_1_BIT_FLIP,
+    FAULT_2_BIT_FLIP,
+    FAULT_1_BIT_0,
+    FAULT_2_BIT_0,
+    FAULT_1_BIT_1,
+    FAULT_2_BIT_1,
+    FAULT_8_LOW_0,
+    FAULT_8_LOW_1,
+    FAULT_8_LOW_ERROR,
+    FAULT_PLUS_1,
+    FAULT_PLUS_2,
+    FAULT_PLUS_3,
+    FAULT_PLUS_4,
+    FAULT_PLUS_5
+} FaultType;
+
+// === 故障位置 ===
+typedef enum
+{
+    FI_LOC_REG, // 寄存器
+    FI_LOC_MEM  // 内存区间内随机选一个 8 字节对齐的字
+} FiLocKind;
+
+typedef struct
+{
+    FiLocKind kind;
+    char reg[16];
+    uint64_t addr;
+    uint64_t len;
+} FiFaultLoc;
+
+// 对 original 施加故障；bit<0 时随机选位
+uint64_t fi_fault_apply(uint64_t original, FaultType type, int bit);
+
+// "flip1"/"add3"... -> 故障类型，未知名称按 flip1 处理
+FaultType fi_fault_parse(const char *name);
+const char *fi_fault_name(FaultType type);
+
+// 寄存器名 -> 寄存器指针 (x86_64: rax..r15/rip/rsp；ARM64: X0-X30/SP/PC)
+uint64_t *fi_fault_reg(fi_regs_t *regs, const char *name);
+
+// 解析 "reg:X19" / "mem:heap" / "mem:stack" / "mem:0x601040+64"
+// heap/stack 需要 pid 读取 /proc/<pid>/maps
+int fi_fault_parse_loc(const char *spec, pid_t pid, FiFaultLoc *loc);
+
+// 对已停住的线程注入一次；addr 返回实际注入的地址 (寄存器为 0)
+// 返回: 0=成功, -1=读写失败, -2=无效寄存器
+int fi_fault_inject(pid_t tid, const FiFaultLoc *loc, FaultType type, int bit,
+                    uint64_t *addr, uint64_t *old_val, uint64_t *new_val);
+
+#endif
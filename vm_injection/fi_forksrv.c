@@ -0,0 +1,429 @@
+/*
+ * fi_forksrv.c - 注入端 fork-server 驱动实现
+ *
+ * 试验子进程是 server 的子进程、注入端的孙进程，注入端以 PTRACE_SEIZE 接管它，
+ * 到点后用 fi_trigger 停住并注入，随即 detach；退出状态仍由 server 回收并转发。
+ * 设置了监视器时改为全程跟踪：致命信号、心跳停止与超时由 fi_monitor 事件驱动地报告。
+ * 断点触发的试验用闸门模式：子进程停在闸门的 futex 上时接管，放行后由 fi_trace 按断点计数。
+ */
+
+#define _GNU_SOURCE
+#include "fi_forksrv.h"
+#include "fi_trace.h"
+#include "fi_trigger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define FI_FORKSRV_START_MS 30000
+#define FI_FORKSRV_REPLY_MS 5000
+#define FI_FORKSRV_GATE_TRIES 1000
+#define FI_FORKSRV_REACH_FACTOR 10 // 断点计数拖慢子进程：到达代表点最多等试验超时的这么多倍
+
+static const char *outcome_names[FI_OUT_COUNT] = {
+    "masked", "detected", "sdc", "crash", "hang", "nofault", "unreached"};
+
+// 带超时读满 len 字节：成功 0，超时 1，出错/EOF -1
+static int read_full(int fd, void *buf, size_t len, int timeout_ms)
+{
+    size_t got = 0;
+    uint64_t deadline = fi_now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    while (got < len)
+    {
+        uint64_t now = fi_now_ns();
+        if (now >= deadline)
+            return 1;
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int pr = poll(&pfd, 1, (int)((deadline - now) / 1000000ULL) + 1);
+        if (pr < 0 && errno == EINTR)
+            continue;
+        if (pr < 0)
+            return -1;
+        if (pr == 0)
+            return 1;
+
+        ssize_t n = read(fd, (char *)buf + got, len - got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+int fi_forksrv_start(FiForkServer *fs, char *const argv[], int cpu, int quiet)
+{
+    int ctl[2], st[2];
+    memset(fs, 0, sizeof(*fs));
+    fs->cpu = cpu;
+    signal(SIGPIPE, SIG_IGN);
+
+    if (pipe2(ctl, O_CLOEXEC) < 0 || pipe2(st, O_CLOEXEC) < 0)
+        return -1;
+
+    // 心跳共享内存：server 及其试验子进程继承同一映射
+    fs->hb_fd = memfd_create("fi_heartbeat", MFD_CLOEXEC);
+    if (fs->hb_fd < 0 || ftruncate(fs->hb_fd, 4096) < 0)
+        return -1;
+    fs->hb = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fs->hb_fd, 0);
+    if (fs->hb == MAP_FAILED)
+        return -1;
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        dup2(ctl[0], FI_FORKSRV_CTL_FD);
+        dup2(st[1], FI_FORKSRV_ST_FD);
+        dup2(fs->hb_fd, FI_HEARTBEAT_FD);
+        char env[32];
+        snprintf(env, sizeof(env), "%d,%d", FI_FORKSRV_CTL_FD, FI_FORKSRV_ST_FD);
+        setenv(FI_FORKSRV_ENV, env, 1);
+        snprintf(env, sizeof(env), "%d", FI_HEARTBEAT_FD);
+        setenv(FI_HEARTBEAT_ENV, env, 1);
+
+        // 监视器在本进程屏蔽了 SIGCHLD，不能让靶子继承
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+        if (cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        if (quiet)
+        {
+            int devnull = open("/dev/null", O_WRONLY);
+            if (devnull >= 0)
+            {
+                dup2(devnull, STDOUT_FILENO);
+                dup2(devnull, STDERR_FILENO);
+                close(devnull);
+            }
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    close(ctl[0]);
+    close(st[1]);
+    fs->server = pid;
+    fs->ctl = ctl[1];
+    fs->st = st[0];
+
+    uint32_t hello = 0;
+    if (read_full(fs->st, &hello, sizeof(hello), FI_FORKSRV_START_MS) != 0 || hello != FI_FORKSRV_MAGIC)
+    {
+        fprintf(stderr, "[-] 靶子未到达检查点 (是否调用了 fi_target_checkpoint?)\n");
+        fi_forksrv_stop(fs);
+        return -1;
+    }
+    return 0;
+}
+
+// 到点停住子进程并注入；keep=0 时注入后立即 detach，keep=1 时继续跟踪 (交给监视器)
+// 返回子进程是否仍处于跟踪中
+static int inject_child(pid_t pid, const FiTrialSpec *spec, uint64_t t0, FiTrialResult *res,
+                        int seized, int keep)
+{
+    if (!seized && fi_seize(pid) < 0)
+        return 0;
+
+    FiTrigger trig;
+    if (fi_trigger_init(&trig, pid, t0 + spec->delay_ns, 0) < 0)
+    {
+        if (keep)
+            return 1;
+        fi_release(pid);
+        return 0;
+    }
+
+    int ret, attached = 0;
+    while ((ret = fi_trigger_wait(&trig, NULL)) > 0)
+        ;
+    if (ret == 0)
+    {
+        if (fi_fault_inject(pid, &spec->loc, spec->type, spec->bit,
+                            &res->addr, &res->old_val, &res->new_val) == 0)
+        {
+            res->injected = 1;
+            res->inject_ns = fi_now_ns();
+        }
+        if (keep)
+        {
+            ptrace(PTRACE_CONT, pid, NULL, NULL);
+            attached = 1;
+        }
+        else
+        {
+            ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        }
+    }
+    else
+    {
+        // 子进程在触发前结束：作为 tracer 必须先回收，server 才能拿到退出状态
+        int status;
+        while (waitpid(pid, &status, __WALL) > 0 && !WIFEXITED(status) && !WIFSIGNALED(status))
+            ;
+    }
+    fi_trigger_close(&trig);
+    return attached;
+}
+
+// 断点触发：子进程已停在闸门之后，运行到第 bp_hit 次到达 bp_pc 时注入
+static int inject_at_break(pid_t pid, const FiTrialSpec *spec, FiTrialResult *res, int keep)
+{
+    FiFaultLoc loc = spec->loc;
+    fi_regs_t regs;
+    if (spec->sp_rel)
+    {
+        if (fi_get_regs(pid, &regs) < 0)
+            return 0;
+        loc.addr += FI_REG_SP(&regs);
+    }
+
+    // 进程在到达前结束时，fi_trace_run_to 的 waitpid 已回收跟踪状态
+    int reach = fi_trace_run_to(pid, spec->bp_pc, spec->bp_hit, spec->timeout_ms * FI_FORKSRV_REACH_FACTOR);
+    if (reach < 0)
+        return 0;
+    if (reach == 1)
+    {
+        // 本次运行没走到代表点：结束子进程，回复随即到达
+        res->unreached = 1;
+        kill(pid, SIGKILL);
+        while (waitpid(pid, NULL, __WALL) < 0 && errno == EINTR)
+            ;
+        return 0;
+    }
+    if (fi_fault_inject(pid, &loc, spec->type, spec->bit, &res->addr, &res->old_val, &res->new_val) == 0)
+    {
+        res->injected = 1;
+        res->inject_ns = fi_now_ns();
+    }
+    if (keep)
+    {
+        ptrace(PTRACE_CONT, pid, NULL, NULL);
+        return 1;
+    }
+    ptrace(PTRACE_DETACH, pid, NULL, NULL);
+    return 0;
+}
+
+// 由监视器等待子进程结束：致命信号在死亡前即被记录，心跳停止或超时则强制结束
+static void watch_child(FiForkServer *fs, pid_t pid, const FiTrialSpec *spec, uint64_t t0,
+                        FiTrialResult *res)
+{
+    uint64_t hb_timeout = (uint64_t)spec->hb_timeout_ms * 1000000ULL;
+    uint64_t deadline = t0 + (uint64_t)spec->timeout_ms * 1000000ULL;
+    if (fi_monitor_watch(fs->mon, pid, 1, deadline, fs->hb, hb_timeout, NULL) < 0)
+        return;
+
+    FiMonEvent ev;
+    while (fi_monitor_wait(fs->mon, &ev, -1) > 0)
+    {
+        if (ev.pid != pid)
+            continue;
+        // 检测延迟从注入时刻算起；fork 到注入之间的时间由 -d/-r 或断点位置决定，不计入
+        if (res->injected && res->detect_ns == 0 && ev.when_ns >= res->inject_ns)
+            res->detect_ns = ev.when_ns - res->inject_ns;
+
+        if (ev.kind == FI_MON_FATAL && res->fatal_sig == 0)
+        {
+            res->fatal_sig = ev.code;
+            res->fault_addr = ev.addr;
+        }
+        else if (ev.kind == FI_MON_HANG || ev.kind == FI_MON_DEADLINE)
+        {
+            res->hang = 1;
+            kill(pid, SIGKILL);
+        }
+        else if (ev.kind == FI_MON_EXITED || ev.kind == FI_MON_SIGNALED)
+        {
+            break;
+        }
+    }
+}
+
+pid_t fi_forksrv_spawn_gated(FiForkServer *fs)
+{
+    volatile uint32_t *gate = (volatile uint32_t *)(fs->hb + 1);
+    *gate = 0;
+    uint32_t cmd = FI_FORKSRV_CMD_GATED;
+    if (write(fs->ctl, &cmd, sizeof(cmd)) != sizeof(cmd))
+        return -1;
+    int32_t pid;
+    if (read_full(fs->st, &pid, sizeof(pid), FI_FORKSRV_REPLY_MS) != 0)
+        return -1;
+    if (fi_seize(pid) < 0)
+    {
+        fi_forksrv_discard(fs, pid);
+        return -1;
+    }
+
+    // 等子进程阻塞在闸门的 futex 上；被中断的 futex 在恢复时重启，此时闸门已开，立即返回。
+    // 靶子的 libc 在 fork 返回路径上也可能等别的 futex，因此核对首参数是否为靶子公布的闸门地址
+    uint64_t gate_addr = fs->hb[2];
+    for (int i = 0;; i++)
+    {
+        fi_regs_t regs;
+        if (fi_interrupt_wait(pid) < 0)
+            return -1;
+        if (gate_addr && fi_get_regs(pid, &regs) == 0 && fi_get_sysno(pid, &regs) == SYS_futex &&
+            *fi_sys_arg(&regs, 0) == gate_addr)
+            break;
+        if (i >= FI_FORKSRV_GATE_TRIES)
+        {
+            fi_forksrv_discard(fs, pid);
+            return -1;
+        }
+        ptrace(PTRACE_CONT, pid, NULL, NULL);
+        usleep(100);
+    }
+    *gate = 1;
+    // 单步越过重启的 futex：此后的指令序列与计数对每个闸门子进程都相同
+    if (fi_trace_step(pid) < 0)
+        return -1;
+    return pid;
+}
+
+int fi_forksrv_discard(FiForkServer *fs, pid_t pid)
+{
+    FiTrialReply reply;
+    kill(pid, SIGKILL);
+    // 若仍是 tracer，先回收跟踪状态，server 才能拿到退出状态
+    while (waitpid(pid, NULL, __WALL) < 0 && errno == EINTR)
+        ;
+    return read_full(fs->st, &reply, sizeof(reply), FI_FORKSRV_REPLY_MS) == 0 ? 0 : -1;
+}
+
+int fi_forksrv_trial(FiForkServer *fs, const FiTrialSpec *spec, FiTrialResult *res)
+{
+    memset(res, 0, sizeof(*res));
+
+    int attached = 0;
+    int32_t pid;
+    uint64_t t0;
+    if (spec->inject && spec->bp_pc)
+    {
+        pid = fi_forksrv_spawn_gated(fs);
+        if (pid < 0)
+            return -1;
+        res->pid = pid;
+        attached = inject_at_break(pid, spec, res, fs->mon != NULL);
+        // 断点计数会拖慢子进程，超时从注入时刻算起
+        t0 = fi_now_ns();
+    }
+    else
+    {
+        uint32_t cmd = FI_FORKSRV_CMD_TRIAL;
+        if (write(fs->ctl, &cmd, sizeof(cmd)) != sizeof(cmd))
+            return -1;
+        if (read_full(fs->st, &pid, sizeof(pid), FI_FORKSRV_REPLY_MS) != 0)
+            return -1;
+        t0 = fi_now_ns();
+        res->pid = pid;
+
+        // 有监视器时从 fork 起全程跟踪，黄金运行也不例外
+        if (fs->mon && fi_seize(pid) == 0)
+            attached = 1;
+        if (spec->inject)
+            attached = inject_child(pid, spec, t0, res, attached, fs->mon != NULL);
+    }
+    if (attached)
+        watch_child(fs, pid, spec, t0, res);
+
+    // 监视器已确认子进程结束 (或已强制结束)，回复随即到达
+    FiTrialReply reply;
+    uint64_t spent_ms = (fi_now_ns() - t0) / 1000000ULL;
+    int remain = (spec->timeout_ms > (int)spent_ms) ? spec->timeout_ms - (int)spent_ms : 0;
+    if (attached)
+        remain = FI_FORKSRV_REPLY_MS;
+    int r = read_full(fs->st, &reply, sizeof(reply), remain);
+    if (r == 1)
+    {
+        res->hang = 1;
+        kill(pid, SIGKILL);
+        r = read_full(fs->st, &reply, sizeof(reply), FI_FORKSRV_REPLY_MS);
+    }
+    if (r != 0)
+        return -1;
+
+    res->status = reply.status;
+    res->has_digest = reply.has_digest;
+    res->digest = reply.digest;
+    res->elapsed_ns = fi_now_ns() - t0;
+    return 0;
+}
+
+FiOutcome fi_forksrv_classify(const FiTrialResult *res, const FiTrialResult *golden)
+{
+    if (res->unreached)
+        return FI_OUT_UNREACHED;
+    if (!res->injected)
+        return FI_OUT_NOFAULT;
+    if (res->hang)
+        return FI_OUT_HANG;
+    if (WIFSIGNALED(res->status))
+        return FI_OUT_CRASH;
+    if (WIFEXITED(res->status) && WEXITSTATUS(res->status) != FI_EXIT_OK)
+        return FI_OUT_DETECTED;
+    if (golden->has_digest && (!res->has_digest || res->digest != golden->digest))
+        return FI_OUT_SDC;
+    return FI_OUT_MASKED;
+}
+
+const char *fi_outcome_name(FiOutcome outcome)
+{
+    if ((int)outcome < 0 || outcome >= FI_OUT_COUNT)
+        return "?";
+    return outcome_names[outcome];
+}
+
+void fi_forksrv_stop(FiForkServer *fs)
+{
+    if (fs->ctl > 0)
+        close(fs->ctl);
+    if (fs->st > 0)
+        close(fs->st);
+    fs->ctl = fs->st = -1;
+    if (fs->hb && fs->hb != MAP_FAILED)
+        munmap((void *)fs->hb, 4096);
+    if (fs->hb_fd > 0)
+        close(fs->hb_fd);
+    fs->hb = NULL;
+    fs->hb_fd = -1;
+
+    if (fs->server > 0)
+    {
+        // 关闭控制管道后 server 自行退出；仍未退出 (如卡在预热) 则强制结束
+        for (int i = 0; i < 100; i++)
+        {
+            if (waitpid(fs->server, NULL, WNOHANG) == fs->server)
+            {
+                fs->server = 0;
+                return;
+            }
+            usleep(10000);
+        }
+        kill(fs->server, SIGKILL);
+        waitpid(fs->server, NULL, 0);
+        fs->server = 0;
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * fi_forksrv.h - 注入端 fork-server 驱动
+ * 功能：启动链接了 fi_target 的靶子并等它停在检查点；
+ *       每次试验让检查点 fork 一个写时复制子进程，按延时触发注入，
+ *       回收结果并与黄金运行 (不注入) 比较，归类为 masked/detected/SDC/crash/hang。
+ *       也可以按断点触发：第 hit 次执行到某条指令之前注入 (fi_prune 给出的代表点)。
+ */
+
+#ifndef FI_FORKSRV_H
+#define FI_FORKSRV_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "fi_target.h"
+#include "fi_fault.h"
+#include "fi_monitor.h"
+
+// === 试验结果分类 ===
+typedef enum
+{
+    FI_OUT_MASKED,    // 结果与黄金运行一致
+    FI_OUT_DETECTED,  // 靶子自检发现错误 (非零退出)
+    FI_OUT_SDC,       // 正常退出但结果不同：静默数据损坏
+    FI_OUT_CRASH,     // 被信号终止
+    FI_OUT_HANG,      // 超时未结束
+    FI_OUT_NOFAULT,   // 触发前子进程已结束，未注入
+    FI_OUT_UNREACHED, // 限时内未到达断点代表点 (路径不确定)，未注入
+    FI_OUT_COUNT
+} FiOutcome;
+
+typedef struct
+{
+    pid_t server;
+    int ctl; // 写端：请求试验
+    int st;  // 读端：pid 与结果
+    int cpu; // 绑定的 CPU (-1 不绑定)
+    int hb_fd;
+    volatile uint64_t *hb; // 与靶子共享的心跳计数
+    FiMonitor *mon;        // 可选 (start 之后设置)：试验子进程全程被跟踪，由监视器检测致命信号/挂死
+} FiForkServer;
+
+// 一次试验的参数
+typedef struct
+{
+    int inject;        // 0 = 黄金运行
+    FiFaultLoc loc;
+    FaultType type;
+    int bit;           // -1 随机
+    uint64_t delay_ns; // fork 后多久注入
+    int timeout_ms;    // 超时判定为 hang
+    int hb_timeout_ms; // 心跳停止多久判定为 hang (0=只看超时，需要监视器)
+    uint64_t bp_pc;    // 非 0 时改用断点触发：子进程过闸门后第 bp_hit 次执行到 bp_pc 之前注入，忽略 delay_ns
+    uint32_t bp_hit;
+    int sp_rel;        // loc.addr 是相对闸门处栈指针的偏移 (栈上的代表点)
+} FiTrialSpec;
+
+typedef struct
+{
+    pid_t pid;
+    int injected;
+    uint64_t addr, old_val, new_val;
+    int status;
+    int has_digest;
+    uint64_t digest;
+    int hang;
+    int unreached;       // 断点触发时限时内未到达代表点
+    int fatal_sig;       // 监视器截获的致命信号 (0=无)
+    uint64_t fault_addr; // 致命信号的故障地址
+    uint64_t inject_ns;  // 注入时刻 (CLOCK_MONOTONIC，0=未注入)
+    uint64_t detect_ns;  // 从注入到监视器首次检测到结果 (0=未注入或未使用监视器)
+    uint64_t elapsed_ns; // 从 fork 到回收
+} FiTrialResult;
+
+// 启动靶子并等待检查点；cpu>=0 时绑定到该 CPU，quiet 时丢弃靶子输出
+int fi_forksrv_start(FiForkServer *fs, char *const argv[], int cpu, int quiet);
+
+// 执行一次试验 (fork -> 定时注入 -> 回收)，server 失效返回 -1
+int fi_forksrv_trial(FiForkServer *fs, const FiTrialSpec *spec, FiTrialResult *res);
+
+// 请求一个闸门模式的试验子进程：返回时已被 seize、越过闸门并处于跟踪停止状态，失败返回 -1
+pid_t fi_forksrv_spawn_gated(FiForkServer *fs);
+
+// 结束 (SIGKILL) 自行接管的试验子进程并读取其回复，使协议保持同步
+int fi_forksrv_discard(FiForkServer *fs, pid_t pid);
+
+// 与黄金运行比较并分类
+FiOutcome fi_forksrv_classify(const FiTrialResult *res, const FiTrialResult *golden);
+const char *fi_outcome_name(FiOutcome outcome);
+
+void fi_forksrv_stop(FiForkServer *fs);
+
+#endif
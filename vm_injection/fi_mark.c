@@ -0,0 +1,26 @@
+/*
+ * fi_mark.c - 注入起止标记实现
+ *
+ * 每条标记单独打开、追加、关闭：注入器与 fi_schedlat 可能同时在运行，不持有文件。
+ */
+
+#define _GNU_SOURCE
+#include "fi_mark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void fi_mark_write(const char *what, const char *label)
+{
+    const char *path = getenv(FI_MARK_ENV);
+    if (!path)
+        return;
+    FILE *fp = fopen(path, "a");
+    if (!fp)
+        return;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    fprintf(fp, "%lld %s %s\n", (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec, what, label);
+    fclose(fp);
+}
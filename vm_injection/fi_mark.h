@@ -0,0 +1,15 @@
+/*
+ * fi_mark.h - 注入起止标记
+ * 功能：注入器在施加/撤除故障时把时刻 (CLOCK_MONOTONIC 纳秒) 追加到 FI_MARK_FILE，
+ *       每行 "<纳秒> start|stop <标签>"，fi_schedlat 据此把延迟采样对齐到注入区间。
+ */
+
+#ifndef FI_MARK_H
+#define FI_MARK_H
+
+#define FI_MARK_ENV "FI_MARK_FILE"
+
+// 追加一条标记；未设置 FI_MARK_FILE 或文件打不开时为空操作
+void fi_mark_write(const char *what, const char *label);
+
+#endif
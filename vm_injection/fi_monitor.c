@@ -0,0 +1,415 @@
+/*
+ * fi_monitor.c - 事件驱动的试验结果监视器实现
+ *
+ * epoll 数据约定：0 = signalfd，1 = timerfd，其余为 (槽位号 + 2) 对应的 pidfd。
+ * 心跳只在计时器到点时读取一次：变化则顺延检查时刻，不变则报告 hang。
+ */
+
+#define _GNU_SOURCE
+#include "fi_monitor.h"
+#include "fi_trigger.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ptrace.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+#define FI_MON_TAG_SIGNAL 0
+#define FI_MON_TAG_TIMER 1
+#define FI_MON_TAG_BASE 2
+
+typedef struct
+{
+    pid_t pid; // 0 = 空闲槽位
+    int traced;
+    int pidfd;
+    uint64_t deadline_ns;
+    const volatile uint64_t *hb;
+    uint64_t hb_timeout_ns;
+    uint64_t hb_last;
+    uint64_t hb_change_ns;
+    void *user;
+} FiMonSlot;
+
+struct FiMonitor
+{
+    int epfd;
+    int sfd;
+    int tfd;
+    FiMonSlot *slots;
+    int nslots;
+    int active;
+    FiMonEvent *queue; // 待取走的事件 (环形)
+    int qcap, qhead, qlen;
+};
+
+static void push_event(FiMonitor *m, FiMonSlot *s, FiMonKind kind, int code, uint64_t addr)
+{
+    if (m->qlen == m->qcap)
+    {
+        int ncap = m->qcap ? m->qcap * 2 : 64;
+        FiMonEvent *nq = malloc(sizeof(FiMonEvent) * ncap);
+        if (!nq)
+            return;
+        for (int i = 0; i < m->qlen; i++)
+            nq[i] = m->queue[(m->qhead + i) % m->qcap];
+        free(m->queue);
+        m->queue = nq;
+        m->qcap = ncap;
+        m->qhead = 0;
+    }
+    FiMonEvent *ev = &m->queue[(m->qhead + m->qlen) % m->qcap];
+    ev->pid = s->pid;
+    ev->kind = kind;
+    ev->code = code;
+    ev->addr = addr;
+    ev->when_ns = fi_now_ns();
+    ev->user = s->user;
+    m->qlen++;
+}
+
+static void free_slot(FiMonitor *m, FiMonSlot *s)
+{
+    if (s->pidfd >= 0)
+    {
+        epoll_ctl(m->epfd, EPOLL_CTL_DEL, s->pidfd, NULL);
+        close(s->pidfd);
+    }
+    memset(s, 0, sizeof(*s));
+    s->pidfd = -1;
+    m->active--;
+}
+
+static uint64_t slot_check_ns(const FiMonSlot *s)
+{
+    uint64_t t = s->deadline_ns;
+    if (s->hb)
+    {
+        uint64_t h = s->hb_change_ns + s->hb_timeout_ns;
+        if (t == 0 || h < t)
+            t = h;
+    }
+    return t;
+}
+
+// 把计时器设为所有槽位中最早的检查时刻
+static void rearm_timer(FiMonitor *m)
+{
+    uint64_t next = 0;
+    for (int i = 0; i < m->nslots; i++)
+    {
+        if (m->slots[i].pid == 0)
+            continue;
+        uint64_t t = slot_check_ns(&m->slots[i]);
+        if (t && (next == 0 || t < next))
+            next = t;
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (next)
+    {
+        its.it_value.tv_sec = next / 1000000000ULL;
+        its.it_value.tv_nsec = next % 1000000000ULL;
+    }
+    timerfd_settime(m->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int is_fatal(int sig)
+{
+    return sig == SIGSEGV || sig == SIGBUS || sig == SIGILL || sig == SIGFPE ||
+           sig == SIGABRT || sig == SIGSYS || sig == SIGTRAP;
+}
+
+// 处理被跟踪进程的一次 waitpid 结果
+static void handle_traced(FiMonitor *m, FiMonSlot *s, int status)
+{
+    if (WIFEXITED(status))
+    {
+        push_event(m, s, FI_MON_EXITED, WEXITSTATUS(status), 0);
+        free_slot(m, s);
+        return;
+    }
+    if (WIFSIGNALED(status))
+    {
+        push_event(m, s, FI_MON_SIGNALED, WTERMSIG(status), 0);
+        free_slot(m, s);
+        return;
+    }
+    if (!WIFSTOPPED(status))
+        return;
+
+    int sig = WSTOPSIG(status);
+    if ((status >> 16) != 0)
+    {
+        // PTRACE_EVENT_STOP (组停止/中断) 等事件：直接放行
+        ptrace(PTRACE_CONT, s->pid, NULL, NULL);
+        return;
+    }
+
+    if (is_fatal(sig))
+    {
+        siginfo_t si;
+        memset(&si, 0, sizeof(si));
+        ptrace(PTRACE_GETSIGINFO, s->pid, NULL, &si);
+        push_event(m, s, FI_MON_FATAL, sig, (uint64_t)(uintptr_t)si.si_addr);
+    }
+    // 原样投递，目标自己的信号处理逻辑 (若有) 照常生效
+    ptrace(PTRACE_CONT, s->pid, NULL, (void *)(long)sig);
+}
+
+static void on_sigchld(FiMonitor *m)
+{
+    struct signalfd_siginfo ssi;
+    while (read(m->sfd, &ssi, sizeof(ssi)) == sizeof(ssi))
+        ;
+
+    // SIGCHLD 会合并，逐个收割全部被跟踪槽位
+    for (int i = 0; i < m->nslots; i++)
+    {
+        FiMonSlot *s = &m->slots[i];
+        int status;
+        while (s->pid && s->traced && waitpid(s->pid, &status, __WALL | WNOHANG) > 0)
+            handle_traced(m, s, status);
+    }
+}
+
+static void on_pidfd(FiMonitor *m, FiMonSlot *s)
+{
+    siginfo_t si;
+    memset(&si, 0, sizeof(si));
+    if (syscall(SYS_waitid, P_PIDFD, s->pidfd, &si, WEXITED | WNOHANG, NULL) == 0 && si.si_pid != 0)
+    {
+        if (si.si_code == CLD_EXITED)
+            push_event(m, s, FI_MON_EXITED, si.si_status, 0);
+        else
+            push_event(m, s, FI_MON_SIGNALED, si.si_status, 0);
+    }
+    else
+    {
+        // 不是我们的子进程：只知道它已结束
+        push_event(m, s, FI_MON_EXITED, -1, 0);
+    }
+    free_slot(m, s);
+}
+
+static void on_timer(FiMonitor *m)
+{
+    uint64_t expirations;
+    if (read(m->tfd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN)
+        return;
+
+    uint64_t now = fi_now_ns();
+    for (int i = 0; i < m->nslots; i++)
+    {
+        FiMonSlot *s = &m->slots[i];
+        if (s->pid == 0)
+            continue;
+        if (s->hb)
+        {
+            uint64_t beat = *s->hb;
+            if (beat != s->hb_last)
+            {
+                s->hb_last = beat;
+                s->hb_change_ns = now;
+            }
+            else if (now >= s->hb_change_ns + s->hb_timeout_ns)
+            {
+                push_event(m, s, FI_MON_HANG, 0, 0);
+                s->hb = NULL;
+            }
+        }
+        if (s->deadline_ns && now >= s->deadline_ns)
+        {
+            push_event(m, s, FI_MON_DEADLINE, 0, 0);
+            s->deadline_ns = 0;
+        }
+    }
+    rearm_timer(m);
+}
+
+FiMonitor *fi_monitor_create(void)
+{
+    FiMonitor *m = calloc(1, sizeof(FiMonitor));
+    if (!m)
+        return NULL;
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, NULL);
+
+    m->epfd = epoll_create1(EPOLL_CLOEXEC);
+    m->sfd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    m->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m->epfd < 0 || m->sfd < 0 || m->tfd < 0)
+    {
+        fi_monitor_destroy(m);
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = FI_MON_TAG_SIGNAL;
+    epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->sfd, &ev);
+    ev.data.u64 = FI_MON_TAG_TIMER;
+    epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->tfd, &ev);
+    return m;
+}
+
+void fi_monitor_destroy(FiMonitor *m)
+{
+    if (!m)
+        return;
+    for (int i = 0; i < m->nslots; i++)
+    {
+        if (m->slots[i].pidfd >= 0)
+            close(m->slots[i].pidfd);
+    }
+    if (m->epfd >= 0)
+        close(m->epfd);
+    if (m->sfd >= 0)
+        close(m->sfd);
+    if (m->tfd >= 0)
+        close(m->tfd);
+    free(m->slots);
+    free(m->queue);
+    free(m);
+}
+
+int fi_monitor_watch(FiMonitor *m, pid_t pid, int traced, uint64_t deadline_ns,
+                     const volatile uint64_t *heartbeat, uint64_t hb_timeout_ns, void *user)
+{
+    int idx = -1;
+    for (int i = 0; i < m->nslots; i++)
+    {
+        if (m->slots[i].pid == 0)
+        {
+            idx = i;
+            break;
+        }
+    }
+    if (idx < 0)
+    {
+        int ncap = m->nslots ? m->nslots * 2 : 16;
+        FiMonSlot *ns = realloc(m->slots, sizeof(FiMonSlot) * ncap);
+        if (!ns)
+            return -1;
+        memset(ns + m->nslots, 0, sizeof(FiMonSlot) * (ncap - m->nslots));
+        for (int i = m->nslots; i < ncap; i++)
+            ns[i].pidfd = -1;
+        idx = m->nslots;
+        m->slots = ns;
+        m->nslots = ncap;
+    }
+
+    FiMonSlot *s = &m->slots[idx];
+    s->pid = pid;
+    s->traced = traced;
+    s->pidfd = -1;
+    s->deadline_ns = deadline_ns;
+    s->hb = (heartbeat && hb_timeout_ns) ? heartbeat : NULL;
+    s->hb_timeout_ns = hb_timeout_ns;
+    s->hb_last = s->hb ? *s->hb : 0;
+    s->hb_change_ns = fi_now_ns();
+    s->user = user;
+    m->active++;
+
+    // 被跟踪进程的退出经由 SIGCHLD 报告，其余用 pidfd
+    if (!traced)
+    {
+        s->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+        if (s->pidfd < 0)
+        {
+            free_slot(m, s);
+            return -1;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = (uint64_t)idx + FI_MON_TAG_BASE;
+        epoll_ctl(m->epfd, EPOLL_CTL_ADD, s->pidfd, &ev);
+    }
+    else
+    {
+        // 注册前可能已经停住或退出，主动收割一次
+        int status;
+        while (s->pid && waitpid(pid, &status, __WALL | WNOHANG) > 0)
+            handle_traced(m, s, status);
+    }
+
+    rearm_timer(m);
+    return 0;
+}
+
+void fi_monitor_unwatch(FiMonitor *m, pid_t pid)
+{
+    for (int i = 0; i < m->nslots; i++)
+    {
+        if (m->slots[i].pid == pid)
+        {
+            free_slot(m, &m->slots[i]);
+            rearm_timer(m);
+            return;
+        }
+    }
+}
+
+int fi_monitor_wait(FiMonitor *m, FiMonEvent *ev, int timeout_ms)
+{
+    uint64_t deadline = (timeout_ms >= 0) ? fi_now_ns() + (uint64_t)timeout_ms * 1000000ULL : 0;
+
+    while (m->qlen == 0)
+    {
+        int wait_ms = -1;
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = fi_now_ns();
+            if (now >= deadline)
+                return 0;
+            wait_ms = (int)((deadline - now + 999999ULL) / 1000000ULL);
+        }
+
+        struct epoll_event evs[16];
+        int n = epoll_wait(m->epfd, evs, 16, wait_ms);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t tag = evs[i].data.u64;
+            if (tag == FI_MON_TAG_SIGNAL)
+                on_sigchld(m);
+            else if (tag == FI_MON_TAG_TIMER)
+                on_timer(m);
+            else if (tag - FI_MON_TAG_BASE < (uint64_t)m->nslots && m->slots[tag - FI_MON_TAG_BASE].pid)
+                on_pidfd(m, &m->slots[tag - FI_MON_TAG_BASE]);
+        }
+    }
+
+    *ev = m->queue[m->qhead];
+    m->qhead = (m->qhead + 1) % m->qcap;
+    m->qlen--;
+    return 1;
+}
+
+int fi_monitor_count(const FiMonitor *m)
+{
+    return m->active;
+}
@@ -0,0 +1,58 @@
+/*
+ * fi_monitor.h - 事件驱动的试验结果监视器
+ * 功能：用一个 epoll 同时等待：
+ *       - pidfd：非跟踪目标的退出；
+ *       - signalfd(SIGCHLD)：被跟踪目标的退出与信号投递停止 (致命信号在进程死亡前即可报告)；
+ *       - timerfd：最近的截止时刻或心跳检查时刻 (心跳位于共享内存，停止增长即判定为 hang)。
+ *       不做任何轮询；检测延迟取决于调度唤醒，通常在几十微秒量级。
+ * 限制：SIGCHLD 是进程级信号，一个进程只应有一个监视器，且必须由跟踪者线程调用；
+ *       创建监视器时会在调用线程屏蔽 SIGCHLD。
+ */
+
+#ifndef FI_MONITOR_H
+#define FI_MONITOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef enum
+{
+    FI_MON_EXITED,   // 正常退出，code = 退出码 (非子进程且未跟踪时为 -1)
+    FI_MON_SIGNALED, // 被信号终止，code = 信号
+    FI_MON_FATAL,    // 跟踪中截获致命信号 (尚未死亡)，code = 信号，addr = 故障地址
+    FI_MON_HANG,     // 心跳在 hb_timeout 内没有变化
+    FI_MON_DEADLINE  // 超过截止时刻
+} FiMonKind;
+
+typedef struct
+{
+    pid_t pid;
+    FiMonKind kind;
+    int code;
+    uint64_t addr;
+    uint64_t when_ns; // 检测时刻 (CLOCK_MONOTONIC)
+    void *user;
+} FiMonEvent;
+
+typedef struct FiMonitor FiMonitor;
+
+FiMonitor *fi_monitor_create(void);
+void fi_monitor_destroy(FiMonitor *m);
+
+// 开始监视 pid
+//   traced      : 调用者已 PTRACE_SEIZE 该进程，由监视器负责转发信号与回收停止
+//   deadline_ns : 绝对截止时刻 (0 = 无)
+//   heartbeat   : 共享内存中的心跳计数 (NULL = 无)，hb_timeout_ns 内不变即报告 hang
+int fi_monitor_watch(FiMonitor *m, pid_t pid, int traced, uint64_t deadline_ns,
+                     const volatile uint64_t *heartbeat, uint64_t hb_timeout_ns, void *user);
+
+// 停止监视 (进程结束后自动移除，无需调用)
+void fi_monitor_unwatch(FiMonitor *m, pid_t pid);
+
+// 等待下一个事件：1 = 有事件，0 = 超时，-1 = 出错；timeout_ms < 0 表示无限等待
+int fi_monitor_wait(FiMonitor *m, FiMonEvent *ev, int timeout_ms);
+
+// 当前监视的进程数
+int fi_monitor_count(const FiMonitor *m);
+
+#endif
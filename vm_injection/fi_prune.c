@@ -0,0 +1,214 @@
+/*
+ * fi_prune.c - 黄金运行跟踪与 def-use 故障空间剪枝
+ * 功能：以闸门模式拉起一个试验子进程，从闸门放行处逐条单步执行感兴趣区间 (ROI)，
+ *       记录每条指令读写的寄存器与内存字，把注入点归并为等价类：
+ *       必然被覆盖的注入点直接判为 masked，其余每类只保留一个代表点并记下权重。
+ *       输出的代表点文件交给 campaign_injector (sites 键) 只跑代表点，结果按权重还原到完整故障空间。
+ *       跟踪与战役都关闭 ASLR，代表点的指令地址与内存地址在两边一致。
+ * 编译：gcc -o fi_prune fi_prune.c fi_trace.c fi_forksrv.c fi_monitor.c fi_target.c fi_fault.c fi_trigger.c fi_sys.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/personality.h>
+#include <sys/wait.h>
+
+#include "fi_forksrv.h"
+#include "fi_trace.h"
+#include "fi_trigger.h"
+
+void print_help(const char *prog)
+{
+    printf("用法: %s [选项] -- <靶子> [参数...]\n", prog);
+    printf("选项:\n");
+    printf("  -s <n>     放行后先跳过的指令数 (默认0)\n");
+    printf("  -n <n>     ROI 指令数 (默认100000)\n");
+    printf("  -r         只分析寄存器 (默认寄存器 + ROI 内访问过的内存字)\n");
+    printf("  -o <file>  代表点文件 (默认 sites.txt)\n");
+    printf("  -c <cpu>   靶子绑定的 CPU (默认不绑定)\n");
+    printf("说明: 靶子须链接 fi_target.c 并在初始化后调用 fi_target_checkpoint()；\n");
+    printf("      ROI 内的执行路径须与输入确定，代表点以 \"第 hit 次执行到 pc 之前\" 定位\n");
+    printf("示例:\n");
+    printf("  %s -n 200000 -o reg.sites -- ./target_reg\n", prog);
+    printf("  然后在战役文件的 [靶子] 节中写: sites reg.sites\n");
+}
+
+// 按位置汇总代表点，列出实验最多的几个位置
+static void print_top_locs(const FiTraceResult *tr)
+{
+    typedef struct
+    {
+        const char *loc;
+        long live;
+        uint64_t weight;
+    } LocSum;
+    LocSum top[8];
+    int ntop = 0;
+
+    // 寄存器位置逐个统计，内存字合并为一行
+    for (int r = 0; r < FI_TRACE_NREGS + 1; r++)
+    {
+        char loc[40];
+        if (r < FI_TRACE_NREGS)
+            snprintf(loc, sizeof(loc), "reg:%s", fi_trace_reg_name(r));
+        long live = 0;
+        uint64_t weight = 0;
+        for (size_t i = 0; i < tr->nsites; i++)
+        {
+            const FiSite *s = &tr->sites[i];
+            int match = (r < FI_TRACE_NREGS) ? strcmp(s->loc, loc) == 0 : strncmp(s->loc, "mem:", 4) == 0;
+            if (!match || s->kind == FI_SITE_MASKED)
+                continue;
+            live++;
+            weight += s->weight;
+        }
+        if (live == 0)
+            continue;
+
+        int pos = ntop < 8 ? ntop++ : 7;
+        if (pos == 7 && ntop == 8 && top[7].live >= live)
+            continue;
+        while (pos > 0 && top[pos - 1].live < live)
+        {
+            top[pos] = top[pos - 1];
+            pos--;
+        }
+        top[pos].loc = (r < FI_TRACE_NREGS) ? fi_trace_reg_name(r) : "内存";
+        top[pos].live = live;
+        top[pos].weight = weight;
+    }
+
+    printf(" %-10s %10s %12s %10s\n", "位置", "代表点", "等价注入点", "平均权重");
+    for (int i = 0; i < ntop; i++)
+        printf(" %-10s %10ld %12lu %10.1f\n", top[i].loc, top[i].live, (unsigned long)top[i].weight,
+               (double)top[i].weight / top[i].live);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t skip = 0, steps = 100000;
+    int want_mem = 1, cpu = -1;
+    const char *out_path = "sites.txt";
+    int sep = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            sep = i;
+            break;
+        }
+    }
+    if (sep < 0 || sep + 1 >= argc)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < sep; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < sep)
+            skip = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < sep)
+            steps = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-r") == 0)
+            want_mem = 0;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < sep)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < sep)
+            cpu = atoi(argv[++i]);
+        else
+        {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    if (steps == 0)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+    char **target_argv = &argv[sep + 1];
+
+    // 关闭 ASLR (由靶子继承)，战役中的 fork-server 同样如此，地址才能对上
+    personality(ADDR_NO_RANDOMIZE);
+
+    printf("=== 黄金运行跟踪与故障空间剪枝 ===\n");
+    FiForkServer fs;
+    if (fi_forksrv_start(&fs, target_argv, cpu, 1) < 0)
+        return 1;
+
+    FiTrialSpec spec;
+    FiTrialResult golden;
+    memset(&spec, 0, sizeof(spec));
+    spec.timeout_ms = 10000;
+    if (fi_forksrv_trial(&fs, &spec, &golden) < 0 || golden.hang || !WIFEXITED(golden.status))
+    {
+        fprintf(stderr, "[-] 黄金运行失败\n");
+        fi_forksrv_stop(&fs);
+        return 1;
+    }
+    printf(" 靶子: %s, 黄金运行 %.1f ms, 摘要 0x%lx\n", target_argv[0], golden.elapsed_ns / 1e6,
+           (unsigned long)golden.digest);
+
+    pid_t pid = fi_forksrv_spawn_gated(&fs);
+    if (pid < 0)
+    {
+        fprintf(stderr, "[-] 闸门子进程启动失败\n");
+        fi_forksrv_stop(&fs);
+        return 1;
+    }
+    printf(" ROI: 放行后第 %lu 条起 %lu 条指令, 分析%s\n", (unsigned long)skip, (unsigned long)steps,
+           want_mem ? "寄存器与内存" : "寄存器");
+    fflush(stdout);
+
+    FiTraceResult tr;
+    uint64_t t0 = fi_now_ns();
+    int rc = fi_trace_record(pid, skip, steps, want_mem, &tr);
+    double secs = (fi_now_ns() - t0) / 1e9;
+    fi_forksrv_discard(&fs, pid);
+    fi_forksrv_stop(&fs);
+    if (rc < 0)
+    {
+        fprintf(stderr, "[-] 跟踪失败 (内存不足或子进程已结束)\n");
+        return 1;
+    }
+    if (tr.executed < steps)
+        printf(" [!] 子进程在 ROI 结束前退出，只跟踪到 %lu 条指令\n", (unsigned long)tr.executed);
+
+    long live = 0, out = 0;
+    for (size_t i = 0; i < tr.nsites; i++)
+    {
+        if (tr.sites[i].kind == FI_SITE_LIVE)
+            live++;
+        else if (tr.sites[i].kind == FI_SITE_OUT)
+            out++;
+    }
+    printf(" 单步 %lu 条, 用时 %.2f 秒 (%.1f 万条/秒), 无法解码 %lu 条 (%.2f%%), 内存字 %lu 个\n",
+           (unsigned long)tr.executed, secs, secs > 0 ? tr.executed / secs / 1e4 : 0.0,
+           (unsigned long)tr.unknown, tr.executed ? 100.0 * tr.unknown / tr.executed : 0.0,
+           (unsigned long)tr.nwords);
+    printf("------------------------------------------------------------------------\n");
+    print_top_locs(&tr);
+    printf("------------------------------------------------------------------------\n");
+    printf(" 完整故障空间:   %lu 个注入点 (位置 × 指令)\n", (unsigned long)tr.space);
+    printf(" 已证明 masked: %lu 个 (%.1f%%)\n", (unsigned long)tr.masked,
+           tr.space ? 100.0 * tr.masked / tr.space : 0.0);
+    printf(" 代表点:         %ld 个 (其中带出 ROI %ld 个), 缩减 %.1f 倍\n", live + out, out,
+           live + out ? (double)tr.space / (live + out) : 0.0);
+
+    FILE *fp = fopen(out_path, "w");
+    if (!fp || fi_trace_write_sites(fp, &tr, target_argv[0]) < 0)
+    {
+        perror("写代表点文件失败");
+        if (fp)
+            fclose(fp);
+        fi_trace_free(&tr);
+        return 1;
+    }
+    fclose(fp);
+    printf(" 已写入 %s\n", out_path);
+    fi_trace_free(&tr);
+    return 0;
+}
@@ -0,0 +1,489 @@
+/*
+ * fi_query.c - 实验结果库查询
+ * 功能：mmap 由 FI_RESULTS 记录的列式结果库，按任意列分组统计次数、占比与平均耗时，
+ *       支持按列过滤、导出 CSV 与 JSON (供 Web 控制器调用)。
+ * 编译：gcc -O2 -o fi_query fi_query.c fi_results.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "fi_results.h"
+
+#define MAX_GROUP_COLS 4
+#define MAX_FILTERS 8
+
+// === 列定义 ===
+typedef enum
+{
+    COL_TOOL,
+    COL_TARGET,
+    COL_SITE,
+    COL_MODEL,
+    COL_OUTCOME,
+    COL_BIT,
+    COL_SIGNAL,
+    COL_PID,
+    COL_COUNT
+} QueryCol;
+
+static const char *col_names[COL_COUNT] = {
+    "tool", "target", "site", "model", "outcome", "bit", "signal", "pid"};
+
+static int col_is_str(QueryCol c)
+{
+    return c <= COL_OUTCOME;
+}
+
+static int col_lookup(const char *name)
+{
+    for (int i = 0; i < COL_COUNT; i++)
+        if (strcmp(col_names[i], name) == 0)
+            return i;
+    return -1;
+}
+
+static const uint16_t *str_col(const FiResBlock *b, QueryCol c)
+{
+    switch (c)
+    {
+    case COL_TOOL:
+        return b->tool;
+    case COL_TARGET:
+        return b->target;
+    case COL_SITE:
+        return b->site;
+    case COL_MODEL:
+        return b->model;
+    default:
+        return b->outcome;
+    }
+}
+
+// === 全局字符串表 (跨块统一编号) ===
+typedef struct
+{
+    char **s;
+    size_t n, cap;
+    uint32_t *hash; // 存 (编号 + 1)
+    size_t hcap;
+} StrTab;
+
+static uint32_t fnv(const void *data, size_t len, uint32_t h)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 16777619U;
+    return h;
+}
+
+static void strtab_grow(StrTab *t)
+{
+    size_t hcap = t->hcap ? t->hcap * 2 : 1024;
+    uint32_t *h = calloc(hcap, sizeof(uint32_t));
+    for (size_t i = 0; i < t->n; i++)
+    {
+        uint32_t k = fnv(t->s[i], strlen(t->s[i]), 2166136261U) & (hcap - 1);
+        while (h[k])
+            k = (k + 1) & (hcap - 1);
+        h[k] = (uint32_t)i + 1;
+    }
+    free(t->hash);
+    t->hash = h;
+    t->hcap = hcap;
+}
+
+static uint32_t strtab_id(StrTab *t, const char *s)
+{
+    if (t->n * 2 >= t->hcap)
+        strtab_grow(t);
+    uint32_t k = fnv(s, strlen(s), 2166136261U) & (t->hcap - 1);
+    while (t->hash[k])
+    {
+        uint32_t id = t->hash[k] - 1;
+        if (strcmp(t->s[id], s) == 0)
+            return id;
+        k = (k + 1) & (t->hcap - 1);
+    }
+    if (t->n == t->cap)
+    {
+        t->cap = t->cap ? t->cap * 2 : 256;
+        t->s = realloc(t->s, t->cap * sizeof(char *));
+    }
+    t->s[t->n] = strdup(s);
+    t->hash[k] = (uint32_t)t->n + 1;
+    return (uint32_t)t->n++;
+}
+
+// === 分组表 ===
+typedef struct
+{
+    int64_t key[MAX_GROUP_COLS]; // 字符串列为全局编号，数值列为原值
+    uint64_t count;
+    uint64_t dur_sum;
+} Group;
+
+typedef struct
+{
+    Group *g;
+    size_t n, cap;
+    uint32_t *hash;
+    size_t hcap;
+} GroupTab;
+
+static int ngroup_cols = 0;
+static QueryCol group_cols[MAX_GROUP_COLS];
+
+static uint32_t key_hash(const int64_t *key)
+{
+    return fnv(key, ngroup_cols * sizeof(int64_t), 2166136261U);
+}
+
+static void groups_grow(GroupTab *t)
+{
+    size_t hcap = t->hcap ? t->hcap * 2 : 1024;
+    uint32_t *h = calloc(hcap, sizeof(uint32_t));
+    for (size_t i = 0; i < t->n; i++)
+    {
+        uint32_t k = key_hash(t->g[i].key) & (hcap - 1);
+        while (h[k])
+            k = (k + 1) & (hcap - 1);
+        h[k] = (uint32_t)i + 1;
+    }
+    free(t->hash);
+    t->hash = h;
+    t->hcap = hcap;
+}
+
+static Group *group_get(GroupTab *t, const int64_t *key)
+{
+    if (t->n * 2 >= t->hcap)
+        groups_grow(t);
+    uint32_t k = key_hash(key) & (t->hcap - 1);
+    while (t->hash[k])
+    {
+        Group *g = &t->g[t->hash[k] - 1];
+        if (memcmp(g->key, key, ngroup_cols * sizeof(int64_t)) == 0)
+            return g;
+        k = (k + 1) & (t->hcap - 1);
+    }
+    if (t->n == t->cap)
+    {
+        t->cap = t->cap ? t->cap * 2 : 256;
+        t->g = realloc(t->g, t->cap * sizeof(Group));
+    }
+    Group *g = &t->g[t->n];
+    memset(g, 0, sizeof(*g));
+    memcpy(g->key, key, ngroup_cols * sizeof(int64_t));
+    t->hash[k] = (uint32_t)t->n + 1;
+    t->n++;
+    return g;
+}
+
+// === 过滤条件 ===
+typedef struct
+{
+    QueryCol col;
+    const char *value;
+    long num;
+    int negate;
+} Filter;
+
+static Filter filters[MAX_FILTERS];
+static int nfilters = 0;
+
+static int parse_filter(const char *spec)
+{
+    if (nfilters >= MAX_FILTERS)
+        return -1;
+    const char *eq = strchr(spec, '=');
+    if (!eq || eq == spec)
+        return -1;
+    Filter *f = &filters[nfilters];
+    size_t len = (size_t)(eq - spec);
+    f->negate = (spec[len - 1] == '!');
+    if (f->negate)
+        len--;
+    char name[32];
+    if (len == 0 || len >= sizeof(name))
+        return -1;
+    memcpy(name, spec, len);
+    name[len] = '\0';
+    int c = col_lookup(name);
+    if (c < 0)
+        return -1;
+    f->col = (QueryCol)c;
+    f->value = eq + 1;
+    f->num = strtol(eq + 1, NULL, 0);
+    nfilters++;
+    return 0;
+}
+
+static int64_t num_value(const FiResBlock *b, QueryCol c, uint32_t i)
+{
+    if (c == COL_BIT)
+        return b->bit[i];
+    if (c == COL_SIGNAL)
+        return b->signal[i];
+    return b->pid;
+}
+
+// === 输出 ===
+static StrTab strtab;
+
+// JSON 形式输出分组键 (字符串转义)
+static void print_json_key(const Group *g, int c)
+{
+    if (!col_is_str(group_cols[c]))
+    {
+        printf("%lld", (long long)g->key[c]);
+        return;
+    }
+    putchar('"');
+    for (const char *s = strtab.s[g->key[c]]; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            putchar('\\');
+        if ((unsigned char)*s >= 0x20)
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+static int group_cmp(const void *a, const void *b)
+{
+    const Group *ga = a, *gb = b;
+    for (int c = 0; c < ngroup_cols; c++)
+    {
+        if (ga->key[c] == gb->key[c])
+            continue;
+        if (col_is_str(group_cols[c]))
+            return strcmp(strtab.s[ga->key[c]], strtab.s[gb->key[c]]);
+        return ga->key[c] < gb->key[c] ? -1 : 1;
+    }
+    return 0;
+}
+
+void print_help(const char *prog)
+{
+    printf("用法: %s [选项] <结果库>\n", prog);
+    printf("选项:\n");
+    printf("  -g <列,...>    分组列 (默认 target,outcome)，最多 %d 列\n", MAX_GROUP_COLS);
+    printf("  -w <列=值>     过滤条件，可重复；列!=值 表示排除\n");
+    printf("  -c             逐行导出 CSV (应用过滤条件)\n");
+    printf("  -j             以 JSON 输出分组统计\n");
+    printf("列: tool target site model outcome bit signal pid\n");
+    printf("\n示例:\n");
+    printf("  FI_RESULTS=results.fir ./campaign_injector campaign_example.conf\n");
+    printf("  %s results.fir\n", prog);
+    printf("  %s -g site,outcome -w target=target_reg results.fir\n", prog);
+    printf("  %s -c -w outcome=sdc results.fir > sdc.csv\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    const char *group_spec = "target,outcome";
+    int csv = 0, json = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            group_spec = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            if (parse_filter(argv[++i]) < 0)
+            {
+                fprintf(stderr, "[-] 无效过滤条件: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+            csv = 1;
+        else if (strcmp(argv[i], "-j") == 0)
+            json = 1;
+        else if (argv[i][0] != '-')
+            path = argv[i];
+        else
+        {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    if (!path)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    char spec[128];
+    snprintf(spec, sizeof(spec), "%s", group_spec);
+    for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ","))
+    {
+        int c = col_lookup(tok);
+        if (c < 0 || ngroup_cols >= MAX_GROUP_COLS)
+        {
+            fprintf(stderr, "[-] 无效分组列: %s\n", tok);
+            return 1;
+        }
+        group_cols[ngroup_cols++] = (QueryCol)c;
+    }
+
+    FiResReader rd;
+    if (fi_results_map(&rd, path) < 0)
+    {
+        perror("打开结果库失败");
+        return 1;
+    }
+
+    if (csv)
+        printf("id,ts_ns,dur_ns,tool,target,site,model,bit,addr,old,new,outcome,signal,pid\n");
+
+    GroupTab groups = {0};
+    uint64_t total = 0, nblocks = 0;
+    uint32_t *gid = NULL;  // 块内字符串下标 -> 全局编号
+    uint8_t *match = NULL; // 块内字符串下标 -> 各过滤条件是否满足 (按位)
+    size_t map_cap = 0;
+    FiResBlock blk;
+    int r;
+
+    while ((r = fi_results_next(&rd, &blk)) > 0)
+    {
+        nblocks++;
+        if (blk.nstr == 0)
+            continue;
+        if (blk.nstr > map_cap)
+        {
+            map_cap = blk.nstr;
+            gid = realloc(gid, map_cap * sizeof(uint32_t));
+            match = realloc(match, map_cap);
+        }
+        // 每块只解析一次字符串表，之后按行只做数组查找
+        for (uint32_t s = 0; s < blk.nstr; s++)
+        {
+            gid[s] = strtab_id(&strtab, blk.str[s]);
+            match[s] = 0;
+            for (int f = 0; f < nfilters; f++)
+                if (col_is_str(filters[f].col) && strcmp(blk.str[s], filters[f].value) == 0)
+                    match[s] |= (uint8_t)(1u << f);
+        }
+
+        for (uint32_t i = 0; i < blk.nrows; i++)
+        {
+            int keep = 1;
+            for (int f = 0; f < nfilters && keep; f++)
+            {
+                int hit;
+                if (col_is_str(filters[f].col))
+                {
+                    uint16_t s = str_col(&blk, filters[f].col)[i];
+                    hit = s < blk.nstr && (match[s] >> f & 1);
+                }
+                else
+                {
+                    hit = num_value(&blk, filters[f].col, i) == filters[f].num;
+                }
+                keep = hit != filters[f].negate;
+            }
+            if (!keep)
+                continue;
+
+            if (csv)
+            {
+                const char *sv[5];
+                for (int c = COL_TOOL; c <= COL_OUTCOME; c++)
+                {
+                    uint16_t s = str_col(&blk, (QueryCol)c)[i];
+                    sv[c] = s < blk.nstr ? blk.str[s] : "";
+                }
+                printf("%llu,%llu,%llu,%s,%s,%s,%s,%d,0x%llx,0x%llx,0x%llx,%s,%d,%u\n",
+                       (unsigned long long)blk.id[i], (unsigned long long)blk.ts_ns[i],
+                       (unsigned long long)blk.dur_ns[i], sv[0], sv[1], sv[2], sv[3], blk.bit[i],
+                       (unsigned long long)blk.addr[i], (unsigned long long)blk.old_val[i],
+                       (unsigned long long)blk.new_val[i], sv[4], blk.signal[i], blk.pid);
+                continue;
+            }
+
+            int64_t key[MAX_GROUP_COLS];
+            for (int c = 0; c < ngroup_cols; c++)
+            {
+                if (col_is_str(group_cols[c]))
+                {
+                    uint16_t s = str_col(&blk, group_cols[c])[i];
+                    key[c] = s < blk.nstr ? gid[s] : gid[0];
+                }
+                else
+                {
+                    key[c] = num_value(&blk, group_cols[c], i);
+                }
+            }
+            Group *g = group_get(&groups, key);
+            g->count++;
+            g->dur_sum += blk.dur_ns[i];
+            total++;
+        }
+    }
+    if (r < 0)
+        fprintf(stderr, "[!] 偏移 %zu 处的块读取失败 (内存不足)，之后的数据被忽略\n", rd.off);
+    if (rd.skipped)
+        fprintf(stderr, "[!] 跳过了 %zu 字节不完整或已损坏的数据\n", rd.skipped);
+
+    if (!csv)
+    {
+        qsort(groups.g, groups.n, sizeof(Group), group_cmp);
+        if (json)
+        {
+            printf("{\"total\": %llu, \"blocks\": %llu, \"columns\": [", (unsigned long long)total,
+                   (unsigned long long)nblocks);
+            for (int c = 0; c < ngroup_cols; c++)
+                printf("%s\"%s\"", c ? ", " : "", col_names[group_cols[c]]);
+            printf("], \"groups\": [");
+            for (size_t k = 0; k < groups.n; k++)
+            {
+                Group *g = &groups.g[k];
+                printf("%s{", k ? ", " : "");
+                for (int c = 0; c < ngroup_cols; c++)
+                {
+                    printf("\"%s\": ", col_names[group_cols[c]]);
+                    print_json_key(g, c);
+                    printf(", ");
+                }
+                printf("\"count\": %llu, \"avg_ms\": %.3f}", (unsigned long long)g->count,
+                       g->dur_sum / 1e6 / g->count);
+            }
+            printf("]}\n");
+        }
+        else
+        {
+            printf("=== 实验结果统计 (%s) ===\n", path);
+            for (int c = 0; c < ngroup_cols; c++)
+                printf(" %-16s", col_names[group_cols[c]]);
+            printf(" %10s %8s %10s\n", "count", "占比", "平均ms");
+            for (size_t k = 0; k < groups.n; k++)
+            {
+                Group *g = &groups.g[k];
+                for (int c = 0; c < ngroup_cols; c++)
+                {
+                    printf(" ");
+                    if (col_is_str(group_cols[c]))
+                        printf("%-16s", strtab.s[g->key[c]]);
+                    else
+                        printf("%-16lld", (long long)g->key[c]);
+                }
+                printf(" %10llu %7.2f%% %10.3f\n", (unsigned long long)g->count,
+                       100.0 * g->count / total, g->dur_sum / 1e6 / g->count);
+            }
+            printf("------------------------------------------------------------------------\n");
+            printf(" 共 %llu 行, %llu 块, %zu 组\n", (unsigned long long)total, (unsigned long long)nblocks,
+                   groups.n);
+        }
+    }
+
+    free(gid);
+    free(match);
+    fi_results_unmap(&rd);
+    return 0;
+}
@@ -0,0 +1,311 @@
+/*
+ * fi_remote.c - 远程系统调用执行引擎实现
+ *
+ * 桩代码 (写在目标第一个可执行映射的起始处，执行完即恢复)：
+ *   x86_64: 0f 05 (syscall) ; cc (int3)
+ *   ARM64 : d4000001 (svc #0) ; d4200000 (brk #0)
+ * 执行时把被打断的系统调用号置为 -1，避免内核按原寄存器做系统调用重启；
+ * 恢复原寄存器后，原先被打断的阻塞调用仍按内核语义正常重启。
+ */
+
+#define _GNU_SOURCE
+#include "fi_remote.h"
+#include "fi_trigger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__x86_64__)
+#define FI_STUB_CODE 0xcc050fUL
+#define FI_STUB_MASK 0xffffffUL
+#else
+#define FI_STUB_CODE 0xd4200000d4000001UL
+#define FI_STUB_MASK 0xffffffffffffffffUL
+#endif
+
+// 选第一个可执行的文件映射作为桩代码位置 (避开 vdso/vsyscall)
+static int find_stub_addr(pid_t pid, uint64_t *addr)
+{
+    char path[64], line[512];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    int found = -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long start, end;
+        char perms[5];
+        if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3)
+            continue;
+        if (perms[2] != 'x' || strstr(line, "[vdso]") || strstr(line, "[vsyscall]"))
+            continue;
+        *addr = start;
+        found = 0;
+        break;
+    }
+    fclose(fp);
+    return found;
+}
+
+// 冻结目标的全部线程 (PTRACE_SEIZE + PTRACE_INTERRUPT)
+// 扫描期间未冻结的线程仍可创建新线程，因此反复扫描直到一整轮没有新线程；
+// 任何一个仍存活的线程无法冻结或超出上限都算失败，不能在有线程运行时改写桩代码
+static int thread_frozen(const FiRemote *rc, pid_t tid)
+{
+    for (int i = 0; i < rc->ntids; i++)
+    {
+        if (rc->tids[i] == tid)
+            return 1;
+    }
+    return 0;
+}
+
+static int freeze_threads(FiRemote *rc)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", rc->pid);
+
+    int added;
+    do
+    {
+        DIR *dir = opendir(path);
+        if (!dir)
+            return -1;
+        added = 0;
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL)
+        {
+            pid_t tid = atoi(de->d_name);
+            if (tid <= 0 || thread_frozen(rc, tid))
+                continue;
+            if (rc->ntids >= FI_REMOTE_MAX_THREADS)
+            {
+                fprintf(stderr, "[-] 目标线程数超过 %d\n", FI_REMOTE_MAX_THREADS);
+                closedir(dir);
+                errno = E2BIG;
+                return -1;
+            }
+            if (fi_seize(tid) < 0)
+            {
+                if (errno == ESRCH)
+                    continue; // 线程已退出
+                fprintf(stderr, "[-] 无法冻结线程 %d\n", tid);
+                closedir(dir);
+                return -1;
+            }
+            rc->tids[rc->ntids++] = tid;
+            if (fi_interrupt_wait(tid) < 0 && syscall(SYS_tgkill, rc->pid, tid, 0) == 0)
+            {
+                fprintf(stderr, "[-] 无法停住线程 %d\n", tid);
+                closedir(dir);
+                return -1;
+            }
+            added++;
+        }
+        closedir(dir);
+    } while (added > 0);
+
+    return thread_frozen(rc, rc->pid) ? 0 : -1;
+}
+
+static void thaw_threads(FiRemote *rc)
+{
+    for (int i = 0; i < rc->ntids; i++)
+    {
+        int sig = (rc->tids[i] == rc->pid) ? rc->pending_sig : 0;
+        ptrace(PTRACE_DETACH, rc->tids[i], NULL, (void *)(long)sig);
+    }
+    rc->ntids = 0;
+}
+
+int fi_remote_attach(FiRemote *rc, pid_t pid)
+{
+    memset(rc, 0, sizeof(*rc));
+    rc->pid = pid;
+
+    if (find_stub_addr(pid, &rc->stub_addr) < 0)
+    {
+        fprintf(stderr, "[-] 未找到目标的可执行映射\n");
+        return -1;
+    }
+
+    rc->stop_ns = fi_now_ns();
+    if (freeze_threads(rc) < 0)
+    {
+        perror("冻结目标失败");
+        thaw_threads(rc);
+        return -1;
+    }
+
+    if (fi_get_regs(pid, &rc->saved) < 0)
+        goto fail;
+    rc->saved_sysno = fi_get_sysno(pid, &rc->saved);
+
+    errno = 0;
+    rc->saved_code = ptrace(PTRACE_PEEKTEXT, pid, (void *)rc->stub_addr, NULL);
+    if (errno != 0)
+        goto fail;
+
+    long stub = (long)(((unsigned long)rc->saved_code & ~FI_STUB_MASK) | FI_STUB_CODE);
+    if (ptrace(PTRACE_POKETEXT, pid, (void *)rc->stub_addr, (void *)stub) < 0)
+        goto fail;
+    return 0;
+
+fail:
+    perror("准备远程调用失败");
+    thaw_threads(rc);
+    return -1;
+}
+
+long fi_remote_syscall(FiRemote *rc, long nr, const uint64_t args[6])
+{
+    fi_regs_t regs = rc->saved;
+
+    // 先清除被打断的系统调用号，再装载本次调用
+    if (fi_set_sysno(rc->pid, &regs, -1) < 0)
+        return -ENOTRECOVERABLE;
+    FI_REG_PC(&regs) = rc->stub_addr;
+#if defined(__x86_64__)
+    regs.rax = (uint64_t)nr;
+#else
+    regs.regs[8] = (uint64_t)nr;
+#endif
+    for (int i = 0; i < 6; i++)
+        *fi_sys_arg(&regs, i) = args ? args[i] : 0;
+
+    if (fi_set_regs(rc->pid, &regs) < 0)
+        return -ENOTRECOVERABLE;
+    if (ptrace(PTRACE_CONT, rc->pid, NULL, NULL) < 0)
+        return -ENOTRECOVERABLE;
+
+    while (1)
+    {
+        int status;
+        if (waitpid(rc->pid, &status, __WALL) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -ENOTRECOVERABLE;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            return -ENOTRECOVERABLE;
+        if (!WIFSTOPPED(status))
+            continue;
+
+        int sig = WSTOPSIG(status);
+        if (sig == SIGTRAP && (status >> 16) == 0)
+            break;
+
+        // 执行期间到达的信号先扣下，释放时补发
+        if ((status >> 16) == 0 && sig != SIGSTOP)
+            rc->pending_sig = sig;
+        ptrace(PTRACE_CONT, rc->pid, NULL, NULL);
+    }
+
+    if (fi_get_regs(rc->pid, &regs) < 0)
+        return -ENOTRECOVERABLE;
+    return (long)FI_REG_RET(&regs);
+}
+
+int fi_remote_batch(FiRemote *rc, FiRemoteCall *calls, int n)
+{
+    int done = 0;
+    for (int i = 0; i < n; i++)
+    {
+        calls[i].ret = fi_remote_syscall(rc, calls[i].nr, calls[i].args);
+        if (calls[i].ret == -ENOTRECOVERABLE)
+            break;
+        done++;
+    }
+    return done;
+}
+
+uint64_t fi_remote_scratch(FiRemote *rc, size_t len)
+{
+    if (rc->scratch)
+        return (len <= rc->scratch_len) ? rc->scratch : 0;
+
+    len = (len + 4095) & ~4095UL;
+    uint64_t args[6] = {0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, (uint64_t)-1, 0};
+    long ret = fi_remote_syscall(rc, SYS_mmap, args);
+    if (ret < 0 && ret > -4096)
+        return 0;
+    rc->scratch = (uint64_t)ret;
+    rc->scratch_len = len;
+    return rc->scratch;
+}
+
+int fi_remote_write(FiRemote *rc, uint64_t addr, const void *buf, size_t len)
+{
+    struct iovec local = {(void *)buf, len};
+    struct iovec remote = {(void *)addr, len};
+    if (process_vm_writev(rc->pid, &local, 1, &remote, 1, 0) == (ssize_t)len)
+        return 0;
+
+    // 退化为逐字写入
+    for (size_t off = 0; off < len; off += sizeof(long))
+    {
+        long word = 0;
+        size_t n = (len - off < sizeof(long)) ? len - off : sizeof(long);
+        if (n < sizeof(long))
+        {
+            errno = 0;
+            word = ptrace(PTRACE_PEEKDATA, rc->pid, (void *)(addr + off), NULL);
+            if (errno != 0)
+                return -1;
+        }
+        memcpy(&word, (const char *)buf + off, n);
+        if (ptrace(PTRACE_POKEDATA, rc->pid, (void *)(addr + off), (void *)word) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+int fi_remote_read(FiRemote *rc, uint64_t addr, void *buf, size_t len)
+{
+    struct iovec local = {buf, len};
+    struct iovec remote = {(void *)addr, len};
+    if (process_vm_readv(rc->pid, &local, 1, &remote, 1, 0) == (ssize_t)len)
+        return 0;
+
+    for (size_t off = 0; off < len; off += sizeof(long))
+    {
+        errno = 0;
+        long word = ptrace(PTRACE_PEEKDATA, rc->pid, (void *)(addr + off), NULL);
+        if (errno != 0)
+            return -1;
+        size_t n = (len - off < sizeof(long)) ? len - off : sizeof(long);
+        memcpy((char *)buf + off, &word, n);
+    }
+    return 0;
+}
+
+uint64_t fi_remote_detach(FiRemote *rc)
+{
+    if (rc->scratch)
+    {
+        uint64_t args[6] = {rc->scratch, rc->scratch_len, 0, 0, 0, 0};
+        fi_remote_syscall(rc, SYS_munmap, args);
+        rc->scratch = 0;
+    }
+
+    ptrace(PTRACE_POKETEXT, rc->pid, (void *)rc->stub_addr, (void *)rc->saved_code);
+    fi_regs_t regs = rc->saved;
+    fi_set_sysno(rc->pid, &regs, rc->saved_sysno);
+    fi_set_regs(rc->pid, &rc->saved);
+
+    thaw_threads(rc);
+    return fi_now_ns() - rc->stop_ns;
+}
@@ -0,0 +1,61 @@
+/*
+ * fi_remote.h - 远程系统调用执行引擎
+ * 功能：在目标进程上下文中执行任意系统调用 (参考 CRIU parasite 的做法)：
+ *       冻结目标全部线程 -> 保存寄存器 -> 在可执行页写入 "syscall; trap" 桩代码 ->
+ *       逐个执行 -> 恢复代码与寄存器 -> 释放。
+ *       同一次 attach 内的多个调用共享一次停止。
+ */
+
+#ifndef FI_REMOTE_H
+#define FI_REMOTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "fi_sys.h"
+
+#define FI_REMOTE_MAX_THREADS 4096 // JVM/Hadoop 进程常有数百上千个线程
+
+typedef struct
+{
+    pid_t pid;                // 执行系统调用的线程 (主线程)
+    pid_t tids[FI_REMOTE_MAX_THREADS];
+    int ntids;                // 被冻结的线程数
+    fi_regs_t saved;          // 主线程原寄存器
+    long saved_sysno;         // 被打断的系统调用号 (用于恢复重启语义)
+    uint64_t stub_addr;       // 桩代码地址
+    long saved_code;          // 被覆盖的原指令字
+    uint64_t scratch;         // 远程临时内存
+    size_t scratch_len;
+    int pending_sig;          // 执行期间截获的信号，释放时补发
+    uint64_t stop_ns;         // 冻结时刻，用于统计停止耗时
+} FiRemote;
+
+typedef struct
+{
+    long nr;
+    uint64_t args[6];
+    long ret; // 返回值 (负数为 -errno)
+} FiRemoteCall;
+
+// 冻结目标并准备桩代码，成功返回 0
+int fi_remote_attach(FiRemote *rc, pid_t pid);
+
+// 执行一个远程系统调用，返回目标内的返回值；引擎自身出错时返回 -ENOTRECOVERABLE
+long fi_remote_syscall(FiRemote *rc, long nr, const uint64_t args[6]);
+
+// 批量执行，全部共享同一次停止；返回成功执行的调用数
+int fi_remote_batch(FiRemote *rc, FiRemoteCall *calls, int n);
+
+// 在目标内申请一块可读写临时内存 (远程 mmap)，失败返回 0
+uint64_t fi_remote_scratch(FiRemote *rc, size_t len);
+
+// 读写目标内存
+int fi_remote_write(FiRemote *rc, uint64_t addr, const void *buf, size_t len);
+int fi_remote_read(FiRemote *rc, uint64_t addr, void *buf, size_t len);
+
+// 释放临时内存，恢复代码与寄存器，解冻全部线程；返回本次停止耗时 (纳秒)
+uint64_t fi_remote_detach(FiRemote *rc);
+
+#endif
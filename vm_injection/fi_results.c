@@ -0,0 +1,358 @@
+/*
+ * fi_results.c - 只追加的列式实验结果库实现
+ *
+ * 写端的缓冲本身就按列存放，落盘时把各列与字符串表拼成一个块，一次 write 追加。
+ * O_APPEND 下同一文件的 write 由内核串行化，块之间不会交错；
+ * 写入中途失败 (如磁盘满) 只会留下残块，读端校验失败后向后搜索魔数重新同步，跳过残块继续读。
+ */
+
+#define _GNU_SOURCE
+#include "fi_results.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FI_RES_NCOLS 13
+#define FI_RES_STR_COLS 5
+#define FI_RES_HASH_SIZE (1 << 15) // 须大于 FI_RES_BLOCK_ROWS * FI_RES_STR_COLS
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+struct FiResults
+{
+    int fd;
+    char tool[32];
+    uint32_t seq;
+
+    // 按列缓冲
+    uint32_t nrows;
+    uint64_t *u64[6];  // id, ts_ns, dur_ns, addr, old, new
+    uint16_t *u16[5];  // tool, target, site, model, outcome
+    int16_t *i16[2];   // bit, signal
+
+    // 块内字符串表：strbuf 中依次存放，hash 存 (下标 + 1)
+    char *strbuf;
+    size_t str_bytes, str_cap;
+    uint32_t *str_off;
+    uint32_t nstr;
+    uint32_t *hash;
+};
+
+static uint32_t str_hash(const char *s)
+{
+    uint32_t h = 2166136261U;
+    while (*s)
+        h = (h ^ (uint8_t)*s++) * 16777619U;
+    return h;
+}
+
+// 字符串在块内的下标，不存在则加入；内存不足返回 -1
+static int intern(FiResults *r, const char *s)
+{
+    if (!s)
+        s = "";
+    uint32_t h = str_hash(s) & (FI_RES_HASH_SIZE - 1);
+    while (r->hash[h])
+    {
+        uint32_t idx = r->hash[h] - 1;
+        if (strcmp(r->strbuf + r->str_off[idx], s) == 0)
+            return (int)idx;
+        h = (h + 1) & (FI_RES_HASH_SIZE - 1);
+    }
+
+    size_t len = strlen(s) + 1;
+    if (r->str_bytes + len > r->str_cap)
+    {
+        size_t cap = r->str_cap * 2;
+        while (cap < r->str_bytes + len)
+            cap *= 2;
+        char *p = realloc(r->strbuf, cap);
+        if (!p)
+            return -1;
+        r->strbuf = p;
+        r->str_cap = cap;
+    }
+    memcpy(r->strbuf + r->str_bytes, s, len);
+    r->str_off[r->nstr] = (uint32_t)r->str_bytes;
+    r->str_bytes += len;
+    r->hash[h] = r->nstr + 1;
+    return (int)r->nstr++;
+}
+
+static void reset_block(FiResults *r)
+{
+    r->nrows = 0;
+    r->nstr = 0;
+    r->str_bytes = 0;
+    memset(r->hash, 0, FI_RES_HASH_SIZE * sizeof(uint32_t));
+    intern(r, r->tool); // 下标 0 固定为注入器名
+}
+
+FiResults *fi_results_open(const char *path, const char *tool)
+{
+    FiResults *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    r->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (r->fd < 0)
+    {
+        perror("打开结果库失败");
+        free(r);
+        return NULL;
+    }
+    snprintf(r->tool, sizeof(r->tool), "%s", tool ? tool : "");
+
+    int ok = 1;
+    for (int i = 0; i < 6; i++)
+        ok &= (r->u64[i] = malloc(FI_RES_BLOCK_ROWS * sizeof(uint64_t))) != NULL;
+    for (int i = 0; i < 5; i++)
+        ok &= (r->u16[i] = malloc(FI_RES_BLOCK_ROWS * sizeof(uint16_t))) != NULL;
+    for (int i = 0; i < 2; i++)
+        ok &= (r->i16[i] = malloc(FI_RES_BLOCK_ROWS * sizeof(int16_t))) != NULL;
+    r->str_cap = 4096;
+    r->strbuf = malloc(r->str_cap);
+    r->str_off = malloc((FI_RES_BLOCK_ROWS * FI_RES_STR_COLS + 1) * sizeof(uint32_t));
+    r->hash = malloc(FI_RES_HASH_SIZE * sizeof(uint32_t));
+    if (!ok || !r->strbuf || !r->str_off || !r->hash)
+    {
+        fi_results_close(r);
+        return NULL;
+    }
+    reset_block(r);
+    return r;
+}
+
+FiResults *fi_results_open_env(const char *tool)
+{
+    const char *path = getenv(FI_RESULTS_ENV);
+    if (!path || !*path)
+        return NULL;
+    return fi_results_open(path, tool);
+}
+
+int fi_results_add(FiResults *r, const FiResultRow *row)
+{
+    if (!r)
+        return 0;
+
+    // 先登记字符串：失败时整行丢弃，不写入指向错误字符串的下标
+    int target = intern(r, row->target);
+    int site = intern(r, row->site);
+    int model = intern(r, row->model);
+    int outcome = intern(r, row->outcome);
+    if (target < 0 || site < 0 || model < 0 || outcome < 0)
+    {
+        fprintf(stderr, "[-] 结果库字符串表内存不足，丢弃一行\n");
+        return -1;
+    }
+
+    uint32_t i = r->nrows;
+    uint64_t ts = row->ts_ns;
+    if (ts == 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        ts = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec - row->dur_ns;
+    }
+    r->seq++;
+    r->u64[0][i] = row->id ? row->id : ((uint64_t)getpid() << 32 | r->seq);
+    r->u64[1][i] = ts;
+    r->u64[2][i] = row->dur_ns;
+    r->u64[3][i] = row->addr;
+    r->u64[4][i] = row->old_val;
+    r->u64[5][i] = row->new_val;
+    r->u16[0][i] = 0;
+    r->u16[1][i] = (uint16_t)target;
+    r->u16[2][i] = (uint16_t)site;
+    r->u16[3][i] = (uint16_t)model;
+    r->u16[4][i] = (uint16_t)outcome;
+    r->i16[0][i] = (int16_t)row->bit;
+    r->i16[1][i] = (int16_t)row->signal;
+
+    if (++r->nrows >= FI_RES_BLOCK_ROWS)
+        return fi_results_flush(r);
+    return 0;
+}
+
+int fi_results_flush(FiResults *r)
+{
+    if (!r || r->nrows == 0)
+        return 0;
+
+    size_t n = r->nrows;
+    size_t size = sizeof(FiResBlockHdr) + 6 * ALIGN8(n * 8) + 7 * ALIGN8(n * 2) + ALIGN8(r->str_bytes);
+    uint8_t *buf = calloc(1, size);
+    if (!buf)
+        return -1;
+
+    FiResBlockHdr *hdr = (FiResBlockHdr *)buf;
+    hdr->magic = FI_RES_MAGIC;
+    hdr->version = FI_RES_VERSION;
+    hdr->ncols = FI_RES_NCOLS;
+    hdr->nrows = (uint32_t)n;
+    hdr->nstr = r->nstr;
+    hdr->str_bytes = (uint32_t)r->str_bytes;
+    hdr->size = (uint32_t)size;
+    hdr->pid = (uint32_t)getpid();
+
+    uint8_t *p = buf + sizeof(*hdr);
+    for (int c = 0; c < 6; c++, p += ALIGN8(n * 8))
+        memcpy(p, r->u64[c], n * 8);
+    for (int c = 0; c < 5; c++, p += ALIGN8(n * 2))
+        memcpy(p, r->u16[c], n * 2);
+    for (int c = 0; c < 2; c++, p += ALIGN8(n * 2))
+        memcpy(p, r->i16[c], n * 2);
+    memcpy(p, r->strbuf, r->str_bytes);
+
+    // 一个块只用一次 write，保证与其他写端的块不交错
+    ssize_t w = write(r->fd, buf, size);
+    free(buf);
+    reset_block(r);
+    if (w != (ssize_t)size)
+    {
+        perror("写结果库失败");
+        return -1;
+    }
+    return 0;
+}
+
+void fi_results_close(FiResults *r)
+{
+    if (!r)
+        return;
+    if (r->fd >= 0 && r->hash)
+        fi_results_flush(r);
+    if (r->fd >= 0)
+        close(r->fd);
+    for (int i = 0; i < 6; i++)
+        free(r->u64[i]);
+    for (int i = 0; i < 5; i++)
+        free(r->u16[i]);
+    for (int i = 0; i < 2; i++)
+        free(r->i16[i]);
+    free(r->strbuf);
+    free(r->str_off);
+    free(r->hash);
+    free(r);
+}
+
+// === 读端 ===
+
+int fi_results_map(FiResReader *rd, const char *path)
+{
+    memset(rd, 0, sizeof(*rd));
+    rd->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (rd->fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(rd->fd, &st) < 0)
+    {
+        close(rd->fd);
+        return -1;
+    }
+    rd->size = (size_t)st.st_size;
+    if (rd->size > 0)
+    {
+        void *p = mmap(NULL, rd->size, PROT_READ, MAP_PRIVATE, rd->fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(rd->fd);
+            return -1;
+        }
+        madvise(p, rd->size, MADV_SEQUENTIAL);
+        rd->base = p;
+    }
+    return 0;
+}
+
+// 解析 rd->off 处的块：1 = 有块，0 = 残块或损坏，-1 = 内存不足
+static int parse_block(FiResReader *rd, FiResBlock *blk)
+{
+    if (rd->off + sizeof(FiResBlockHdr) > rd->size)
+        return 0;
+
+    const FiResBlockHdr *hdr = (const FiResBlockHdr *)(rd->base + rd->off);
+    size_t n = hdr->nrows;
+    if (hdr->magic != FI_RES_MAGIC || hdr->version != FI_RES_VERSION || hdr->ncols != FI_RES_NCOLS ||
+        hdr->size > rd->size - rd->off ||
+        hdr->size != sizeof(*hdr) + 6 * ALIGN8(n * 8) + 7 * ALIGN8(n * 2) + ALIGN8(hdr->str_bytes))
+        return 0;
+    // 残块的块头是完整的，只有其后紧跟文件尾或下一个块头才算完整的块
+    size_t next = rd->off + hdr->size;
+    if (next != rd->size &&
+        (next + sizeof(uint32_t) > rd->size || *(const uint32_t *)(rd->base + next) != FI_RES_MAGIC))
+        return 0;
+
+    const uint8_t *p = (const uint8_t *)(hdr + 1);
+    const uint64_t **u64[6] = {&blk->id, &blk->ts_ns, &blk->dur_ns, &blk->addr, &blk->old_val, &blk->new_val};
+    const uint16_t **u16[5] = {&blk->tool, &blk->target, &blk->site, &blk->model, &blk->outcome};
+    const int16_t **i16[2] = {&blk->bit, &blk->signal};
+    for (int c = 0; c < 6; c++, p += ALIGN8(n * 8))
+        *u64[c] = (const uint64_t *)p;
+    for (int c = 0; c < 5; c++, p += ALIGN8(n * 2))
+        *u16[c] = (const uint16_t *)p;
+    for (int c = 0; c < 2; c++, p += ALIGN8(n * 2))
+        *i16[c] = (const int16_t *)p;
+
+    // 字符串表：逐个定位，末尾必须以 NUL 结束
+    if (hdr->nstr > rd->strcap)
+    {
+        const char **v = realloc(rd->strv, hdr->nstr * sizeof(char *));
+        if (!v)
+            return -1;
+        rd->strv = v;
+        rd->strcap = hdr->nstr;
+    }
+    const char *s = (const char *)p, *end = s + hdr->str_bytes;
+    if (hdr->nstr && (hdr->str_bytes == 0 || end[-1] != '\0'))
+        return 0;
+    for (uint32_t i = 0; i < hdr->nstr; i++)
+    {
+        if (s >= end)
+            return 0;
+        rd->strv[i] = s;
+        s += strlen(s) + 1;
+    }
+
+    blk->nrows = hdr->nrows;
+    blk->nstr = hdr->nstr;
+    blk->pid = hdr->pid;
+    blk->str = rd->strv;
+    rd->off += hdr->size;
+    return 1;
+}
+
+int fi_results_next(FiResReader *rd, FiResBlock *blk)
+{
+    const uint32_t magic = FI_RES_MAGIC;
+    while (rd->off < rd->size)
+    {
+        int r = parse_block(rd, blk);
+        if (r != 0)
+            return r;
+        // 残块或损坏：向后找下一个块头的魔数重新同步，候选块同样要通过校验
+        size_t from = rd->off + 1;
+        const uint8_t *hit = (from < rd->size) ? memmem(rd->base + from, rd->size - from, &magic, sizeof(magic)) : NULL;
+        size_t next = hit ? (size_t)(hit - rd->base) : rd->size;
+        rd->skipped += next - rd->off;
+        rd->off = next;
+    }
+    return 0;
+}
+
+void fi_results_unmap(FiResReader *rd)
+{
+    if (rd->base)
+        munmap((void *)rd->base, rd->size);
+    if (rd->fd >= 0)
+        close(rd->fd);
+    free(rd->strv);
+    memset(rd, 0, sizeof(*rd));
+    rd->fd = -1;
+}
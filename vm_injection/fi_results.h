@@ -0,0 +1,105 @@
+/*
+ * fi_results.h - 只追加的列式实验结果库
+ * 功能：各注入器把每次实验的结果追加到同一个文件，供 fi_query 与 Web 控制器查询。
+ *       写端在进程内缓冲一个块 (最多 FI_RES_BLOCK_ROWS 行)，按列排布后用一次 O_APPEND write 追加，
+ *       多个进程/线程各自持有写端即可并发追加，无需加锁；
+ *       读端 mmap 整个文件，逐块直接访问列数组，统计百万行只需顺序扫描几个小整数列。
+ *       设置环境变量 FI_RESULTS=<文件> 即可让支持的注入器自动记录。
+ *
+ * 块格式 (小端，各段按 8 字节对齐)：
+ *   FiResBlockHdr
+ *   u64 列: id, ts_ns, dur_ns, addr, old, new          (各 nrows 个)
+ *   u16 列: tool, target, site, model, outcome         (块内字符串表下标)
+ *   i16 列: bit, signal
+ *   字符串表: nstr 个以 NUL 结尾的字符串
+ */
+
+#ifndef FI_RESULTS_H
+#define FI_RESULTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FI_RESULTS_ENV "FI_RESULTS"
+#define FI_RES_MAGIC 0x42524946U // "FIRB"
+#define FI_RES_VERSION 1
+#define FI_RES_BLOCK_ROWS 4096
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t ncols;
+    uint32_t nrows;
+    uint32_t nstr;
+    uint32_t str_bytes;
+    uint32_t size; // 整个块的字节数 (含本头)
+    uint32_t pid;  // 写入进程
+    uint32_t reserved;
+} FiResBlockHdr;
+
+// 一行实验记录 (字符串在 fi_results_add 时复制)
+typedef struct
+{
+    uint64_t id;      // 实验编号 (0 = 自动编号：pid<<32 | 序号)
+    uint64_t ts_ns;   // 实验开始时刻 (CLOCK_REALTIME，0 = 当前时刻减去 dur_ns)
+    uint64_t dur_ns;  // 实验耗时
+    const char *target;
+    const char *site;    // 故障位置，如 reg:X19 / mem:heap / sys:read
+    const char *model;   // 故障模型，如 flip1 / add1 / err:EIO
+    const char *outcome; // masked/detected/sdc/crash/hang/nofault/injected ...
+    int bit;             // -1 = 随机或不适用
+    uint64_t addr, old_val, new_val;
+    int signal;
+} FiResultRow;
+
+// === 写端 ===
+typedef struct FiResults FiResults;
+
+// 打开 (不存在则创建) 结果文件；tool 为注入器名
+FiResults *fi_results_open(const char *path, const char *tool);
+
+// 按 FI_RESULTS 环境变量打开，未设置时返回 NULL
+FiResults *fi_results_open_env(const char *tool);
+
+// 追加一行 (缓冲满时自动落盘)；r 为 NULL 时为空操作。内存不足或落盘失败返回 -1
+int fi_results_add(FiResults *r, const FiResultRow *row);
+
+// 把缓冲的行作为一个块写入文件
+int fi_results_flush(FiResults *r);
+
+// 落盘并关闭
+void fi_results_close(FiResults *r);
+
+// === 读端 ===
+typedef struct
+{
+    uint32_t nrows;
+    uint32_t nstr;
+    uint32_t pid;
+    const uint64_t *id, *ts_ns, *dur_ns, *addr, *old_val, *new_val;
+    const uint16_t *tool, *target, *site, *model, *outcome;
+    const int16_t *bit, *signal;
+    const char **str; // 块内字符串表，下标即 u16 列的值
+} FiResBlock;
+
+typedef struct
+{
+    int fd;
+    const uint8_t *base;
+    size_t size;
+    size_t off;
+    const char **strv;
+    size_t strcap;
+    size_t skipped; // 因残块或损坏跳过的字节数
+} FiResReader;
+
+// mmap 结果文件：0 成功，-1 失败
+int fi_results_map(FiResReader *rd, const char *path);
+
+// 读取下一块：1 = 有块，0 = 结束，-1 = 内存不足；残块与损坏的块被跳过并计入 skipped
+int fi_results_next(FiResReader *rd, FiResBlock *blk);
+
+void fi_results_unmap(FiResReader *rd);
+
+#endif
@@ -0,0 +1,616 @@
+/*
+ * fi_schedlat.c - 运行队列等待与 CPU 压力采样器
+ * 功能：以固定间隔 (默认 1ms) 读取目标全部线程的 /proc/<pid>/task/<tid>/schedstat 与 /proc/pressure/cpu，
+ *       得到每个线程的运行队列等待直方图 (按注入前/中/后分段) 与 CPU PSI 时间线。
+ *       schedstat 只有累计值，直方图统计的是每次采样内的平均等待 (wait/调度次数)，
+ *       不是逐次等待；逐次等待需 sched_switch/sched_wakeup 跟踪点。
+ *       注入起止时刻取自 FI_MARK_FILE 标记文件：cpu_injector 与 kvm_injector perf-delay/perf-clear
+ *       在该环境变量存在时追加 "<CLOCK_MONOTONIC 纳秒> start|stop <说明>"；
+ *       在 -- 之后给出注入命令时由本工具设置该变量并在前后各留一段基线，命令未写标记时以其启动/退出时刻为准。
+ * 编译：gcc -o fi_schedlat fi_schedlat.c
+ */
+
+#define _GNU_SOURCE
+#include "fi_mark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MAX_THREADS 4096
+#define NBUCKETS 24 // 对数分桶：<1us, 1-2us, ..., >=2^22us (约 4s)
+
+enum { PH_BEFORE, PH_DURING, PH_AFTER, PH_COUNT };
+static const char *phase_names[PH_COUNT] = {"注入前", "注入中", "注入后"};
+
+typedef struct
+{
+    int tid;
+    int fd;
+    char comm[20];
+    long long run, wait, slices; // 上次读数
+    int alive;
+} Thread;
+
+// 一次采样中某线程的增量 (只记录有调度事件的)
+typedef struct
+{
+    int thread;
+    int slices;
+    long long wait;
+    long long run;
+} Event;
+
+typedef struct
+{
+    long long t;       // CLOCK_MONOTONIC 纳秒
+    long long psi_some; // 累计停顿 (微秒)
+    long long psi_full;
+    long long wait;    // 全部线程本次增量 (纳秒)
+    long long run;
+    int nthreads;
+    size_t ev_end;     // 本次采样的事件在 events 中的结束位置
+} Sample;
+
+static Thread threads[MAX_THREADS];
+static int nthreads = 0;
+static Sample *samples;
+static size_t nsamples, cap_samples;
+static Event *events;
+static size_t nevents, cap_events;
+static volatile int stop = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void print_help(const char *prog)
+{
+    printf("用法: %s -p <PID> [选项] [-- <注入命令> [参数...]]\n", prog);
+    printf("选项:\n");
+    printf("  -p <pid>    目标进程 (采样其全部线程)\n");
+    printf("  -i <us>     采样间隔 (默认1000)\n");
+    printf("  -d <秒>     采样时长 (未给注入命令时必需)\n");
+    printf("  -b <秒>     注入命令启动前的基线时长 (默认1)\n");
+    printf("  -a <秒>     注入命令退出后继续采样的时长 (默认1)\n");
+    printf("  -M <file>   标记文件 (默认 fi_marks.txt，同时作为 FI_MARK_FILE 传给注入命令)\n");
+    printf("  -o <file>   时间线 CSV (每次采样一行)\n");
+    printf("  -H <file>   每线程直方图 CSV (样本内平均等待)\n");
+    printf("示例:\n");
+    printf("  %s -p 1234 -o tl.csv -- ./cpu_injector -D 20/100 1234 10\n", prog);
+    printf("  FI_MARK_FILE=m.txt ./kvm_injector perf-delay 1234 50; ...; %s -p 1234 -d 30 -M m.txt\n", prog);
+}
+
+// === 1. 读取 ===
+
+static int read_schedstat(Thread *th)
+{
+    char buf[128];
+    ssize_t n = pread(th->fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+        return -1;
+    buf[n] = 0;
+    long long r, w, s;
+    if (sscanf(buf, "%lld %lld %lld", &r, &w, &s) != 3)
+        return -1;
+    th->run = r;
+    th->wait = w;
+    th->slices = s;
+    return 0;
+}
+
+// /proc/pressure/cpu 的 some/full 累计值 (微秒)；没有 full 行时为 0
+static int read_psi(int fd, long long *some, long long *full)
+{
+    char buf[256];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+        return -1;
+    buf[n] = 0;
+    char *p = strstr(buf, "some");
+    *some = p && (p = strstr(p, "total=")) ? atoll(p + 6) : 0;
+    p = strstr(buf, "full");
+    *full = p && (p = strstr(p, "total=")) ? atoll(p + 6) : 0;
+    return 0;
+}
+
+// 扫描 task 目录，为新线程打开 schedstat
+static void scan_threads(int pid)
+{
+    char path[300];
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *d = opendir(path);
+    if (!d)
+        return;
+    struct dirent *e;
+    while ((e = readdir(d)) && nthreads < MAX_THREADS)
+    {
+        int tid = atoi(e->d_name);
+        if (tid <= 0)
+            continue;
+        int known = 0;
+        for (int i = 0; i < nthreads && !known; i++)
+            known = threads[i].tid == tid;
+        if (known)
+            continue;
+
+        Thread *th = &threads[nthreads];
+        memset(th, 0, sizeof(*th));
+        th->tid = tid;
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+        if ((th->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+            continue;
+        if (read_schedstat(th) < 0)
+        {
+            close(th->fd);
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/comm", pid, tid);
+        FILE *fp = fopen(path, "r");
+        if (fp)
+        {
+            if (fgets(th->comm, sizeof(th->comm), fp))
+                th->comm[strcspn(th->comm, "\n")] = 0;
+            fclose(fp);
+        }
+        th->alive = 1;
+        nthreads++;
+    }
+    closedir(d);
+}
+
+static void *grow(void *p, size_t *cap, size_t need, size_t elem)
+{
+    if (need <= *cap)
+        return p;
+    size_t nc = *cap ? *cap * 2 : 4096;
+    while (nc < need)
+        nc *= 2;
+    void *q = realloc(p, nc * elem);
+    if (!q)
+    {
+        perror("realloc");
+        exit(1);
+    }
+    *cap = nc;
+    return q;
+}
+
+// 一次采样：记录各线程增量与 PSI 累计值
+static int take_sample(int psi_fd)
+{
+    Sample s = {0};
+    s.t = now_ns();
+    if (psi_fd >= 0)
+        read_psi(psi_fd, &s.psi_some, &s.psi_full);
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        Thread *th = &threads[i];
+        if (!th->alive)
+            continue;
+        long long r = th->run, w = th->wait, sl = th->slices;
+        if (read_schedstat(th) < 0)
+        {
+            th->alive = 0;
+            close(th->fd);
+            continue;
+        }
+        s.nthreads++;
+        if (th->slices == sl && th->wait == w)
+            continue;
+        events = grow(events, &cap_events, nevents + 1, sizeof(Event));
+        events[nevents].thread = i;
+        events[nevents].slices = (int)(th->slices - sl);
+        events[nevents].wait = th->wait - w;
+        events[nevents].run = th->run - r;
+        s.wait += th->wait - w;
+        s.run += th->run - r;
+        nevents++;
+    }
+    s.ev_end = nevents;
+
+    samples = grow(samples, &cap_samples, nsamples + 1, sizeof(Sample));
+    samples[nsamples++] = s;
+    return s.nthreads;
+}
+
+// === 2. 标记 ===
+
+// 取 [lo, hi] 内最早的 start 与最晚的 stop；标记文件默认不截断，之前运行留下的标记不计入。返回找到的标记数
+static int load_marks(const char *path, long long lo, long long hi, long long *start, long long *end)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    char line[256], what[16];
+    long long t;
+    int n = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%lld %15s", &t, what) != 2 || t < lo || t > hi)
+            continue;
+        if (strcmp(what, "start") == 0)
+        {
+            if (*start == 0 || t < *start)
+                *start = t;
+            n++;
+        }
+        else if (strcmp(what, "stop") == 0)
+        {
+            if (t > *end)
+                *end = t;
+            n++;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+static int phase_of(long long t, long long start, long long end)
+{
+    if (start && t < start)
+        return PH_BEFORE;
+    if (end && t >= end)
+        return PH_AFTER;
+    return start ? PH_DURING : PH_BEFORE;
+}
+
+// === 3. 直方图与输出 ===
+
+static int bucket_of(long long ns)
+{
+    long long us = ns / 1000;
+    int b = 0;
+    while (us > 0 && b < NBUCKETS - 1)
+    {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void bucket_label(int b, char *buf, size_t len)
+{
+    long long lo = b ? 1LL << (b - 1) : 0;
+    if (lo < 1000)
+        snprintf(buf, len, "%lldus", lo);
+    else if (lo < 1000000)
+        snprintf(buf, len, "%lldms", lo / 1000);
+    else
+        snprintf(buf, len, "%llds", lo / 1000000);
+}
+
+// 直方图的分位点 (取桶上界，微秒)
+static long long hist_pct(const long long *h, double q)
+{
+    long long total = 0, acc = 0;
+    for (int b = 0; b < NBUCKETS; b++)
+        total += h[b];
+    if (total == 0)
+        return 0;
+    for (int b = 0; b < NBUCKETS; b++)
+    {
+        acc += h[b];
+        if (acc >= q * total)
+            return 1LL << b;
+    }
+    return 1LL << (NBUCKETS - 1);
+}
+
+static void print_hist(const long long *h, const char *title)
+{
+    long long max = 0, total = 0;
+    for (int b = 0; b < NBUCKETS; b++)
+    {
+        total += h[b];
+        if (h[b] > max)
+            max = h[b];
+    }
+    printf("\n%s (调度事件 %lld 次，样本内平均等待 p50 <%lldus，p99 <%lldus)\n", title, total, hist_pct(h, 0.5), hist_pct(h, 0.99));
+    if (total == 0)
+        return;
+    for (int b = 0; b < NBUCKETS; b++)
+    {
+        if (h[b] == 0)
+            continue;
+        char lbl[16];
+        bucket_label(b, lbl, sizeof(lbl));
+        int bar = (int)(h[b] * 40 / max);
+        printf("  >=%-7s %10lld  ", lbl, h[b]);
+        for (int i = 0; i < bar; i++)
+            printf("█");
+        printf("\n");
+    }
+}
+
+static void report(long long start, long long end, const char *tl_path, const char *hist_path)
+{
+    long long (*hist)[PH_COUNT][NBUCKETS] = calloc(nthreads, sizeof(*hist));
+    long long total[PH_COUNT][NBUCKETS] = {{0}};
+    long long wait[PH_COUNT] = {0}, span[PH_COUNT] = {0};
+    if (!hist)
+        return;
+
+    // 每次采样内线程的等待均摊到该次的调度事件上，按事件数计入对应阶段的桶。
+    // 桶值是样本内平均等待：同一样本里一次长等待与多次短等待无法区分，p99 会被低估
+    size_t ev = 0;
+    for (size_t i = 0; i < nsamples; i++)
+    {
+        int ph = phase_of(samples[i].t, start, end);
+        if (i > 0)
+            span[ph] += samples[i].t - samples[i - 1].t;
+        for (; ev < samples[i].ev_end; ev++)
+        {
+            Event *e = &events[ev];
+            wait[ph] += e->wait;
+            if (e->slices <= 0)
+                continue;
+            int b = bucket_of(e->wait / e->slices);
+            hist[e->thread][ph][b] += e->slices;
+            total[ph][b] += e->slices;
+        }
+    }
+
+    printf("\n=== 运行队列等待 (样本内平均等待，每次采样的等待时间 / 调度次数) ===\n");
+    for (int ph = 0; ph < PH_COUNT; ph++)
+    {
+        if (span[ph] == 0)
+            continue;
+        char title[96];
+        snprintf(title, sizeof(title), "[%s] %.1f 秒，全部线程等待 %.2f ms/秒",
+                 phase_names[ph], span[ph] / 1e9, wait[ph] / 1e6 / (span[ph] / 1e9));
+        print_hist(total[ph], title);
+    }
+
+    printf("\n%-8s %-16s", "TID", "名称");
+    for (int ph = 0; ph < PH_COUNT; ph++)
+        if (span[ph])
+            printf("  %s 均值p50/p99(us)", phase_names[ph]);
+    printf("\n");
+    for (int i = 0; i < nthreads; i++)
+    {
+        long long n = 0;
+        for (int ph = 0; ph < PH_COUNT; ph++)
+            for (int b = 0; b < NBUCKETS; b++)
+                n += hist[i][ph][b];
+        if (n == 0)
+            continue;
+        printf("%-8d %-16s", threads[i].tid, threads[i].comm);
+        for (int ph = 0; ph < PH_COUNT; ph++)
+            if (span[ph])
+                printf("  %8lld/%-8lld  ", hist_pct(hist[i][ph], 0.5), hist_pct(hist[i][ph], 0.99));
+        printf("\n");
+    }
+
+    // PSI 逐秒时间线 (相对注入开始)
+    long long t0 = start ? start : (nsamples ? samples[0].t : 0);
+    printf("\n=== CPU 压力时间线 (相对注入开始) ===\n");
+    printf("  秒     阶段     PSI some%%  PSI full%%  等待 ms/秒\n");
+    size_t j = 0;
+    while (j + 1 < nsamples)
+    {
+        size_t k = j + 1;
+        while (k + 1 < nsamples && samples[k].t - samples[j].t < 1000000000LL)
+            k++;
+        double secs = (samples[k].t - samples[j].t) / 1e9;
+        long long w = 0;
+        for (size_t x = j + 1; x <= k; x++)
+            w += samples[x].wait;
+        printf("  %+6.1f  %-8s %9.2f  %9.2f  %10.2f\n", (samples[j].t - t0) / 1e9,
+               phase_names[phase_of(samples[j].t, start, end)],
+               (samples[k].psi_some - samples[j].psi_some) / 1e4 / secs,
+               (samples[k].psi_full - samples[j].psi_full) / 1e4 / secs, w / 1e6 / secs);
+        j = k;
+    }
+
+    if (tl_path)
+    {
+        FILE *fp = fopen(tl_path, "w");
+        if (fp)
+        {
+            fprintf(fp, "t_ms,phase,psi_some_pct,psi_full_pct,wait_ms_per_s,run_ms_per_s,threads\n");
+            for (size_t i = 1; i < nsamples; i++)
+            {
+                double dt = (samples[i].t - samples[i - 1].t) / 1e9;
+                fprintf(fp, "%.3f,%d,%.2f,%.2f,%.3f,%.3f,%d\n", (samples[i].t - t0) / 1e6,
+                        phase_of(samples[i].t, start, end),
+                        (samples[i].psi_some - samples[i - 1].psi_some) / 1e4 / dt,
+                        (samples[i].psi_full - samples[i - 1].psi_full) / 1e4 / dt,
+                        samples[i].wait / 1e6 / dt, samples[i].run / 1e6 / dt, samples[i].nthreads);
+            }
+            fclose(fp);
+            printf("\n[✓] 时间线: %s (%zu 行，phase 0/1/2 = 注入前/中/后)\n", tl_path, nsamples - 1);
+        }
+    }
+    if (hist_path)
+    {
+        FILE *fp = fopen(hist_path, "w");
+        if (fp)
+        {
+            fprintf(fp, "tid,comm,phase,mean_wait_lo_us,count\n");
+            for (int i = 0; i < nthreads; i++)
+                for (int ph = 0; ph < PH_COUNT; ph++)
+                    for (int b = 0; b < NBUCKETS; b++)
+                        if (hist[i][ph][b])
+                            fprintf(fp, "%d,%s,%d,%lld,%lld\n", threads[i].tid, threads[i].comm, ph,
+                                    b ? 1LL << (b - 1) : 0, hist[i][ph][b]);
+            fclose(fp);
+            printf("[✓] 直方图: %s\n", hist_path);
+        }
+    }
+    free(hist);
+}
+
+// === 4. 主流程 ===
+
+int main(int argc, char *argv[])
+{
+    int pid = 0, interval_us = 1000;
+    double duration = 0, before = 1, after = 1;
+    const char *mark_path = "fi_marks.txt", *tl_path = NULL, *hist_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+p:i:d:b:a:M:o:H:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            pid = atoi(optarg);
+            break;
+        case 'i':
+            interval_us = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'b':
+            before = atof(optarg);
+            break;
+        case 'a':
+            after = atof(optarg);
+            break;
+        case 'M':
+            mark_path = optarg;
+            break;
+        case 'o':
+            tl_path = optarg;
+            break;
+        case 'H':
+            hist_path = optarg;
+            break;
+        default:
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    char **cmd = optind < argc ? &argv[optind] : NULL;
+    if (pid <= 0 || (!cmd && duration <= 0) || interval_us <= 0)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    scan_threads(pid);
+    if (nthreads == 0)
+    {
+        printf("[错误] 无法读取 /proc/%d/task/*/schedstat\n", pid);
+        return 1;
+    }
+    int psi_fd = open("/proc/pressure/cpu", O_RDONLY | O_CLOEXEC);
+    if (psi_fd < 0)
+        printf("[提示] 无法读取 /proc/pressure/cpu (内核未开启 PSI?)，只采样 schedstat\n");
+
+    // 由本工具启动注入命令时清空旧标记
+    if (cmd)
+    {
+        unlink(mark_path);
+        setenv(FI_MARK_ENV, mark_path, 1);
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    printf("[*] 采样 PID %d (%d 个线程)，间隔 %d us\n", pid, nthreads, interval_us);
+
+    long long t_begin = now_ns(), cmd_start = 0, cmd_end = 0, deadline;
+    long long spawn_at = cmd ? t_begin + (long long)(before * 1e9) : 0;
+    pid_t child = 0;
+    deadline = cmd ? 0 : t_begin + (long long)(duration * 1e9);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (long long i = 0; !stop; i++)
+    {
+        if (take_sample(psi_fd) == 0 && !cmd)
+        {
+            printf("[*] 目标已退出\n");
+            break;
+        }
+        if (i % (100000 / interval_us + 1) == 0)
+            scan_threads(pid);
+
+        long long t = now_ns();
+        if (cmd && !child && t >= spawn_at)
+        {
+            cmd_start = t;
+            child = fork();
+            if (child == 0)
+            {
+                execvp(cmd[0], cmd);
+                perror("execvp");
+                _exit(127);
+            }
+            printf("[*] 启动注入命令: %s (pid %d)\n", cmd[0], child);
+        }
+        if (child > 0 && !cmd_end)
+        {
+            int st;
+            if (waitpid(child, &st, WNOHANG) == child)
+            {
+                cmd_end = now_ns();
+                deadline = cmd_end + (long long)(after * 1e9);
+                printf("[*] 注入命令结束，继续采样 %.1f 秒\n", after);
+            }
+        }
+        if (deadline && t >= deadline)
+            break;
+
+        next.tv_nsec += interval_us * 1000L;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    if (child > 0 && !cmd_end)
+    {
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+        cmd_end = now_ns();
+    }
+
+    long long start = 0, end = 0;
+    if (load_marks(mark_path, t_begin, now_ns(), &start, &end) > 0)
+        printf("[*] 注入标记 (%s): 开始 %+.3f 秒，结束 %+.3f 秒\n", mark_path,
+               start ? (start - t_begin) / 1e9 : 0.0, end ? (end - t_begin) / 1e9 : 0.0);
+    else if (cmd)
+    {
+        start = cmd_start;
+        end = cmd_end;
+        printf("[*] 注入命令未写标记，以其启动/退出时刻为准\n");
+    }
+    else
+        printf("[*] 未找到注入标记，全部计为注入前\n");
+
+    long long elapsed = nsamples > 1 ? samples[nsamples - 1].t - samples[0].t : 0;
+    printf("[*] 共 %zu 次采样，平均间隔 %.1f us\n", nsamples,
+           nsamples > 1 ? elapsed / 1e3 / (nsamples - 1) : 0.0);
+
+    report(start, end, tl_path, hist_path);
+
+    for (int i = 0; i < nthreads; i++)
+        if (threads[i].alive)
+            close(threads[i].fd);
+    if (psi_fd >= 0)
+        close(psi_fd);
+    free(samples);
+    free(events);
+    return 0;
+}
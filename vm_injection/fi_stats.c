@@ -0,0 +1,137 @@
+/*
+ * fi_stats.c - 比例的置信区间实现
+ *
+ * Clopper-Pearson 区间的端点是 Beta 分布分位数：
+ *   下限 = BetaInv(α/2; k, n-k+1)，上限 = BetaInv(1-α/2; k+1, n-k)
+ * 正则化不完全 Beta 函数用连分式求值，分位数用二分法求解 (单调，60 次迭代足够)。
+ */
+
+#define _GNU_SOURCE
+#include "fi_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+double fi_stats_z(double confidence)
+{
+    // 解 P(|Z| <= z) = confidence，即 erfc(z/√2) = 1 - confidence
+    double alpha = 1.0 - confidence;
+    double lo = 0.0, hi = 10.0;
+    for (int i = 0; i < 100; i++)
+    {
+        double mid = (lo + hi) / 2;
+        if (erfc(mid / M_SQRT2) > alpha)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+// 不完全 Beta 函数的连分式 (Lentz 算法)
+static double beta_cf(double a, double b, double x)
+{
+    const double tiny = 1e-300;
+    double c = 1.0, d = 1.0 - (a + b) * x / (a + 1.0);
+    if (fabs(d) < tiny)
+        d = tiny;
+    d = 1.0 / d;
+    double h = d;
+    for (int m = 1; m <= 300; m++)
+    {
+        double m2 = 2.0 * m;
+        double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+        d = 1.0 + aa * d;
+        if (fabs(d) < tiny)
+            d = tiny;
+        c = 1.0 + aa / c;
+        if (fabs(c) < tiny)
+            c = tiny;
+        d = 1.0 / d;
+        h *= d * c;
+
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+        d = 1.0 + aa * d;
+        if (fabs(d) < tiny)
+            d = tiny;
+        c = 1.0 + aa / c;
+        if (fabs(c) < tiny)
+            c = tiny;
+        d = 1.0 / d;
+        double del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < 1e-12)
+            break;
+    }
+    return h;
+}
+
+// 正则化不完全 Beta 函数 I_x(a, b)
+static double beta_inc(double a, double b, double x)
+{
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+    double lbt = lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x);
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return exp(lbt) * beta_cf(a, b, x) / a;
+    return 1.0 - exp(lbt) * beta_cf(b, a, 1.0 - x) / b;
+}
+
+// Beta(a, b) 的 p 分位数
+static double beta_inv(double p, double a, double b)
+{
+    double lo = 0.0, hi = 1.0;
+    for (int i = 0; i < 60; i++)
+    {
+        double mid = (lo + hi) / 2;
+        if (beta_inc(a, b, mid) < p)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+void fi_stats_ci(FiCiMethod method, uint64_t k, uint64_t n, double confidence, double *lo, double *hi)
+{
+    if (n == 0)
+    {
+        *lo = 0.0;
+        *hi = 1.0;
+        return;
+    }
+    if (k > n)
+        k = n;
+
+    if (method == FI_CI_CLOPPER)
+    {
+        double alpha = 1.0 - confidence;
+        *lo = (k == 0) ? 0.0 : beta_inv(alpha / 2, (double)k, (double)(n - k + 1));
+        *hi = (k == n) ? 1.0 : beta_inv(1.0 - alpha / 2, (double)(k + 1), (double)(n - k));
+        return;
+    }
+
+    double z = fi_stats_z(confidence);
+    double p = (double)k / n, z2 = z * z;
+    double denom = 1.0 + z2 / n;
+    double center = (p + z2 / (2.0 * n)) / denom;
+    double half = z * sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denom;
+    *lo = center - half < 0.0 ? 0.0 : center - half;
+    *hi = center + half > 1.0 ? 1.0 : center + half;
+}
+
+int fi_stats_parse_method(const char *name)
+{
+    if (strcmp(name, "wilson") == 0)
+        return FI_CI_WILSON;
+    if (strcmp(name, "cp") == 0 || strcmp(name, "clopper") == 0)
+        return FI_CI_CLOPPER;
+    return -1;
+}
+
+const char *fi_stats_method_name(FiCiMethod method)
+{
+    return method == FI_CI_CLOPPER ? "Clopper-Pearson" : "Wilson";
+}
@@ -0,0 +1,28 @@
+/*
+ * fi_stats.h - 比例的置信区间
+ * 功能：二项比例的 Wilson 得分区间与 Clopper-Pearson 精确区间，
+ *       供注入战役做序贯抽样：各结果类别的区间都窄于要求的误差限即可停止。
+ */
+
+#ifndef FI_STATS_H
+#define FI_STATS_H
+
+#include <stdint.h>
+
+typedef enum
+{
+    FI_CI_WILSON,  // 得分区间：计算快，小样本与极端比例下仍表现良好
+    FI_CI_CLOPPER  // 精确区间：基于 Beta 分位数，保守 (覆盖率不低于置信度)
+} FiCiMethod;
+
+// 双侧置信度对应的标准正态分位数，如 0.95 -> 1.96
+double fi_stats_z(double confidence);
+
+// n 次中出现 k 次的比例区间 [lo, hi]；n == 0 时为 [0, 1]
+void fi_stats_ci(FiCiMethod method, uint64_t k, uint64_t n, double confidence, double *lo, double *hi);
+
+// 按名称解析方法 ("wilson" / "cp")，无效返回 -1
+int fi_stats_parse_method(const char *name);
+const char *fi_stats_method_name(FiCiMethod method);
+
+#endif
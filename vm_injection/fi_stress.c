@@ -0,0 +1,1029 @@
+/*
+ * fi_stress.c - cgroup v2 受限压力引擎
+ */
+
+#define _GNU_SOURCE
+#include "fi_stress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define CPU_PERIOD_US 100000
+
+// === 1. cgroup 文件读写 ===
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return -1;
+    ssize_t n = write(fd, val, strlen(val));
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return n < 0 ? -1 : 0;
+}
+
+static int read_file(const char *dir, const char *name, char *buf, size_t len)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = 0;
+    return 0;
+}
+
+// 在 "key value\n" 形式的文本中取 key 对应的值
+static unsigned long long kv_get(const char *text, const char *key)
+{
+    size_t klen = strlen(key);
+    for (const char *p = text; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL)
+        if (strncmp(p, key, klen) == 0 && p[klen] == ' ')
+            return strtoull(p + klen + 1, NULL, 10);
+    return 0;
+}
+
+static int has_word(const char *text, const char *word)
+{
+    size_t len = strlen(word);
+    for (const char *p = text; (p = strstr(p, word)); p += len)
+        if ((p == text || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\n' || p[len] == 0))
+            return 1;
+    return 0;
+}
+
+// 解析 "0-3,8" 形式的 CPU 列表，返回 CPU 个数，格式错误返回 -1
+static int parse_cpus(const char *s, cpu_set_t *set)
+{
+    int n = 0;
+    CPU_ZERO(set);
+    while (*s && *s != '\n')
+    {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s)
+            return -1;
+        if (*end == '-')
+        {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s)
+                return -1;
+        }
+        for (long c = a; c <= b && c < CPU_SETSIZE; c++)
+        {
+            CPU_SET(c, set);
+            n++;
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// 在 /proc/self/mounts 中找 cgroup2 挂载点，优先 /sys/fs/cgroup
+static int find_cgroup2(char *mnt, size_t len)
+{
+    FILE *fp = fopen("/proc/self/mounts", "r");
+    char dev[64], dir[256], type[32];
+    int found = 0;
+    if (!fp)
+        return -1;
+    while (fscanf(fp, "%63s %255s %31s %*[^\n]", dev, dir, type) == 3)
+    {
+        if (strcmp(type, "cgroup2") != 0)
+            continue;
+        if (!found || strcmp(dir, "/sys/fs/cgroup") == 0)
+            snprintf(mnt, len, "%s", dir);
+        found = 1;
+    }
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+static long long mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// === 2. 叶子创建与限额 ===
+
+void fi_stress_defaults(FiStressConfig *cfg, const char *name)
+{
+    long pages = sysconf(_SC_PHYS_PAGES), psize = sysconf(_SC_PAGESIZE);
+    memset(cfg, 0, sizeof(*cfg));
+    snprintf(cfg->name, sizeof(cfg->name), "%s", name ? name : "stress");
+    cfg->cpu_pct = 90;
+    cfg->mem_mb = pages > 0 && psize > 0 ? (long)((long long)pages * psize / 4 >> 20) : 256;
+}
+
+int fi_stress_parse(FiStressConfig *cfg, const char *spec)
+{
+    char buf[256], *save = NULL;
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(NULL, ",", &save))
+    {
+        char *val = strchr(kv, '=');
+        if (!val)
+            return -1;
+        *val++ = 0;
+        if (strcmp(kv, "cpu") == 0)
+            cfg->cpu_pct = atoi(val);
+        else if (strcmp(kv, "mem") == 0)
+            cfg->mem_mb = atol(val);
+        else if (strcmp(kv, "threads") == 0)
+            cfg->threads = atoi(val);
+        else if (strcmp(kv, "cpus") == 0)
+        {
+            // cpus 的值本身含逗号时用 ':' 分隔，例如 cpus=0-1:4
+            snprintf(cfg->cpus, sizeof(cfg->cpus), "%s", val);
+            for (char *p = cfg->cpus; *p; p++)
+                if (*p == ':')
+                    *p = ',';
+        }
+        else
+            return -1;
+    }
+    if (cfg->cpu_pct <= 0 || cfg->cpu_pct > 100 || cfg->mem_mb <= 0)
+        return -1;
+    if (cfg->cpus[0])
+    {
+        cpu_set_t set;
+        if (parse_cpus(cfg->cpus, &set) <= 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void enable_controllers(const char *dir)
+{
+    // 逐个启用，缺少某个控制器不影响其余
+    write_file(dir, "cgroup.subtree_control", "+cpu");
+    write_file(dir, "cgroup.subtree_control", "+cpuset");
+    write_file(dir, "cgroup.subtree_control", "+memory");
+}
+
+// 删除叶子，再尝试删除 fi_stress/ 父目录 (还有其他注入器的叶子时 EBUSY，留给最后一个退出者)；
+// 根 cgroup 的 subtree_control 不回退，其他 cgroup 可能已依赖这些控制器
+static void remove_leaf(const char *path)
+{
+    char parent[512];
+    for (int i = 0; i < 50 && rmdir(path) < 0 && errno == EBUSY; i++)
+        usleep(20000);
+    snprintf(parent, sizeof(parent), "%s", path);
+    char *slash = strrchr(parent, '/');
+    if (slash)
+    {
+        *slash = 0;
+        rmdir(parent);
+    }
+}
+
+// 清理根下 <name>.<pid> 形式、进程已不存在的分区叶子 (注入器被强杀时遗留，占着分区的 CPU)
+static void remove_stale_partitions(const char *mnt, const char *name)
+{
+    DIR *d = opendir(mnt);
+    struct dirent *e;
+    size_t n = strlen(name);
+    if (!d)
+        return;
+    while ((e = readdir(d)))
+    {
+        char *end;
+        if (strncmp(e->d_name, name, n) != 0 || e->d_name[n] != '.')
+            continue;
+        long pid = strtol(e->d_name + n + 1, &end, 10);
+        if (*end || pid <= 0 || kill((pid_t)pid, 0) == 0 || errno != ESRCH)
+            continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", mnt, e->d_name);
+        if (rmdir(path) == 0)
+            printf("[stress] 已清理遗留分区 %s\n", path);
+    }
+    closedir(d);
+}
+
+// 分区模式：叶子直接挂在根下 (分区的父级必须也是分区根)，cpuset.cpus 独占后设为 root 分区
+static int create_partition(FiStress *s, const char *mnt)
+{
+    char buf[512];
+    remove_stale_partitions(mnt, s->cfg.name);
+    snprintf(s->path, sizeof(s->path), "%s/%s.%d", mnt, s->cfg.name, getpid());
+    if (mkdir(s->path, 0755) < 0 && errno != EEXIST)
+    {
+        printf("[stress] 创建 %s 失败: %s\n", s->path, strerror(errno));
+        s->path[0] = 0;
+        return -1;
+    }
+    if (write_file(s->path, "cpuset.cpus", s->cfg.cpus) < 0)
+    {
+        printf("[stress] 写 cpuset.cpus=%s 失败: %s\n", s->cfg.cpus, strerror(errno));
+        goto fail;
+    }
+    write_file(s->path, "cpuset.cpus.exclusive", s->cfg.cpus); // 6.7 起才有，旧内核按 cpuset.cpus 独占
+    if (write_file(s->path, "cpuset.cpus.partition", "root") < 0)
+    {
+        printf("[stress] 写 cpuset.cpus.partition=root 失败: %s\n", strerror(errno));
+        goto fail;
+    }
+    // 写入总会成功，是否生效看读回的状态：CPU 被占用或取走了父级最后一个 CPU 时为 "root invalid (原因)"
+    if (read_file(s->path, "cpuset.cpus.partition", buf, sizeof(buf)) < 0 || strncmp(buf, "root", 4) != 0 ||
+        strstr(buf, "invalid"))
+    {
+        buf[strcspn(buf, "\n")] = 0;
+        printf("[stress] cpuset 分区未生效: %s\n", buf);
+        goto fail;
+    }
+    if (read_file(s->path, "cpuset.cpus.effective", buf, sizeof(buf)) == 0)
+    {
+        cpu_set_t set;
+        int n = parse_cpus(buf, &set);
+        if (n > 0)
+            s->ncpus = n;
+    }
+    fi_stress_set_cpu(s, 100);
+    printf("[stress] cpuset 分区 %s: CPU %s (%d 个)\n", s->path, s->cfg.cpus, s->ncpus);
+    return 0;
+
+fail:
+    remove_leaf(s->path);
+    s->path[0] = 0;
+    return -1;
+}
+
+int fi_stress_create(FiStress *s, const FiStressConfig *cfg)
+{
+    char mnt[256], parent[300], buf[512];
+    cpu_set_t set;
+
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        s->ncpus = CPU_COUNT(&set);
+    if (cfg->cpus[0])
+        s->ncpus = parse_cpus(cfg->cpus, &set);
+    if (s->ncpus <= 0)
+        s->ncpus = 1;
+
+    if (cfg->partition)
+    {
+        if (!cfg->cpus[0] || find_cgroup2(mnt, sizeof(mnt)) < 0 ||
+            read_file(mnt, "cgroup.controllers", buf, sizeof(buf)) < 0 || !has_word(buf, "cpuset"))
+        {
+            printf("[stress] 需要 cgroup v2 的 cpuset 控制器与 CPU 列表才能建立分区\n");
+            return -1;
+        }
+        enable_controllers(mnt);
+        return create_partition(s, mnt);
+    }
+
+    if (find_cgroup2(mnt, sizeof(mnt)) < 0)
+    {
+        printf("[stress] 未挂载 cgroup v2，回退为 nice 19 子进程 (无法限制 cpu.max/memory.max)\n");
+        return 0;
+    }
+    if (read_file(mnt, "cgroup.controllers", buf, sizeof(buf)) < 0 || !has_word(buf, "cpu"))
+    {
+        printf("[stress] %s 未提供 cpu 控制器 (混合模式?)，回退为 nice 19 子进程\n", mnt);
+        return 0;
+    }
+
+    // 叶子挂在根下的 fi_stress 目录，避免与本进程所在 cgroup 的"无内部进程"规则冲突
+    enable_controllers(mnt);
+    snprintf(parent, sizeof(parent), "%s/fi_stress", mnt);
+    if (mkdir(parent, 0755) < 0 && errno != EEXIST)
+    {
+        printf("[stress] 创建 %s 失败: %s，回退为 nice 19 子进程\n", parent, strerror(errno));
+        return 0;
+    }
+    enable_controllers(parent);
+    snprintf(s->path, sizeof(s->path), "%s/%s.%d", parent, cfg->name, getpid());
+    if (mkdir(s->path, 0755) < 0 && errno != EEXIST)
+    {
+        printf("[stress] 创建 %s 失败: %s，回退为 nice 19 子进程\n", s->path, strerror(errno));
+        s->path[0] = 0;
+        return 0;
+    }
+
+    if (cfg->cpus[0] && write_file(s->path, "cpuset.cpus", cfg->cpus) < 0)
+        printf("[stress] 写 cpuset.cpus=%s 失败: %s\n", cfg->cpus, strerror(errno));
+    if (read_file(s->path, "cpuset.cpus.effective", buf, sizeof(buf)) == 0 && parse_cpus(buf, &set) > 0)
+        s->ncpus = parse_cpus(buf, &set);
+
+    snprintf(buf, sizeof(buf), "%lld", (long long)cfg->mem_mb << 20);
+    if (write_file(s->path, "memory.max", buf) < 0)
+        printf("[stress] 写 memory.max 失败: %s\n", strerror(errno));
+    write_file(s->path, "memory.swap.max", "0");
+
+    // 没有 cpu.max 的叶子既不限额也不降优先级，会与 agent/sshd 争抢 CPU：放弃叶子，回退为 nice 19
+    if (fi_stress_set_cpu(s, cfg->cpu_pct) < 0)
+    {
+        printf("[stress] 写 cpu.max 失败: %s (父级未启用 cpu 控制器?)，回退为 nice 19 子进程\n", strerror(errno));
+        remove_leaf(s->path);
+        s->path[0] = 0;
+        return 0;
+    }
+
+    if (read_file(s->path, "cpuset.cpus.effective", buf, sizeof(buf)) < 0)
+        snprintf(buf, sizeof(buf), "(继承)");
+    buf[strcspn(buf, "\n")] = 0;
+    printf("[stress] cgroup 叶子 %s\n", s->path);
+    printf("[stress]   cpu.max %d%% x %d CPU = %.2f 核, cpuset.cpus %s, memory.max %ld MB\n",
+           s->cfg.cpu_pct, s->ncpus, s->cfg.cpu_pct * s->ncpus / 100.0, buf, cfg->mem_mb);
+    return 0;
+}
+
+pid_t fi_stress_fork(FiStress *s)
+{
+    int pfd[2];
+    char ok = 0;
+
+    if (pipe(pfd) < 0)
+        return -1;
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close(pfd[0]);
+        // 注入器异常退出时压力随之结束
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (s->path[0])
+            ok = write_file(s->path, "cgroup.procs", "0") == 0;
+        else
+        {
+            cpu_set_t set;
+            setpriority(PRIO_PROCESS, 0, 19);
+            if (s->cfg.cpus[0] && parse_cpus(s->cfg.cpus, &set) > 0)
+                sched_setaffinity(0, sizeof(set), &set);
+            ok = 1;
+        }
+        if (write(pfd[1], &ok, 1) < 0 || !ok)
+            _exit(127);
+        close(pfd[1]);
+        return 0;
+    }
+
+    close(pfd[1]);
+    if (read(pfd[0], &ok, 1) != 1 || !ok)
+    {
+        printf("[stress] 压力进程无法进入 %s\n", s->path);
+        waitpid(pid, NULL, 0);
+        close(pfd[0]);
+        return -1;
+    }
+    close(pfd[0]);
+    s->pid = pid;
+    return pid;
+}
+
+// === 3. 运行时控制与计量 ===
+
+int fi_stress_set_cpu(FiStress *s, int pct)
+{
+    char buf[64];
+    if (!s->path[0])
+    {
+        printf("[stress] 未启用 cgroup，无法调整强度\n");
+        return -1;
+    }
+    if (pct < 1)
+        pct = 1;
+    if (pct > 100)
+        pct = 100;
+    long long quota = (long long)pct * s->ncpus * CPU_PERIOD_US / 100;
+    if (quota < 1000)
+        quota = 1000;
+    snprintf(buf, sizeof(buf), "%lld %d", quota, CPU_PERIOD_US);
+    if (write_file(s->path, "cpu.max", buf) < 0)
+        return -1;
+    s->cfg.cpu_pct = pct;
+    return 0;
+}
+
+int fi_stress_pause(FiStress *s, int pause)
+{
+    // 无 cgroup.freeze (5.2 之前) 时退回 SIGSTOP/SIGCONT
+    if (!(s->path[0] && write_file(s->path, "cgroup.freeze", pause ? "1" : "0") == 0))
+    {
+        if (s->pid <= 0 || kill(s->pid, pause ? SIGSTOP : SIGCONT) < 0)
+            return -1;
+    }
+    s->paused = pause;
+    return 0;
+}
+
+int fi_stress_read(const FiStress *s, FiStressStat *st)
+{
+    char buf[1024];
+    memset(st, 0, sizeof(*st));
+
+    if (s->path[0])
+    {
+        if (read_file(s->path, "cpu.stat", buf, sizeof(buf)) < 0)
+            return -1;
+        st->usage_us = kv_get(buf, "usage_usec");
+        st->user_us = kv_get(buf, "user_usec");
+        st->system_us = kv_get(buf, "system_usec");
+        st->nr_periods = kv_get(buf, "nr_periods");
+        st->nr_throttled = kv_get(buf, "nr_throttled");
+        st->throttled_us = kv_get(buf, "throttled_usec");
+        if (read_file(s->path, "memory.current", buf, sizeof(buf)) == 0)
+            st->mem_bytes = strtoull(buf, NULL, 10);
+        if (read_file(s->path, "memory.events", buf, sizeof(buf)) == 0)
+            st->oom_kills = kv_get(buf, "oom_kill");
+        return 0;
+    }
+
+    // 回退：/proc/<pid>/stat 的 utime/stime (第 14、15 字段) 与 statm 常驻页
+    char dir[64];
+    if (s->pid <= 0)
+        return -1;
+    snprintf(dir, sizeof(dir), "/proc/%d", s->pid);
+    if (read_file(dir, "stat", buf, sizeof(buf)) < 0)
+        return -1;
+    char *p = strrchr(buf, ')');
+    unsigned long long ut = 0, stime = 0;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &ut, &stime) != 2)
+        return -1;
+    long hz = sysconf(_SC_CLK_TCK);
+    st->user_us = ut * 1000000ULL / hz;
+    st->system_us = stime * 1000000ULL / hz;
+    st->usage_us = st->user_us + st->system_us;
+    if (read_file(dir, "statm", buf, sizeof(buf)) == 0)
+        st->mem_bytes = strtoull(strchr(buf, ' ') ? strchr(buf, ' ') + 1 : buf, NULL, 10) * sysconf(_SC_PAGESIZE);
+    return 0;
+}
+
+static volatile sig_atomic_t wait_stop = 0;
+
+static void wait_signal(int sig)
+{
+    (void)sig;
+    wait_stop = 1;
+}
+
+static void handle_command(FiStress *s, char *line, int *stop)
+{
+    int pct;
+    line[strcspn(line, "\r\n")] = 0;
+    if (sscanf(line, "cpu %d", &pct) == 1)
+    {
+        if (fi_stress_set_cpu(s, pct) == 0)
+            printf("[stress] 强度 -> %d%% (%.2f 核)\n", s->cfg.cpu_pct, s->cfg.cpu_pct * s->ncpus / 100.0);
+    }
+    else if (strcmp(line, "pause") == 0)
+        printf(fi_stress_pause(s, 1) == 0 ? "[stress] 已暂停\n" : "[stress] 暂停失败\n");
+    else if (strcmp(line, "resume") == 0)
+        printf(fi_stress_pause(s, 0) == 0 ? "[stress] 已恢复\n" : "[stress] 恢复失败\n");
+    else if (strcmp(line, "stop") == 0)
+        *stop = 1;
+    else if (line[0])
+        printf("[stress] 未知命令: %s (cpu N / pause / resume / stop)\n", line);
+    fflush(stdout);
+}
+
+int fi_stress_wait(FiStress *s, int duration, int report)
+{
+    struct sigaction sa, old_int, old_term, old_hup;
+    FiStressStat st0, prev, cur;
+    char line[256];
+    size_t llen = 0;
+    int stdin_ok = 1, stop = 0, status = 0;
+    unsigned long long mem_peak = 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = wait_signal;
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    sigaction(SIGHUP, &sa, &old_hup);
+    wait_stop = 0;
+
+    fi_stress_read(s, &st0);
+    prev = st0;
+    long long start = mono_ms(), last = start, next = start + 1000;
+
+    while (!stop && !wait_stop)
+    {
+        int ws;
+        if (s->pid > 0 && waitpid(s->pid, &ws, WNOHANG) == s->pid)
+        {
+            status = WIFEXITED(ws) ? WEXITSTATUS(ws) : 128 + WTERMSIG(ws);
+            s->pid = 0;
+            break;
+        }
+        long long now = mono_ms();
+        if (duration > 0 && now - start >= duration * 1000LL)
+            break;
+
+        if (now >= next)
+        {
+            if (fi_stress_read(s, &cur) == 0)
+            {
+                double dt = (now - last) / 1000.0;
+                if (cur.mem_bytes > mem_peak)
+                    mem_peak = cur.mem_bytes;
+                if (report)
+                {
+                    printf("[stress] %4llds  %5.2f 核 (用户 %5.2f 系统 %5.2f)  内存 %7.1f MB",
+                           (now - start + 500) / 1000,
+                           (cur.usage_us - prev.usage_us) / 1e6 / dt,
+                           (cur.user_us - prev.user_us) / 1e6 / dt,
+                           (cur.system_us - prev.system_us) / 1e6 / dt,
+                           cur.mem_bytes / 1048576.0);
+                    if (s->path[0])
+                        printf("  限流 %llu/%llu 周期", cur.nr_throttled - prev.nr_throttled, cur.nr_periods - prev.nr_periods);
+                    printf("%s\n", s->paused ? "  [暂停]" : "");
+                }
+                fflush(stdout);
+                prev = cur;
+            }
+            last = now;
+            next += 1000;
+            continue;
+        }
+
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        int timeout = (int)(next - now);
+        if (timeout > 100)
+            timeout = 100; // 兼顾子进程退出检测
+        if (poll(&pfd, stdin_ok ? 1 : 0, timeout) > 0 && (pfd.revents & (POLLIN | POLLHUP)))
+        {
+            ssize_t n = read(STDIN_FILENO, line + llen, sizeof(line) - 1 - llen);
+            if (n <= 0)
+            {
+                stdin_ok = 0;
+                continue;
+            }
+            llen += n;
+            line[llen] = 0;
+            char *nl;
+            while ((nl = strchr(line, '\n')))
+            {
+                *nl = 0;
+                handle_command(s, line, &stop);
+                llen -= nl + 1 - line;
+                memmove(line, nl + 1, llen + 1);
+            }
+            if (llen == sizeof(line) - 1)
+                llen = 0;
+        }
+    }
+
+    if (fi_stress_read(s, &cur) < 0)
+        cur = prev;
+    if (cur.mem_bytes > mem_peak)
+        mem_peak = cur.mem_bytes;
+    double secs = (mono_ms() - start) / 1000.0;
+    if (secs > 0)
+    {
+        printf("[stress] 共消耗 CPU %.2f 秒 (平均 %.2f 核)，内存峰值 %.1f MB",
+               (cur.usage_us - st0.usage_us) / 1e6, (cur.usage_us - st0.usage_us) / 1e6 / secs, mem_peak / 1048576.0);
+        if (s->path[0])
+            printf("，上限 %.2f 核，限流 %llu 次共 %.2f 秒", s->cfg.cpu_pct * s->ncpus / 100.0,
+                   cur.nr_throttled - st0.nr_throttled, (cur.throttled_us - st0.throttled_us) / 1e6);
+        if (cur.oom_kills)
+            printf("，OOM 杀死 %llu 次", cur.oom_kills);
+        printf("\n");
+    }
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    sigaction(SIGHUP, &old_hup, NULL);
+    return status;
+}
+
+void fi_stress_destroy(FiStress *s)
+{
+    if (s->pid > 0)
+    {
+        if (s->paused)
+            fi_stress_pause(s, 0);
+        kill(s->pid, SIGTERM);
+        // 给 1 秒正常退出 (写结束标记等)，之后整组强杀
+        for (int i = 0; i < 100 && waitpid(s->pid, NULL, WNOHANG) == 0; i++)
+            usleep(10000);
+        if (kill(s->pid, 0) == 0)
+        {
+            if (!(s->path[0] && write_file(s->path, "cgroup.kill", "1") == 0))
+                kill(s->pid, SIGKILL);
+            waitpid(s->pid, NULL, 0);
+        }
+        s->pid = 0;
+    }
+    if (s->path[0])
+    {
+        // 任务完全退出后叶子才可删除
+        remove_leaf(s->path);
+        s->path[0] = 0;
+    }
+}
+
+// === 4. CPU 压力 ===
+
+static void *spin_worker(void *arg)
+{
+    volatile double x = 0.0;
+    (void)arg;
+    for (;;)
+    {
+        x = x + 0.1;
+        if (x > 1000000)
+            x = 0;
+    }
+    return NULL;
+}
+
+int fi_stress_cpu(const FiStressConfig *cfg, int duration)
+{
+    FiStress s;
+    if (fi_stress_create(&s, cfg) < 0)
+        return -1;
+    int threads = cfg->threads > 0 ? cfg->threads : s.ncpus;
+
+    printf("[stress] %d 个忙循环线程，持续 %d 秒 (标准输入: cpu N / pause / resume / stop)\n", threads, duration);
+    pid_t pid = fi_stress_fork(&s);
+    if (pid < 0)
+    {
+        fi_stress_destroy(&s);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        for (int i = 0; i < threads; i++)
+        {
+            pthread_t th;
+            pthread_create(&th, NULL, spin_worker, NULL);
+        }
+        for (;;)
+            pause();
+    }
+
+    fi_stress_wait(&s, duration, 1);
+    fi_stress_destroy(&s);
+    return 0;
+}
+
+// === 5. 目标内存压力 ===
+
+typedef struct
+{
+    char mnt[256];
+    char path[512]; // 施压的 cgroup
+    int moved;      // 1=目标迁入新叶子，0=就地使用目标独占的 cgroup
+    pid_t pids[FI_MEMPRESS_MAX_PIDS];
+    char orig[FI_MEMPRESS_MAX_PIDS][256]; // 目标原 cgroup (相对挂载点)
+    int npids;
+    char orig_high[32];
+} MemPress;
+
+void fi_mempress_defaults(FiMemPressConfig *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->stall_pct = 20;
+    cfg->step_pct = 5;
+    cfg->interval_ms = 1000;
+    cfg->floor_mb = 32;
+}
+
+// /proc/<pid>/cgroup 中 "0::/path" 一行
+static int pid_cgroup(pid_t pid, char *out, size_t len)
+{
+    char dir[64], buf[4096];
+    snprintf(dir, sizeof(dir), "/proc/%d", pid);
+    if (read_file(dir, "cgroup", buf, sizeof(buf)) < 0)
+        return -1;
+    for (char *p = buf; p; p = strchr(p, '\n'), p = p ? p + 1 : NULL)
+    {
+        if (strncmp(p, "0::", 3) == 0)
+        {
+            size_t n = strcspn(p + 3, "\n");
+            snprintf(out, len, "%.*s", (int)n, p + 3);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static long long pid_rss(pid_t pid)
+{
+    char dir[64], buf[256];
+    unsigned long long size, rss;
+    snprintf(dir, sizeof(dir), "/proc/%d", pid);
+    if (read_file(dir, "statm", buf, sizeof(buf)) < 0 || sscanf(buf, "%llu %llu", &size, &rss) != 2)
+        return 0;
+    return (long long)rss * sysconf(_SC_PAGESIZE);
+}
+
+static pid_t pid_ppid(pid_t pid)
+{
+    char dir[64], buf[512];
+    int ppid;
+    snprintf(dir, sizeof(dir), "/proc/%d", pid);
+    if (read_file(dir, "stat", buf, sizeof(buf)) < 0)
+        return 0;
+    char *p = strrchr(buf, ')');
+    return p && sscanf(p + 1, " %*c %d", &ppid) == 1 ? ppid : 0;
+}
+
+// pid 是否为某个目标本身、目标的祖先或后代 (沿 ppid 链比较)
+static int pid_related(pid_t pid, const pid_t *pids, int n)
+{
+    for (pid_t p = pid; p > 1; p = pid_ppid(p))
+        for (int i = 0; i < n; i++)
+            if (pids[i] == p)
+                return 1;
+    for (int i = 0; i < n; i++)
+        for (pid_t p = pid_ppid(pids[i]); p > 1; p = pid_ppid(p))
+            if (p == pid)
+                return 1;
+    return 0;
+}
+
+// cgroup.procs 中的进程是否都与目标相关：YARN 容器里除 YarnChild 外还有启动它的 bash
+static int procs_subset(const char *procs, const pid_t *pids, int n)
+{
+    for (const char *p = procs; *p;)
+    {
+        pid_t pid = atoi(p);
+        if (!pid_related(pid, pids, n))
+            return 0;
+        p += strcspn(p, "\n");
+        if (*p)
+            p++;
+    }
+    return 1;
+}
+
+static void mempress_restore(MemPress *m, int count)
+{
+    char dir[600], buf[32];
+    if (!m->moved)
+    {
+        write_file(m->path, "memory.high", m->orig_high);
+        return;
+    }
+    write_file(m->path, "memory.high", "max");
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(dir, sizeof(dir), "%s%s", m->mnt, m->orig[i]);
+        snprintf(buf, sizeof(buf), "%d", m->pids[i]);
+        write_file(dir, "cgroup.procs", buf); // 目标已退出时忽略
+    }
+    remove_leaf(m->path);
+}
+
+static int mempress_attach(MemPress *m, const pid_t *pids, int n, const char *name)
+{
+    char buf[8192], parent[300];
+
+    if (find_cgroup2(m->mnt, sizeof(m->mnt)) < 0 || read_file(m->mnt, "cgroup.controllers", buf, sizeof(buf)) < 0 ||
+        !has_word(buf, "memory"))
+    {
+        printf("[mempress] 需要提供 memory 控制器的 cgroup v2 (混合模式不支持)\n");
+        return -1;
+    }
+    if (n > FI_MEMPRESS_MAX_PIDS)
+        n = FI_MEMPRESS_MAX_PIDS;
+    for (int i = 0; i < n; i++)
+    {
+        m->pids[i] = pids[i];
+        if (pid_cgroup(pids[i], m->orig[i], sizeof(m->orig[i])) < 0)
+        {
+            printf("[mempress] 无法读取进程 %d 的 cgroup\n", pids[i]);
+            return -1;
+        }
+    }
+    m->npids = n;
+
+    // 目标独占一个 cgroup (libvirt 的 machine-qemu-*.scope、启用 cgroup 的 YARN 容器) 时就地施压：
+    // v2 的内存计费不随进程迁移，只有原 cgroup 才覆盖目标已有的页面
+    int same = 1;
+    for (int i = 1; i < n; i++)
+        same = same && strcmp(m->orig[i], m->orig[0]) == 0;
+    if (same && strcmp(m->orig[0], "/") != 0)
+    {
+        snprintf(m->path, sizeof(m->path), "%s%s", m->mnt, m->orig[0]);
+        if (read_file(m->path, "cgroup.procs", buf, sizeof(buf)) == 0 && procs_subset(buf, pids, n) &&
+            read_file(m->path, "memory.high", m->orig_high, sizeof(m->orig_high)) == 0)
+        {
+            m->orig_high[strcspn(m->orig_high, "\n")] = 0;
+            printf("[mempress] 目标独占 %s，就地调节 memory.high (原值 %s)\n", m->path, m->orig_high);
+            return 0;
+        }
+    }
+
+    enable_controllers(m->mnt);
+    snprintf(parent, sizeof(parent), "%s/fi_stress", m->mnt);
+    if (mkdir(parent, 0755) < 0 && errno != EEXIST)
+    {
+        printf("[mempress] 创建 %s 失败: %s\n", parent, strerror(errno));
+        return -1;
+    }
+    enable_controllers(parent);
+    snprintf(m->path, sizeof(m->path), "%s/%s.%d", parent, name, getpid());
+    if (mkdir(m->path, 0755) < 0 && errno != EEXIST)
+    {
+        printf("[mempress] 创建 %s 失败: %s\n", m->path, strerror(errno));
+        return -1;
+    }
+    m->moved = 1;
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(buf, sizeof(buf), "%d", pids[i]);
+        if (write_file(m->path, "cgroup.procs", buf) < 0)
+        {
+            printf("[mempress] 迁移进程 %d 失败: %s\n", pids[i], strerror(errno));
+            mempress_restore(m, i);
+            return -1;
+        }
+    }
+    printf("[mempress] %d 个目标进程迁入 %s\n", n, m->path);
+    printf("[mempress]   原 cgroup 中已计费的页面不随迁移，目标重新缺页后才受 memory.high 约束\n");
+    return 0;
+}
+
+// memory.pressure 中 some/full 行的 total (微秒)
+static int psi_total(const char *path, int full, unsigned long long *total)
+{
+    char buf[512];
+    if (read_file(path, "memory.pressure", buf, sizeof(buf)) < 0)
+        return -1;
+    char *p = strstr(buf, full ? "full " : "some ");
+    if (!p || !(p = strstr(p, "total=")))
+        return -1;
+    *total = strtoull(p + 6, NULL, 10);
+    return 0;
+}
+
+static void memcg_counters(const char *path, unsigned long long *majflt, unsigned long long *refault)
+{
+    char buf[8192];
+    *majflt = *refault = 0;
+    if (read_file(path, "memory.stat", buf, sizeof(buf)) < 0)
+        return;
+    *majflt = kv_get(buf, "pgmajfault");
+    // 5.9 起分为 anon/file 两项
+    *refault = kv_get(buf, "workingset_refault") + kv_get(buf, "workingset_refault_anon") +
+               kv_get(buf, "workingset_refault_file");
+}
+
+int fi_mempress(const pid_t *pids, int n, const FiMemPressConfig *cfg, int duration, const char *name)
+{
+    struct sigaction sa, old_int, old_term, old_hup;
+    char buf[64];
+    unsigned long long psi0, psi, maj0, maj, ref0, ref, maj_start;
+    MemPress *m = calloc(1, sizeof(*m));
+
+    if (!m || n <= 0)
+    {
+        free(m);
+        return -1;
+    }
+    if (mempress_attach(m, pids, n, name ? name : "mempress") < 0)
+    {
+        free(m);
+        return -1;
+    }
+    if (psi_total(m->path, cfg->full, &psi0) < 0)
+    {
+        printf("[mempress] 读取 %s/memory.pressure 失败 (内核需 CONFIG_PSI 且未以 psi=0 启动)\n", m->path);
+        mempress_restore(m, m->npids);
+        free(m);
+        return -1;
+    }
+
+    // 起点取施压 cgroup 的实际用量：迁移模式下新叶子只计入迁入后新缺页的页面，memory.current 接近 0，
+    // 从目标 RSS 开始下调的那些周期都不起作用；另留 floor 的余量，回退上限取目标 RSS 之和
+    long long high = 0, floor = (long long)cfg->floor_mb << 20, ceiling = 0;
+    if (read_file(m->path, "memory.current", buf, sizeof(buf)) == 0)
+        high = strtoll(buf, NULL, 10);
+    if (m->moved)
+    {
+        high += floor;
+        for (int i = 0; i < m->npids; i++)
+            ceiling += pid_rss(m->pids[i]);
+    }
+    if (high < floor)
+        high = floor;
+    if (ceiling < high)
+        ceiling = high;
+    long long initial = high;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = wait_signal;
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    sigaction(SIGHUP, &sa, &old_hup);
+    wait_stop = 0;
+
+    printf("[mempress] 初始 memory.high %.1f MB，目标 %s stall %.1f%%，每 %d ms 调整 %d%%，下限 %ld MB，持续 %d 秒\n",
+           initial / 1048576.0, cfg->full ? "full" : "some", cfg->stall_pct, cfg->interval_ms, cfg->step_pct,
+           cfg->floor_mb, duration);
+    snprintf(buf, sizeof(buf), "%lld", high);
+    write_file(m->path, "memory.high", buf);
+
+    memcg_counters(m->path, &maj0, &ref0);
+    maj_start = maj0;
+    long long start = mono_ms(), last = start;
+    double reached = -1, hold_sum = 0;
+    int hold_n = 0, floor_warned = 0;
+    double lo = cfg->stall_pct * 0.9, hi = cfg->stall_pct * 1.1 + 0.5;
+
+    while (!wait_stop && (duration <= 0 || mono_ms() - start < duration * 1000LL))
+    {
+        usleep(cfg->interval_ms * 1000);
+        long long now = mono_ms();
+        double dt = (now - last) / 1000.0, t = (now - start) / 1000.0;
+        if (psi_total(m->path, cfg->full, &psi) < 0 || dt <= 0)
+            break;
+        memcg_counters(m->path, &maj, &ref);
+        double stall = (psi - psi0) / 1e4 / dt; // 微秒 -> 百分比
+        long long cur = read_file(m->path, "memory.current", buf, sizeof(buf)) == 0 ? strtoll(buf, NULL, 10) : 0;
+
+        printf("[mempress] %5.1fs  high %8.1f MB  当前 %8.1f MB  stall %5.1f%%  主缺页 %7.0f/s  refault %8.0f/s\n",
+               t, high / 1048576.0, cur / 1048576.0, stall, (maj - maj0) / dt, (ref - ref0) / dt);
+        fflush(stdout);
+
+        if (reached >= 0)
+        {
+            hold_sum += stall;
+            hold_n++;
+        }
+        if (stall < lo)
+        {
+            long long step = high * cfg->step_pct / 100;
+            if (step < (1LL << 20))
+                step = 1LL << 20;
+            high = high - step < floor ? floor : high - step;
+            if (high == floor && !floor_warned)
+            {
+                printf("[mempress] memory.high 已到下限 %ld MB\n", cfg->floor_mb);
+                floor_warned = 1;
+            }
+        }
+        else if (stall > hi)
+        {
+            // 超调时回退半步
+            high += high * cfg->step_pct / 200 + (1LL << 20);
+            if (high > ceiling)
+                high = ceiling;
+        }
+        else if (reached < 0)
+        {
+            reached = t;
+            printf("[mempress] %.1f 秒后达到目标，memory.high 保持在 %.1f MB 附近\n", t, high / 1048576.0);
+        }
+        snprintf(buf, sizeof(buf), "%lld", high);
+        write_file(m->path, "memory.high", buf);
+
+        psi0 = psi;
+        maj0 = maj;
+        ref0 = ref;
+        last = now;
+    }
+
+    printf("[mempress] memory.high %.1f -> %.1f MB，", initial / 1048576.0, high / 1048576.0);
+    if (reached >= 0)
+        printf("%.1f 秒达到目标，之后平均 stall %.1f%%", reached, hold_n ? hold_sum / hold_n : 0);
+    else
+        printf("未达到目标 stall");
+    printf("，主缺页共 %llu 次\n", maj0 - maj_start);
+
+    mempress_restore(m, m->npids);
+    printf("[mempress] 已恢复 %s\n", m->moved ? "目标原 cgroup" : "原 memory.high");
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    sigaction(SIGHUP, &old_hup, NULL);
+    free(m);
+    return 0;
+}
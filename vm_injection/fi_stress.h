@@ -0,0 +1,94 @@
+/*
+ * fi_stress.h - cgroup v2 受限压力引擎
+ * 功能：在 <cgroup2 挂载点>/fi_stress/<名称>.<pid> 叶子中运行压力子进程，
+ *       由 cpu.max / cpuset.cpus / memory.max 明确限定其可用的 CPU 与内存，
+ *       注入器、节点 agent、sshd 始终留有余量；运行中可调整强度 (cpu.max)、
+ *       暂停/恢复 (cgroup.freeze)、停止 (cgroup.kill)，消耗量直接取自 cpu.stat。
+ *       cgroup v2 不可用或写不进 cpu.max 时回退为 nice 19 的普通子进程 (无法限额，只能暂停/停止)。
+ *       为此会在根 cgroup 的 subtree_control 中启用 cpu/cpuset/memory (结束后不回退)；
+ *       叶子在结束时删除，fi_stress/ 父目录在最后一个叶子删除后一并删除。
+ *       分区模式：叶子直接挂在根下并设为 cpuset 分区，供 SCHED_DEADLINE 线程绑在少数 CPU 上而不必
+ *       关闭整机的 sched_rt_runtime_us；注入器被强杀留下的空分区在下次建立时清理。
+ *       目标内存压力：把目标进程置于 cgroup 中逐步压低 memory.high，按该 cgroup 的
+ *       memory.pressure (PSI) 反馈调节，直到达到要求的 stall 百分比并保持，回收压力只落在目标上。
+ */
+
+#ifndef FI_STRESS_H
+#define FI_STRESS_H
+
+#include <sys/types.h>
+
+typedef struct
+{
+    char name[32];  // 叶子名前缀
+    int threads;    // 压力线程数 (fi_stress_cpu 使用)，<=0 为可用 CPU 数
+    int cpu_pct;    // cpu.max：占叶子可用 CPU 总量的百分比
+    char cpus[128]; // cpuset.cpus，空为继承
+    long mem_mb;    // memory.max (MB)
+    int partition;  // 1: 叶子直接建在 cgroup2 根下并设为独立 cpuset 分区 (cpuset.cpus.partition=root)，
+                    //    SCHED_DEADLINE 准入控制只在该分区的根域内计算；要求 cpus 非空
+} FiStressConfig;
+
+typedef struct
+{
+    FiStressConfig cfg;
+    char path[384]; // 叶子目录，空表示未启用 cgroup
+    int ncpus;      // 叶子可用 CPU 数
+    pid_t pid;      // 压力子进程
+    int paused;
+} FiStress;
+
+typedef struct
+{
+    unsigned long long usage_us, user_us, system_us;
+    unsigned long long nr_periods, nr_throttled, throttled_us;
+    unsigned long long mem_bytes;
+    unsigned long long oom_kills;
+} FiStressStat;
+
+// 默认值：cpu=90%、继承 cpuset、memory.max=物理内存 1/4
+void fi_stress_defaults(FiStressConfig *cfg, const char *name);
+
+// 解析 "cpu=50,cpus=2-3,mem=256,threads=4"，未出现的键保持原值
+int fi_stress_parse(FiStressConfig *cfg, const char *spec);
+
+// 建立叶子并写入限额；cgroup 不可用时返回 0 且 path 为空。
+// partition 模式不回退：建不成分区时返回 -1 且 path 为空
+int fi_stress_create(FiStress *s, const FiStressConfig *cfg);
+
+// 与 fork 相同：子进程进入叶子后返回 0，父进程返回子进程 pid，失败 -1
+pid_t fi_stress_fork(FiStress *s);
+
+// 运行时控制
+int fi_stress_set_cpu(FiStress *s, int pct);
+int fi_stress_pause(FiStress *s, int pause);
+int fi_stress_read(const FiStress *s, FiStressStat *st);
+
+// 等待 duration 秒 (<=0 为直到子进程退出)，期间从标准输入接收
+// "cpu N" / "pause" / "resume" / "stop"；report 为真时逐秒打印消耗。返回子进程退出码
+int fi_stress_wait(FiStress *s, int duration, int report);
+
+// 停止子进程并删除叶子
+void fi_stress_destroy(FiStress *s);
+
+// 一站式 CPU 压力：建叶子、cfg->threads 个忙循环线程、等待 duration 秒、清理
+int fi_stress_cpu(const FiStressConfig *cfg, int duration);
+
+#define FI_MEMPRESS_MAX_PIDS 256
+
+typedef struct
+{
+    double stall_pct; // 目标 stall 百分比 (每秒内有任务因内存停顿的时间占比)
+    int full;         // 1 按 full 行 (全部任务停顿)，0 按 some 行
+    int step_pct;     // 每步把 memory.high 降低的比例
+    int interval_ms;  // 调节周期
+    long floor_mb;    // memory.high 下限
+} FiMemPressConfig;
+
+// 默认值：some 20%、每步 5%、1 秒、下限 32MB
+void fi_mempress_defaults(FiMemPressConfig *cfg);
+
+// 对 pids 施加内存回收压力 duration 秒，结束或收到 SIGINT/SIGTERM 后恢复；失败返回 -1
+int fi_mempress(const pid_t *pids, int n, const FiMemPressConfig *cfg, int duration, const char *name);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * fi_sys.c - 系统调用层公共设施实现
+ */
+
+#define _GNU_SOURCE
+#include "fi_sys.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#if defined(__x86_64__)
+#define FI_AUDIT_ARCH AUDIT_ARCH_X86_64
+#else
+#define FI_AUDIT_ARCH AUDIT_ARCH_AARCH64
+#endif
+
+#ifndef NT_ARM_SYSTEM_CALL
+#define NT_ARM_SYSTEM_CALL 0x404
+#endif
+
+int fi_get_regs(pid_t pid, fi_regs_t *regs)
+{
+    struct iovec iov = {regs, sizeof(*regs)};
+    return (int)ptrace(PTRACE_GETREGSET, pid, NT_PRSTATUS, &iov);
+}
+
+int fi_set_regs(pid_t pid, const fi_regs_t *regs)
+{
+    struct iovec iov = {(void *)regs, sizeof(*regs)};
+    return (int)ptrace(PTRACE_SETREGSET, pid, NT_PRSTATUS, &iov);
+}
+
+uint64_t *fi_sys_arg(fi_regs_t *regs, int idx)
+{
+#if defined(__x86_64__)
+    switch (idx)
+    {
+    case 0:
+        return &regs->rdi;
+    case 1:
+        return &regs->rsi;
+    case 2:
+        return &regs->rdx;
+    case 3:
+        return &regs->r10;
+    case 4:
+        return &regs->r8;
+    case 5:
+        return &regs->r9;
+    }
+    return NULL;
+#else
+    if (idx < 0 || idx > 5)
+        return NULL;
+    return &regs->regs[idx];
+#endif
+}
+
+long fi_get_sysno(pid_t pid, const fi_regs_t *regs)
+{
+#if defined(__x86_64__)
+    (void)pid;
+    return (long)regs->orig_rax;
+#else
+    int sysno = -1;
+    struct iovec iov = {&sysno, sizeof(sysno)};
+    (void)regs;
+    if (ptrace(PTRACE_GETREGSET, pid, NT_ARM_SYSTEM_CALL, &iov) < 0)
+        return -1;
+    return sysno;
+#endif
+}
+
+int fi_set_sysno(pid_t pid, fi_regs_t *regs, long nr)
+{
+#if defined(__x86_64__)
+    (void)pid;
+    regs->orig_rax = (uint64_t)nr;
+    return 0;
+#else
+    int sysno = (int)nr;
+    struct iovec iov = {&sysno, sizeof(sysno)};
+    regs->regs[8] = (uint64_t)nr;
+    return (int)ptrace(PTRACE_SETREGSET, pid, NT_ARM_SYSTEM_CALL, &iov);
+#endif
+}
+
+// === 常用系统调用名称表 (按本机架构的 SYS_* 编译) ===
+#define FI_SYS(name) {#name, SYS_##name}
+
+static const struct
+{
+    const char *name;
+    long nr;
+} sys_table[] = {
+    FI_SYS(read),
+    FI_SYS(write),
+    FI_SYS(pread64),
+    FI_SYS(pwrite64),
+    FI_SYS(readv),
+    FI_SYS(writev),
+    FI_SYS(openat),
+    FI_SYS(close),
+    FI_SYS(lseek),
+    FI_SYS(fsync),
+    FI_SYS(fdatasync),
+    FI_SYS(ftruncate),
+    FI_SYS(fstat),
+    FI_SYS(newfstatat),
+    FI_SYS(ioctl),
+    FI_SYS(mmap),
+    FI_SYS(munmap),
+    FI_SYS(mprotect),
+    FI_SYS(madvise),
+    FI_SYS(brk),
+    FI_SYS(socket),
+    FI_SYS(connect),
+    FI_SYS(accept),
+    FI_SYS(accept4),
+    FI_SYS(bind),
+    FI_SYS(listen),
+    FI_SYS(sendto),
+    FI_SYS(recvfrom),
+    FI_SYS(sendmsg),
+    FI_SYS(recvmsg),
+    FI_SYS(setsockopt),
+    FI_SYS(getsockopt),
+    FI_SYS(shutdown),
+    FI_SYS(ppoll),
+    FI_SYS(pselect6),
+    FI_SYS(epoll_pwait),
+    FI_SYS(futex),
+    FI_SYS(nanosleep),
+    FI_SYS(clock_nanosleep),
+    FI_SYS(clock_gettime),
+    FI_SYS(getrandom),
+    FI_SYS(dup),
+    FI_SYS(dup3),
+    FI_SYS(fcntl),
+    FI_SYS(clone),
+    FI_SYS(execve),
+    FI_SYS(exit_group),
+    FI_SYS(kill),
+    FI_SYS(unlinkat),
+    FI_SYS(renameat),
+    FI_SYS(mkdirat),
+#ifdef SYS_open
+    FI_SYS(open),
+#endif
+#ifdef SYS_stat
+    FI_SYS(stat),
+#endif
+#ifdef SYS_poll
+    FI_SYS(poll),
+#endif
+#ifdef SYS_select
+    FI_SYS(select),
+#endif
+#ifdef SYS_epoll_wait
+    FI_SYS(epoll_wait),
+#endif
+#ifdef SYS_fork
+    FI_SYS(fork),
+#endif
+#ifdef SYS_dup2
+    FI_SYS(dup2),
+#endif
+#ifdef SYS_unlink
+    FI_SYS(unlink),
+#endif
+#ifdef SYS_rename
+    FI_SYS(rename),
+#endif
+};
+
+#define SYS_TABLE_LEN (sizeof(sys_table) / sizeof(sys_table[0]))
+
+long fi_sys_lookup(const char *name)
+{
+    char *end;
+    long nr = strtol(name, &end, 10);
+    if (*name && *end == '\0')
+        return nr;
+
+    for (size_t i = 0; i < SYS_TABLE_LEN; i++)
+    {
+        if (strcmp(sys_table[i].name, name) == 0)
+            return sys_table[i].nr;
+    }
+    return -1;
+}
+
+const char *fi_sys_name(long nr)
+{
+    for (size_t i = 0; i < SYS_TABLE_LEN; i++)
+    {
+        if (sys_table[i].nr == nr)
+            return sys_table[i].name;
+    }
+    return "?";
+}
+
+int fi_sys_parse_list(const char *spec, int *nrs, int max)
+{
+    char buf[512];
+    int n = 0;
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        long nr = fi_sys_lookup(tok);
+        if (nr < 0)
+        {
+            fprintf(stderr, "[-] 未知系统调用: %s\n", tok);
+            return -1;
+        }
+        if (n >= max)
+        {
+            fprintf(stderr, "[-] 系统调用过多 (最多 %d 个)\n", max);
+            return -1;
+        }
+        nrs[n++] = (int)nr;
+    }
+    return n;
+}
+
+int fi_errno_lookup(const char *name)
+{
+    static const struct
+    {
+        const char *name;
+        int val;
+    } errs[] = {
+        {"EPERM", EPERM}, {"ENOENT", ENOENT}, {"EINTR", EINTR}, {"EIO", EIO},
+        {"EBADF", EBADF}, {"EAGAIN", EAGAIN}, {"ENOMEM", ENOMEM}, {"EACCES", EACCES},
+        {"EFAULT", EFAULT}, {"EBUSY", EBUSY}, {"EEXIST", EEXIST}, {"EINVAL", EINVAL},
+        {"ENFILE", ENFILE}, {"EMFILE", EMFILE}, {"EFBIG", EFBIG}, {"ENOSPC", ENOSPC},
+        {"EROFS", EROFS}, {"EPIPE", EPIPE}, {"ENOSYS", ENOSYS}, {"ETIMEDOUT", ETIMEDOUT},
+        {"ECONNREFUSED", ECONNREFUSED}, {"ECONNRESET", ECONNRESET}, {"ECONNABORTED", ECONNABORTED}, {"ENETUNREACH", ENETUNREACH},
+        {"EHOSTUNREACH", EHOSTUNREACH}, {"ENOBUFS", ENOBUFS}, {"EDQUOT", EDQUOT},
+    };
+
+    char *end;
+    long v = strtol(name, &end, 10);
+    if (*name && *end == '\0')
+        return (v > 0 && v < 4096) ? (int)v : -1;
+
+    for (size_t i = 0; i < sizeof(errs) / sizeof(errs[0]); i++)
+    {
+        if (strcasecmp(errs[i].name, name) == 0)
+            return errs[i].val;
+    }
+    return -1;
+}
+
+int fi_seccomp_install(const int *nrs, int n, uint32_t action, unsigned int flags)
+{
+    if (n <= 0 || n > FI_SYS_MAX_FILTER)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // 布局: 校验架构 -> 取调用号 -> 逐个比较 -> 默认放行
+    struct sock_filter filter[FI_SYS_MAX_FILTER + 8];
+    int k = 0;
+    filter[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+    filter[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, FI_AUDIT_ARCH, 1, 0);
+    filter[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    filter[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+    for (int i = 0; i < n; i++)
+    {
+        // 命中跳到最后一条 (返回 action)，否则继续比较
+        int jt = n - i;
+        filter[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)nrs[i], jt, 0);
+    }
+    filter[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    filter[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, action);
+
+    struct sock_fprog prog = {(unsigned short)k, filter};
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0)
+        return -1;
+    return (int)syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, flags, &prog);
+}
@@ -0,0 +1,70 @@
+/*
+ * fi_sys.h - 系统调用层公共设施
+ * 功能：跨架构 (x86_64 / ARM64) 的系统调用寄存器访问、系统调用名称表、
+ *       errno 名称解析，以及只拦截指定系统调用的 seccomp 过滤器安装。
+ */
+
+#ifndef FI_SYS_H
+#define FI_SYS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// === 架构相关寄存器布局 (与 PTRACE_GETREGSET/NT_PRSTATUS 一致) ===
+#if defined(__x86_64__)
+typedef struct
+{
+    uint64_t r15, r14, r13, r12, rbp, rbx, r11, r10, r9, r8;
+    uint64_t rax, rcx, rdx, rsi, rdi, orig_rax, rip, cs, eflags, rsp, ss;
+    uint64_t fs_base, gs_base, ds, es, fs, gs;
+} fi_regs_t;
+#define FI_REG_PC(r) ((r)->rip)
+#define FI_REG_SP(r) ((r)->rsp)
+#define FI_REG_RET(r) ((r)->rax)
+#define FI_REG_SYSNO(r) ((r)->orig_rax)
+#elif defined(__aarch64__)
+typedef struct
+{
+    uint64_t regs[31];
+    uint64_t sp;
+    uint64_t pc;
+    uint64_t pstate;
+} fi_regs_t;
+#define FI_REG_PC(r) ((r)->pc)
+#define FI_REG_SP(r) ((r)->sp)
+#define FI_REG_RET(r) ((r)->regs[0])
+#define FI_REG_SYSNO(r) ((r)->regs[8])
+#else
+#error "fi_sys: 仅支持 x86_64 与 ARM64"
+#endif
+
+#define FI_SYS_MAX_FILTER 64
+
+int fi_get_regs(pid_t pid, fi_regs_t *regs);
+int fi_set_regs(pid_t pid, const fi_regs_t *regs);
+
+// 第 idx 个系统调用参数 (0-5) 的寄存器指针
+uint64_t *fi_sys_arg(fi_regs_t *regs, int idx);
+
+// 读取当前被跟踪线程的系统调用号 (未处于系统调用中为 -1)
+long fi_get_sysno(pid_t pid, const fi_regs_t *regs);
+
+// 修改当前 (seccomp/syscall-entry 停止时) 的系统调用号，-1 表示跳过该调用
+// x86_64 通过 orig_rax (需随后 fi_set_regs)，ARM64 通过 NT_ARM_SYSTEM_CALL 立即生效
+int fi_set_sysno(pid_t pid, fi_regs_t *regs, long nr);
+
+// 名称 <-> 系统调用号 (也接受纯数字)
+long fi_sys_lookup(const char *name);
+const char *fi_sys_name(long nr);
+
+// 解析 "read,fsync,42" 形式的列表，返回个数，失败返回 -1
+int fi_sys_parse_list(const char *spec, int *nrs, int max);
+
+// errno 名称 ("EIO" / "5") -> 数值，失败返回 -1
+int fi_errno_lookup(const char *name);
+
+// 在当前进程安装过滤器：nrs 中的系统调用返回 action，其余 SECCOMP_RET_ALLOW
+// flags 透传给 seccomp(2)，带 SECCOMP_FILTER_FLAG_NEW_LISTENER 时返回通知 fd
+int fi_seccomp_install(const int *nrs, int n, uint32_t action, unsigned int flags);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * fi_target.h - 靶子侧 fork-server 支持 (AFL 风格)
+ * 功能：靶子完成初始化/预热后调用 fi_target_checkpoint() 停在检查点；
+ *       注入端每请求一次试验，检查点 fork 出一个写时复制的子进程执行一轮有界工作，
+ *       子进程用 fi_target_finish() 上报结果摘要与是否自检出错误。
+ *       未设置 FI_FORKSRV 环境变量时检查点直接返回，靶子照常运行。
+ *       工作循环中调用 fi_target_heartbeat()，注入端据此区分 "慢" 与 "挂死"。
+ *       闸门模式下子进程 fork 后先阻塞在闸门上，注入端接管后才放行，供逐条指令跟踪与断点计数。
+ */
+
+#ifndef FI_TARGET_H
+#define FI_TARGET_H
+
+#include <stdint.h>
+
+// 环境变量 "控制fd,状态fd"，由注入端设置
+#define FI_FORKSRV_ENV "FI_FORKSRV"
+#define FI_FORKSRV_CTL_FD 198
+#define FI_FORKSRV_ST_FD 199
+#define FI_FORKSRV_MAGIC 0x46495352U // "FISR"
+
+// 心跳：注入端创建的共享内存 fd (首 8 字节为计数，其后 4 字节为闸门，
+// 再后 8 字节为靶子侧闸门地址，供注入端核对 futex 参数)，靶子在工作循环中递增
+#define FI_HEARTBEAT_ENV "FI_HEARTBEAT"
+#define FI_HEARTBEAT_FD 197
+
+// 试验子进程的退出码约定
+#define FI_EXIT_OK 0
+#define FI_EXIT_DETECTED 1
+
+// 协议：
+//   server -> 注入端: MAGIC (u32)，随后每轮 pid (i32) + FiTrialReply
+//   注入端 -> server: 命令 (u32) 请求一次试验，关闭管道则 server 退出
+//     FI_FORKSRV_CMD_GATED: 子进程阻塞在闸门上 (futex 等待闸门字非 0)，其余值立即运行
+#define FI_FORKSRV_CMD_TRIAL 1
+#define FI_FORKSRV_CMD_GATED 2
+typedef struct
+{
+    int32_t status;      // waitpid 状态
+    uint32_t has_digest; // 子进程是否调用了 fi_target_finish
+    uint64_t digest;     // 结果摘要
+} FiTrialReply;
+
+// 检查点：普通运行返回 0；fork-server 模式下只在试验子进程中返回 1
+int fi_target_checkpoint(void);
+
+// 当前是否为试验子进程
+int fi_target_trial(void);
+
+// 递增心跳计数，表明仍在推进；未设置 FI_HEARTBEAT 时为空操作
+void fi_target_heartbeat(void);
+
+// 结束本轮试验：记录摘要并以 FI_EXIT_OK / FI_EXIT_DETECTED 退出
+void fi_target_finish(uint64_t digest, int detected) __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * fi_topo.c - CPU 拓扑与目标线程放置
+ */
+
+#define _GNU_SOURCE
+#include "fi_topo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+
+static const char *place_names[FI_PLACE_COUNT] = {"core", "smt", "llc", "node", "remote"};
+
+// === 1. sysfs 读取 ===
+
+static int read_line(const char *path, char *buf, size_t len)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    if (!fgets(buf, len, fp))
+    {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = 0;
+    return 0;
+}
+
+int fi_topo_parse_list(const char *s, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    while (*s)
+    {
+        char *end;
+        long a = strtol(s, &end, 10), b;
+        if (end == s)
+            return -1;
+        b = a;
+        if (*end == '-')
+        {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s)
+                return -1;
+        }
+        for (long c = a; c <= b && c < FI_TOPO_MAX_CPUS; c++)
+            CPU_SET(c, set);
+        s = end;
+        if (*s == ',')
+            s++;
+        else if (*s && *s != '\n')
+            return -1;
+        else
+            break;
+    }
+    return 0;
+}
+
+char *fi_topo_format(const cpu_set_t *set, char *buf, size_t len)
+{
+    size_t off = 0;
+    buf[0] = 0;
+    for (int c = 0; c < FI_TOPO_MAX_CPUS && off < len; c++)
+    {
+        if (!CPU_ISSET(c, set))
+            continue;
+        int e = c;
+        while (e + 1 < FI_TOPO_MAX_CPUS && CPU_ISSET(e + 1, set))
+            e++;
+        if (e == c)
+            off += snprintf(buf + off, len - off, "%s%d", off ? "," : "", c);
+        else
+            off += snprintf(buf + off, len - off, "%s%d-%d", off ? "," : "", c, e);
+        c = e;
+    }
+    if (off == 0)
+        snprintf(buf, len, "(无)");
+    return buf;
+}
+
+// 集合中最小的 CPU 号，空集返回 -1
+static int first_cpu(const cpu_set_t *set)
+{
+    for (int c = 0; c < FI_TOPO_MAX_CPUS; c++)
+        if (CPU_ISSET(c, set))
+            return c;
+    return -1;
+}
+
+int fi_topo_load(FiTopo *t)
+{
+    char path[128], buf[1024];
+    cpu_set_t online, self, set;
+
+    memset(t, 0, sizeof(*t));
+    t->ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if (t->ncpu <= 0 || t->ncpu > FI_TOPO_MAX_CPUS)
+        t->ncpu = FI_TOPO_MAX_CPUS;
+
+    if (read_line("/sys/devices/system/cpu/online", buf, sizeof(buf)) < 0 || fi_topo_parse_list(buf, &online) < 0)
+        return -1;
+    if (sched_getaffinity(0, sizeof(self), &self) < 0)
+        return -1;
+    CPU_AND(&t->usable, &online, &self);
+
+    for (int c = 0; c < t->ncpu; c++)
+    {
+        t->core[c] = t->llc[c] = c;
+        t->node[c] = 0;
+        if (!CPU_ISSET(c, &online))
+            continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        if (read_line(path, buf, sizeof(buf)) == 0 && fi_topo_parse_list(buf, &set) == 0 && first_cpu(&set) >= 0)
+            t->core[c] = first_cpu(&set);
+
+        // 取级别最高的缓存作为 LLC
+        int best = -1;
+        for (int i = 0; i < 16; i++)
+        {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", c, i);
+            if (read_line(path, buf, sizeof(buf)) < 0)
+                break;
+            int level = atoi(buf);
+            if (level < best)
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", c, i);
+            if (read_line(path, buf, sizeof(buf)) == 0 && fi_topo_parse_list(buf, &set) == 0 && first_cpu(&set) >= 0)
+            {
+                best = level;
+                t->llc[c] = first_cpu(&set);
+            }
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", c);
+        DIR *d = opendir(path);
+        if (d)
+        {
+            struct dirent *e;
+            while ((e = readdir(d)))
+            {
+                if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9')
+                {
+                    t->node[c] = atoi(e->d_name + 4);
+                    break;
+                }
+            }
+            closedir(d);
+        }
+    }
+    return 0;
+}
+
+// === 2. 目标线程 ===
+
+// /proc/<pid>/task/<tid>/stat 的第 39 字段为最后运行的 CPU
+static int task_last_cpu(pid_t pid, const char *tid)
+{
+    char path[300], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/task/%s/stat", pid, tid);
+    if (read_line(path, buf, sizeof(buf)) < 0)
+        return -1;
+    char *p = strrchr(buf, ')');
+    if (!p)
+        return -1;
+    p++;
+    for (int field = 3; field < 39; field++)
+    {
+        p = strchr(p + 1, ' ');
+        if (!p)
+            return -1;
+    }
+    return atoi(p + 1);
+}
+
+int fi_topo_target_cpus(pid_t pid, int sample_ms, cpu_set_t *used, cpu_set_t *allowed)
+{
+    char path[64];
+    int nthreads = -1;
+
+    CPU_ZERO(used);
+    CPU_ZERO(allowed);
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+    // 线程会迁移，间隔 5ms 多次采样取并集
+    for (int elapsed = 0;; elapsed += 5)
+    {
+        DIR *d = opendir(path);
+        if (!d)
+            return nthreads;
+        struct dirent *e;
+        int n = 0;
+        while ((e = readdir(d)))
+        {
+            if (e->d_name[0] < '0' || e->d_name[0] > '9')
+                continue;
+            int cpu = task_last_cpu(pid, e->d_name);
+            if (cpu < 0 || cpu >= FI_TOPO_MAX_CPUS)
+                continue;
+            CPU_SET(cpu, used);
+            cpu_set_t aff;
+            if (sched_getaffinity(atoi(e->d_name), sizeof(aff), &aff) == 0)
+                CPU_OR(allowed, allowed, &aff);
+            n++;
+        }
+        closedir(d);
+        if (n > nthreads)
+            nthreads = n;
+        if (elapsed >= sample_ms)
+            break;
+        struct timespec ts = {0, 5000000};
+        nanosleep(&ts, NULL);
+    }
+    return nthreads;
+}
+
+// === 3. 放置策略 ===
+
+int fi_topo_parse_place(const char *name)
+{
+    for (int i = 0; i < FI_PLACE_COUNT; i++)
+        if (strcmp(name, place_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+const char *fi_topo_place_name(int policy)
+{
+    return policy >= 0 && policy < FI_PLACE_COUNT ? place_names[policy] : "?";
+}
+
+int fi_topo_place(const FiTopo *t, const cpu_set_t *target, int policy, int *cpus, int max)
+{
+    int n = 0;
+
+    for (int c = 0; c < t->ncpu && n < max; c++)
+    {
+        if (!CPU_ISSET(c, &t->usable))
+            continue;
+
+        // 逐级判断 c 与目标最近的共享层级：0=同 CPU 1=同核 2=同 LLC 3=同节点 4=远端
+        int nearest = FI_PLACE_REMOTE;
+        for (int x = 0; x < t->ncpu && nearest > FI_PLACE_CORE; x++)
+        {
+            if (!CPU_ISSET(x, target))
+                continue;
+            int lvl = FI_PLACE_REMOTE;
+            if (x == c)
+                lvl = FI_PLACE_CORE;
+            else if (t->core[x] == t->core[c])
+                lvl = FI_PLACE_SMT;
+            else if (t->llc[x] == t->llc[c])
+                lvl = FI_PLACE_LLC;
+            else if (t->node[x] == t->node[c])
+                lvl = FI_PLACE_NODE;
+            if (lvl < nearest)
+                nearest = lvl;
+        }
+        if (nearest == policy)
+            cpus[n++] = c;
+    }
+    return n;
+}
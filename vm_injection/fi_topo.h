@@ -0,0 +1,55 @@
+/*
+ * fi_topo.h - CPU 拓扑与目标线程放置
+ * 功能：从 sysfs 读取每个 CPU 的 SMT 核、最后一级缓存与 NUMA 节点；
+ *       采样 /proc/<pid>/task/星号/stat 的最后运行 CPU 与 sched_getaffinity，得到目标实际使用的 CPU；
+ *       按干扰类型给出放置 CPU：同核、SMT 兄弟、同 LLC、同 NUMA 节点、远端节点。
+ *       各层级互斥 (例如 llc 不含目标所在物理核)，便于把目标降速归因到单一共享资源。
+ */
+
+#ifndef FI_TOPO_H
+#define FI_TOPO_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FI_TOPO_MAX_CPUS 1024
+
+typedef struct
+{
+    int ncpu;                    // 编号上限 (含离线 CPU)
+    cpu_set_t usable;            // 在线且本进程允许运行的 CPU
+    short core[FI_TOPO_MAX_CPUS]; // 物理核编号 (SMT 兄弟中最小的 CPU 号)
+    short llc[FI_TOPO_MAX_CPUS];  // 最后一级缓存编号 (共享该缓存的最小 CPU 号)
+    short node[FI_TOPO_MAX_CPUS]; // NUMA 节点
+} FiTopo;
+
+typedef enum
+{
+    FI_PLACE_CORE,   // 与目标线程同一逻辑 CPU (争抢时间片)
+    FI_PLACE_SMT,    // 同一物理核的 SMT 兄弟 (争抢执行单元、L1/L2)
+    FI_PLACE_LLC,    // 共享 LLC 的其他物理核
+    FI_PLACE_NODE,   // 同一 NUMA 节点但不共享 LLC
+    FI_PLACE_REMOTE, // 其他 NUMA 节点
+    FI_PLACE_COUNT
+} FiPlacement;
+
+int fi_topo_load(FiTopo *t);
+
+// 解析 "0-3,8,10-11" 形式的 CPU 列表
+int fi_topo_parse_list(const char *s, cpu_set_t *set);
+
+// 格式化为 CPU 列表字符串
+char *fi_topo_format(const cpu_set_t *set, char *buf, size_t len);
+
+// 在 sample_ms 内反复采样目标全部线程：used 为最后运行过的 CPU，allowed 为亲和性并集；返回线程数，-1 失败
+int fi_topo_target_cpus(pid_t pid, int sample_ms, cpu_set_t *used, cpu_set_t *allowed);
+
+// 策略名 (core/smt/llc/node/remote) 与编号互转，未知返回 -1
+int fi_topo_parse_place(const char *name);
+const char *fi_topo_place_name(int policy);
+
+// 按策略从 target 推出放置 CPU，写入 cpus (升序)，返回个数
+int fi_topo_place(const FiTopo *t, const cpu_set_t *target, int policy, int *cpus, int max);
+
+#endif
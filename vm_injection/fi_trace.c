@@ -0,0 +1,1863 @@
+/*
+ * fi_trace.c - 黄金运行指令级跟踪与 def-use 故障空间剪枝实现
+ *
+ * 故障空间：位置 L (寄存器或 8 字节内存字) × 时刻 t ("ROI 内第 t 条指令执行之前")。
+ * 对每个位置按时间顺序扫描它的访问，设上一次访问在第 a-1 步，下一次访问在第 s 步：
+ *   - s 读 L        -> [a, s] 内任一时刻翻转都等价于 "第 s 步之前翻转"，权重 s-a+1；
+ *   - s 只整体写 L  -> [a, s] 内的翻转必然被覆盖，计入 masked，不需要实验；
+ *   - ROI 内不再访问 -> [a, 结束) 等价于在最后一步之前翻转 (值带出 ROI)。
+ * 无法解码的指令与系统调用对内存是 "读全部" 的屏障，按需惰性地切开每个内存字的等价类。
+ *
+ * 代表点 "第 hit 次执行到 pc 之前" 对同一二进制、同一输入是确定的：
+ * 闸门保证计数从同一位置开始，关闭 ASLR 保证地址一致 (栈上的字另按闸门处栈指针的偏移记录)。
+ */
+
+#define _GNU_SOURCE
+#include "fi_trace.h"
+#include "fi_trigger.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#define ALL_REGS ((1ULL << FI_TRACE_NREGS) - 1)
+
+static void add_mem(FiInsnAccess *acc, uint64_t addr, uint32_t size, int rd, int wr)
+{
+    if (size == 0)
+        return;
+    if (acc->nmem >= FI_TRACE_MAX_MEM)
+    {
+        acc->unknown = 1;
+        return;
+    }
+    acc->mem[acc->nmem].addr = addr;
+    acc->mem[acc->nmem].size = size;
+    acc->mem[acc->nmem].read = (uint8_t)rd;
+    acc->mem[acc->nmem].write = (uint8_t)wr;
+    acc->nmem++;
+}
+
+#if defined(__x86_64__)
+// === 1. x86_64 解码 ===
+enum
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+static const char *reg_names[FI_TRACE_NREGS] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+
+static const size_t reg_off[FI_TRACE_NREGS] = {
+    offsetof(fi_regs_t, rax), offsetof(fi_regs_t, rcx), offsetof(fi_regs_t, rdx), offsetof(fi_regs_t, rbx),
+    offsetof(fi_regs_t, rsp), offsetof(fi_regs_t, rbp), offsetof(fi_regs_t, rsi), offsetof(fi_regs_t, rdi),
+    offsetof(fi_regs_t, r8), offsetof(fi_regs_t, r9), offsetof(fi_regs_t, r10), offsetof(fi_regs_t, r11),
+    offsetof(fi_regs_t, r12), offsetof(fi_regs_t, r13), offsetof(fi_regs_t, r14), offsetof(fi_regs_t, r15)};
+
+typedef struct
+{
+    const uint8_t *p, *end;
+    const fi_regs_t *regs;
+    FiInsnAccess *acc;
+    int trunc;
+    int rex;         // REX 字节 (0 = 无)
+    int osz;         // 操作数宽度 (字节)
+    int opd66, asz32, rep, seg;
+    int mod, reg, rm; // reg/rm 已并入 REX.R/REX.B
+    int riprel;
+    uint64_t ea;
+    uint32_t ea_mask; // 哪些 mem 项来自 ModRM (RIP 相对寻址需补上指令长度)
+} X86Insn;
+
+static uint64_t reg_val(const fi_regs_t *regs, int r)
+{
+    return *(const uint64_t *)((const char *)regs + reg_off[r]);
+}
+
+static uint8_t next(X86Insn *x)
+{
+    if (x->p >= x->end)
+    {
+        x->trunc = 1;
+        return 0;
+    }
+    return *x->p++;
+}
+
+static int64_t sdisp(X86Insn *x, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v |= (uint64_t)next(x) << (8 * i);
+    return n == 1 ? (int8_t)v : (int32_t)v;
+}
+
+static void imm(X86Insn *x, int n)
+{
+    for (int i = 0; i < n; i++)
+        next(x);
+}
+
+static void use(X86Insn *x, int r)
+{
+    x->acc->use_regs |= 1ULL << r;
+}
+
+// 写 size 字节：32/64 位写覆盖整个寄存器 (32 位零扩展)，8/16 位写保留其余位，按读处理
+static void put(X86Insn *x, int r, int size)
+{
+    if (size >= 4)
+        x->acc->def_regs |= 1ULL << r;
+    else
+        use(x, r);
+}
+
+// 无 REX 时字节寄存器 4-7 是 ah/ch/dh/bh
+static int breg(X86Insn *x, int r)
+{
+    return (!x->rex && r >= 4 && r < 8) ? r - 4 : r;
+}
+
+static void modrm(X86Insn *x)
+{
+    uint8_t m = next(x);
+    int base = -1, index = -1, scale = 1;
+    int64_t disp = 0;
+    x->mod = m >> 6;
+    x->reg = ((m >> 3) & 7) | ((x->rex & 4) << 1);
+    x->rm = m & 7;
+    if (x->mod == 3)
+    {
+        x->rm |= (x->rex & 1) << 3;
+        return;
+    }
+
+    if (x->rm == 4)
+    {
+        uint8_t sib = next(x);
+        scale = 1 << (sib >> 6);
+        index = ((sib >> 3) & 7) | ((x->rex & 2) << 2);
+        if (index == RSP)
+            index = -1;
+        if ((sib & 7) == 5 && x->mod == 0)
+            disp = sdisp(x, 4);
+        else
+            base = (sib & 7) | ((x->rex & 1) << 3);
+    }
+    else if (x->rm == 5 && x->mod == 0)
+    {
+        x->riprel = 1;
+        disp = sdisp(x, 4);
+    }
+    else
+    {
+        base = x->rm | ((x->rex & 1) << 3);
+    }
+    if (x->mod == 1)
+        disp = sdisp(x, 1);
+    else if (x->mod == 2)
+        disp = sdisp(x, 4);
+
+    uint64_t ea = (uint64_t)disp;
+    if (base >= 0)
+    {
+        use(x, base);
+        ea += reg_val(x->regs, base);
+    }
+    if (index >= 0)
+    {
+        use(x, index);
+        ea += reg_val(x->regs, index) * scale;
+    }
+    if (x->asz32)
+        ea = (uint32_t)ea;
+    if (x->seg == 0x64)
+        ea += x->regs->fs_base;
+    else if (x->seg == 0x65)
+        ea += x->regs->gs_base;
+    x->ea = ea;
+}
+
+static void ea_mem(X86Insn *x, uint32_t size, int rd, int wr)
+{
+    x->ea_mask |= 1U << x->acc->nmem;
+    add_mem(x->acc, x->ea, size, rd, wr);
+}
+
+// ModRM 的 r/m 操作数：读 / 写 / 读改写
+static void rm_read(X86Insn *x, int size)
+{
+    if (x->mod == 3)
+        use(x, size == 1 ? breg(x, x->rm) : x->rm);
+    else
+        ea_mem(x, size, 1, 0);
+}
+
+static void rm_write(X86Insn *x, int size)
+{
+    if (x->mod == 3)
+        put(x, size == 1 ? breg(x, x->rm) : x->rm, size);
+    else
+        ea_mem(x, size, 0, 1);
+}
+
+static void rm_rmw(X86Insn *x, int size)
+{
+    if (x->mod == 3)
+        use(x, size == 1 ? breg(x, x->rm) : x->rm);
+    else
+        ea_mem(x, size, 1, 1);
+}
+
+// SIMD 寄存器不在故障空间内，只记录内存操作数
+static void sse_read(X86Insn *x, int size)
+{
+    if (x->mod != 3)
+        ea_mem(x, size, 1, 0);
+}
+
+static void push(X86Insn *x)
+{
+    use(x, RSP);
+    add_mem(x->acc, reg_val(x->regs, RSP) - 8, 8, 0, 1);
+}
+
+static void pop(X86Insn *x)
+{
+    use(x, RSP);
+    add_mem(x->acc, reg_val(x->regs, RSP), 8, 1, 0);
+}
+
+// movs/stos/lods/cmps/scas；单步时带 rep 前缀的指令每步只执行一次迭代 (rcx 为 0 时不访问)
+static void string_op(X86Insn *x, uint8_t op)
+{
+    int size = (op & 1) ? x->osz : 1;
+    uint64_t rsi = reg_val(x->regs, RSI), rdi = reg_val(x->regs, RDI);
+    int kind = (op - 0xA4) >> 1; // 0 movs, 1 cmps, 3 stos, 4 lods, 5 scas
+
+    if (x->rep)
+    {
+        use(x, RCX);
+        if (reg_val(x->regs, RCX) == 0)
+            return;
+    }
+    switch (kind)
+    {
+    case 0:
+        use(x, RSI);
+        use(x, RDI);
+        add_mem(x->acc, rsi, size, 1, 0);
+        add_mem(x->acc, rdi, size, 0, 1);
+        break;
+    case 1:
+        use(x, RSI);
+        use(x, RDI);
+        add_mem(x->acc, rsi, size, 1, 0);
+        add_mem(x->acc, rdi, size, 1, 0);
+        break;
+    case 3:
+        use(x, RAX);
+        use(x, RDI);
+        add_mem(x->acc, rdi, size, 0, 1);
+        break;
+    case 4:
+        use(x, RSI);
+        add_mem(x->acc, rsi, size, 1, 0);
+        put(x, RAX, size);
+        break;
+    default:
+        use(x, RAX);
+        use(x, RDI);
+        add_mem(x->acc, rdi, size, 1, 0);
+        break;
+    }
+}
+
+static void x86_onebyte(X86Insn *x, uint8_t op)
+{
+    int sz = x->osz, iz = (sz == 2) ? 2 : 4;
+    int size = (op & 1) ? sz : 1;
+    int r = (op & 7) | ((x->rex & 1) << 3);
+
+    // add/or/adc/sbb/and/sub/xor/cmp 的六种形式
+    if (op < 0x40 && (op & 7) < 6)
+    {
+        int grp = op >> 3, col = op & 7;
+        if (col >= 4)
+        {
+            use(x, RAX);
+            imm(x, col == 4 ? 1 : iz);
+            return;
+        }
+        modrm(x);
+        int g = (size == 1) ? breg(x, x->reg) : x->reg;
+        // sub/xor 同一寄存器是清零惯用法：不读旧值
+        if ((grp == 5 || grp == 6) && x->mod == 3 && x->reg == x->rm && size >= 4)
+        {
+            put(x, g, size);
+            return;
+        }
+        use(x, g);
+        if (col < 2 && grp != 7)
+            rm_rmw(x, size);
+        else
+            rm_read(x, size);
+        return;
+    }
+
+    if (op >= 0x70 && op <= 0x7F) // jcc rel8
+    {
+        imm(x, 1);
+        return;
+    }
+
+    switch (op)
+    {
+    case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+        if (x->opd66)
+            break;
+        use(x, r);
+        push(x);
+        return;
+    case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+        if (x->opd66)
+            break;
+        pop(x);
+        put(x, r, 8);
+        return;
+    case 0x63: // movsxd
+        modrm(x);
+        rm_read(x, 4);
+        put(x, x->reg, sz);
+        return;
+    case 0x68:
+    case 0x6A:
+        imm(x, op == 0x68 ? 4 : 1);
+        push(x);
+        return;
+    case 0x69:
+    case 0x6B: // imul r, r/m, imm
+        modrm(x);
+        imm(x, op == 0x69 ? iz : 1);
+        rm_read(x, sz);
+        put(x, x->reg, sz);
+        return;
+    case 0x80:
+    case 0x81:
+    case 0x83:
+        modrm(x);
+        imm(x, op == 0x81 ? iz : 1);
+        size = (op == 0x80) ? 1 : sz;
+        if ((x->reg & 7) == 7)
+            rm_read(x, size);
+        else
+            rm_rmw(x, size);
+        return;
+    case 0x84:
+    case 0x85: // test
+        modrm(x);
+        rm_read(x, size);
+        use(x, size == 1 ? breg(x, x->reg) : x->reg);
+        return;
+    case 0x86:
+    case 0x87: // xchg
+        modrm(x);
+        rm_rmw(x, size);
+        use(x, size == 1 ? breg(x, x->reg) : x->reg);
+        return;
+    case 0x88:
+    case 0x89: // mov r/m, r
+        modrm(x);
+        use(x, size == 1 ? breg(x, x->reg) : x->reg);
+        rm_write(x, size);
+        return;
+    case 0x8A:
+    case 0x8B: // mov r, r/m
+        modrm(x);
+        rm_read(x, size);
+        put(x, size == 1 ? breg(x, x->reg) : x->reg, size);
+        return;
+    case 0x8D: // lea：只用到地址寄存器
+        modrm(x);
+        if (x->mod == 3)
+            break;
+        put(x, x->reg, sz);
+        return;
+    case 0x8F:
+        modrm(x);
+        if ((x->reg & 7) != 0)
+            break;
+        pop(x);
+        rm_write(x, 8);
+        return;
+    case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97:
+        if (r != RAX) // 90 (无 REX.B) 是 nop/pause
+        {
+            use(x, r);
+            use(x, RAX);
+        }
+        return;
+    case 0x98:
+        use(x, RAX);
+        return;
+    case 0x99: // cdq/cqo
+        use(x, RAX);
+        put(x, RDX, sz);
+        return;
+    case 0xA8:
+    case 0xA9:
+        use(x, RAX);
+        imm(x, op == 0xA8 ? 1 : iz);
+        return;
+    case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+    case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+        string_op(x, op);
+        return;
+    case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+        imm(x, 1);
+        use(x, breg(x, r));
+        return;
+    case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+        imm(x, sz == 8 ? 8 : iz);
+        put(x, r, sz);
+        return;
+    case 0xC0:
+    case 0xC1:
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3: // 移位
+        modrm(x);
+        if (op <= 0xC1)
+            imm(x, 1);
+        if (op >= 0xD2)
+            use(x, RCX);
+        rm_rmw(x, size);
+        return;
+    case 0xC2:
+    case 0xC3: // ret
+        if (op == 0xC2)
+            imm(x, 2);
+        pop(x);
+        return;
+    case 0xC6:
+    case 0xC7: // mov r/m, imm
+        modrm(x);
+        if ((x->reg & 7) != 0)
+            break;
+        imm(x, op == 0xC6 ? 1 : iz);
+        rm_write(x, size);
+        return;
+    case 0xC9: // leave：rsp = rbp，rbp = [rbp]
+        use(x, RBP);
+        add_mem(x->acc, reg_val(x->regs, RBP), 8, 1, 0);
+        put(x, RSP, 8);
+        return;
+    case 0xE0: case 0xE1: case 0xE2: case 0xE3: // loop/jrcxz
+        use(x, RCX);
+        imm(x, 1);
+        return;
+    case 0xE8: // call
+        imm(x, 4);
+        push(x);
+        return;
+    case 0xE9:
+        imm(x, 4);
+        return;
+    case 0xEB:
+        imm(x, 1);
+        return;
+    case 0xF5: case 0xF8: case 0xF9: case 0xFA: case 0xFB: case 0xFC: case 0xFD: // 标志位
+        return;
+    case 0xF6:
+    case 0xF7:
+        modrm(x);
+        switch (x->reg & 7)
+        {
+        case 0:
+        case 1: // test
+            imm(x, op == 0xF6 ? 1 : iz);
+            rm_read(x, size);
+            return;
+        case 2:
+        case 3: // not/neg
+            rm_rmw(x, size);
+            return;
+        default: // mul/imul/div/idiv：rdx:rax
+            rm_read(x, size);
+            use(x, RAX);
+            if (size == 1)
+                return;
+            if ((x->reg & 7) >= 6)
+                use(x, RDX);
+            else
+                put(x, RDX, size);
+            return;
+        }
+    case 0xFE:
+        modrm(x);
+        if ((x->reg & 7) > 1)
+            break;
+        rm_rmw(x, 1);
+        return;
+    case 0xFF:
+        modrm(x);
+        switch (x->reg & 7)
+        {
+        case 0:
+        case 1: // inc/dec
+            rm_rmw(x, sz);
+            return;
+        case 2: // call r/m
+        case 6: // push r/m
+            rm_read(x, 8);
+            push(x);
+            return;
+        case 4: // jmp r/m
+            rm_read(x, 8);
+            return;
+        }
+        break;
+    }
+    x->acc->unknown = 1;
+}
+
+// 只涉及 SIMD 寄存器与内存操作数的 SSE 指令 (0F xx)
+static int sse_xmm_only(uint8_t op)
+{
+    return op == 0x10 || op == 0x12 || (op >= 0x14 && op <= 0x16) || op == 0x28 || op == 0x2E ||
+           op == 0x2F || (op >= 0x51 && op <= 0x6D) || op == 0x6F || (op >= 0x74 && op <= 0x76) ||
+           (op >= 0xD1 && op <= 0xD5) || (op >= 0xD8 && op <= 0xE6) || (op >= 0xE8 && op <= 0xEF) ||
+           (op >= 0xF1 && op <= 0xF6) || (op >= 0xF8 && op <= 0xFE);
+}
+
+static uint32_t sse_store_size(X86Insn *x, uint8_t op)
+{
+    switch (op)
+    {
+    case 0x11:
+        return x->rep == 0xF3 ? 4 : (x->rep == 0xF2 ? 8 : 16);
+    case 0x13:
+    case 0x17:
+    case 0xD6:
+        return 8;
+    case 0x7F:
+    case 0xE7:
+        return (x->opd66 || x->rep == 0xF3) ? 16 : 8;
+    default:
+        return 16;
+    }
+}
+
+static void x86_twobyte(X86Insn *x, uint8_t op)
+{
+    int sz = x->osz;
+    int gsz = (x->rex & 8) ? 8 : 4; // SSE 指令中 66 是强制前缀，通用寄存器宽度只看 REX.W
+
+    if (op >= 0x80 && op <= 0x8F) // jcc rel32
+    {
+        imm(x, 4);
+        return;
+    }
+    if (op >= 0x40 && op <= 0x4F) // cmovcc：条件不成立时保留原值
+    {
+        modrm(x);
+        rm_read(x, sz);
+        use(x, x->reg);
+        return;
+    }
+    if (op >= 0x90 && op <= 0x9F) // setcc
+    {
+        modrm(x);
+        rm_write(x, 1);
+        return;
+    }
+    if (op >= 0x19 && op <= 0x1F) // 提示类 nop (含 endbr64)，不访问内存
+    {
+        modrm(x);
+        return;
+    }
+    if (op >= 0xC8) // bswap
+    {
+        use(x, (op & 7) | ((x->rex & 1) << 3));
+        return;
+    }
+
+    switch (op)
+    {
+    case 0x05: // syscall：参数寄存器与任意内存
+        use(x, RAX);
+        use(x, RDI);
+        use(x, RSI);
+        use(x, RDX);
+        use(x, R10);
+        use(x, R8);
+        use(x, R9);
+        put(x, RCX, 8);
+        put(x, R11, 8);
+        x->acc->mem_all = 1;
+        return;
+    case 0x0D:
+    case 0x18: // 预取
+        modrm(x);
+        return;
+    case 0x31: // rdtsc
+        put(x, RAX, 4);
+        put(x, RDX, 4);
+        return;
+    case 0xA2: // cpuid
+        use(x, RAX);
+        use(x, RCX);
+        put(x, RBX, 4);
+        put(x, RDX, 4);
+        return;
+    case 0xA3:
+    case 0xAB:
+    case 0xB3:
+    case 0xBB: // bt/bts/btr/btc r/m, r：内存形式的位偏移可越出操作数
+        modrm(x);
+        if (x->mod != 3)
+            break;
+        use(x, x->reg);
+        use(x, x->rm);
+        return;
+    case 0xBA:
+        modrm(x);
+        imm(x, 1);
+        if ((x->reg & 7) < 4)
+            break;
+        if ((x->reg & 7) == 4)
+            rm_read(x, sz);
+        else
+            rm_rmw(x, sz);
+        return;
+    case 0xA4:
+    case 0xAC: // shld/shrd imm
+        modrm(x);
+        imm(x, 1);
+        use(x, x->reg);
+        rm_rmw(x, sz);
+        return;
+    case 0xA5:
+    case 0xAD: // shld/shrd cl
+        modrm(x);
+        use(x, x->reg);
+        use(x, RCX);
+        rm_rmw(x, sz);
+        return;
+    case 0xAF: // imul r, r/m
+        modrm(x);
+        rm_read(x, sz);
+        use(x, x->reg);
+        return;
+    case 0xB0:
+    case 0xB1: // cmpxchg
+    case 0xC0:
+    case 0xC1: // xadd
+    {
+        int size = (op & 1) ? sz : 1;
+        modrm(x);
+        if (op <= 0xB1)
+            use(x, RAX);
+        use(x, size == 1 ? breg(x, x->reg) : x->reg);
+        rm_rmw(x, size);
+        return;
+    }
+    case 0xB6:
+    case 0xBE: // movzx/movsx r, r/m8
+        modrm(x);
+        rm_read(x, 1);
+        put(x, x->reg, sz);
+        return;
+    case 0xB7:
+    case 0xBF: // movzx/movsx r, r/m16
+        modrm(x);
+        rm_read(x, 2);
+        put(x, x->reg, sz);
+        return;
+    case 0xB8: // popcnt
+        if (x->rep != 0xF3)
+            break;
+        modrm(x);
+        rm_read(x, sz);
+        put(x, x->reg, sz);
+        return;
+    case 0xBC:
+    case 0xBD: // bsf/bsr (源为 0 时目的不变)；F3 前缀为 tzcnt/lzcnt
+        modrm(x);
+        rm_read(x, sz);
+        if (x->rep == 0xF3)
+            put(x, x->reg, sz);
+        else
+            use(x, x->reg);
+        return;
+    case 0xAE: // lfence/mfence/sfence；内存形式 (fxsave 等) 不处理
+        modrm(x);
+        if (x->mod != 3)
+            break;
+        return;
+    case 0x2A: // cvtsi2ss/sd
+        modrm(x);
+        rm_read(x, x->rep ? gsz : 8);
+        return;
+    case 0x2C:
+    case 0x2D: // cvt(t)ss/sd2si
+        modrm(x);
+        sse_read(x, 16);
+        if (x->rep)
+            put(x, x->reg, gsz);
+        return;
+    case 0x50:
+    case 0xD7: // movmskps/pmovmskb
+        modrm(x);
+        if (x->mod != 3)
+            break;
+        put(x, x->reg, 4);
+        return;
+    case 0x6E: // movd/movq xmm, r/m
+        modrm(x);
+        rm_read(x, gsz);
+        return;
+    case 0x7E:
+        modrm(x);
+        if (x->rep == 0xF3) // movq xmm, xmm/m64
+            sse_read(x, 8);
+        else // movd/movq r/m, xmm
+            rm_write(x, gsz);
+        return;
+    case 0xC4: // pinsrw
+        modrm(x);
+        imm(x, 1);
+        rm_read(x, 2);
+        return;
+    case 0xC5: // pextrw
+        modrm(x);
+        imm(x, 1);
+        if (x->mod != 3)
+            break;
+        put(x, x->reg, 4);
+        return;
+    case 0x70:
+    case 0xC2:
+    case 0xC6: // 带 imm8 的 SSE 指令
+        modrm(x);
+        imm(x, 1);
+        sse_read(x, 16);
+        return;
+    case 0x11:
+    case 0x13:
+    case 0x17:
+    case 0x29:
+    case 0x2B:
+    case 0x7F:
+    case 0xD6:
+    case 0xE7: // SSE 存储
+        modrm(x);
+        if (x->mod != 3)
+            ea_mem(x, sse_store_size(x, op), 0, 1);
+        return;
+    case 0x77: // emms
+        return;
+    default:
+        if (sse_xmm_only(op))
+        {
+            modrm(x);
+            sse_read(x, 16);
+            return;
+        }
+        break;
+    }
+    x->acc->unknown = 1;
+}
+
+int fi_trace_decode(const uint8_t *code, size_t len, const fi_regs_t *regs, FiInsnAccess *acc)
+{
+    X86Insn x;
+    memset(&x, 0, sizeof(x));
+    memset(acc, 0, sizeof(*acc));
+    x.p = code;
+    x.end = code + len;
+    x.regs = regs;
+    x.acc = acc;
+
+    uint8_t op;
+    while (1)
+    {
+        op = next(&x);
+        if (op == 0x66)
+            x.opd66 = 1;
+        else if (op == 0x67)
+            x.asz32 = 1;
+        else if (op == 0xF2 || op == 0xF3)
+            x.rep = op;
+        else if (op == 0x64 || op == 0x65)
+            x.seg = op;
+        else if (op != 0xF0 && op != 0x2E && op != 0x36 && op != 0x3E && op != 0x26)
+            break;
+        if (x.trunc)
+            return -1;
+    }
+    if ((op & 0xF0) == 0x40)
+    {
+        x.rex = op;
+        op = next(&x);
+    }
+    x.osz = (x.rex & 8) ? 8 : (x.opd66 ? 2 : 4);
+
+    // VEX/EVEX (AVX) 与三字节操作码不解码
+    if (op == 0xC4 || op == 0xC5 || op == 0x62)
+        acc->unknown = 1;
+    else if (op != 0x0F)
+        x86_onebyte(&x, op);
+    else
+    {
+        op = next(&x);
+        if (op == 0x38 || op == 0x3A)
+            acc->unknown = 1;
+        else
+            x86_twobyte(&x, op);
+    }
+    if (x.trunc)
+        return -1;
+
+    acc->len = (uint32_t)(x.p - code);
+    if (x.riprel)
+    {
+        for (int i = 0; i < acc->nmem; i++)
+            if (x.ea_mask & (1U << i))
+                acc->mem[i].addr += regs->rip + acc->len;
+    }
+    if (acc->unknown)
+        acc->nmem = 0;
+    return 0;
+}
+
+#else
+// === 1. ARM64 解码 ===
+static const char *reg_names[FI_TRACE_NREGS] = {
+    "X0", "X1", "X2", "X3", "X4", "X5", "X6", "X7", "X8", "X9", "X10",
+    "X11", "X12", "X13", "X14", "X15", "X16", "X17", "X18", "X19", "X20",
+    "X21", "X22", "X23", "X24", "X25", "X26", "X27", "X28", "X29", "X30", "SP"};
+
+// 编号 31 依指令不同是 SP 或零寄存器：sp=1 表示 SP (位 31)，否则忽略
+static void a_use(FiInsnAccess *acc, int r, int sp)
+{
+    if (r != 31 || sp)
+        acc->use_regs |= 1ULL << r;
+}
+
+// W 寄存器的写会把高 32 位清零，同样是整体覆盖
+static void a_def(FiInsnAccess *acc, int r, int sp)
+{
+    if (r != 31 || sp)
+        acc->def_regs |= 1ULL << r;
+}
+
+static uint64_t a_val(const uint64_t *x, uint64_t sp, int r, int is_sp)
+{
+    return r == 31 ? (is_sp ? sp : 0) : x[r];
+}
+
+static int64_t sext(uint64_t v, int bits)
+{
+    return (int64_t)(v << (64 - bits)) >> (64 - bits);
+}
+
+// 单寄存器访存：LDR/STR 立即数、非缩放、前/后变址、寄存器偏移
+static void a64_ldst(uint32_t in, const uint64_t *x, uint64_t sp, FiInsnAccess *acc)
+{
+    int size = in >> 30, v = (in >> 26) & 1, opc = (in >> 22) & 3;
+    int rt = in & 31, rn = (in >> 5) & 31;
+    int scale = v ? (((opc >> 1) << 2) | size) : size;
+    int load, prefetch = 0;
+
+    if (v)
+    {
+        if (scale > 4)
+        {
+            acc->unknown = 1;
+            return;
+        }
+        load = opc & 1;
+    }
+    else
+    {
+        load = opc != 0;
+        if (opc == 2 && size == 3)
+            prefetch = 1;
+        else if (opc == 3 && size >= 2)
+        {
+            acc->unknown = 1;
+            return;
+        }
+    }
+
+    a_use(acc, rn, 1);
+    uint64_t addr = a_val(x, sp, rn, 1);
+    if ((in & 0x3B000000) == 0x39000000) // 无符号立即数
+    {
+        addr += (uint64_t)((in >> 10) & 0xFFF) << scale;
+    }
+    else if ((in & 0x00200000) == 0) // 非缩放 / 后变址 / 非特权 / 前变址
+    {
+        int mode = (in >> 10) & 3;
+        if (mode != 1)
+            addr += sext((in >> 12) & 0x1FF, 9);
+    }
+    else // 寄存器偏移
+    {
+        int rm = (in >> 16) & 31, option = (in >> 13) & 7, s = (in >> 12) & 1;
+        uint64_t off = a_val(x, sp, rm, 0);
+        if (option == 2)
+            off = (uint32_t)off;
+        else if (option == 6)
+            off = (uint64_t)(int64_t)(int32_t)off;
+        else if (option != 3 && option != 7)
+        {
+            acc->unknown = 1;
+            return;
+        }
+        a_use(acc, rm, 0);
+        addr += off << (s ? scale : 0);
+    }
+
+    if (prefetch)
+        return;
+    add_mem(acc, addr, 1U << scale, load, !load);
+    if (v)
+        return;
+    if (load)
+        a_def(acc, rt, 0);
+    else
+        a_use(acc, rt, 0);
+}
+
+static void a64_pair(uint32_t in, const uint64_t *x, uint64_t sp, FiInsnAccess *acc)
+{
+    int opc = in >> 30, v = (in >> 26) & 1, mode = (in >> 23) & 3, load = (in >> 22) & 1;
+    int rt = in & 31, rn = (in >> 5) & 31, rt2 = (in >> 10) & 31;
+    int size;
+    if (v)
+        size = 4 << opc;
+    else if (opc == 0 || (opc == 1 && load))
+        size = 4;
+    else if (opc == 2)
+        size = 8;
+    else
+        size = 0;
+    if (size == 0 || size > 16)
+    {
+        acc->unknown = 1;
+        return;
+    }
+
+    a_use(acc, rn, 1);
+    uint64_t addr = a_val(x, sp, rn, 1);
+    if (mode != 1) // 后变址用原基址
+        addr += (uint64_t)(sext((in >> 15) & 0x7F, 7) * size);
+    add_mem(acc, addr, 2 * size, load, !load);
+    if (v)
+        return;
+    if (load)
+    {
+        a_def(acc, rt, 0);
+        a_def(acc, rt2, 0);
+    }
+    else
+    {
+        a_use(acc, rt, 0);
+        a_use(acc, rt2, 0);
+    }
+}
+
+static void decode_a64(uint32_t in, const uint64_t *x, uint64_t sp, uint64_t pc, FiInsnAccess *acc)
+{
+    int rd = in & 31, rn = (in >> 5) & 31, rm = (in >> 16) & 31;
+    int op0 = (in >> 25) & 0xF;
+
+    if ((op0 & 0xE) == 0x8) // 数据处理：立即数
+    {
+        switch ((in >> 23) & 7)
+        {
+        case 0:
+        case 1: // adr/adrp
+            a_def(acc, rd, 0);
+            return;
+        case 2: // add/sub imm
+            a_use(acc, rn, 1);
+            a_def(acc, rd, !((in >> 29) & 1));
+            return;
+        case 4: // 逻辑运算 imm
+            a_use(acc, rn, 0);
+            a_def(acc, rd, ((in >> 29) & 3) != 3);
+            return;
+        case 5: // movn/movz/movk
+            if (((in >> 29) & 3) == 1)
+                break;
+            if (((in >> 29) & 3) == 3)
+                a_use(acc, rd, 0);
+            a_def(acc, rd, 0);
+            return;
+        case 6: // sbfm/bfm/ubfm
+            if (((in >> 29) & 3) == 3)
+                break;
+            if (((in >> 29) & 3) == 1)
+                a_use(acc, rd, 0);
+            a_use(acc, rn, 0);
+            a_def(acc, rd, 0);
+            return;
+        case 7: // extr
+            a_use(acc, rn, 0);
+            a_use(acc, rm, 0);
+            a_def(acc, rd, 0);
+            return;
+        }
+        acc->unknown = 1;
+        return;
+    }
+
+    if ((op0 & 0xE) == 0xA) // 分支、异常、系统指令
+    {
+        if ((in & 0x7C000000) == 0x14000000) // b/bl
+        {
+            if (in >> 31)
+                a_def(acc, 30, 0);
+            return;
+        }
+        if ((in & 0xFE000000) == 0x54000000) // b.cond
+            return;
+        if ((in & 0x7C000000) == 0x34000000) // cbz/cbnz/tbz/tbnz
+        {
+            a_use(acc, rd, 0);
+            return;
+        }
+        if ((in & 0xFFE0001F) == 0xD4000001) // svc：参数寄存器与任意内存
+        {
+            for (int r = 0; r <= 8; r++)
+                a_use(acc, r, 0);
+            acc->mem_all = 1;
+            return;
+        }
+        if (in == 0xD503201F || (in & 0xFFFFFF3F) == 0xD503241F) // nop/bti
+            return;
+        if ((in & 0xFFFFF01F) == 0xD503201F) // 其余提示 (含 PAC 指令)：可能读 X16/X17/X30/SP
+        {
+            a_use(acc, 16, 0);
+            a_use(acc, 17, 0);
+            a_use(acc, 30, 0);
+            a_use(acc, 31, 1);
+            return;
+        }
+        if ((in & 0xFFFFF01F) == 0xD503301F) // 屏障
+            return;
+        if ((in & 0xFFF00000) == 0xD5300000) // mrs
+        {
+            a_def(acc, rd, 0);
+            return;
+        }
+        if ((in & 0xFFF00000) == 0xD5100000) // msr
+        {
+            a_use(acc, rd, 0);
+            return;
+        }
+        if ((in & 0xFFDFFC1F) == 0xD61F0000 || (in & 0xFFFFFC1F) == 0xD65F0000) // br/blr/ret
+        {
+            a_use(acc, rn, 0);
+            if (in & 0x00200000)
+                a_def(acc, 30, 0);
+            return;
+        }
+        acc->unknown = 1;
+        return;
+    }
+
+    if ((op0 & 0x5) == 0x4) // 访存
+    {
+        if ((in & 0x3B000000) == 0x39000000 || (in & 0x3B200000) == 0x38000000 ||
+            (in & 0x3B200C00) == 0x38200800)
+        {
+            a64_ldst(in, x, sp, acc);
+            return;
+        }
+        if ((in & 0x3A000000) == 0x28000000)
+        {
+            a64_pair(in, x, sp, acc);
+            return;
+        }
+        if ((in & 0x3B000000) == 0x18000000) // ldr literal
+        {
+            int opc = in >> 30, v = (in >> 26) & 1;
+            uint64_t addr = pc + (uint64_t)(sext((in >> 5) & 0x7FFFF, 19) * 4);
+            if (!v && opc == 3) // prfm
+                return;
+            if (v && opc == 3)
+            {
+                acc->unknown = 1;
+                return;
+            }
+            add_mem(acc, addr, v ? (4U << opc) : (opc == 1 ? 8 : 4), 1, 0);
+            if (!v)
+                a_def(acc, rd, 0);
+            return;
+        }
+        acc->unknown = 1; // 独占/原子/SIMD 结构访存
+        return;
+    }
+
+    if ((op0 & 0x7) == 0x5) // 数据处理：寄存器
+    {
+        if ((in & 0x1F000000) == 0x0A000000 || (in & 0x1F200000) == 0x0B000000 ||
+            (in & 0x1FE00000) == 0x1A000000 || (in & 0x1FE00000) == 0x1A800000)
+        {
+            // 逻辑/加减 (移位寄存器)、adc/sbc、条件选择
+            a_use(acc, rn, 0);
+            a_use(acc, rm, 0);
+            a_def(acc, rd, 0);
+            return;
+        }
+        if ((in & 0x1F200000) == 0x0B200000) // add/sub 扩展寄存器：Rn/Rd 可为 SP
+        {
+            a_use(acc, rn, 1);
+            a_use(acc, rm, 0);
+            a_def(acc, rd, !((in >> 29) & 1));
+            return;
+        }
+        if ((in & 0x1FE00000) == 0x1A400000) // 条件比较
+        {
+            a_use(acc, rn, 0);
+            if (!(in & 0x800))
+                a_use(acc, rm, 0);
+            return;
+        }
+        if ((in & 0x5FE00000) == 0x1AC00000) // 双源：udiv/sdiv/移位/crc32
+        {
+            int opc = (in >> 10) & 0x3F;
+            if (opc == 2 || opc == 3 || (opc >= 8 && opc <= 11) || (opc >= 16 && opc <= 23))
+            {
+                a_use(acc, rn, 0);
+                a_use(acc, rm, 0);
+                a_def(acc, rd, 0);
+                return;
+            }
+        }
+        else if ((in & 0x5FFFC000) == 0x5AC00000) // 单源：rbit/rev/clz/cls
+        {
+            if (((in >> 10) & 0x3F) <= 5)
+            {
+                a_use(acc, rn, 0);
+                a_def(acc, rd, 0);
+                return;
+            }
+        }
+        else if ((in & 0x1F000000) == 0x1B000000) // 三源：madd/msub/smull/umulh
+        {
+            a_use(acc, rn, 0);
+            a_use(acc, rm, 0);
+            a_use(acc, (in >> 10) & 31, 0);
+            a_def(acc, rd, 0);
+            return;
+        }
+        acc->unknown = 1;
+        return;
+    }
+
+    if ((op0 & 0x7) == 0x7) // SIMD/浮点：只有与通用寄存器互传的指令涉及故障空间
+    {
+        if ((in & 0x5F20FC00) == 0x1E200000 || (in & 0x5F200000) == 0x1E000000)
+        {
+            // 浮点与整数/定点互转、fmov：scvtf/ucvtf/fmov (通用->浮点) 读 Rn，其余写 Rd
+            int opc = (in >> 16) & 7;
+            if (opc == 2 || opc == 3 || opc == 7)
+                a_use(acc, rn, 0);
+            else
+                a_def(acc, rd, 0);
+            return;
+        }
+        if ((in & 0xBFE08400) == 0x0E000400) // AdvSIMD 复制
+        {
+            int imm4 = (in >> 11) & 15;
+            if (imm4 == 1 || imm4 == 3) // dup/ins (通用寄存器)
+                a_use(acc, rn, 0);
+            else if (imm4 == 5 || imm4 == 7) // smov/umov
+                a_def(acc, rd, 0);
+        }
+        return;
+    }
+    acc->unknown = 1;
+}
+
+int fi_trace_decode(const uint8_t *code, size_t len, const fi_regs_t *regs, FiInsnAccess *acc)
+{
+    memset(acc, 0, sizeof(*acc));
+    if (len < 4)
+        return -1;
+    uint32_t in;
+    memcpy(&in, code, 4);
+    acc->len = 4;
+    decode_a64(in, regs->regs, regs->sp, regs->pc, acc);
+    if (acc->unknown)
+        acc->nmem = 0;
+    return 0;
+}
+#endif
+
+const char *fi_trace_reg_name(int idx)
+{
+    return (idx >= 0 && idx < FI_TRACE_NREGS) ? reg_names[idx] : "?";
+}
+
+// === 2. 单步与断点 ===
+#if defined(__x86_64__)
+#define BRK_INSN 0xCCUL
+#define BRK_MASK 0xFFUL
+#define BRK_PC_ADJ 1 // int3 执行后 PC 指向下一字节
+#else
+#define BRK_INSN 0xD4200000UL // brk #0
+#define BRK_MASK 0xFFFFFFFFUL
+#define BRK_PC_ADJ 0
+#endif
+
+// 等待下一次停止：0 = 停止 (*sig 为停止信号，事件停止为 0)，-1 = 进程已结束
+static int wait_stop(pid_t pid, int *sig)
+{
+    int status;
+    while (waitpid(pid, &status, __WALL) < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+        return -1;
+    *sig = (status >> 16) ? 0 : WSTOPSIG(status);
+    return 0;
+}
+
+int fi_trace_step(pid_t pid)
+{
+    int sig = 0;
+    while (1)
+    {
+        // 途中收到的信号在下一次单步时原样投递
+        if (ptrace(PTRACE_SINGLESTEP, pid, NULL, (void *)(long)sig) < 0)
+            return -1;
+        if (wait_stop(pid, &sig) < 0)
+            return -1;
+        if (sig == SIGTRAP)
+            return 0;
+    }
+}
+
+// 同 wait_stop，但最多等到 deadline_ns (0=不限)：超时返回 1，进程仍在运行。
+// 停止不会产生可 poll 的事件，只能退避轮询；先短后长，密集命中断点时不拖慢太多
+static int wait_stop_until(pid_t pid, int *sig, uint64_t deadline_ns)
+{
+    if (!deadline_ns)
+        return wait_stop(pid, sig);
+    int status;
+    useconds_t nap = 10;
+    while (1)
+    {
+        pid_t r = waitpid(pid, &status, __WALL | WNOHANG);
+        if (r == pid)
+            break;
+        if (r < 0 && errno != EINTR)
+            return -1;
+        if (r == 0)
+        {
+            if (fi_now_ns() >= deadline_ns)
+                return 1;
+            usleep(nap);
+            if (nap < 1000)
+                nap *= 2;
+        }
+    }
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+        return -1;
+    *sig = (status >> 16) ? 0 : WSTOPSIG(status);
+    return 0;
+}
+
+// 超时后把进程拉停在中断停止上；若恰好先命中断点，按到达处理返回 0，否则返回 1
+static int interrupt_at(pid_t pid, uint64_t pc, fi_regs_t *regs)
+{
+    if (ptrace(PTRACE_INTERRUPT, pid, NULL, NULL) < 0)
+        return -1;
+    while (1)
+    {
+        int status;
+        if (waitpid(pid, &status, __WALL) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            return -1;
+        if (!WIFSTOPPED(status))
+            continue;
+        if ((status >> 16) == PTRACE_EVENT_STOP)
+            return 1;
+        int sig = WSTOPSIG(status);
+        if (sig == SIGTRAP && fi_get_regs(pid, regs) == 0 && FI_REG_PC(regs) - BRK_PC_ADJ == pc)
+            return 0;
+        // 其他信号投递停止：原样转交，中断请求仍然挂起
+        ptrace(PTRACE_CONT, pid, NULL, (void *)(long)sig);
+    }
+}
+
+int fi_trace_run_to(pid_t pid, uint64_t pc, uint32_t hit, int timeout_ms)
+{
+    uint64_t deadline = (timeout_ms > 0) ? fi_now_ns() + (uint64_t)timeout_ms * 1000000ULL : 0;
+    errno = 0;
+    long orig = ptrace(PTRACE_PEEKTEXT, pid, (void *)pc, NULL);
+    if (errno != 0)
+        return -1;
+    long patched = (long)(((unsigned long)orig & ~BRK_MASK) | BRK_INSN);
+
+    // 停在 pc 上 (尚未执行) 即算一次到达，与 fi_trace_record 的计数一致
+    fi_regs_t regs;
+    if (fi_get_regs(pid, &regs) < 0)
+        return -1;
+    for (uint32_t seen = (FI_REG_PC(&regs) == pc); seen < hit;)
+    {
+        // 正停在 pc 上 (上一次到达)：先单步越过，再放回断点
+        if (FI_REG_PC(&regs) == pc && fi_trace_step(pid) < 0)
+            return -1;
+        if (ptrace(PTRACE_POKETEXT, pid, (void *)pc, (void *)patched) < 0)
+            return -1;
+
+        int sig = 0;
+        while (1)
+        {
+            if (ptrace(PTRACE_CONT, pid, NULL, (void *)(long)sig) < 0)
+                return -1;
+            int ret = wait_stop_until(pid, &sig, deadline);
+            if (ret == 1)
+                ret = interrupt_at(pid, pc, &regs);
+            if (ret < 0)
+                return -1;
+            if (ret == 1)
+            {
+                // 走了另一条路径 (非确定性)：撤掉断点，停在原处交还调用者
+                ptrace(PTRACE_POKETEXT, pid, (void *)pc, (void *)orig);
+                return 1;
+            }
+            if (sig == SIGTRAP && fi_get_regs(pid, &regs) == 0 && FI_REG_PC(&regs) - BRK_PC_ADJ == pc)
+                break;
+        }
+        ptrace(PTRACE_POKETEXT, pid, (void *)pc, (void *)orig);
+        FI_REG_PC(&regs) = pc;
+        if (fi_set_regs(pid, &regs) < 0)
+            return -1;
+        seen++;
+    }
+    return 0;
+}
+
+// === 3. 记录与等价类归并 ===
+typedef struct
+{
+    uint64_t pc;
+    uint32_t hits;
+    uint32_t ncode;
+    uint8_t code[16];
+} PcSlot;
+
+typedef struct
+{
+    uint64_t word; // 地址 / 8，0 表示空槽
+    uint64_t start;
+    uint64_t masked;
+} WordSlot;
+
+typedef struct
+{
+    uint64_t step, pc;
+    uint32_t hit;
+} Barrier;
+
+typedef struct
+{
+    FiTraceResult *out;
+    size_t site_cap;
+    PcSlot *pcs;
+    size_t npcs, pc_cap;
+    WordSlot *words;
+    size_t nwords, word_cap;
+    Barrier *bars;
+    size_t nbars, bar_cap;
+    uint64_t reg_start[FI_TRACE_NREGS];
+    uint64_t reg_masked[FI_TRACE_NREGS];
+    uint64_t stack_lo, stack_hi;
+    int oom;
+} Tracer;
+
+static uint64_t hash64(uint64_t v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    return v;
+}
+
+static void *grow(void *p, size_t *cap, size_t elem, size_t need)
+{
+    if (need <= *cap)
+        return p;
+    size_t n = *cap ? *cap * 2 : 1024;
+    while (n < need)
+        n *= 2;
+    void *q = realloc(p, n * elem);
+    if (q)
+        *cap = n;
+    return q;
+}
+
+static PcSlot *pc_slot(Tracer *t, uint64_t pc)
+{
+    if (t->npcs * 2 >= t->pc_cap)
+    {
+        size_t cap = t->pc_cap ? t->pc_cap * 2 : 4096;
+        PcSlot *n = calloc(cap, sizeof(PcSlot));
+        if (!n)
+            return NULL;
+        for (size_t i = 0; i < t->pc_cap; i++)
+        {
+            if (!t->pcs[i].pc)
+                continue;
+            size_t h = hash64(t->pcs[i].pc) & (cap - 1);
+            while (n[h].pc)
+                h = (h + 1) & (cap - 1);
+            n[h] = t->pcs[i];
+        }
+        free(t->pcs);
+        t->pcs = n;
+        t->pc_cap = cap;
+    }
+    size_t h = hash64(pc) & (t->pc_cap - 1);
+    while (t->pcs[h].pc && t->pcs[h].pc != pc)
+        h = (h + 1) & (t->pc_cap - 1);
+    if (!t->pcs[h].pc)
+    {
+        t->pcs[h].pc = pc;
+        t->npcs++;
+    }
+    return &t->pcs[h];
+}
+
+static WordSlot *word_slot(Tracer *t, uint64_t word)
+{
+    if (t->nwords * 2 >= t->word_cap)
+    {
+        size_t cap = t->word_cap ? t->word_cap * 2 : 4096;
+        WordSlot *n = calloc(cap, sizeof(WordSlot));
+        if (!n)
+            return NULL;
+        for (size_t i = 0; i < t->word_cap; i++)
+        {
+            if (!t->words[i].word)
+                continue;
+            size_t h = hash64(t->words[i].word) & (cap - 1);
+            while (n[h].word)
+                h = (h + 1) & (cap - 1);
+            n[h] = t->words[i];
+        }
+        free(t->words);
+        t->words = n;
+        t->word_cap = cap;
+    }
+    size_t h = hash64(word) & (t->word_cap - 1);
+    while (t->words[h].word && t->words[h].word != word)
+        h = (h + 1) & (t->word_cap - 1);
+    if (!t->words[h].word)
+    {
+        t->words[h].word = word; // 首次访问：等价类从 ROI 起点开始
+        t->nwords++;
+    }
+    return &t->words[h];
+}
+
+static void mem_loc(Tracer *t, uint64_t word, char *loc, size_t len)
+{
+    uint64_t addr = word * 8;
+    if (addr >= t->stack_lo && addr < t->stack_hi)
+    {
+        int64_t off = (int64_t)(addr - t->out->gate_sp);
+        snprintf(loc, len, "mem:sp%c0x%lx", off < 0 ? '-' : '+',
+                 (unsigned long)(off < 0 ? -off : off));
+    }
+    else
+    {
+        snprintf(loc, len, "mem:0x%lx", (unsigned long)addr);
+    }
+}
+
+static void add_site(Tracer *t, FiSiteKind kind, const char *loc, uint64_t pc, uint32_t hit, uint64_t weight)
+{
+    FiTraceResult *out = t->out;
+    FiSite *s = grow(out->sites, &t->site_cap, sizeof(FiSite), out->nsites + 1);
+    if (!s)
+    {
+        t->oom = 1;
+        return;
+    }
+    out->sites = s;
+    s = &out->sites[out->nsites++];
+    s->kind = kind;
+    snprintf(s->loc, sizeof(s->loc), "%s", loc);
+    s->pc = pc;
+    s->hit = hit;
+    s->weight = weight;
+}
+
+static void reg_event(Tracer *t, int r, int is_use, uint64_t n, uint64_t pc, uint32_t hit)
+{
+    uint64_t w = n - t->reg_start[r] + 1;
+    if (is_use)
+    {
+        char loc[40];
+        snprintf(loc, sizeof(loc), "reg:%s", reg_names[r]);
+        add_site(t, FI_SITE_LIVE, loc, pc, hit, w);
+    }
+    else
+    {
+        t->reg_masked[r] += w;
+    }
+    t->reg_start[r] = n + 1;
+}
+
+// 把内存字在 [start, upto) 之间遇到的屏障各自切成一个以屏障为代表点的等价类
+static void flush_barriers(Tracer *t, WordSlot *s, uint64_t upto)
+{
+    size_t lo = 0, hi = t->nbars;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (t->bars[mid].step < s->start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (size_t i = lo; i < t->nbars && t->bars[i].step < upto; i++)
+    {
+        char loc[40];
+        mem_loc(t, s->word, loc, sizeof(loc));
+        add_site(t, FI_SITE_LIVE, loc, t->bars[i].pc, t->bars[i].hit, t->bars[i].step - s->start + 1);
+        s->start = t->bars[i].step + 1;
+    }
+}
+
+static void mem_event(Tracer *t, uint64_t word, int is_use, uint64_t n, uint64_t pc, uint32_t hit)
+{
+    WordSlot *s = word_slot(t, word);
+    if (!s)
+    {
+        t->oom = 1;
+        return;
+    }
+    flush_barriers(t, s, n);
+    uint64_t w = n - s->start + 1;
+    if (is_use)
+    {
+        char loc[40];
+        mem_loc(t, word, loc, sizeof(loc));
+        add_site(t, FI_SITE_LIVE, loc, pc, hit, w);
+    }
+    else
+    {
+        s->masked += w;
+    }
+    s->start = n + 1;
+}
+
+static void account(Tracer *t, const FiInsnAccess *acc, int want_mem, uint64_t n, uint64_t pc, uint32_t hit)
+{
+    // 同一条指令既读又写同一位置时按读处理
+    uint64_t use = acc->unknown ? ALL_REGS : acc->use_regs;
+    uint64_t def = acc->unknown ? 0 : (acc->def_regs & ~use);
+    for (int r = 0; r < FI_TRACE_NREGS; r++)
+    {
+        if ((use | def) >> r & 1)
+            reg_event(t, r, (use >> r) & 1, n, pc, hit);
+    }
+    if (!want_mem)
+        return;
+
+    if (acc->unknown || acc->mem_all)
+    {
+        Barrier *b = grow(t->bars, &t->bar_cap, sizeof(Barrier), t->nbars + 1);
+        if (!b)
+        {
+            t->oom = 1;
+            return;
+        }
+        t->bars = b;
+        t->bars[t->nbars++] = (Barrier){n, pc, hit};
+    }
+    for (int i = 0; i < acc->nmem; i++)
+    {
+        uint64_t a = acc->mem[i].addr, end = a + acc->mem[i].size;
+        for (uint64_t w = a / 8; w <= (end - 1) / 8; w++)
+        {
+            // 只写且覆盖整个字才是 def，部分写保留了其余字节
+            int full = acc->mem[i].write && !acc->mem[i].read && a <= w * 8 && end >= w * 8 + 8;
+            mem_event(t, w, !full, n, pc, hit);
+        }
+    }
+}
+
+static void find_stack(pid_t pid, uint64_t *lo, uint64_t *hi)
+{
+    char path[64], line[512];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *fp = fopen(path, "r");
+    *lo = *hi = 0;
+    if (!fp)
+        return;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long s, e;
+        if (strstr(line, "[stack]") && sscanf(line, "%lx-%lx", &s, &e) == 2)
+        {
+            *lo = s;
+            *hi = e;
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+// 读取 pc 处最多 16 字节 (跨页失败时只读到页尾)
+static uint32_t read_code(pid_t pid, uint64_t pc, uint8_t *buf)
+{
+    size_t want = 16;
+    while (want > 0)
+    {
+        struct iovec local = {buf, want}, remote = {(void *)pc, want};
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n > 0)
+            return (uint32_t)n;
+        size_t to_page = 4096 - (pc & 4095);
+        want = (want > to_page) ? to_page : 0;
+    }
+    return 0;
+}
+
+int fi_trace_record(pid_t pid, uint64_t skip, uint64_t steps, int want_mem, FiTraceResult *out)
+{
+    Tracer t;
+    memset(&t, 0, sizeof(t));
+    memset(out, 0, sizeof(*out));
+    t.out = out;
+    out->skip = skip;
+    out->steps = steps;
+
+    fi_regs_t regs;
+    if (fi_get_regs(pid, &regs) < 0)
+        return -1;
+    out->gate_sp = FI_REG_SP(&regs);
+    find_stack(pid, &t.stack_lo, &t.stack_hi);
+
+    uint64_t n = 0, last_pc = 0;
+    uint32_t last_hit = 0;
+    for (uint64_t step = 0; step < skip + steps && !t.oom; step++)
+    {
+        if (step > 0 && (fi_trace_step(pid) < 0 || fi_get_regs(pid, &regs) < 0))
+            break;
+        uint64_t pc = FI_REG_PC(&regs);
+        PcSlot *ps = pc_slot(&t, pc);
+        if (!ps)
+        {
+            t.oom = 1;
+            break;
+        }
+        ps->hits++;
+        if (step < skip)
+            continue;
+
+        if (ps->ncode == 0)
+            ps->ncode = read_code(pid, pc, ps->code);
+        FiInsnAccess acc;
+        if (fi_trace_decode(ps->code, ps->ncode, &regs, &acc) < 0)
+        {
+            memset(&acc, 0, sizeof(acc));
+            acc.unknown = 1;
+        }
+        if (acc.unknown)
+            out->unknown++;
+        account(&t, &acc, want_mem, n, pc, ps->hits);
+        last_pc = pc;
+        last_hit = ps->hits;
+        n++;
+    }
+    out->executed = n;
+
+    // ROI 结束：未再访问的位置在最后一步之前注入即可代表
+    for (int r = 0; r < FI_TRACE_NREGS && n > 0; r++)
+    {
+        if (t.reg_start[r] < n)
+        {
+            char loc[40];
+            snprintf(loc, sizeof(loc), "reg:%s", reg_names[r]);
+            add_site(&t, FI_SITE_OUT, loc, last_pc, last_hit, n - t.reg_start[r]);
+        }
+    }
+    for (size_t i = 0; i < t.word_cap; i++)
+    {
+        WordSlot *s = &t.words[i];
+        if (!s->word)
+            continue;
+        flush_barriers(&t, s, n);
+        if (s->start < n)
+        {
+            char loc[40];
+            mem_loc(&t, s->word, loc, sizeof(loc));
+            add_site(&t, FI_SITE_OUT, loc, last_pc, last_hit, n - s->start);
+        }
+    }
+
+    // 已证明 masked 的注入点按位置汇总
+    for (int r = 0; r < FI_TRACE_NREGS; r++)
+    {
+        if (t.reg_masked[r])
+        {
+            char loc[40];
+            snprintf(loc, sizeof(loc), "reg:%s", reg_names[r]);
+            add_site(&t, FI_SITE_MASKED, loc, 0, 0, t.reg_masked[r]);
+            out->masked += t.reg_masked[r];
+        }
+    }
+    for (size_t i = 0; i < t.word_cap; i++)
+    {
+        if (t.words[i].word && t.words[i].masked)
+        {
+            char loc[40];
+            mem_loc(&t, t.words[i].word, loc, sizeof(loc));
+            add_site(&t, FI_SITE_MASKED, loc, 0, 0, t.words[i].masked);
+            out->masked += t.words[i].masked;
+        }
+    }
+    out->nwords = t.nwords;
+    out->space = (FI_TRACE_NREGS + t.nwords) * n;
+
+    free(t.pcs);
+    free(t.words);
+    free(t.bars);
+    if (t.oom)
+    {
+        fi_trace_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+void fi_trace_free(FiTraceResult *tr)
+{
+    free(tr->sites);
+    tr->sites = NULL;
+    tr->nsites = 0;
+}
+
+// === 4. 代表点文件 ===
+static const char *kind_names[] = {"live", "out", "masked"};
+
+int fi_trace_write_sites(FILE *fp, const FiTraceResult *tr, const char *cmd)
+{
+    fprintf(fp, "# fi_prune 代表点: %s\n", cmd);
+    fprintf(fp, "# roi %lu+%lu executed %lu gate_sp 0x%lx\n", (unsigned long)tr->skip,
+            (unsigned long)tr->steps, (unsigned long)tr->executed, (unsigned long)tr->gate_sp);
+    fprintf(fp, "# space %lu masked %lu words %lu unknown %lu\n", (unsigned long)tr->space,
+            (unsigned long)tr->masked, (unsigned long)tr->nwords, (unsigned long)tr->unknown);
+    fprintf(fp, "# kind loc pc hit weight\n");
+    for (size_t i = 0; i < tr->nsites; i++)
+    {
+        const FiSite *s = &tr->sites[i];
+        fprintf(fp, "%s %s 0x%lx %u %lu\n", kind_names[s->kind], s->loc, (unsigned long)s->pc, s->hit,
+                (unsigned long)s->weight);
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+int fi_trace_load_sites(const char *path, FiSite **sites, size_t *nsites)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    FiSite *v = NULL;
+    size_t n = 0, cap = 0;
+    char line[256];
+    int ret = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        char kind[16];
+        unsigned long pc, weight;
+        unsigned int hit;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        FiSite s;
+        memset(&s, 0, sizeof(s));
+        if (sscanf(line, "%15s %39s %lx %u %lu", kind, s.loc, &pc, &hit, &weight) != 5)
+        {
+            ret = -1;
+            break;
+        }
+        int k;
+        for (k = 0; k < 3 && strcmp(kind, kind_names[k]) != 0; k++)
+            ;
+        if (k == 3)
+        {
+            ret = -1;
+            break;
+        }
+        s.kind = (FiSiteKind)k;
+        s.pc = pc;
+        s.hit = hit;
+        s.weight = weight;
+
+        FiSite *p = grow(v, &cap, sizeof(FiSite), n + 1);
+        if (!p)
+        {
+            ret = -1;
+            break;
+        }
+        v = p;
+        v[n++] = s;
+    }
+    fclose(fp);
+    if (ret < 0)
+    {
+        free(v);
+        return -1;
+    }
+    *sites = v;
+    *nsites = n;
+    return 0;
+}
+
+int fi_trace_site_loc(const FiSite *site, FiFaultLoc *loc, int *sp_rel)
+{
+    *sp_rel = 0;
+    if (strncmp(site->loc, "mem:sp", 6) == 0)
+    {
+        char sign = site->loc[6];
+        uint64_t off = strtoull(site->loc + 7, NULL, 16);
+        if (sign != '+' && sign != '-')
+            return -1;
+        memset(loc, 0, sizeof(*loc));
+        loc->kind = FI_LOC_MEM;
+        loc->addr = (sign == '-') ? (uint64_t)-(int64_t)off : off;
+        loc->len = 8;
+        *sp_rel = 1;
+        return 0;
+    }
+    return fi_fault_parse_loc(site->loc, 0, loc);
+}
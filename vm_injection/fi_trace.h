@@ -0,0 +1,102 @@
+/*
+ * fi_trace.h - 黄金运行指令级跟踪与 def-use 故障空间剪枝
+ * 功能：从闸门放行处逐条单步执行试验子进程，对感兴趣区间 (ROI) 内的每条指令解码出
+ *       读/写了哪些通用寄存器与内存字，据此把注入点 (位置 × "第几条指令之前") 归并为等价类：
+ *         - 位置在下一次被读之前被翻转，效果都等同于紧挨着那次读之前翻转 -> 一个代表点 + 权重；
+ *         - 下一次访问是整体覆盖写 (不读) -> 整类必然 masked，无需实验。
+ *       代表点用 "第 hit 次执行到 pc 之前" 定位，注入端用断点计数精确复现。
+ *       解码器是保守的：无法识别的指令视为读取全部寄存器与内存 (只会少剪枝，不会误剪)。
+ *       支持 x86_64 与 ARM64 的常见整数/访存/分支/标量 SIMD 指令。
+ */
+
+#ifndef FI_TRACE_H
+#define FI_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "fi_fault.h"
+#include "fi_sys.h"
+
+#if defined(__x86_64__)
+#define FI_TRACE_NREGS 16 // rax..r15 (按指令编码顺序)
+#else
+#define FI_TRACE_NREGS 32 // X0..X30, SP
+#endif
+#define FI_TRACE_MAX_MEM 4
+
+// === 单条指令的访问集合 ===
+typedef struct
+{
+    uint32_t len;      // 指令长度
+    uint32_t unknown;  // 无法解码：视为读全部寄存器、读全部内存
+    uint32_t mem_all;  // 可能读任意内存 (系统调用等)
+    uint64_t use_regs; // 可能读取的寄存器 (超集)
+    uint64_t def_regs; // 必定整体覆盖写的寄存器 (子集，部分写不算)
+    int nmem;
+    struct
+    {
+        uint64_t addr;
+        uint32_t size;
+        uint8_t read, write;
+    } mem[FI_TRACE_MAX_MEM];
+} FiInsnAccess;
+
+// 解码 code 处的一条指令 (regs 用于计算有效地址)：0 成功，-1 字节不足
+int fi_trace_decode(const uint8_t *code, size_t len, const fi_regs_t *regs, FiInsnAccess *acc);
+
+// 寄存器编号 -> fi_fault_reg 可识别的名称
+const char *fi_trace_reg_name(int idx);
+
+// === 代表点 ===
+typedef enum
+{
+    FI_SITE_LIVE,   // 下一次访问是读：需要实验
+    FI_SITE_OUT,    // ROI 结束前不再访问：值带出 ROI，需要实验
+    FI_SITE_MASKED  // 下一次访问是覆盖写：必然 masked (按位置汇总成一行)
+} FiSiteKind;
+
+typedef struct
+{
+    FiSiteKind kind;
+    char loc[40];    // reg:rax / mem:0x5555... / mem:sp+0x18 (相对闸门处栈指针)
+    uint64_t pc;     // 在第 hit 次执行到 pc 之前注入
+    uint32_t hit;
+    uint64_t weight; // 等价的注入点个数
+} FiSite;
+
+typedef struct
+{
+    uint64_t skip, steps; // ROI = 放行后第 [skip, skip+steps) 条指令
+    uint64_t executed;    // ROI 内实际执行的指令数 (子进程提前结束时小于 steps)
+    uint64_t unknown;     // 无法解码的指令数
+    uint64_t nwords;      // ROI 内访问过的内存字数
+    uint64_t gate_sp;     // 闸门处的栈指针
+    uint64_t space;       // 完整故障空间：(寄存器数 + 内存字数) × executed
+    uint64_t masked;      // 已证明 masked 的注入点数
+    FiSite *sites;
+    size_t nsites;
+} FiTraceResult;
+
+// 跟踪已停在闸门处的子进程 (见 fi_forksrv_spawn_gated，调用前已放行)，ROI 结束后子进程仍处于停止状态
+// want_mem = 0 时只分析寄存器
+int fi_trace_record(pid_t pid, uint64_t skip, uint64_t steps, int want_mem, FiTraceResult *out);
+void fi_trace_free(FiTraceResult *tr);
+
+// 写出/读入代表点文件 (供 campaign_injector 的 sites 键使用)
+int fi_trace_write_sites(FILE *fp, const FiTraceResult *tr, const char *cmd);
+int fi_trace_load_sites(const char *path, FiSite **sites, size_t *nsites);
+
+// 代表点位置 -> 注入位置；sp_rel 置 1 表示 loc->addr 是相对闸门处栈指针的偏移
+int fi_trace_site_loc(const FiSite *site, FiFaultLoc *loc, int *sp_rel);
+
+// 单步执行一条指令 (途中的信号原样投递)：0 成功，-1 进程结束
+int fi_trace_step(pid_t pid);
+
+// 已停止的被跟踪进程运行到第 hit 次到达 pc (指令执行之前，已停在 pc 上算一次) 再停住：
+// 0 成功，-1 进程结束，1 超过 timeout_ms (0=不限) 仍未到达 (断点已撤除，进程停在跟踪停止状态)
+int fi_trace_run_to(pid_t pid, uint64_t pc, uint32_t hit, int timeout_ms);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * fi_trigger.c - 精确定时注入触发器实现
+ *
+ * 原理：
+ * 1. 注入器用 PTRACE_SEIZE 接管目标，目标继续全速运行，不产生任何停止信号；
+ * 2. timerfd 以 TFD_TIMER_ABSTIME 提前 FI_SPIN_NS 唤醒，随后忙等到精确截止时刻，
+ *    消除定时器唤醒抖动；
+ * 3. PTRACE_INTERRUPT 让目标进入 PTRACE_EVENT_STOP，记录实际停住时刻。
+ */
+
+#define _GNU_SOURCE
+#include "fi_trigger.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
+
+// timerfd 提前唤醒量，剩余部分忙等
+#define FI_SPIN_NS 200000ULL
+
+uint64_t fi_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t fi_realtime_to_mono(double epoch_sec)
+{
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    double now_rt = rt.tv_sec + rt.tv_nsec / 1e9;
+    double delta = epoch_sec - now_rt;
+    uint64_t now = fi_now_ns();
+    if (delta <= 0)
+        return now;
+    return now + (uint64_t)(delta * 1e9);
+}
+
+int fi_seize(pid_t pid)
+{
+    if (ptrace(PTRACE_SEIZE, pid, NULL, NULL) < 0)
+        return -1;
+    return 0;
+}
+
+int fi_interrupt_wait(pid_t pid)
+{
+    if (ptrace(PTRACE_INTERRUPT, pid, NULL, NULL) < 0)
+        return -1;
+
+    while (1)
+    {
+        int status;
+        if (waitpid(pid, &status, __WALL) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            return -1;
+        if (!WIFSTOPPED(status))
+            continue;
+        if ((status >> 16) == PTRACE_EVENT_STOP)
+            return 0;
+
+        // 信号投递停止：原样转交信号，中断请求仍然挂起
+        ptrace(PTRACE_CONT, pid, NULL, (void *)(long)WSTOPSIG(status));
+    }
+}
+
+void fi_release(pid_t pid)
+{
+    if (fi_interrupt_wait(pid) == 0)
+        ptrace(PTRACE_DETACH, pid, NULL, NULL);
+}
+
+int fi_trigger_init(FiTrigger *t, pid_t pid, uint64_t deadline_ns, uint64_t period_ns)
+{
+    memset(t, 0, sizeof(*t));
+    t->pid = pid;
+    t->base_ns = fi_now_ns();
+    t->next_ns = deadline_ns;
+    t->period_ns = period_ns;
+    t->lat_min = INT64_MAX;
+    t->lat_max = INT64_MIN;
+
+    // 降低本线程的定时器合并松弛量 (默认 50µs)
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    t->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (t->tfd < 0)
+        return -1;
+    return 0;
+}
+
+int fi_trigger_wait(FiTrigger *t, FiTriggerHit *hit)
+{
+    uint64_t wake_ns = (t->next_ns > FI_SPIN_NS) ? t->next_ns - FI_SPIN_NS : t->next_ns;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = wake_ns / 1000000000ULL;
+    its.it_value.tv_nsec = wake_ns % 1000000000ULL;
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+        its.it_value.tv_nsec = 1; // 全零会解除定时器
+
+    if (timerfd_settime(t->tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        return -1;
+
+    uint64_t expirations;
+    if (read(t->tfd, &expirations, sizeof(expirations)) < 0)
+        return (errno == EINTR) ? 1 : -1;
+
+    // 忙等剩余部分
+    while (fi_now_ns() < t->next_ns)
+        ;
+
+    if (fi_interrupt_wait(t->pid) < 0)
+        return -1;
+
+    uint64_t actual = fi_now_ns();
+    uint64_t requested = t->next_ns;
+    uint64_t overruns = 0;
+
+    // 周期模式：若本次严重滞后，跳过已错过的周期，避免连续补发
+    if (t->period_ns > 0)
+    {
+        t->next_ns += t->period_ns;
+        while (t->next_ns <= actual)
+        {
+            t->next_ns += t->period_ns;
+            overruns++;
+        }
+    }
+
+    t->fired++;
+    t->missed += overruns;
+
+    int64_t lat = (int64_t)(actual - requested);
+    if (lat < t->lat_min)
+        t->lat_min = lat;
+    if (lat > t->lat_max)
+        t->lat_max = lat;
+    t->lat_sum += lat;
+    if (lat > 100000)
+        t->over_100us++;
+
+    if (hit)
+    {
+        hit->seq = t->fired;
+        hit->requested_ns = requested;
+        hit->actual_ns = actual;
+        hit->overruns = overruns;
+    }
+
+    if (t->log)
+    {
+        fprintf(t->log, "%llu,%llu,%llu,%lld,%llu\n",
+                (unsigned long long)t->fired,
+                (unsigned long long)requested,
+                (unsigned long long)actual,
+                (long long)lat,
+                (unsigned long long)overruns);
+        fflush(t->log);
+    }
+    return 0;
+}
+
+void fi_trigger_report(const FiTrigger *t)
+{
+    if (t->fired == 0)
+    {
+        printf(" [触发统计] 未发生触发\n");
+        return;
+    }
+    printf(" [触发统计] 次数: %llu, 错过周期: %llu\n",
+           (unsigned long long)t->fired, (unsigned long long)t->missed);
+    printf("            偏差 min/avg/max: %.1f / %.1f / %.1f µs, 超过100µs: %llu 次\n",
+           t->lat_min / 1000.0,
+           t->lat_sum / t->fired / 1000.0,
+           t->lat_max / 1000.0,
+           (unsigned long long)t->over_100us);
+}
+
+void fi_trigger_close(FiTrigger *t)
+{
+    if (t->tfd >= 0)
+        close(t->tfd);
+    t->tfd = -1;
+    if (t->log)
+        fclose(t->log);
+    t->log = NULL;
+}
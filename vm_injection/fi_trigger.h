@@ -0,0 +1,65 @@
+/*
+ * fi_trigger.h - 精确定时注入触发器
+ * 基于 timerfd(CLOCK_MONOTONIC) + PTRACE_SEIZE/PTRACE_INTERRUPT，
+ * 替代 ualarm + SIGSTOP：目标不会收到任何停止信号，触发时刻可精确到 100µs 以内。
+ * 支持相对延时、绝对截止时间与周期调度，并记录每次注入的请求/实际时刻。
+ */
+
+#ifndef FI_TRIGGER_H
+#define FI_TRIGGER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 单次触发记录
+typedef struct
+{
+    uint64_t seq;          // 第几次触发 (从 1 开始)
+    uint64_t requested_ns; // 请求的触发时刻 (CLOCK_MONOTONIC)
+    uint64_t actual_ns;    // 目标实际停住的时刻
+    uint64_t overruns;     // 期间错过的周期数
+} FiTriggerHit;
+
+// 触发器上下文
+typedef struct
+{
+    pid_t pid;
+    int tfd;
+    uint64_t base_ns;   // 创建时刻，用于输出相对时间
+    uint64_t next_ns;   // 下一次请求的触发时刻
+    uint64_t period_ns; // 0 = 单次触发
+    uint64_t fired;
+    uint64_t missed;
+    // 偏差统计 (纳秒)
+    int64_t lat_min;
+    int64_t lat_max;
+    double lat_sum;
+    uint64_t over_100us;
+    FILE *log; // 可选：逐次记录 CSV
+} FiTrigger;
+
+uint64_t fi_now_ns(void);
+
+// 把 CLOCK_REALTIME 绝对时间 (秒) 换算为 CLOCK_MONOTONIC 纳秒
+uint64_t fi_realtime_to_mono(double epoch_sec);
+
+// PTRACE_SEIZE 目标 (不停止目标，也不发送信号)
+int fi_seize(pid_t pid);
+
+// 中断已 seize 的目标并等待其进入 PTRACE_EVENT_STOP；目标退出返回 -1
+int fi_interrupt_wait(pid_t pid);
+
+// 停止并脱离目标
+void fi_release(pid_t pid);
+
+// deadline_ns: 首次触发的绝对时刻；period_ns: 周期 (0=单次)
+int fi_trigger_init(FiTrigger *t, pid_t pid, uint64_t deadline_ns, uint64_t period_ns);
+
+// 等到下一个触发点，令目标停住。成功返回 0，目标退出返回 -1，被打断返回 1
+int fi_trigger_wait(FiTrigger *t, FiTriggerHit *hit);
+
+void fi_trigger_report(const FiTrigger *t);
+void fi_trigger_close(FiTrigger *t);
+
+#endif
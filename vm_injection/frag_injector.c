@@ -0,0 +1,639 @@
+/*
+ * frag_injector.c - 物理内存碎片化注入器
+ * 功能：故意打碎伙伴系统，使 THP / hugetlb 大页无法分配，测试 qemu 客户机、JVM 在缺少大页时的退化。
+ *       先以 4k 页占满空闲内存 (含可回收的页缓存)，再按 /proc/self/pagemap 的物理页帧号，
+ *       在每个 2^order 页的物理块中只留一页、其余释放 (-g 1 即每隔一页释放)，留下的页 mlock 钉住；
+ *       -c 同时设置 compact_unevictable_allowed=0 等，使压缩无法迁走钉住的页，大页无法重新拼出。
+ *       前后对比 /proc/buddyinfo、/proc/vmstat 中 thp_fault_fallback 与压缩计数，
+ *       逐秒报告目标进程 smaps 中的 AnonHugePages，并以本进程的 MADV_HUGEPAGE 探测区直接验证。
+ * 编译：gcc -o frag_injector frag_injector.c
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#ifndef MLOCK_ONFAULT
+#define MLOCK_ONFAULT 0x01
+#endif
+
+#define CHUNK_MB 16
+#define CHUNK_BYTES ((size_t)CHUNK_MB << 20)
+#define MAX_CHUNKS 65536
+#define MAX_ZONES 16
+#define MAX_ORDERS 16
+#define MAX_TARGETS 64
+#define PROBE_MB 32 // 大页探测区大小
+
+volatile int keep_running = 1;
+
+static size_t page_size, huge_size;
+static char *chunks[MAX_CHUNKS];
+static int nchunks = 0;
+static char **huges; // 收尾阶段整块取走的 THP
+static int nhuges = 0;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+// === 1. 系统计数 ===
+
+typedef struct
+{
+    int nzones;
+    int norders;
+    char name[MAX_ZONES][32]; // "Node 0 Normal"
+    long cnt[MAX_ZONES][MAX_ORDERS];
+} Buddy;
+
+static int read_buddy(Buddy *b)
+{
+    char line[512];
+    FILE *fp = fopen("/proc/buddyinfo", "r");
+
+    memset(b, 0, sizeof(*b));
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp) && b->nzones < MAX_ZONES)
+    {
+        int node, off = 0, n = 0;
+        char zone[16];
+        if (sscanf(line, "Node %d, zone %15s %n", &node, zone, &off) < 2)
+            continue;
+        char *p = line + off, *end;
+        for (long v = strtol(p, &end, 10); end != p && n < MAX_ORDERS; v = strtol(p, &end, 10))
+        {
+            b->cnt[b->nzones][n++] = v;
+            p = end;
+        }
+        snprintf(b->name[b->nzones], sizeof(b->name[0]), "Node %d %s", node, zone);
+        if (n > b->norders)
+            b->norders = n;
+        b->nzones++;
+    }
+    fclose(fp);
+    return b->nzones > 0 ? 0 : -1;
+}
+
+// 阶数不低于 order 的空闲块折合多少个 order 块 (即还能直接满足多少次该阶分配)
+static long zone_blocks(const Buddy *b, int z, int order)
+{
+    long n = 0;
+    for (int o = order; o < b->norders; o++)
+        n += b->cnt[z][o] << (o - order);
+    return n;
+}
+
+static long buddy_blocks(const Buddy *b, int order)
+{
+    long n = 0;
+    for (int z = 0; z < b->nzones; z++)
+        n += zone_blocks(b, z, order);
+    return n;
+}
+
+static void print_buddy(const Buddy *before, const Buddy *after, int huge_order)
+{
+    printf("  阶  块大小      碎片化前      碎片化后\n");
+    for (int o = 0; o < before->norders; o++)
+    {
+        long a = 0, c = 0;
+        for (int z = 0; z < before->nzones; z++)
+        {
+            a += before->cnt[z][o];
+            c += after->cnt[z][o];
+        }
+        printf("  %2d %7zuK %13ld %13ld%s\n", o, (page_size << o) >> 10, a, c, o == huge_order ? "  <- 大页" : "");
+    }
+    for (int z = 0; z < before->nzones; z++)
+        printf("  %-18s 可直接分配的大页: %ld -> %ld\n", before->name[z],
+               zone_blocks(before, z, huge_order), zone_blocks(after, z, huge_order));
+}
+
+typedef struct
+{
+    unsigned long long fault_alloc, fault_fallback;
+    unsigned long long collapse_alloc, collapse_failed;
+    unsigned long long compact_stall, compact_fail, compact_success;
+} VmStat;
+
+static void read_vmstat(VmStat *v)
+{
+    char key[64];
+    unsigned long long val;
+    FILE *fp = fopen("/proc/vmstat", "r");
+
+    memset(v, 0, sizeof(*v));
+    if (!fp)
+        return;
+    while (fscanf(fp, "%63s %llu", key, &val) == 2)
+    {
+        if (strcmp(key, "thp_fault_alloc") == 0)
+            v->fault_alloc = val;
+        else if (strcmp(key, "thp_fault_fallback") == 0)
+            v->fault_fallback = val;
+        else if (strcmp(key, "thp_collapse_alloc") == 0)
+            v->collapse_alloc = val;
+        else if (strcmp(key, "thp_collapse_alloc_failed") == 0)
+            v->collapse_failed = val;
+        else if (strcmp(key, "compact_stall") == 0)
+            v->compact_stall = val;
+        else if (strcmp(key, "compact_fail") == 0)
+            v->compact_fail = val;
+        else if (strcmp(key, "compact_success") == 0)
+            v->compact_success = val;
+    }
+    fclose(fp);
+}
+
+// 从 "Key:   123 kB" 形式的文件中读取一个键 (单位 kB)，缺失返回 -1
+static long long read_kb(const char *path, const char *key)
+{
+    char line[256];
+    long long v = -1;
+    size_t len = strlen(key);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, key, len) == 0 && line[len] == ':')
+        {
+            v = atoll(line + len + 1);
+            break;
+        }
+    }
+    fclose(fp);
+    return v;
+}
+
+// 目标进程 AnonHugePages 之和 (MB)，全部不可读返回 -1
+static double targets_thp_mb(const pid_t *pids, int n)
+{
+    char path[64];
+    long long sum = 0;
+    int ok = 0;
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", pids[i]);
+        long long kb = read_kb(path, "AnonHugePages");
+        if (kb >= 0)
+        {
+            sum += kb;
+            ok = 1;
+        }
+    }
+    return ok ? sum / 1024.0 : -1;
+}
+
+static void read_word(const char *path, char *buf, size_t len)
+{
+    FILE *fp = fopen(path, "r");
+    buf[0] = '\0';
+    if (fp)
+    {
+        if (!fgets(buf, len, fp))
+            buf[0] = '\0';
+        fclose(fp);
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+}
+
+// === 2. 压制内存压缩 ===
+
+// 钉住的页均为 mlock 页；compact_unevictable_allowed=0 时压缩跳过不可回收页，碎片无法被整理
+static const struct
+{
+    const char *path;
+    const char *value;
+} no_compact[] = {
+    {"/proc/sys/vm/compact_unevictable_allowed", "0"},
+    {"/proc/sys/vm/compaction_proactiveness", "0"}, // 5.9+，关闭 kcompactd 主动压缩
+    {"/proc/sys/vm/extfrag_threshold", "1000"},     // 高阶分配失败时倾向回收而非压缩
+};
+#define NO_COMPACT_N (int)(sizeof(no_compact) / sizeof(no_compact[0]))
+
+static char saved_sysctl[NO_COMPACT_N][32];
+
+static void block_compaction(void)
+{
+    for (int i = 0; i < NO_COMPACT_N; i++)
+    {
+        read_word(no_compact[i].path, saved_sysctl[i], sizeof(saved_sysctl[i]));
+        if (!saved_sysctl[i][0])
+            continue;
+        FILE *fp = fopen(no_compact[i].path, "w");
+        int ok = fp && fprintf(fp, "%s\n", no_compact[i].value) > 0;
+        if (fp && fclose(fp) != 0)
+            ok = 0;
+        if (!ok)
+        {
+            printf("[提示] 无法写入 %s (%s)，需要 root\n", no_compact[i].path, strerror(errno));
+            saved_sysctl[i][0] = '\0';
+            continue;
+        }
+        printf("[*] %s: %s -> %s\n", no_compact[i].path, saved_sysctl[i], no_compact[i].value);
+    }
+}
+
+static void restore_compaction(void)
+{
+    for (int i = 0; i < NO_COMPACT_N; i++)
+    {
+        if (!saved_sysctl[i][0])
+            continue;
+        FILE *fp = fopen(no_compact[i].path, "w");
+        if (fp)
+        {
+            fprintf(fp, "%s\n", saved_sysctl[i]);
+            fclose(fp);
+        }
+    }
+}
+
+// === 3. 占满与碎片化 ===
+
+static char *map_chunk(void)
+{
+    char *p = mmap(NULL, CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    // 逐个 4k 页取得物理页；MADV_POPULATE_WRITE 不可用时由下面的写入逐页缺页
+    madvise(p, CHUNK_BYTES, MADV_NOHUGEPAGE);
+    madvise(p, CHUNK_BYTES, MADV_POPULATE_WRITE);
+    for (size_t off = 0; off < CHUNK_BYTES; off += page_size)
+        *(volatile uint64_t *)(p + off) = (uintptr_t)(p + off) * 0x9E3779B97F4A7C15ULL;
+    return p;
+}
+
+static unsigned char *seen; // 已留页的物理块位图，按块号索引
+static size_t seen_bytes;
+
+// 块号首次出现返回 1
+static int first_in_block(uint64_t blk)
+{
+    size_t byte = blk >> 3;
+    if (byte >= seen_bytes)
+    {
+        size_t n = seen_bytes ? seen_bytes : 4096;
+        while (n <= byte)
+            n *= 2;
+        unsigned char *p = realloc(seen, n);
+        if (!p)
+            return 1;
+        memset(p + seen_bytes, 0, n - seen_bytes);
+        seen = p;
+        seen_bytes = n;
+    }
+    if (seen[byte] & (1 << (blk & 7)))
+        return 0;
+    seen[byte] |= 1 << (blk & 7);
+    return 1;
+}
+
+typedef struct
+{
+    long kept, freed;
+    int by_pfn;  // 0 表示无 PFN (非 root)，按虚拟地址交替
+    int lock_failed;
+} FragStat;
+
+// 每个 2^order 页的物理块只留第一页，其余 MADV_DONTNEED 还给伙伴系统，留下的页 mlock
+static void fragment_chunk(char *p, int fd, int order, FragStat *st)
+{
+    size_t npages = CHUNK_BYTES / page_size;
+    uint64_t *ent = malloc(npages * sizeof(uint64_t));
+    size_t run = 0; // 当前待释放区间起点 (页号)，与 i 相等表示无
+
+    if (!ent)
+        return;
+    if (fd < 0 || pread(fd, ent, npages * sizeof(uint64_t), (uintptr_t)p / page_size * sizeof(uint64_t)) != (ssize_t)(npages * sizeof(uint64_t)))
+        memset(ent, 0, npages * sizeof(uint64_t));
+
+    for (size_t i = 0; i <= npages; i++)
+    {
+        int keep = 0;
+        if (i < npages)
+        {
+            uint64_t pfn = ent[i] & ((1ULL << 55) - 1);
+            if ((ent[i] >> 63) && pfn)
+            {
+                st->by_pfn = 1;
+                keep = first_in_block(pfn >> order);
+            }
+            else
+                keep = (((uintptr_t)p / page_size + i) & ((1UL << order) - 1)) == 0;
+            if (!keep)
+                continue;
+            st->kept++;
+        }
+        if (i > run)
+        {
+            madvise(p + run * page_size, (i - run) * page_size, MADV_DONTNEED);
+            st->freed += i - run;
+        }
+        run = i + 1;
+    }
+    free(ent);
+
+    // MLOCK_ONFAULT 只锁已驻留的页，释放出的空洞不会被重新填充；整块只产生一个 VMA
+    if (!st->lock_failed && syscall(SYS_mlock2, p, CHUNK_BYTES, MLOCK_ONFAULT) < 0)
+    {
+        printf("[提示] mlock2 失败 (%s)，留下的页未锁定，可能被换出或迁移\n", strerror(errno));
+        st->lock_failed = 1;
+    }
+}
+
+// 保留量里残留的整块无法用 4k 分配触及 (伙伴系统优先用碎块)，改以 THP 缺页整块取走并锁定，
+// 直到缺页不再得到大页；总量不超过 limit_mb，即占满阶段已让出的保留量
+static void mop_up(long long limit_mb)
+{
+    int max = (int)((limit_mb << 20) / huge_size);
+    long long base = read_kb("/proc/self/smaps_rollup", "AnonHugePages");
+
+    huges = calloc(max > 0 ? max : 1, sizeof(char *));
+    if (!huges || base < 0)
+        return;
+    while (nhuges < max && keep_running)
+    {
+        char *raw = mmap(NULL, huge_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            break;
+        char *p = (char *)(((uintptr_t)raw + huge_size - 1) & ~(uintptr_t)(huge_size - 1));
+        if (p > raw)
+            munmap(raw, p - raw);
+        munmap(p + huge_size, raw + huge_size - p);
+        madvise(p, huge_size, MADV_HUGEPAGE);
+        *(volatile char *)p = 1;
+        if (read_kb("/proc/self/smaps_rollup", "AnonHugePages") - base < (long long)(nhuges + 1) * (huge_size >> 10))
+        {
+            munmap(p, huge_size);
+            break;
+        }
+        mlock(p, huge_size);
+        huges[nhuges++] = p;
+    }
+}
+
+// === 4. 大页探测 ===
+
+// 映射 PROBE_MB 的 MADV_HUGEPAGE 区并写满，返回其中由 THP 承载的比例 (%)，THP 关闭时为 -1
+static double probe_thp(void)
+{
+    size_t len = (size_t)PROBE_MB << 20, align = huge_size;
+    long long before = read_kb("/proc/self/smaps_rollup", "AnonHugePages");
+    char *raw = mmap(NULL, len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED || before < 0)
+        return -1;
+    char *p = (char *)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+    if (madvise(p, len, MADV_HUGEPAGE) < 0)
+    {
+        munmap(raw, len + align);
+        return -1;
+    }
+    for (size_t off = 0; off < len; off += page_size)
+        p[off] = 1;
+    long long after = read_kb("/proc/self/smaps_rollup", "AnonHugePages");
+    munmap(raw, len + align);
+    return (after - before) * 100.0 / (len >> 10);
+}
+
+// === 5. 主流程 ===
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char *argv[])
+{
+    long long size_mb = 0, reserve_mb = 256;
+    int duration = 60, order = -1, nocompact = 0;
+    pid_t targets[MAX_TARGETS];
+    int ntargets = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:r:g:cd:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            size_mb = atoll(optarg);
+            break;
+        case 'r':
+            reserve_mb = atoll(optarg);
+            break;
+        case 'g':
+            order = atoi(optarg);
+            break;
+        case 'c':
+            nocompact = 1;
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 't':
+        {
+            char list[1024], *save = NULL;
+            snprintf(list, sizeof(list), "%s", optarg);
+            for (char *tok = strtok_r(list, ",", &save); tok && ntargets < MAX_TARGETS; tok = strtok_r(NULL, ",", &save))
+                targets[ntargets++] = atoi(tok);
+            break;
+        }
+        default:
+            printf("用法: %s [-s 占用MB] [-r 保留MB] [-g 阶] [-c] [-d 秒] [-t PID[,PID...]]\n", argv[0]);
+            printf("  -s MB     先占用多少内存再打碎 (默认: MemAvailable - 保留量，连同页缓存一起覆盖，\n");
+            printf("            再以 THP 缺页整块取走保留量中残留的大页)\n");
+            printf("  -r MB     MemAvailable 保留量 (默认 256MB)\n");
+            printf("  -g 阶     每个 2^阶 页的物理块钉住一页 (默认为大页阶，1 即每隔一页释放)\n");
+            printf("  -c        阻止压缩整理：compact_unevictable_allowed=0 等，结束后恢复\n");
+            printf("  -d 秒     保持碎片状态的时长 (默认 60)\n");
+            printf("  -t PID    逐秒报告这些进程 smaps 中的 AnonHugePages\n");
+            printf("示例: sudo %s -c -t $(pidof qemu-system-aarch64) -d 120\n", argv[0]);
+            printf("      sudo %s -g 1 -s 2048 -d 30\n", argv[0]);
+            return 1;
+        }
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    char buf[128];
+    read_word("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", buf, sizeof(buf));
+    huge_size = buf[0] ? strtoull(buf, NULL, 10) : 2UL << 20;
+    int huge_order = 0;
+    while ((page_size << huge_order) < huge_size)
+        huge_order++;
+    if (order < 0)
+        order = huge_order;
+    if (order < 1 || order >= MAX_ORDERS || duration <= 0)
+    {
+        printf("[错误] 阶需在 1-%d，时长需大于 0\n", MAX_ORDERS - 1);
+        return 1;
+    }
+    for (int i = 0; i < ntargets; i++)
+    {
+        if (targets[i] <= 0 || kill(targets[i], 0) < 0)
+        {
+            printf("[错误] 无效或不存在的 PID: %d\n", targets[i]);
+            return 1;
+        }
+    }
+
+    long long avail = read_kb("/proc/meminfo", "MemAvailable") / 1024;
+    int whole = size_mb <= 0; // 未指定 -s：覆盖整机空闲内存，并收尾保留量中的整块
+    if (whole)
+        size_mb = avail - reserve_mb;
+    if (size_mb < CHUNK_MB || size_mb / CHUNK_MB > MAX_CHUNKS)
+    {
+        printf("[错误] 占用量 %lld MB 超出范围 (%d - %d MB)，MemAvailable %lld MB\n", size_mb, CHUNK_MB, MAX_CHUNKS * CHUNK_MB, avail);
+        return 1;
+    }
+
+    struct rlimit rl = {RLIM_INFINITY, RLIM_INFINITY};
+    setrlimit(RLIMIT_MEMLOCK, &rl); // 非 root 时失败，由 mlock2 报错提示
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    char thp_enabled[64], thp_defrag[64];
+    read_word("/sys/kernel/mm/transparent_hugepage/enabled", thp_enabled, sizeof(thp_enabled));
+    read_word("/sys/kernel/mm/transparent_hugepage/defrag", thp_defrag, sizeof(thp_defrag));
+    printf("=== 物理内存碎片化注入器 ===\n");
+    printf("占用 %lld MB 后每 %zuKB 物理块钉住一页 (阶 %d，大页阶 %d)，保持 %d 秒%s\n",
+           size_mb, (page_size << order) >> 10, order, huge_order, duration, nocompact ? "，阻止压缩" : "");
+    printf("THP enabled: %s\nTHP defrag:  %s\n\n", thp_enabled, thp_defrag);
+
+    // --- 基线 ---
+    Buddy b0, b1, b2;
+    VmStat v0, v1, vprev;
+    read_buddy(&b0);
+    read_vmstat(&v0);
+    double probe0 = probe_thp();
+    double thp0 = targets_thp_mb(targets, ntargets);
+
+    if (nocompact)
+        block_compaction();
+
+    // --- 占满：全部分配完再打碎，否则释放的页会被下一块立即取回 ---
+    long long t0 = now_ms();
+    int max_chunks = (int)(size_mb / CHUNK_MB);
+    while (nchunks < max_chunks && keep_running)
+    {
+        avail = read_kb("/proc/meminfo", "MemAvailable") / 1024;
+        if (avail >= 0 && avail - CHUNK_MB < reserve_mb)
+        {
+            printf("[下限] MemAvailable %lld MB 接近保留量 %lld MB，停止占用\n", avail, reserve_mb);
+            break;
+        }
+        char *p = map_chunk();
+        if (!p)
+        {
+            printf("[提示] mmap 失败 (%s)，按已占用部分继续\n", strerror(errno));
+            break;
+        }
+        chunks[nchunks++] = p;
+    }
+    printf("[*] 已占用 %d MB (%.1f 秒)，按物理页帧打碎...\n", nchunks * CHUNK_MB, (now_ms() - t0) / 1000.0);
+
+    // --- 打碎 ---
+    FragStat fs = {0};
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    for (int i = 0; i < nchunks && keep_running; i++)
+        fragment_chunk(chunks[i], fd, order, &fs);
+    if (fd >= 0)
+        close(fd);
+    free(seen);
+    if (!fs.by_pfn)
+        printf("[提示] pagemap 未给出物理页帧号 (需要 root)，改为按虚拟地址每 %d 页留一页，效果取决于分配的物理连续性\n", 1 << order);
+    printf("[*] 钉住 %ld 页 (%.1f MB)，每页占据一个物理块，释放 %.1f MB%s\n",
+           fs.kept, fs.kept * page_size / 1048576.0, fs.freed * page_size / 1048576.0,
+           fs.lock_failed ? "，未锁定" : "");
+    if (whole && keep_running)
+    {
+        mop_up(reserve_mb);
+        printf("[*] 收尾：以 THP 缺页整块取走残留大页 %d 个 (%zu MB)\n", nhuges, nhuges * (huge_size >> 20));
+    }
+    printf("\n");
+
+    read_buddy(&b1);
+    if (b0.nzones && b1.nzones)
+    {
+        print_buddy(&b0, &b1, huge_order);
+        printf("\n");
+    }
+
+    // --- 保持并逐秒报告 ---
+    if (ntargets > 0)
+        printf("  秒  目标THP MB  THP分配/s  回退/s  collapse失败/s  压缩stall/s  压缩成功/s  可用大页\n");
+    else
+        printf("  秒  THP分配/s  回退/s  collapse失败/s  压缩stall/s  压缩成功/s  可用大页\n");
+    read_vmstat(&vprev);
+    long long start = now_ms();
+    for (int sec = 1; sec <= duration && keep_running; sec++)
+    {
+        long long wait = start + sec * 1000LL - now_ms();
+        if (wait > 0)
+            usleep(wait * 1000);
+        if (!keep_running)
+            break;
+        VmStat v;
+        Buddy b;
+        read_vmstat(&v);
+        read_buddy(&b);
+        printf("%4d", sec);
+        if (ntargets > 0)
+            printf(" %11.0f", targets_thp_mb(targets, ntargets));
+        printf(" %10llu %7llu %15llu %12llu %11llu %9ld\n",
+               v.fault_alloc - vprev.fault_alloc, v.fault_fallback - vprev.fault_fallback,
+               v.collapse_failed - vprev.collapse_failed, v.compact_stall - vprev.compact_stall,
+               v.compact_success - vprev.compact_success, buddy_blocks(&b, huge_order));
+        fflush(stdout);
+        vprev = v;
+    }
+
+    // --- 结果：先在碎片状态下探测，再释放 ---
+    double probe1 = probe_thp();
+    double thp1 = targets_thp_mb(targets, ntargets);
+    read_vmstat(&v1);
+    while (nchunks > 0)
+        munmap(chunks[--nchunks], CHUNK_BYTES);
+    while (nhuges > 0)
+        munmap(huges[--nhuges], huge_size);
+    free(huges);
+    if (nocompact)
+        restore_compaction();
+    read_buddy(&b2);
+
+    printf("\n[结果] vmstat 增量 (碎片化期间):\n");
+    printf("  thp_fault_alloc %llu, thp_fault_fallback %llu, thp_collapse_alloc %llu, thp_collapse_alloc_failed %llu\n",
+           v1.fault_alloc - v0.fault_alloc, v1.fault_fallback - v0.fault_fallback,
+           v1.collapse_alloc - v0.collapse_alloc, v1.collapse_failed - v0.collapse_failed);
+    printf("  compact_stall %llu, compact_fail %llu, compact_success %llu\n",
+           v1.compact_stall - v0.compact_stall, v1.compact_fail - v0.compact_fail, v1.compact_success - v0.compact_success);
+    if (probe0 >= 0)
+        printf("  探测区 (%dMB, MADV_HUGEPAGE) 由 THP 承载: %.0f%% -> %.0f%%\n", PROBE_MB, probe0, probe1);
+    else
+        printf("  探测区: THP 不可用 (enabled=never 或内核不支持)\n");
+    if (ntargets > 0 && thp0 >= 0)
+        printf("  目标 AnonHugePages: %.0f MB -> %.0f MB (已有大页不会被拆分，只影响新缺页与 khugepaged 合并)\n", thp0, thp1);
+    printf("  可直接分配的大页: 之前 %ld，碎片化后 %ld，释放后 %ld\n",
+           buddy_blocks(&b0, huge_order), buddy_blocks(&b1, huge_order), buddy_blocks(&b2, huge_order));
+    printf("释放内存%s，退出。\n", nocompact ? "、恢复压缩设置" : "");
+    return 0;
+}
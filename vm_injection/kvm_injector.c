@@ -6,9 +6,10 @@
  *   - 软错误注入：寄存器位翻转、交换、覆盖
  *   - 客户OS错误行为：随机修改进程状态
  *   - 性能故障：qemu-kvm ioctl延迟
- *   - 维护故障：CPU热插拔
+ *   - 维护故障：CPU热插拔、热插拔风暴 (测量切换与vCPU迁移耗时)
+ *   - 内存干扰：客户机内存 KSM 合并风暴、THP 合并/拆分循环 (经 fi_remote 在 qemu 内执行 madvise)
  * 
- * 编译：gcc -o kvm_injector kvm_injector.c -lpthread
+ * 编译：gcc -o kvm_injector kvm_injector.c fi_remote.c fi_sys.c fi_trigger.c fi_mark.c -lpthread
  */
 
 #define _GNU_SOURCE
@@ -25,6 +26,12 @@
 #include <time.h>
 #include <pthread.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#include "fi_remote.h"
+#include "fi_mark.h"
 
 // === 故障类型枚举 ===
 typedef enum {
@@ -158,7 +165,7 @@ int inject_soft_error(int pid, SoftErrorType error_type, const char *target_reg,
     
     if (access("./reg_injector", F_OK) != 0) {
         printf("  未找到reg_injector，尝试编译...\n");
-        system("gcc -o reg_injector reg_injector.c 2>/dev/null");
+        system("make -s reg_injector 2>/dev/null");
     }
     
     if (bit >= 0) {
@@ -225,6 +232,7 @@ int inject_performance_fault(int pid, int delay_ms)
         // 尝试 v2 恢复 (移回 cgroup.procs)
         snprintf(cmd, sizeof(cmd), "echo %d > /sys/fs/cgroup/cgroup.procs 2>/dev/null", pid);
         system(cmd);
+        fi_mark_write("stop", "kvm_injector:perf-clear");
 
         printf(" 已尝试清理性能限制\n");
         return 0;
@@ -292,6 +300,7 @@ int inject_performance_fault(int pid, int delay_ms)
         system(cmd);
         printf("   通过cpulimit限制CPU使用率为 %d%%\n", cpu_percent);
     }
+    fi_mark_write("start", "kvm_injector:perf-delay");
 
     return 0;
 }
@@ -311,10 +320,10 @@ int inject_cpu_stress(int pid, int duration, int threads)
     if (access("./cpu_injector", F_OK) != 0)
     {
         printf("  未找到 cpu_injector，尝试自动编译...\n");
-        int ret = system("gcc -o cpu_injector cpu_injector.c -lpthread -lm 2>/dev/null");
+        int ret = system("make -s cpu_injector 2>/dev/null"); // 源文件列表只在 Makefile 中维护
         if (ret != 0)
         {
-            printf("  [错误] 编译失败！请确认 cpu_injector.c 存在且已安装 gcc。\n");
+            printf("  [错误] 编译失败！请确认在 vm_injection 目录下运行且已安装 gcc/make。\n");
             return -1;
         }
     }
@@ -397,6 +406,673 @@ void clear_all_faults() {
     printf(" 故障清理完成\n");
 }
 
+// === CPU热插拔风暴：轮流下线/上线一组CPU，测量每次切换耗时与vCPU线程迁移耗时 ===
+#define STORM_MAX_CPUS 256
+#define STORM_MAX_SAMPLES 100000
+
+static volatile sig_atomic_t storm_stop = 0;
+
+static void storm_signal(int sig) {
+    (void)sig;
+    storm_stop = 1;
+}
+
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latency(const char *name, long long *v, int n) {
+    if (n == 0) {
+        printf("   %-12s 无样本\n", name);
+        return;
+    }
+    qsort(v, n, sizeof(long long), cmp_ll);
+    long long sum = 0;
+    for (int i = 0; i < n; i++) sum += v[i];
+    printf("   %-12s %6d 次  最小 %8.2f ms  平均 %8.2f ms  p99 %8.2f ms  最大 %8.2f ms\n", name, n,
+           v[0] / 1e6, sum / 1e6 / n, v[(int)(n * 0.99) < n ? (int)(n * 0.99) : n - 1] / 1e6, v[n - 1] / 1e6);
+}
+
+// 读取线程最后运行的CPU (stat 第39字段) 与累计运行时间 (schedstat 第1字段)
+static int thread_cpu_run(int pid, int tid, long long *run) {
+    char path[128], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    if (fscanf(fp, "%lld", run) != 1) *run = 0;
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", pid, tid);
+    fp = fopen(path, "r");
+    if (!fp) return -1;
+    if (!fgets(buf, sizeof(buf), fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    for (int field = 3; field <= 39; field++) {
+        p = strchr(p + 1, ' ');
+        if (!p) return -1;
+    }
+    return atoi(p);
+}
+
+// qemu 的 vCPU 线程名为 "CPU n/KVM"；找不到时退化为全部线程
+static int find_vcpu_threads(int pid, int *tids, int max) {
+    char path[64], comm[64];
+    int n = 0, all = 0;
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    for (int pass = 0; pass < 2 && n == 0; pass++) {
+        DIR *d = opendir(path);
+        if (!d) return 0;
+        struct dirent *e;
+        while ((e = readdir(d)) && n < max) {
+            int tid = atoi(e->d_name);
+            if (tid <= 0) continue;
+            char cpath[128];
+            snprintf(cpath, sizeof(cpath), "/proc/%d/task/%d/comm", pid, tid);
+            FILE *fp = fopen(cpath, "r");
+            if (!fp) continue;
+            if (!fgets(comm, sizeof(comm), fp)) comm[0] = 0;
+            fclose(fp);
+            if (pass == 1 || strncmp(comm, "CPU ", 4) == 0) tids[n++] = tid;
+        }
+        closedir(d);
+        all = pass;
+    }
+    if (all && n > 0) printf("   未找到 \"CPU n/KVM\" 线程，改为跟踪全部 %d 个线程\n", n);
+    return n;
+}
+
+// 写 online 文件 (不经 shell)，返回耗时 (纳秒)，失败返回 -errno
+static long long set_cpu_online(int fd, int online) {
+    long long t0 = mono_ns();
+    if (pwrite(fd, online ? "1" : "0", 1, 0) != 1) return -errno;
+    return mono_ns() - t0;
+}
+
+int inject_cpu_hotplug_storm(const char *list, int duration, int interval_ms, int pid) {
+    int cpus[STORM_MAX_CPUS], fds[STORM_MAX_CPUS], orig[STORM_MAX_CPUS], ncpu = 0;
+    char path[128];
+
+    printf(" [CPU热插拔风暴]\n");
+
+    // 解析 "2-5,8" 形式的CPU列表
+    const char *s = list;
+    while (*s && ncpu < STORM_MAX_CPUS) {
+        char *end;
+        int a = strtol(s, &end, 10), b = a;
+        if (end == s) break;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (int c = a; c <= b && ncpu < STORM_MAX_CPUS; c++) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/online", c);
+            int fd = open(path, O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                printf("   跳过 CPU%d: 不支持热插拔或不存在\n", c);
+                continue;
+            }
+            char v = '1';
+            if (pread(fd, &v, 1, 0) != 1) v = '1';
+            cpus[ncpu] = c;
+            fds[ncpu] = fd;
+            orig[ncpu] = (v == '1');
+            ncpu++;
+        }
+        s = (*end == ',') ? end + 1 : end;
+        if (*end != ',') break;
+    }
+    if (ncpu == 0) {
+        printf(" 没有可热插拔的CPU (需要root，CPU0通常不能下线)\n");
+        return -1;
+    }
+    if (interval_ms <= 0) interval_ms = 100;
+
+    int tids[512], ntids = pid > 0 ? find_vcpu_threads(pid, tids, 512) : 0;
+    printf("   CPU: %s (%d 个)，每 %d ms 切换一次，持续 %d 秒\n", list, ncpu, interval_ms, duration);
+    if (ntids > 0) printf("   跟踪 PID %d 的 %d 个 vCPU 线程迁移\n", pid, ntids);
+
+    long long *off_ns = malloc(STORM_MAX_SAMPLES * sizeof(long long));
+    long long *on_ns = malloc(STORM_MAX_SAMPLES * sizeof(long long));
+    long long *mig_ns = malloc(STORM_MAX_SAMPLES * sizeof(long long));
+    if (!off_ns || !on_ns || !mig_ns) {
+        perror("malloc");
+        return -1;
+    }
+    int noff = 0, non = 0, nmig = 0, nfail = 0, nidle = 0;
+
+    // 信号只置标志，循环退出后统一恢复
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = storm_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    storm_stop = 0;
+
+    // 风暴开始前确保所有CPU在线
+    for (int i = 0; i < ncpu; i++)
+        if (!orig[i]) set_cpu_online(fds[i], 1);
+
+    fi_mark_write("start", "kvm_injector:cpu-storm");
+    long long start = mono_ns(), end = start + (long long)duration * 1000000000LL;
+    long long next = start;
+    for (long tick = 0; !storm_stop && mono_ns() < end; tick++) {
+        int i = (tick / 2) % ncpu;
+        int going_off = (tick % 2) == 0;
+
+        // 下线前记下正在该CPU上的线程及其运行时间
+        int moved[512], nmoved = 0;
+        long long run0[512];
+        if (going_off) {
+            for (int t = 0; t < ntids; t++) {
+                long long run;
+                if (thread_cpu_run(pid, tids[t], &run) == cpus[i]) {
+                    moved[nmoved] = tids[t];
+                    run0[nmoved++] = run;
+                }
+            }
+        }
+
+        long long t0 = mono_ns();
+        long long cost = set_cpu_online(fds[i], !going_off);
+        if (cost < 0) {
+            nfail++;
+            if (nfail <= 5) printf("   CPU%d %s失败: %s\n", cpus[i], going_off ? "下线" : "上线", strerror((int)-cost));
+        } else if (going_off && noff < STORM_MAX_SAMPLES) {
+            off_ns[noff++] = cost;
+        } else if (!going_off && non < STORM_MAX_SAMPLES) {
+            on_ns[non++] = cost;
+        }
+
+        // 迁移耗时：从开始下线到线程在其他CPU上再次运行 (运行时间增长)；本周期内未再运行的计为空闲
+        long long limit = t0 + (long long)interval_ms * 1000000LL;
+        while (cost >= 0 && nmoved > 0 && mono_ns() < limit && !storm_stop) {
+            for (int m = 0; m < nmoved; m++) {
+                long long run;
+                int c = thread_cpu_run(pid, moved[m], &run);
+                if (c < 0 || (c != cpus[i] && run > run0[m])) {
+                    if (c >= 0 && nmig < STORM_MAX_SAMPLES) mig_ns[nmig++] = mono_ns() - t0;
+                    moved[m] = moved[--nmoved];
+                    run0[m] = run0[nmoved];
+                    m--;
+                }
+            }
+            usleep(100);
+        }
+        nidle += nmoved;
+
+        if (tick % 20 == 19) {
+            printf("\r   已切换 %ld 次 (下线 %d, 上线 %d, 失败 %d)   ", tick + 1, noff, non, nfail);
+            fflush(stdout);
+        }
+
+        next += (long long)interval_ms * 1000000LL;
+        struct timespec ts = {next / 1000000000LL, next % 1000000000LL};
+        while (!storm_stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+
+    // 恢复原始状态 (开始前在线的CPU必须重新上线)
+    int restored = 0;
+    for (int i = 0; i < ncpu; i++) {
+        if (set_cpu_online(fds[i], orig[i]) >= 0) restored++;
+        else printf("\n   [警告] CPU%d 恢复失败: %s\n", cpus[i], strerror(errno));
+        close(fds[i]);
+    }
+    fi_mark_write("stop", "kvm_injector:cpu-storm");
+
+    printf("\n%s已恢复 %d/%d 个CPU的原始状态\n", storm_stop ? " 收到信号，" : " ", restored, ncpu);
+    print_latency("下线耗时", off_ns, noff);
+    print_latency("上线耗时", on_ns, non);
+    if (ntids > 0) {
+        print_latency("vCPU迁移", mig_ns, nmig);
+        if (nidle) printf("   另有 %d 次线程在下线后一个周期内未在其他CPU上运行 (vCPU空闲)\n", nidle);
+    }
+    if (nfail) printf("   失败 %d 次\n", nfail);
+
+    free(off_ns);
+    free(on_ns);
+    free(mig_ns);
+    return nfail > 0 && noff == 0 ? -1 : 0;
+}
+
+// === 客户机内存干扰：KSM 合并风暴与 THP 合并/拆分循环 ===
+// 对象为 qemu 的客户机内存区 (最大的可写非 hugetlbfs 映射)。按周期交替 "干扰/平静" 两个阶段：
+//   ksm-storm：干扰阶段把 ksmd 扫描速率调到最高，平静阶段恢复原值 (已合并页留在原处，客户机写入即触发写时复制)
+//   thp-cycle：干扰阶段对区域执行 MADV_COLLAPSE，平静阶段拆分区域内的 THP
+// 注入前先采样基线；每秒采样 KSM 合并页、cow_ksm、THP 合并/拆分、qemu 次缺页与 vCPU 排队等待。
+// 设置 FI_PROBE_CMD 时每秒运行一次该命令 (如经 ssh 在客户机内测访存延迟)，取输出中的第一个数 (微秒) 作为客户机可见延迟。
+#define GMEM_KSM 1
+#define GMEM_THP 2
+#define GMEM_BASELINE 3
+#define GMEM_MAX_VCPUS 256
+#define KSM_DIR "/sys/kernel/mm/ksm/"
+#define THP_SPLIT_FILE "/sys/kernel/debug/split_huge_pages"
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+
+typedef struct {
+    unsigned long start, end;
+    int mergeable;  // VmFlags 含 mg
+    long thp_kb;    // AnonHugePages
+} GuestRegion;
+
+typedef struct {
+    unsigned long long sharing;   // 全局 pages_sharing
+    long long merging;            // 本进程 ksm_merging_pages，不支持时为 -1
+    unsigned long long cow_ksm, collapse, split, minflt;
+    long long vcpu_wait;          // vCPU 线程累计排队等待 (schedstat 第2字段，纳秒)
+    long thp_kb;
+} GmemSample;
+
+// 扫描 smaps：pick=1 时选出最大的可写非 hugetlbfs 映射，否则刷新 r 所指区域的状态
+static int scan_guest_region(int pid, GuestRegion *r, int pick) {
+    char path[64], line[512], perms[8];
+    snprintf(path, sizeof(path), "/proc/%d/smaps", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    GuestRegion cur = {0}, best = {0};
+    int writable = 0, found = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long s, e;
+        if (sscanf(line, "%lx-%lx %7s", &s, &e, perms) == 3 && strchr(line, '-') < strchr(line, ' ')) {
+            cur.start = s;
+            cur.end = e;
+            cur.thp_kb = 0;
+            writable = perms[1] == 'w';
+        } else if (strncmp(line, "AnonHugePages:", 14) == 0) {
+            cur.thp_kb = atol(line + 14);
+        } else if (strncmp(line, "VmFlags:", 8) == 0) {
+            cur.mergeable = strstr(line, " mg") != NULL;
+            if (pick) {
+                if (writable && !strstr(line, " ht") && cur.end - cur.start > best.end - best.start) best = cur;
+            } else if (cur.start == r->start) {
+                *r = cur;
+                found = 1;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    if (pick && best.end > best.start) {
+        *r = best;
+        found = 1;
+    }
+    return found ? 0 : -1;
+}
+
+static long long read_ll(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    long long v;
+    if (fscanf(fp, "%lld", &v) != 1) v = -1;
+    fclose(fp);
+    return v;
+}
+
+static void gmem_sample(int pid, const int *tids, int ntids, GuestRegion *r, GmemSample *s) {
+    char path[128], line[256];
+    memset(s, 0, sizeof(*s));
+    long long v = read_ll(KSM_DIR "pages_sharing");
+    s->sharing = v > 0 ? v : 0;
+    snprintf(path, sizeof(path), "/proc/%d/ksm_merging_pages", pid);
+    s->merging = read_ll(path);
+
+    FILE *fp = fopen("/proc/vmstat", "r");
+    if (fp) {
+        char key[64];
+        unsigned long long val;
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "%63s %llu", key, &val) != 2) continue;
+            if (strcmp(key, "cow_ksm") == 0) s->cow_ksm = val;
+            else if (strcmp(key, "thp_collapse_alloc") == 0) s->collapse = val;
+            else if (strcmp(key, "thp_split_page") == 0) s->split = val;
+        }
+        fclose(fp);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fp = fopen(path, "r");
+    if (fp) {
+        char buf[1024];
+        char *p = fgets(buf, sizeof(buf), fp) ? strrchr(buf, ')') : NULL;
+        if (p) sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %llu", &s->minflt);
+        fclose(fp);
+    }
+
+    for (int i = 0; i < ntids; i++) {
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tids[i]);
+        fp = fopen(path, "r");
+        if (!fp) continue;
+        long long run, wait;
+        if (fscanf(fp, "%lld %lld", &run, &wait) == 2) s->vcpu_wait += wait;
+        fclose(fp);
+    }
+
+    if (scan_guest_region(pid, r, 0) == 0) s->thp_kb = r->thp_kb;
+}
+
+// 运行 FI_PROBE_CMD，返回其输出中的第一个数 (微秒)；未设置或无输出返回 -1
+static double run_probe(void) {
+    const char *cmd = getenv("FI_PROBE_CMD");
+    if (!cmd) return -1;
+    FILE *fp = popen(cmd, "r");
+    if (!fp) return -1;
+    char buf[256];
+    double v = -1;
+    while (v < 0 && fgets(buf, sizeof(buf), fp)) {
+        char *p = buf;
+        while (*p && !(*p >= '0' && *p <= '9')) p++;
+        if (*p) v = strtod(p, NULL);
+    }
+    pclose(fp);
+    return v;
+}
+
+// 在 qemu 内执行 madvise (fi_remote 冻结全部线程期间)，返回目标内的返回值，*stop_us 为停顿时长
+static long remote_madvise(int pid, unsigned long start, unsigned long len, int advice, double *stop_us) {
+    FiRemote rc;
+    *stop_us = 0;
+    if (fi_remote_attach(&rc, pid) < 0) return -ENOTRECOVERABLE;
+    uint64_t args[6] = {start, len, (uint64_t)advice, 0, 0, 0};
+    long ret = fi_remote_syscall(&rc, SYS_madvise, args);
+    *stop_us = fi_remote_detach(&rc) / 1000.0;
+    return ret;
+}
+
+// ksmd 参数：恢复时按此顺序写回 (advisor_mode 在 pages_to_scan 之后，run 最后)
+static const char *ksm_knobs[] = {"pages_to_scan", "sleep_millisecs", "advisor_mode", "run"};
+#define KSM_NKNOBS 4
+static char ksm_saved[KSM_NKNOBS][32];
+
+static int ksm_write(const char *knob, const char *val) {
+    char path[128];
+    snprintf(path, sizeof(path), KSM_DIR "%s", knob);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -1;
+    int ret = write(fd, val, strlen(val)) == (ssize_t)strlen(val) ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+// advisor_mode 读出为 "[none] scan-time"，只保存方括号内的当前值；旧内核没有该文件时留空
+static void ksm_save(void) {
+    for (int i = 0; i < KSM_NKNOBS; i++) {
+        char path[128], buf[64] = "";
+        snprintf(path, sizeof(path), KSM_DIR "%s", ksm_knobs[i]);
+        ksm_saved[i][0] = 0;
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        if (fgets(buf, sizeof(buf), fp)) {
+            char *p = strchr(buf, '[');
+            p = p ? p + 1 : buf;
+            p[strcspn(p, "]\n")] = 0;
+            snprintf(ksm_saved[i], sizeof(ksm_saved[i]), "%s", p);
+        }
+        fclose(fp);
+    }
+}
+
+static void ksm_restore(void) {
+    for (int i = 0; i < KSM_NKNOBS; i++)
+        if (ksm_saved[i][0] && ksm_write(ksm_knobs[i], ksm_saved[i]) < 0)
+            printf("\n   [警告] 恢复 ksm/%s=%s 失败: %s\n", ksm_knobs[i], ksm_saved[i], strerror(errno));
+}
+
+static void ksm_storm_on(long pages) {
+    char val[32];
+    if (ksm_saved[2][0]) ksm_write("advisor_mode", "none");  // 自动调节会覆盖 pages_to_scan
+    snprintf(val, sizeof(val), "%ld", pages);
+    if (ksm_write("pages_to_scan", val) < 0)
+        printf("\n   [警告] 写 ksm/pages_to_scan 失败: %s\n", strerror(errno));
+    ksm_write("sleep_millisecs", "0");
+    ksm_write("run", "1");
+}
+
+// 对区域前 len 字节执行 MADV_COLLAPSE：优先 process_madvise (6.1+，无需停住 qemu)，不支持时退回远程 madvise。
+// process_madvise 单次最多处理 MAX_RW_COUNT (约 2GB)，按 1GB 分块调用
+#define GMEM_CHUNK (1UL << 30)
+
+static long long guest_collapse(int pid, int pidfd, const GuestRegion *r, unsigned long len, double *stop_us) {
+    long long t0 = mono_ns();
+    *stop_us = 0;
+    if (pidfd >= 0) {
+        int supported = 1;
+        for (unsigned long off = 0; off < len && supported; off += GMEM_CHUNK) {
+            struct iovec iov = {(void *)(r->start + off), len - off < GMEM_CHUNK ? len - off : GMEM_CHUNK};
+            // EAGAIN/ENOMEM 表示本块部分未能合并，继续下一块
+            if (syscall(SYS_process_madvise, pidfd, &iov, 1, MADV_COLLAPSE, 0) < 0 && (errno == EINVAL || errno == ENOSYS))
+                supported = off > 0; // 首块即不支持才退回远程执行
+        }
+        if (supported) return mono_ns() - t0;
+    }
+    long ret = remote_madvise(pid, r->start, len, MADV_COLLAPSE, stop_us);
+    if (ret == -ENOTRECOVERABLE || ret == -EINVAL) return -1;
+    return mono_ns() - t0;
+}
+
+// THP 大小 (x86 为 2MB，64K 页的 aarch64 为 512MB)
+static unsigned long thp_size(void) {
+    long long v = read_ll("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+    return v > 0 ? (unsigned long)v : 2UL << 20;
+}
+
+// 拆分区域内全部 THP：优先经 debugfs 写 "<pid>,0x<起>,0x<止>"；不可用 (未挂载、内核 lockdown) 时
+// 对每个 THP 块的首页 process_madvise(MADV_COLD)，只覆盖半个 PMD 时内核会先拆分独占的大页
+static long long guest_split(int pid, int pidfd, const GuestRegion *r, unsigned long len, const char **how) {
+    char cmd[96];
+    int n = snprintf(cmd, sizeof(cmd), "%d,0x%lx,0x%lx", pid, r->start, r->start + len);
+    long long t0 = mono_ns();
+    int fd = open(THP_SPLIT_FILE, O_WRONLY);
+    if (fd >= 0) {
+        int ok = write(fd, cmd, n) == n;
+        close(fd);
+        if (ok) {
+            *how = "debugfs";
+            return mono_ns() - t0;
+        }
+    }
+    if (pidfd < 0) return -1;
+    *how = "MADV_COLD";
+    struct iovec iov[1024];
+    int cnt = 0;
+    unsigned long page = sysconf(_SC_PAGESIZE), blk = thp_size(), end = r->start + len;
+    for (unsigned long a = (r->start + blk - 1) & ~(blk - 1); a < end; a += blk) {
+        iov[cnt].iov_base = (void *)a;
+        iov[cnt].iov_len = page;
+        if (++cnt == 1024 || a + blk >= end) {
+            if (syscall(SYS_process_madvise, pidfd, iov, cnt, MADV_COLD, 0) < 0 && errno != EAGAIN) return -1;
+            cnt = 0;
+        }
+    }
+    return mono_ns() - t0;
+}
+
+int inject_guest_mem_fault(int pid, int mode, int duration, int period, long arg) {
+    const char *label = mode == GMEM_KSM ? "kvm_injector:ksm-storm" : "kvm_injector:thp-cycle";
+    GuestRegion r;
+    if (duration <= 0 || period <= 0) {
+        printf(" 持续时间与周期必须大于0\n");
+        return -1;
+    }
+    if (scan_guest_region(pid, &r, 1) < 0) {
+        printf(" 无法读取 /proc/%d/smaps 或没有可写映射\n", pid);
+        return -1;
+    }
+    unsigned long len = r.end - r.start;
+    if (mode == GMEM_THP && arg > 0 && (unsigned long)arg << 20 < len) len = (unsigned long)arg << 20;
+
+    int tids[GMEM_MAX_VCPUS];
+    int ntids = find_vcpu_threads(pid, tids, GMEM_MAX_VCPUS);
+
+    printf(" %s: PID %d  客户机内存区 0x%lx-0x%lx (%lu MB%s)  vCPU线程 %d 个  周期 %d 秒\n",
+           mode == GMEM_KSM ? "KSM合并风暴" : "THP合并/拆分循环", pid, r.start, r.end,
+           (r.end - r.start) >> 20, r.mergeable ? ", 已可合并" : "", ntids, period);
+
+    int pidfd = -1, can_split = 0;
+    if (mode == GMEM_KSM) {
+        if (access(KSM_DIR "run", W_OK) != 0) {
+            printf(" 内核未启用KSM或无权限写 %s: %s\n", KSM_DIR, strerror(errno));
+            return -1;
+        }
+        ksm_save();
+        printf("   原KSM参数: run=%s pages_to_scan=%s sleep_millisecs=%s%s%s，干扰阶段 pages_to_scan=%ld sleep_millisecs=0\n",
+               ksm_saved[3], ksm_saved[0], ksm_saved[1], ksm_saved[2][0] ? " advisor_mode=" : "", ksm_saved[2], arg);
+    } else {
+        pidfd = syscall(SYS_pidfd_open, pid, 0);
+        can_split = pidfd >= 0 || access(THP_SPLIT_FILE, W_OK) == 0;
+        printf("   作用范围 %lu MB，合并经 %s\n", len >> 20, pidfd >= 0 ? "process_madvise" : "远程 madvise");
+        if (!can_split) printf("   [警告] 无 pidfd 且 %s 不可用，平静阶段不拆分\n", THP_SPLIT_FILE);
+    }
+    if (!getenv("FI_PROBE_CMD")) printf("   未设置 FI_PROBE_CMD，客户机可见延迟仅以 vCPU 排队等待衡量\n");
+
+    storm_stop = 0;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = storm_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    // 每秒样本按阶段归类：0 基线，1 干扰，2 平静
+    int total = GMEM_BASELINE + duration;
+    long long *wait[3], *probe[3];
+    int nwait[3] = {0}, nprobe[3] = {0}, nsec[3] = {0};
+    unsigned long long cow[3] = {0}, flt[3] = {0};
+    for (int p = 0; p < 3; p++) {
+        wait[p] = calloc(total, sizeof(long long));
+        probe[p] = calloc(total, sizeof(long long));
+    }
+
+    GmemSample first, prev, cur;
+    gmem_sample(pid, tids, ntids, &r, &prev);
+    first = prev;
+    int merged_here = 0, ncollapse = 0, nsplit = 0;
+    double stop_us = 0;
+
+    printf("\n   %4s %4s %10s %8s %8s %9s %10s %10s\n", "秒", "阶段", "KSM页", "CoW/s", "THP MB", "缺页/s", "vCPU等待ms", "探测µs");
+    long long next = mono_ns();
+    for (int sec = -GMEM_BASELINE; sec < duration && !storm_stop; sec++) {
+        int phase = sec < 0 ? 0 : (sec / period) % 2 == 0 ? 1 : 2;
+
+        if (sec == 0) {
+            if (mode == GMEM_KSM && !r.mergeable) {
+                long ret = remote_madvise(pid, r.start, r.end - r.start, MADV_MERGEABLE, &stop_us);
+                if (ret < 0) {
+                    printf("   [错误] 远程 madvise(MADV_MERGEABLE) 失败: %s\n", strerror((int)-ret));
+                    break;
+                }
+                merged_here = 1;
+                printf("   [标记] 远程 madvise(MADV_MERGEABLE)，qemu 停顿 %.1f µs\n", stop_us);
+            }
+            fi_mark_write("start", label);
+        }
+        if (sec >= 0 && sec % period == 0) {
+            if (mode == GMEM_KSM) {
+                if (phase == 1) ksm_storm_on(arg);
+                else ksm_restore();
+            } else if (phase == 1) {
+                long long ns = guest_collapse(pid, pidfd, &r, len, &stop_us);
+                if (ns < 0) printf("   [警告] MADV_COLLAPSE 不受支持\n");
+                else {
+                    ncollapse++;
+                    printf("   [合并] MADV_COLLAPSE 耗时 %.1f ms%s\n", ns / 1e6, stop_us > 0 ? " (远程执行，qemu 全程停顿)" : "");
+                }
+            } else if (can_split) {
+                const char *how = "";
+                long long ns = guest_split(pid, pidfd, &r, len, &how);
+                if (ns < 0) printf("   [警告] 拆分失败: %s\n", strerror(errno));
+                else {
+                    nsplit++;
+                    printf("   [拆分] 经 %s 耗时 %.1f ms\n", how, ns / 1e6);
+                }
+            }
+        }
+
+        double us = run_probe();
+        next += 1000000000LL;
+        struct timespec ts = {next / 1000000000LL, next % 1000000000LL};
+        while (!storm_stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        if (kill(pid, 0) < 0) {
+            printf("   目标进程已退出\n");
+            break;
+        }
+        gmem_sample(pid, tids, ntids, &r, &cur);
+
+        long long w = cur.vcpu_wait - prev.vcpu_wait;
+        wait[phase][nwait[phase]++] = w;
+        if (us >= 0) probe[phase][nprobe[phase]++] = (long long)(us * 1000);
+        cow[phase] += cur.cow_ksm - prev.cow_ksm;
+        flt[phase] += cur.minflt - prev.minflt;
+        nsec[phase]++;
+
+        char pbuf[16] = "-";
+        if (us >= 0) snprintf(pbuf, sizeof(pbuf), "%.0f", us);
+        printf("   %4d %4s %10lld %8llu %8ld %9llu %10.2f %10s\n", sec + 1, phase == 0 ? "基线" : phase == 1 ? "干扰" : "平静",
+               cur.merging >= 0 ? cur.merging : (long long)cur.sharing, cur.cow_ksm - prev.cow_ksm, cur.thp_kb >> 10,
+               cur.minflt - prev.minflt, w / 1e6, pbuf);
+        fflush(stdout);
+        prev = cur;
+    }
+
+    // 恢复：KSM 参数写回原值；本工具标记的区域取消可合并 (内核在此调用内拆散全部合并页，qemu 会停顿较久)
+    if (mode == GMEM_KSM) {
+        ksm_restore();
+        if (merged_here) {
+            long ret = remote_madvise(pid, r.start, r.end - r.start, MADV_UNMERGEABLE, &stop_us);
+            if (ret < 0) printf("   [警告] 远程 madvise(MADV_UNMERGEABLE) 失败: %s\n", strerror((int)-ret));
+            else printf("   [恢复] 远程 madvise(MADV_UNMERGEABLE)，qemu 停顿 %.1f ms\n", stop_us / 1000);
+        }
+    }
+    if (pidfd >= 0) close(pidfd);
+    fi_mark_write("stop", label);
+
+    printf("\n[结果]%s\n", storm_stop ? " (收到信号提前结束)" : "");
+    printf("   KSM pages_sharing     注入前 %llu  结束时 %llu\n", first.sharing, prev.sharing);
+    if (first.merging >= 0) printf("   本进程KSM合并页       注入前 %lld  结束时 %lld\n", first.merging, prev.merging);
+    printf("   KSM写时复制 (cow_ksm) 注入期间 %llu 次\n", prev.cow_ksm - first.cow_ksm);
+    printf("   THP合并 %llu 次 / 拆分 %llu 次 (全局 vmstat)，区域 AnonHugePages %ld MB -> %ld MB",
+           prev.collapse - first.collapse, prev.split - first.split, first.thp_kb >> 10, prev.thp_kb >> 10);
+    if (mode == GMEM_THP) printf("，执行合并 %d 次、拆分 %d 次", ncollapse, nsplit);
+    printf("\n");
+
+    const char *names[3] = {"基线", "干扰", "平静"};
+    printf("   %-6s %6s %12s %12s\n", "阶段", "秒数", "cow_ksm/s", "qemu缺页/s");
+    for (int p = 0; p < 3; p++)
+        if (nsec[p]) printf("   %-6s %6d %12.1f %12.1f\n", names[p], nsec[p], (double)cow[p] / nsec[p], (double)flt[p] / nsec[p]);
+    printf("   vCPU 每秒排队等待:\n");
+    for (int p = 0; p < 3; p++)
+        if (nwait[p]) print_latency(names[p], wait[p], nwait[p]);
+    if (getenv("FI_PROBE_CMD")) {
+        printf("   客户机探测延迟 (FI_PROBE_CMD):\n");
+        for (int p = 0; p < 3; p++) print_latency(names[p], probe[p], nprobe[p]);
+    }
+
+    for (int p = 0; p < 3; p++) {
+        free(wait[p]);
+        free(probe[p]);
+    }
+    return 0;
+}
+
 // === 打印帮助 ===
 void print_usage(const char *prog) {
     printf("\n╔═══════════════════════════════════════════════════════════════════╗\n");
@@ -425,7 +1101,12 @@ void print_usage(const char *prog) {
     
     printf("【维护故障】\n");
     printf("  cpu-offline <CPU号>            下线指定CPU\n");
-    printf("  cpu-online <CPU号>             上线指定CPU\n\n");
+    printf("  cpu-online <CPU号>             上线指定CPU\n");
+    printf("  cpu-storm <CPU列表> <秒> [间隔ms] [PID]  轮流下线/上线，测量切换与vCPU迁移耗时\n\n");
+    
+    printf("【内存干扰】(环境变量 FI_PROBE_CMD 为客户机延迟探测命令)\n");
+    printf("  ksm-storm <PID> <秒> [周期秒] [pages_to_scan]  标记客户机内存可合并，周期性拉高KSM扫描速率\n");
+    printf("  thp-cycle <PID> <秒> [周期秒] [MB]             周期性 MADV_COLLAPSE / 拆分客户机内存THP\n\n");
     
     printf("【其他】\n");
     printf("  clear                          清理所有故障\n\n");
@@ -439,6 +1120,9 @@ void print_usage(const char *prog) {
     printf("  %s soft-flip 1234 PC 10        # 翻转PC第10位\n", prog);
     printf("  %s perf-delay 1234 50          # 注入50ms延迟\n", prog);
     printf("  %s cpu-offline 2               # 下线CPU2\n", prog);
+    printf("  %s cpu-storm 2-5 60 50 1234    # CPU2-5 每50ms切换一次\n", prog);
+    printf("  %s ksm-storm 1234 120 10       # 每10秒在高速扫描/原速之间切换\n", prog);
+    printf("  %s thp-cycle 1234 60 5 1024    # 前1GB客户机内存每5秒合并/拆分\n", prog);
     printf("\n");
 }
 
@@ -551,6 +1235,34 @@ int main(int argc, char *argv[]) {
         }
         inject_cpu_hotplug_fault(atoi(argv[2]), 1);
     }
+    else if (strcmp(command, "cpu-storm") == 0) {
+        if (argc < 4) {
+            printf(" 用法: %s cpu-storm <CPU列表> <秒> [间隔ms] [PID]\n", argv[0]);
+            return 1;
+        }
+        int interval = (argc >= 5) ? atoi(argv[4]) : 100;
+        int pid = (argc >= 6) ? atoi(argv[5]) : 0;
+        return inject_cpu_hotplug_storm(argv[2], atoi(argv[3]), interval, pid) < 0;
+    }
+    // 内存干扰
+    else if (strcmp(command, "ksm-storm") == 0) {
+        if (argc < 4) {
+            printf(" 用法: %s ksm-storm <PID> <秒> [周期秒] [pages_to_scan]\n", argv[0]);
+            return 1;
+        }
+        int period = (argc >= 5) ? atoi(argv[4]) : 10;
+        long pages = (argc >= 6) ? atol(argv[5]) : 10000;
+        return inject_guest_mem_fault(atoi(argv[2]), GMEM_KSM, atoi(argv[3]), period, pages) < 0;
+    }
+    else if (strcmp(command, "thp-cycle") == 0) {
+        if (argc < 4) {
+            printf(" 用法: %s thp-cycle <PID> <秒> [周期秒] [MB]\n", argv[0]);
+            return 1;
+        }
+        int period = (argc >= 5) ? atoi(argv[4]) : 5;
+        long mb = (argc >= 6) ? atol(argv[5]) : 0; // 0 表示整个区域
+        return inject_guest_mem_fault(atoi(argv[2]), GMEM_THP, atoi(argv[3]), period, mb) < 0;
+    }
     // 清理
     else if (strcmp(command, "clear") == 0) {
         clear_all_faults();
@@ -0,0 +1,86 @@
+/*
+ * memcg_injector.c - 目标内存回收压力注入器
+ * 功能：只对目标进程施加内存压力，而非像 mem_leak 那样吞噬整机内存。
+ *       目标独占 cgroup 时就地、否则迁入 fi_stress 下的新叶子，逐步压低 memory.high；
+ *       每个调节周期读取该 cgroup 的 memory.pressure (PSI)，低于目标 stall 继续压低、
+ *       超调则回退，到达后保持，逐周期报告 stall、主缺页与 refault 速率，结束后恢复。
+ * 编译：gcc -o memcg_injector memcg_injector.c fi_stress.c -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "fi_stress.h"
+
+int main(int argc, char *argv[])
+{
+    FiMemPressConfig cfg;
+    int opt;
+
+    fi_mempress_defaults(&cfg);
+    while ((opt = getopt(argc, argv, "+Fs:i:m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'F':
+            cfg.full = 1;
+            break;
+        case 's':
+            cfg.step_pct = atoi(optarg);
+            break;
+        case 'i':
+            cfg.interval_ms = atoi(optarg);
+            break;
+        case 'm':
+            cfg.floor_mb = atol(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    if (argc < 4)
+    {
+        printf("用法: %s [-F] [-s 步长%%] [-i 周期ms] [-m 下限MB] <PID[,PID...]> <stall%%> <Duration_Sec>\n", argv[0]);
+        printf("  -F        按 PSI full 行 (全部任务停顿) 计算，默认 some\n");
+        printf("  -s 步长   每个周期把 memory.high 降低的比例 (默认 5%%)\n");
+        printf("  -i 周期   调节与报告周期 (默认 1000ms)\n");
+        printf("  -m 下限   memory.high 不低于该值 (默认 32MB)\n");
+        printf("示例: %s 1234 20 60          # 压到 some stall 20%% 并保持，共 60 秒\n", argv[0]);
+        printf("      %s -F -s 10 1234,1240 5 120\n", argv[0]);
+        return 1;
+    }
+
+    pid_t pids[FI_MEMPRESS_MAX_PIDS];
+    int n = 0;
+    char list[1024], *save = NULL;
+    snprintf(list, sizeof(list), "%s", argv[1]);
+    for (char *tok = strtok_r(list, ",", &save); tok && n < FI_MEMPRESS_MAX_PIDS; tok = strtok_r(NULL, ",", &save))
+    {
+        pids[n] = atoi(tok);
+        if (pids[n] <= 0 || kill(pids[n], 0) < 0)
+        {
+            printf("[错误] 无效或不存在的 PID: %s\n", tok);
+            return 1;
+        }
+        n++;
+    }
+    cfg.stall_pct = atof(argv[2]);
+    int duration = atoi(argv[3]);
+    if (cfg.stall_pct <= 0 || cfg.stall_pct >= 100 || cfg.step_pct <= 0 || cfg.step_pct > 50 || cfg.interval_ms < 100)
+    {
+        printf("[错误] stall 需在 (0,100)，步长在 (0,50]，周期不少于 100ms\n");
+        return 1;
+    }
+
+    printf("=== 目标内存回收压力注入器 ===\n");
+    printf("目标进程: %s，stall 目标: %.1f%% (%s)，持续 %d 秒\n\n", argv[1], cfg.stall_pct, cfg.full ? "full" : "some", duration);
+    return fi_mempress(pids, n, &cfg, duration, "memcg_injector") < 0;
+}
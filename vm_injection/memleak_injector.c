@@ -1,70 +1,444 @@
 /*
  * mem_leak.c - 内存资源耗尽注入器
  * 功能：持续吞噬宿主机物理内存，模拟 OOM (Out Of Memory) 场景
- * 编译：gcc -o mem_leak mem_leak.c
+ * 增强：以 16MB 为粒度 mmap + MAP_POPULATE 建立映射，由内核一次填满，速度接近内存带宽；
+ *       页类型可选默认 / 禁用 THP / THP / MAP_HUGETLB 大页，可 mlock 锁定不被换出；
+ *       占用量按速率曲线增长与收缩 (一次填满、斜坡、锯齿、保持-释放)，逐秒报告目标与实际 RSS；
+ *       MemAvailable 低于下限 (-f) 时停止增长并逐块归还
+ * 编译：gcc -o mem_leak memleak_injector.c
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define CHUNK_MB 16 // 增减粒度，2MB 大页的整数倍
+#define CHUNK_BYTES ((size_t)CHUNK_MB << 20)
+#define MAX_CHUNKS 65536
+#define HOLD_SEC 60 // 未指定 -d 时填满后的保持时间
+#define TICK_NS 10000000LL
+
+typedef enum
+{
+    PROF_FILL, // 尽快填满到目标
+    PROF_RAMP, // 按 MB/s 线性增长到目标
+    PROF_SAW,  // 从低位按 MB/s 增长到目标后立即回落，循环
+    PROF_HOLD  // 增长到目标、保持、全部释放、空闲，循环
+} ProfileKind;
+
+typedef enum
+{
+    PAGE_DEFAULT,
+    PAGE_4K,     // MADV_NOHUGEPAGE
+    PAGE_THP,    // MADV_HUGEPAGE
+    PAGE_HUGETLB // MAP_HUGETLB，需要预留 vm.nr_hugepages
+} PageMode;
+
+static const char *page_names[] = {"默认", "4k", "thp", "huge"};
+
+volatile int keep_running = 1;
+
+static void *chunks[MAX_CHUNKS];
+static int nchunks = 0;
+
+static struct
+{
+    ProfileKind kind;
+    double rate;    // MB/s
+    double low;     // 锯齿低位 MB
+    double hold_s;  // 保持-释放：保持秒数
+    double idle_s;  // 保持-释放：释放后空闲秒数
+} prof = {PROF_FILL, 0, 0, 0, 0};
+
+static PageMode page_mode = PAGE_DEFAULT;
+static int use_mlock = 0;
+static int mlock_failed = 0;
+static uint64_t page_seq = 0;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// === 1. 速率曲线 ===
+
+static int parse_profile(const char *spec)
+{
+    if (strcmp(spec, "fill") == 0)
+        prof.kind = PROF_FILL;
+    else if (sscanf(spec, "ramp:%lf", &prof.rate) == 1)
+        prof.kind = PROF_RAMP;
+    else if (sscanf(spec, "saw:%lf:%lf", &prof.rate, &prof.low) >= 1)
+        prof.kind = PROF_SAW;
+    else if (sscanf(spec, "hold:%lf:%lf:%lf", &prof.hold_s, &prof.idle_s, &prof.rate) >= 2)
+        prof.kind = PROF_HOLD;
+    else
+        return -1;
+    if ((prof.kind == PROF_RAMP || prof.kind == PROF_SAW) && prof.rate <= 0)
+        return -1;
+    if (prof.kind == PROF_HOLD && (prof.hold_s < 0 || prof.idle_s < 0 || prof.rate < 0))
+        return -1;
+    return 0;
+}
+
+// t 秒时的目标占用 (MB)
+static double target_mb(double t, double size)
+{
+    double rise, cycle, ph;
+
+    switch (prof.kind)
+    {
+    case PROF_RAMP:
+        return prof.rate * t < size ? prof.rate * t : size;
+    case PROF_SAW:
+        if (prof.low >= size)
+            return size;
+        rise = (size - prof.low) / prof.rate;
+        ph = t - (long long)(t / rise) * rise;
+        return prof.low + prof.rate * ph;
+    case PROF_HOLD:
+        rise = prof.rate > 0 ? size / prof.rate : 0;
+        cycle = rise + prof.hold_s + prof.idle_s;
+        if (cycle <= 0)
+            return size;
+        ph = t - (long long)(t / cycle) * cycle;
+        if (ph < rise)
+            return prof.rate * ph;
+        return ph < rise + prof.hold_s ? size : 0;
+    default:
+        return size;
+    }
+}
+
+// === 2. 分块映射 ===
+
+// 每页首 8 字节写入不同的值：页面真正写脏，且不会被当作全零/同值页合并或压缩
+static void stamp_pages(char *p, size_t len)
+{
+    for (size_t off = 0; off < len; off += 4096)
+        *(volatile uint64_t *)(p + off) = ++page_seq * 0x9E3779B97F4A7C15ULL;
+}
+
+// THP 需要 2MB 对齐的区间，多映射 2MB 后裁掉首尾
+static char *map_aligned(size_t len)
+{
+    size_t align = 2UL << 20;
+    char *p = mmap(NULL, len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    char *a = (char *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+    if (a > p)
+        munmap(p, a - p);
+    if (a + len < p + len + align)
+        munmap(a + len, p + len + align - (a + len));
+    return a;
+}
+
+static char *map_chunk(void)
+{
+    char *p = NULL;
+
+    if (page_mode == PAGE_HUGETLB)
+    {
+        p = mmap(NULL, CHUNK_BYTES, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            printf("[提示] MAP_HUGETLB 失败 (%s)，大页池不足? (sysctl vm.nr_hugepages)，改用 THP\n", strerror(errno));
+            page_mode = PAGE_THP;
+            p = NULL;
+        }
+    }
+
+    if (!p && page_mode == PAGE_DEFAULT)
+    {
+        p = mmap(NULL, CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+    }
+    else if (!p)
+    {
+        // 先 madvise 再填充，THP 设置才作用于首次缺页
+        p = map_aligned(CHUNK_BYTES);
+        if (!p)
+            return NULL;
+        madvise(p, CHUNK_BYTES, page_mode == PAGE_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        madvise(p, CHUNK_BYTES, MADV_POPULATE_WRITE); // 5.14 之前不支持，由 stamp_pages 逐页缺页
+    }
+
+    stamp_pages(p, CHUNK_BYTES);
+    if (use_mlock && !mlock_failed && mlock(p, CHUNK_BYTES) < 0)
+    {
+        printf("[提示] mlock 失败 (%s)，后续块不再锁定 (检查 ulimit -l 或以 root 运行)\n", strerror(errno));
+        mlock_failed = 1;
+    }
+    return p;
+}
+
+static void unmap_chunk(void)
+{
+    if (nchunks > 0)
+        munmap(chunks[--nchunks], CHUNK_BYTES);
+}
+
+// === 3. 计量 ===
+
+// 从 "Key:   123 kB" 形式的文件中读取若干键 (单位 kB)
+static void read_kb(const char *path, const char **keys, long long *vals, int n)
+{
+    char line[256];
+    FILE *fp = fopen(path, "r");
+    for (int i = 0; i < n; i++)
+        vals[i] = -1;
+    if (!fp)
+        return;
+    while (fgets(line, sizeof(line), fp))
+    {
+        for (int i = 0; i < n; i++)
+        {
+            size_t len = strlen(keys[i]);
+            if (strncmp(line, keys[i], len) == 0 && line[len] == ':')
+                vals[i] = atoll(line + len + 1);
+        }
+    }
+    fclose(fp);
+}
+
+static long long mem_available_mb(void)
+{
+    const char *keys[] = {"MemAvailable"};
+    long long v;
+    read_kb("/proc/meminfo", keys, &v, 1);
+    return v < 0 ? -1 : v / 1024;
+}
+
+typedef struct
+{
+    double rss_mb;  // VmRSS + HugetlbPages (hugetlb 页不计入 VmRSS)
+    double thp_mb;  // AnonHugePages
+    double lock_mb; // VmLck
+} Usage;
+
+static void read_usage(Usage *u)
+{
+    const char *skeys[] = {"VmRSS", "HugetlbPages", "VmLck"};
+    const char *tkeys[] = {"AnonHugePages"};
+    long long s[3], t;
+    read_kb("/proc/self/status", skeys, s, 3);
+    read_kb("/proc/self/smaps_rollup", tkeys, &t, 1);
+    u->rss_mb = ((s[0] > 0 ? s[0] : 0) + (s[1] > 0 ? s[1] : 0)) / 1024.0;
+    u->lock_mb = (s[2] > 0 ? s[2] : 0) / 1024.0;
+    u->thp_mb = (t > 0 ? t : 0) / 1024.0;
+}
+
+// === 4. 主流程 ===
 
 int main(int argc, char *argv[])
 {
+    int duration = 0;
+    long long floor_mb = 0;
+    const char *prof_spec = "fill";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+p:d:m:lf:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            prof_spec = optarg;
+            if (parse_profile(optarg) < 0)
+            {
+                printf("[错误] 无法解析速率曲线: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'm':
+            if (strcmp(optarg, "4k") == 0)
+                page_mode = PAGE_4K;
+            else if (strcmp(optarg, "thp") == 0)
+                page_mode = PAGE_THP;
+            else if (strcmp(optarg, "huge") == 0)
+                page_mode = PAGE_HUGETLB;
+            else
+            {
+                printf("[错误] 未知页类型: %s (4k/thp/huge)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'l':
+            use_mlock = 1;
+            break;
+        case 'f':
+            floor_mb = atoll(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
     // 参数兼容设计：保留 PID 位置，保持与 fault_controller 格式一致
     if (argc < 3)
     {
-        printf("用法: %s <PID_ignored> <Size_MB>\n", argv[0]);
+        printf("用法: %s [-p 曲线] [-d 秒] [-m 4k|thp|huge] [-l] [-f 可用下限MB] <PID_ignored> <Size_MB>\n", argv[0]);
+        printf("速率曲线 (-p):\n");
+        printf("  fill                      尽快填满 (默认)\n");
+        printf("  ramp:MB/s                 线性增长到 Size\n");
+        printf("  saw:MB/s[:低位MB]         从低位增长到 Size 后立即回落，循环\n");
+        printf("  hold:保持秒:空闲秒[:MB/s]  增长到 Size (省略速率为立即填满)、保持、全部释放、空闲，循环\n");
+        printf("  -d 秒     总时长 (默认: fill/ramp 到达 Size 后保持 %d 秒，saw/hold 共 %d 秒)\n", HOLD_SEC, HOLD_SEC);
+        printf("  -m 页类型 4k=禁用 THP, thp=MADV_HUGEPAGE, huge=MAP_HUGETLB (需 vm.nr_hugepages)\n");
+        printf("  -l        mlock 锁定，不被换出\n");
+        printf("  -f MB     MemAvailable 低于该值时停止增长并逐块归还\n");
         printf("示例: %s 0 1024 (尝试占用 1GB 内存)\n", argv[0]);
+        printf("      %s -p ramp:200 -m thp 0 8192\n", argv[0]);
+        printf("      %s -p saw:500:1024 -f 512 -d 120 0 4096\n", argv[0]);
+        printf("      %s -p hold:20:10 -l 0 2048\n", argv[0]);
         return 1;
     }
 
-    int size_mb = atoi(argv[2]);
-    long long total_bytes = (long long)size_mb * 1024 * 1024;
-    long long current_bytes = 0;
+    long long size_mb = atoll(argv[2]);
+    int max_chunks = (int)((size_mb + CHUNK_MB - 1) / CHUNK_MB);
+    if (size_mb <= 0 || max_chunks > MAX_CHUNKS)
+    {
+        printf("[错误] Size_MB 超出范围 (1 - %d)\n", MAX_CHUNKS * CHUNK_MB);
+        return 1;
+    }
+    if (duration <= 0 && (prof.kind == PROF_SAW || prof.kind == PROF_HOLD))
+        duration = HOLD_SEC;
+    if (use_mlock)
+    {
+        struct rlimit rl = {RLIM_INFINITY, RLIM_INFINITY};
+        setrlimit(RLIMIT_MEMLOCK, &rl); // 非 root 时失败，由 mlock 报错提示
+    }
 
-    // 每次分配的块大小 (10MB)
-    int chunk_size = 10 * 1024 * 1024;
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
 
     printf("=== 内存资源耗尽注入器 ===\n");
-    printf("目标占用: %d MB\n", size_mb);
+    printf("目标占用: %lld MB (每块 %d MB)，曲线 %s，页类型 %s%s\n",
+           size_mb, CHUNK_MB, prof_spec, page_names[page_mode], use_mlock ? "，mlock" : "");
+    if (floor_mb > 0)
+        printf("MemAvailable 下限: %lld MB\n", floor_mb);
     printf("注意：这会触发系统级压力，可能导致 Swap 交换或进程被杀。\n");
-    printf(" 开始吞噬内存...\n");
+    printf(" 开始吞噬内存...\n\n");
+    printf("  秒   目标MB   实际MB    误差MB   可用MB   填充GB/s   THP MB  锁定MB\n");
 
+    long long start = now_ns(), next = start + TICK_NS, report = start + 1000000000LL;
+    long long end = duration > 0 ? start + duration * 1000000000LL : 0;
+    long long fill_bytes = 0, fill_ns = 0; // 本秒内填充量与耗时
+    double err_sum = 0, peak_rss = 0, peak_rate = 0, want = 0;
+    int seconds = 0, floor_hit = 0, map_failed = 0;
+    long long avail = mem_available_mb();
 
-    while (current_bytes < total_bytes)
+    while (keep_running)
     {
-        // 1. 申请虚拟内存
-        char *ptr = (char *)malloc(chunk_size);
-        if (ptr == NULL)
-        {
-            printf("\n malloc 失败！系统内存可能已耗尽。\n");
+        long long now = now_ns();
+        if (end && now >= end)
             break;
+        double t = (now - start) / 1e9;
+        want = target_mb(t, size_mb);
+        int want_chunks = (int)((want + CHUNK_MB / 2.0) / CHUNK_MB);
+        if (want_chunks > max_chunks)
+            want_chunks = max_chunks;
+
+        // 增长：每块后重读 MemAvailable，贴近下限时停止
+        while (nchunks < want_chunks && keep_running && !map_failed)
+        {
+            avail = mem_available_mb();
+            if (floor_mb > 0 && avail >= 0 && avail - CHUNK_MB < floor_mb)
+            {
+                if (!floor_hit)
+                    printf("[下限] MemAvailable %lld MB 接近下限 %lld MB，停止增长\n", avail, floor_mb);
+                floor_hit = 1;
+                break;
+            }
+            long long t0 = now_ns();
+            char *p = map_chunk();
+            if (!p)
+            {
+                printf("[提示] mmap 失败 (%s)，系统内存可能已耗尽，保持当前占用\n", strerror(errno));
+                map_failed = 1;
+                break;
+            }
+            fill_ns += now_ns() - t0;
+            fill_bytes += CHUNK_BYTES;
+            chunks[nchunks++] = p;
         }
+        while (nchunks > want_chunks)
+            unmap_chunk();
 
-        // 2. 关键步骤：写入数据 (Page Fault) 强制分配物理内存
-        memset(ptr, 0xAA, chunk_size);
+        // 其他进程继续吃内存时逐块归还，维持下限
+        if (floor_mb > 0 && nchunks > 0 && (avail = mem_available_mb()) >= 0 && avail < floor_mb - CHUNK_MB)
+            unmap_chunk();
 
-        current_bytes += chunk_size;
+        // fill/ramp 未指定 -d：不再增长后保持 HOLD_SEC 秒
+        if (!end && (nchunks >= max_chunks || floor_hit || map_failed))
+        {
+            end = now_ns() + HOLD_SEC * 1000000000LL;
+            printf("[*] 分配结束，保持占用 %d 秒...\n", HOLD_SEC);
+        }
 
-        // 打印进度条
-        printf("\r[Eat] 已占用: %4lld MB / %4d MB", current_bytes / 1024 / 1024, size_mb);
-        fflush(stdout);
+        now = now_ns();
+        if (now >= report)
+        {
+            Usage u;
+            read_usage(&u);
+            avail = mem_available_mb();
+            double rate = fill_ns > 0 ? fill_bytes / (double)fill_ns : 0; // 字节/ns 即 GB/s
+            seconds++;
+            err_sum += u.rss_mb > want ? u.rss_mb - want : want - u.rss_mb;
+            if (u.rss_mb > peak_rss)
+                peak_rss = u.rss_mb;
+            if (rate > peak_rate)
+                peak_rate = rate;
+            printf("%4d %8.0f %8.0f %+9.0f %8lld ", seconds, want, u.rss_mb, u.rss_mb - want, avail);
+            if (rate > 0)
+                printf("%10.2f", rate);
+            else
+                printf("%10s", "-");
+            printf(" %8.0f %7.0f%s\n", u.thp_mb, u.lock_mb, floor_hit && nchunks < want_chunks ? "  [下限]" : "");
+            fflush(stdout);
+            fill_bytes = fill_ns = 0;
+            report += 1000000000LL;
+        }
 
-        // 稍微休眠一下，防止瞬间卡死系统无法响应中断
-        usleep(50000); // 50ms
+        while (next <= now)
+            next += TICK_NS;
+        struct timespec ts = {next / 1000000000LL, next % 1000000000LL};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
     }
 
-    printf("\n 分配完成。正在保持占用状态 60 秒...\n");
-    printf("此时请观察靶子程序的反应 (或使用 'free -h' 查看)\n");
-
-    // 保持占用 60 秒，期间这部分内存无法被其他进程使用
-    for (int i = 0; i < 60; i++)
-    {
-        sleep(1);
-    }
+    printf("\n[结果] 峰值 RSS %.0f MB，平均 |实际-目标| %.1f MB，最快填充 %.2f GB/s%s\n",
+           peak_rss, seconds ? err_sum / seconds : 0, peak_rate, floor_hit ? "，曾触及 MemAvailable 下限" : "");
 
     // 程序退出后，OS 会自动回收这些内存
+    while (nchunks > 0)
+        unmap_chunk();
     printf("释放内存，退出。\n");
     return 0;
-}
\ No newline at end of file
+}
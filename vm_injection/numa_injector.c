@@ -0,0 +1,673 @@
+/*
+ * numa_injector.c - NUMA 远端内存注入器
+ * 功能：用 move_pages 把目标匿名内存的指定比例、指定地址区间或 qemu 客户机内存区迁到远端 NUMA 节点，
+ *       复现客户机内存漂移到另一路 CPU 后的性能下降；默认目标节点取离目标线程所在节点最远的有内存节点。
+ *       迁移前逐页记录原节点，保持期间逐秒抽样仍在远端的比例与自动 NUMA 平衡迁回的页数，
+ *       结束后按原节点逐页迁回；迁移与迁回均报告成功/失败页数与吞吐。
+ *       单路机器可用内核参数 numa=fake=2 得到两个节点进行测试。
+ * 编译：gcc -o numa_injector numa_injector.c fi_topo.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include "fi_topo.h"
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+#ifndef MPOL_MF_MOVE_ALL
+#define MPOL_MF_MOVE_ALL (1 << 2)
+#endif
+
+#define WIN_BYTES (2UL << 20) // 按比例挑选的粒度，与 THP 对齐
+#define MAX_SEGS 65536
+#define MAX_NODES 64
+#define BATCH 4096           // 每次 move_pages 的页数
+#define SAMPLE_PAGES 65536   // 保持期间每秒抽查的页数上限
+
+volatile int keep_running = 1;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+static long page_size;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// === 1. 节点与距离 ===
+
+static int nodes_mem[MAX_NODES]; // 有内存的节点
+static int nnodes = 0;
+
+static int node_distance(int from, int to)
+{
+    char path[96], line[512];
+    cpu_set_t online;
+    FILE *fp;
+
+    // distance 文件按在线节点编号升序排列
+    fp = fopen("/sys/devices/system/node/online", "r");
+    if (!fp || !fgets(line, sizeof(line), fp) || fi_topo_parse_list(line, &online) < 0)
+    {
+        if (fp)
+            fclose(fp);
+        return from == to ? 10 : 20;
+    }
+    fclose(fp);
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/distance", from);
+    if (!(fp = fopen(path, "r")) || !fgets(line, sizeof(line), fp))
+    {
+        if (fp)
+            fclose(fp);
+        return from == to ? 10 : 20;
+    }
+    fclose(fp);
+    char *p = line;
+    for (int n = 0; n < MAX_NODES; n++)
+    {
+        if (!CPU_ISSET(n, &online))
+            continue;
+        char *end;
+        long d = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (n == to)
+            return (int)d;
+        p = end;
+    }
+    return from == to ? 10 : 20;
+}
+
+static int load_nodes(void)
+{
+    char line[512];
+    cpu_set_t set;
+    FILE *fp = fopen("/sys/devices/system/node/has_memory", "r");
+    if (!fp)
+        fp = fopen("/sys/devices/system/node/online", "r");
+    if (!fp || !fgets(line, sizeof(line), fp) || fi_topo_parse_list(line, &set) < 0)
+    {
+        if (fp)
+            fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    nnodes = 0;
+    for (int n = 0; n < MAX_NODES; n++)
+        if (CPU_ISSET(n, &set))
+            nodes_mem[nnodes++] = n;
+    return nnodes;
+}
+
+// 目标线程实际运行所在的主要节点
+static int target_home_node(pid_t pid)
+{
+    FiTopo topo;
+    cpu_set_t used, allowed;
+    int count[MAX_NODES] = {0}, best = -1;
+
+    if (fi_topo_load(&topo) < 0 || fi_topo_target_cpus(pid, 200, &used, &allowed) <= 0)
+        return -1;
+    for (int c = 0; c < topo.ncpu; c++)
+        if (CPU_ISSET(c, &used) && topo.node[c] >= 0 && topo.node[c] < MAX_NODES)
+            count[topo.node[c]]++;
+    for (int n = 0; n < MAX_NODES; n++)
+        if (count[n] > 0 && (best < 0 || count[n] > count[best]))
+            best = n;
+    return best;
+}
+
+// === 2. 选取页面 ===
+
+typedef struct
+{
+    uintptr_t start, end;
+} Range;
+
+static Range ranges[16];
+static int nranges = 0;
+static int guest_ram = 0; // -r guest：取目标最大的可写映射 (qemu 客户机内存)
+
+static struct
+{
+    uintptr_t start;
+    size_t len;
+} segs[MAX_SEGS];
+static int nsegs = 0;
+
+static void add_seg(uintptr_t start, uintptr_t end)
+{
+    if (nsegs > 0 && segs[nsegs - 1].start + segs[nsegs - 1].len == start)
+        segs[nsegs - 1].len += end - start;
+    else if (nsegs < MAX_SEGS)
+    {
+        segs[nsegs].start = start;
+        segs[nsegs].len = end - start;
+        nsegs++;
+    }
+}
+
+static int is_anon(const char *perms, unsigned long inode, const char *path)
+{
+    if (perms[1] != 'w' || perms[3] != 'p' || inode != 0)
+        return 0;
+    if (path[0] == '\0')
+        return 1;
+    return strcmp(path, "[heap]") == 0 || strcmp(path, "[stack]") == 0 || strncmp(path, "[anon:", 6) == 0;
+}
+
+// 不指定区间时取私有匿名映射；指定区间 (或 guest) 时取区间内全部映射，qemu 的 memfd/共享内存后端也包括在内。
+// 按 2MB 窗口均匀挑选 frac，返回候选总字节数
+static unsigned long long select_pages(pid_t pid, double frac)
+{
+    char path[64], line[512];
+    unsigned long long total = 0, k = 0;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    if (!(fp = fopen(path, "r")))
+        return 0;
+
+    if (guest_ram)
+    {
+        unsigned long long best = 0;
+        while (fgets(line, sizeof(line), fp))
+        {
+            unsigned long long s, e;
+            char perms[8];
+            if (sscanf(line, "%llx-%llx %7s", &s, &e, perms) == 3 && perms[1] == 'w' && e - s > best)
+            {
+                best = e - s;
+                ranges[0].start = s;
+                ranges[0].end = e;
+                nranges = 1;
+            }
+        }
+        rewind(fp);
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long long s, e, off;
+        unsigned long inode;
+        char perms[8], dev[16], name[256] = "";
+        if (sscanf(line, "%llx-%llx %7s %llx %15s %lu %255[^\n]", &s, &e, perms, &off, dev, &inode, name) < 6)
+            continue;
+        if (!nranges && !is_anon(perms, inode, name))
+            continue;
+        for (int r = 0; r < (nranges ? nranges : 1); r++)
+        {
+            uintptr_t a = s, b = e;
+            if (nranges)
+            {
+                a = a > ranges[r].start ? a : ranges[r].start;
+                b = b < ranges[r].end ? b : ranges[r].end;
+                if (a >= b)
+                    continue;
+            }
+            total += b - a;
+            for (uintptr_t w = a; w < b; k++)
+            {
+                uintptr_t we = (w & ~(WIN_BYTES - 1)) + WIN_BYTES;
+                if (we > b)
+                    we = b;
+                if ((unsigned long long)((k + 1) * frac) > (unsigned long long)(k * frac))
+                    add_seg(w, we);
+                w = we;
+            }
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+// 第 idx 个选中页的地址 (按 segs 顺序)；迁移与迁回按同一顺序遍历
+typedef struct
+{
+    int seg;
+    size_t off;
+} Cursor;
+
+static int next_page(Cursor *c, void **addr)
+{
+    while (c->seg < nsegs && c->off >= segs[c->seg].len)
+    {
+        c->seg++;
+        c->off = 0;
+    }
+    if (c->seg >= nsegs)
+        return 0;
+    *addr = (void *)(segs[c->seg].start + c->off);
+    c->off += page_size;
+    return 1;
+}
+
+// === 3. 迁移 ===
+
+static long move_pages_sys(pid_t pid, unsigned long n, void **pages, const int *nodes, int *status, int flags)
+{
+    return syscall(SYS_move_pages, pid, n, pages, nodes, status, flags);
+}
+
+typedef struct
+{
+    long long present, absent;   // 已驻留 / 未分配或已换出 (-ENOENT)
+    long long already;           // 本来就在目的节点
+    long long moved, failed;
+    long long busy, denied, nomem; // 失败原因：EBUSY (锁定/正在 I/O)、EACCES (多进程共享需 -a)、ENOMEM (目的节点已满)
+    long long ns;                // 迁移调用耗时
+} MoveStat;
+
+static void count_fail(MoveStat *st, int err)
+{
+    st->failed++;
+    if (err == -EBUSY)
+        st->busy++;
+    else if (err == -EACCES)
+        st->denied++;
+    else if (err == -ENOMEM)
+        st->nomem++;
+}
+
+static void print_rate(const MoveStat *st)
+{
+    double mb = st->moved * page_size / 1048576.0, sec = st->ns / 1e9;
+    if (st->failed)
+        printf("，失败 %lld (EBUSY %lld，EACCES %lld，ENOMEM %lld)", st->failed, st->busy, st->denied, st->nomem);
+    printf("，耗时 %.2f 秒", sec);
+    if (sec > 0 && st->moved)
+        printf("，吞吐 %.0f MB/s", mb / sec);
+    printf("\n");
+    if (st->denied)
+        printf("[提示] EACCES 为多个进程共享的页，加 -a (MPOL_MF_MOVE_ALL，需要 CAP_SYS_NICE) 一并迁移\n");
+}
+
+// 迁到 dst；orig 非空时记录每页原节点 (-1 为未驻留)。返回 -1 表示整体失败 (errno)
+static int migrate(pid_t pid, int dst, signed char *orig, int flags, MoveStat *st, long long *before)
+{
+    void *pages[BATCH], *mv[BATCH];
+    int status[BATCH], nodes[BATCH];
+    long long idx = 0;
+    Cursor c = {0, 0};
+    long long last = now_ns();
+
+    memset(st, 0, sizeof(*st));
+    while (keep_running)
+    {
+        int n = 0, m = 0;
+        while (n < BATCH && next_page(&c, &pages[n]))
+            n++;
+        if (n == 0)
+            break;
+
+        // 先查询当前节点 (nodes 为 NULL 不迁移)
+        if (move_pages_sys(pid, n, pages, NULL, status, 0) < 0)
+            return -1;
+        for (int i = 0; i < n; i++, idx++)
+        {
+            int node = status[i];
+            if (orig)
+                orig[idx] = node >= 0 && node < MAX_NODES ? node : -1;
+            if (node < 0)
+            {
+                st->absent++;
+                continue;
+            }
+            st->present++;
+            if (before && node < MAX_NODES)
+                before[node]++;
+            if (node == dst)
+            {
+                st->already++;
+                continue;
+            }
+            mv[m] = pages[i];
+            nodes[m++] = dst;
+        }
+        if (m == 0)
+            continue;
+
+        long long t0 = now_ns();
+        long ret = move_pages_sys(pid, m, mv, nodes, status, flags);
+        st->ns += now_ns() - t0;
+        if (ret < 0)
+            return -1;
+        for (int i = 0; i < m; i++)
+        {
+            if (status[i] == dst)
+                st->moved++;
+            else
+                count_fail(st, status[i] < 0 ? status[i] : -EAGAIN);
+        }
+
+        if (now_ns() - last >= 1000000000LL)
+        {
+            printf("  ... 已迁移 %lld 页 (%.1f MB)\n", st->moved, st->moved * page_size / 1048576.0);
+            fflush(stdout);
+            last = now_ns();
+        }
+    }
+    return 0;
+}
+
+// 按 orig 逐页迁回原节点 (move_pages 每页可指定不同节点)；原本就在 dst 的页不动
+static int restore(pid_t pid, const signed char *orig, int dst, int flags, MoveStat *st)
+{
+    void *pages[BATCH];
+    int status[BATCH], nodes[BATCH];
+    long long idx = 0;
+    Cursor c = {0, 0};
+    void *addr;
+
+    memset(st, 0, sizeof(*st));
+    for (;;)
+    {
+        int m = 0;
+        while (m < BATCH && next_page(&c, &addr))
+        {
+            signed char o = orig[idx++];
+            if (o < 0 || o == dst)
+                continue;
+            pages[m] = addr;
+            nodes[m++] = o;
+        }
+        if (m == 0)
+            break;
+        st->present += m;
+        long long t0 = now_ns();
+        long ret = move_pages_sys(pid, m, pages, nodes, status, flags);
+        st->ns += now_ns() - t0;
+        if (ret < 0)
+            return -1;
+        for (int i = 0; i < m; i++)
+        {
+            if (status[i] == nodes[i])
+                st->moved++;
+            else if (status[i] == -ENOENT)
+                st->absent++;
+            else
+                count_fail(st, status[i] < 0 ? status[i] : -EAGAIN);
+        }
+    }
+    return 0;
+}
+
+// 均匀抽查至多 SAMPLE_PAGES 页，返回在 dst 上的比例 (%)，无驻留页返回 -1
+static double sample_on_node(pid_t pid, int dst, long long total_pages)
+{
+    void *pages[BATCH];
+    int status[BATCH];
+    long long stride = total_pages / SAMPLE_PAGES + 1, idx = 0, on = 0, present = 0;
+    Cursor c = {0, 0};
+    void *addr;
+
+    for (;;)
+    {
+        int n = 0;
+        while (n < BATCH && next_page(&c, &addr))
+            if (idx++ % stride == 0)
+                pages[n++] = addr;
+        if (n == 0)
+            break;
+        if (move_pages_sys(pid, n, pages, NULL, status, 0) < 0)
+            return -1;
+        for (int i = 0; i < n; i++)
+        {
+            if (status[i] >= 0)
+                present++;
+            if (status[i] == dst)
+                on++;
+        }
+    }
+    return present ? on * 100.0 / present : -1;
+}
+
+static void read_vmstat(unsigned long long *numa_migrated, unsigned long long *hint_faults)
+{
+    char key[64];
+    unsigned long long val;
+    FILE *fp = fopen("/proc/vmstat", "r");
+
+    *numa_migrated = *hint_faults = 0;
+    if (!fp)
+        return;
+    while (fscanf(fp, "%63s %llu", key, &val) == 2)
+    {
+        if (strcmp(key, "numa_pages_migrated") == 0)
+            *numa_migrated = val;
+        else if (strcmp(key, "numa_hint_faults") == 0)
+            *hint_faults = val;
+    }
+    fclose(fp);
+}
+
+// === 4. 主流程 ===
+
+int main(int argc, char *argv[])
+{
+    double pct = 100;
+    int dst = -1, keep = 0, flags = MPOL_MF_MOVE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+f:r:n:ka")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            pct = atof(optarg);
+            break;
+        case 'r':
+        {
+            unsigned long long a, b;
+            if (strcmp(optarg, "guest") == 0)
+                guest_ram = 1;
+            else if (nranges < 16 && sscanf(optarg, "%llx-%llx", &a, &b) == 2 && a < b)
+            {
+                ranges[nranges].start = a;
+                ranges[nranges].end = b;
+                nranges++;
+            }
+            else
+            {
+                printf("[错误] 无法解析地址区间: %s (起始-结束，十六进制，或 guest)\n", optarg);
+                return 1;
+            }
+            break;
+        }
+        case 'n':
+            dst = atoi(optarg);
+            break;
+        case 'k':
+            keep = 1;
+            break;
+        case 'a':
+            flags = MPOL_MF_MOVE_ALL;
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    if (argc < 3)
+    {
+        printf("用法: %s [-f 比例%%] [-r 起始-结束|guest]... [-n 节点] [-k] [-a] <PID> <Duration_Sec>\n", argv[0]);
+        printf("  -f 比例   迁移匿名内存的百分比，按 2MB 窗口均匀散布 (默认 100)\n");
+        printf("  -r 区间   只迁移该地址区间 (十六进制，可多次指定)；guest 取目标最大的可写映射 (qemu 客户机内存)\n");
+        printf("  -n 节点   目的节点 (默认: 离目标线程所在节点最远的有内存节点)\n");
+        printf("  -k        结束后不迁回原节点\n");
+        printf("  -a        MPOL_MF_MOVE_ALL，同时迁移与其他进程共享的页 (需要 CAP_SYS_NICE)\n");
+        printf("  Duration  在远端保持的秒数，0 为迁移后立即退出 (不迁回)\n");
+        printf("示例: sudo %s -r guest $(pidof qemu-system-aarch64) 60\n", argv[0]);
+        printf("      sudo %s -f 30 -n 1 1234 30\n", argv[0]);
+        printf("单路机器：以内核参数 numa=fake=2 启动后即可测试\n");
+        return 1;
+    }
+
+    pid_t pid = atoi(argv[1]);
+    int duration = atoi(argv[2]);
+    if (pid <= 0 || kill(pid, 0) < 0 || pct <= 0 || pct > 100 || duration < 0)
+    {
+        printf("[错误] PID 无效或比例不在 (0,100]、时长为负\n");
+        return 1;
+    }
+    page_size = sysconf(_SC_PAGESIZE);
+    if (duration == 0)
+        keep = 1;
+
+    if (load_nodes() <= 0)
+    {
+        printf("[错误] 无法读取 NUMA 节点信息 (/sys/devices/system/node)\n");
+        return 1;
+    }
+    int home = target_home_node(pid);
+    if (dst < 0)
+    {
+        int from = home >= 0 ? home : nodes_mem[0], best_d = -1;
+        for (int i = 0; i < nnodes; i++)
+        {
+            int d = node_distance(from, nodes_mem[i]);
+            if (nodes_mem[i] != from && d > best_d)
+            {
+                best_d = d;
+                dst = nodes_mem[i];
+            }
+        }
+        if (dst < 0)
+        {
+            printf("[错误] 只有一个有内存的 NUMA 节点，无处可迁 (单路机器可用内核参数 numa=fake=2，或 -n 指定节点做空跑)\n");
+            return 1;
+        }
+    }
+    int valid = 0;
+    for (int i = 0; i < nnodes; i++)
+        valid |= nodes_mem[i] == dst;
+    if (!valid)
+    {
+        printf("[错误] 节点 %d 不在线或没有内存\n", dst);
+        return 1;
+    }
+
+    unsigned long long total = select_pages(pid, pct / 100.0);
+    long long npages = 0;
+    for (int i = 0; i < nsegs; i++)
+        npages += segs[i].len / page_size;
+    if (npages == 0)
+    {
+        printf("[错误] 目标没有可迁移的内存 (检查 PID 与 -r 区间)\n");
+        return 1;
+    }
+    signed char *orig = keep ? NULL : malloc(npages);
+    if (!keep && !orig)
+    {
+        printf("[错误] 无法分配原节点记录 (%lld 页)\n", npages);
+        return 1;
+    }
+    if (orig)
+        memset(orig, -1, npages); // 中途中断时未查询到的页保持 -1，恢复时跳过
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    printf("=== NUMA 远端内存注入器 ===\n");
+    if (home >= 0)
+        printf("目标 PID: %d，线程所在节点 %d，目的节点 %d (距离 %d)\n", pid, home, dst, node_distance(home, dst));
+    else
+        printf("目标 PID: %d，线程所在节点未知，目的节点 %d\n", pid, dst);
+    printf("候选内存 %.0f MB%s，选中 %.0f%% (%.0f MB，%d 段)，%s\n\n", total / 1048576.0,
+           guest_ram ? " (客户机内存区)" : nranges ? " (限定区间)" : "", pct, npages * page_size / 1048576.0, nsegs,
+           keep ? "不迁回" : "结束后迁回原节点");
+
+    // --- 迁移 ---
+    MoveStat st;
+    long long before[MAX_NODES] = {0};
+    if (migrate(pid, dst, orig, flags, &st, before) < 0)
+    {
+        if (errno == EPERM)
+            printf("[错误] 权限不足：迁移其他进程的页需要 CAP_SYS_NICE (以 root 运行)\n");
+        else if (errno == ENODEV)
+            printf("[错误] 节点 %d 不在线或没有内存\n", dst);
+        else
+            printf("[错误] move_pages 失败: %s\n", strerror(errno));
+        // 前面的批次可能已迁走部分页：按已记录的原节点迁回 (未查询到的页为 -1，会被跳过)
+        MoveStat rs;
+        if (orig && kill(pid, 0) == 0)
+        {
+            if (restore(pid, orig, dst, flags, &rs) < 0)
+                printf("[错误] 迁回失败: %s\n", strerror(errno));
+            else if (rs.present)
+                printf("[迁回] 待迁回 %lld 页，成功 %lld 页\n", rs.present, rs.moved);
+        }
+        free(orig);
+        return 1;
+    }
+    printf("迁移前分布:");
+    for (int n = 0; n < MAX_NODES; n++)
+        if (before[n])
+            printf(" 节点%d %.1f MB", n, before[n] * page_size / 1048576.0);
+    printf("\n");
+    printf("[迁移] 驻留 %lld 页 (未分配/已换出 %lld)，本在节点 %d %lld 页，迁移成功 %lld 页 (%.1f MB)",
+           st.present, st.absent, dst, st.already, st.moved, st.moved * page_size / 1048576.0);
+    print_rate(&st);
+
+    // --- 保持 ---
+    if (duration > 0 && keep_running)
+    {
+        unsigned long long mig_prev, hint_prev;
+        printf("\n  秒  远端驻留%%  自动迁回页/s  NUMA提示缺页/s\n");
+        read_vmstat(&mig_prev, &hint_prev);
+        long long start = now_ns();
+        for (int sec = 1; sec <= duration && keep_running; sec++)
+        {
+            long long wait = start + sec * 1000000000LL - now_ns();
+            if (wait > 0)
+                usleep(wait / 1000);
+            if (!keep_running || kill(pid, 0) < 0)
+                break;
+            unsigned long long mig, hint;
+            read_vmstat(&mig, &hint);
+            double on = sample_on_node(pid, dst, npages);
+            printf("%4d %10.1f %13llu %15llu\n", sec, on, mig - mig_prev, hint - hint_prev);
+            fflush(stdout);
+            mig_prev = mig;
+            hint_prev = hint;
+        }
+    }
+
+    // --- 迁回 ---
+    if (!keep)
+    {
+        MoveStat rs;
+        if (kill(pid, 0) < 0)
+            printf("\n[提示] 目标进程已退出，无需迁回\n");
+        else if (restore(pid, orig, dst, flags, &rs) < 0)
+            printf("\n[错误] 迁回失败: %s\n", strerror(errno));
+        else
+        {
+            printf("\n[迁回] 待迁回 %lld 页，成功 %lld 页 (%.1f MB)，已释放或换出 %lld 页",
+                   rs.present, rs.moved, rs.moved * page_size / 1048576.0, rs.absent);
+            print_rate(&rs);
+        }
+    }
+    free(orig);
+    return 0;
+}
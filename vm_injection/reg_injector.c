@@ -1,7 +1,10 @@
 /*
  * reg_injector.c - 最终统一版 ARM64 寄存器注入器
- * 功能：支持全故障模型 + 立即/延时触发
- * 编译：gcc -o reg_injector reg_injector.c
+ * 功能：支持全故障模型 + 立即/延时/周期触发
+ * 延时与周期触发基于 fi_trigger (timerfd + PTRACE_INTERRUPT)，目标不会收到 SIGSTOP
+ * 系统调用模式 (sys) 基于 seccomp SECCOMP_RET_TRACE，只在选定系统调用处停止
+ * 设置 FI_RESULTS 时每次注入追加到结果库
+ * 编译：gcc -o reg_injector reg_injector.c fi_trigger.c fi_sys.c fi_fault.c fi_results.c
  */
 
 #define _GNU_SOURCE
@@ -20,6 +23,13 @@
 #include <time.h>
 #include <signal.h>
 
+#include "fi_trigger.h"
+#include "fi_sys.h"
+#include "fi_fault.h"
+#include "fi_results.h"
+
+#include <linux/seccomp.h>
+
 // === 1. ARM64 寄存器结构定义 (防止头文件缺失) ===
 struct user_pt_regs
 {
@@ -29,28 +39,44 @@ struct user_pt_regs
     uint64_t pstate;
 };
 
-// === 2. 故障类型定义 ===
-typedef enum
-{
-    FAULT_1_BIT_FLIP,
-    FAULT_2_BIT_FLIP,
-    FAULT_1_BIT_0,
-    FAULT_2_BIT_0,
-    FAULT_1_BIT_1,
-    FAULT_2_BIT_1,
-    FAULT_8_LOW_0,
-    FAULT_8_LOW_1,
-    FAULT_8_LOW_ERROR,
-    FAULT_PLUS_1,
-    FAULT_PLUS_2,
-    FAULT_PLUS_3,
-    FAULT_PLUS_4,
-    FAULT_PLUS_5
-} FaultType;
+// === 2. 故障类型定义见 fi_fault.h ===
 
 // 全局变量 (用于信号处理)
-pid_t global_target_pid = -1;
 volatile int keep_running = 1;
+static FiResults *results = NULL;
+
+// 记录一次注入到结果库 (未设置 FI_RESULTS 时为空操作)
+static void record_injection(pid_t pid, const char *site, const char *model, int bit,
+                             uint64_t old_val, uint64_t new_val)
+{
+    if (!results)
+        return;
+    char path[64], comm[64] = "";
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    FILE *f = fopen(path, "r");
+    if (f)
+    {
+        if (fgets(comm, sizeof(comm), f))
+            comm[strcspn(comm, "\n")] = '\0';
+        fclose(f);
+    }
+
+    FiResultRow row = {0};
+    row.target = comm;
+    row.site = site;
+    row.model = model;
+    row.outcome = "injected";
+    row.bit = bit;
+    row.old_val = old_val;
+    row.new_val = new_val;
+    fi_results_add(results, &row);
+}
+
+static void close_results(void)
+{
+    fi_results_close(results);
+    results = NULL;
+}
 
 void die(const char *msg)
 {
@@ -65,20 +91,6 @@ void sigint_handler(int sig)
     printf("\n[!] 收到停止信号，正在退出...\n");
 }
 
-// 辅助函数
-int rand_bit() { return rand() % 64; }
-uint64_t my_rand() { return (uint64_t)rand(); }
-
-// 信号处理：定时器到期后暂停目标进程
-void alarm_handler(int sig)
-{
-    if (global_target_pid > 0)
-    {
-        // 发送 SIGSTOP 暂停目标，以便 ptrace 接管
-        kill(global_target_pid, SIGSTOP);
-    }
-}
-
 void ptrace_attach(pid_t pid)
 {
     if (ptrace(PTRACE_ATTACH, pid, NULL, NULL) < 0)
@@ -91,92 +103,468 @@ void ptrace_detach(pid_t pid)
     ptrace(PTRACE_DETACH, pid, NULL, NULL);
 }
 
-// === 3. 核心故障逻辑 ===
-uint64_t apply_fault(uint64_t original, FaultType type, int user_specified_bit)
+// === 3. 核心故障逻辑 (fi_fault_apply) ===
+// 定位寄存器指针
+uint64_t *locate_reg(struct user_pt_regs *regs, const char *reg_name)
+{
+    if (strcasecmp(reg_name, "PC") == 0)
+        return &regs->pc;
+    if (strcasecmp(reg_name, "SP") == 0)
+        return &regs->sp;
+    if (reg_name[0] == 'X' || reg_name[0] == 'x')
+    {
+        int idx = atoi(reg_name + 1);
+        if (idx >= 0 && idx <= 30)
+            return &regs->regs[idx];
+    }
+    return NULL;
+}
+
+// 对已停住的目标执行一次注入
+// 返回: 0=成功, -1=读写寄存器失败, -2=无效寄存器
+int inject_stopped(pid_t pid, const char *reg_name, FaultType type, int bit,
+                   uint64_t *old_val, uint64_t *new_val)
+{
+    struct user_pt_regs regs;
+    struct iovec iov;
+    iov.iov_base = &regs;
+    iov.iov_len = sizeof(regs);
+    if (ptrace(PTRACE_GETREGSET, pid, NT_PRSTATUS, &iov) < 0)
+    {
+        perror("GETREGSET failed");
+        return -1;
+    }
+
+    uint64_t *target_ptr = locate_reg(&regs, reg_name);
+    if (!target_ptr)
+        return -2;
+
+    *old_val = *target_ptr;
+    *new_val = fi_fault_apply(*old_val, type, bit);
+    *target_ptr = *new_val;
+
+    if (ptrace(PTRACE_SETREGSET, pid, NT_PRSTATUS, &iov) < 0)
+    {
+        perror("SETREGSET failed");
+        return -1;
+    }
+    return 0;
+}
+
+// === 4. 定时触发模式 (延时 / 绝对时刻 / 周期) ===
+// 整个过程只 seize 一次，每次触发用 PTRACE_INTERRUPT 精确停住目标
+int run_timed(pid_t pid, const char *reg_name, FaultType type, int bit,
+              uint64_t deadline_ns, uint64_t period_ns, int loop_count, const char *csv_path)
+{
+    FiTrigger trig;
+    int injection_count = 0;
+    int infinite_loop = (loop_count == 0);
+    char site[32];
+    snprintf(site, sizeof(site), "reg:%s", reg_name);
+
+    struct user_pt_regs probe;
+    if (!locate_reg(&probe, reg_name))
+    {
+        printf(" 无效寄存器\n");
+        return -1;
+    }
+    if (fi_seize(pid) < 0)
+    {
+        perror("Seize failed");
+        return -1;
+    }
+    if (fi_trigger_init(&trig, pid, deadline_ns, period_ns) < 0)
+    {
+        perror("timerfd_create failed");
+        fi_release(pid);
+        return -1;
+    }
+    if (csv_path)
+    {
+        trig.log = fopen(csv_path, "w");
+        if (trig.log)
+            fprintf(trig.log, "seq,requested_ns,actual_ns,latency_ns,overruns\n");
+        else
+            perror("打开触发日志失败");
+    }
+
+    printf(" 定时模式: 首次触发 +%.3f ms", (deadline_ns - trig.base_ns) / 1e6);
+    if (period_ns > 0)
+        printf(", 周期 %.3f ms", period_ns / 1e6);
+    printf("\n");
+
+    int attached = 1, stopped = 0;
+    while (keep_running && (infinite_loop || injection_count < loop_count))
+    {
+        FiTriggerHit hit;
+        int ret = fi_trigger_wait(&trig, &hit);
+        if (ret > 0)
+            continue;
+        if (ret < 0)
+        {
+            printf("[!] 目标进程已退出\n");
+            attached = 0;
+            break;
+        }
+        stopped = 1;
+
+        uint64_t old_val, new_val;
+        int r = inject_stopped(pid, reg_name, type, bit, &old_val, &new_val);
+        if (r == 0)
+        {
+            injection_count++;
+            record_injection(pid, site, fi_fault_name(type), bit, old_val, new_val);
+            printf("[#%d] %s: 0x%lx -> 0x%lx  请求 +%.3f ms, 实际 +%.3f ms, 偏差 %.1f µs\n",
+                   injection_count, reg_name, old_val, new_val,
+                   (hit.requested_ns - trig.base_ns) / 1e6,
+                   (hit.actual_ns - trig.base_ns) / 1e6,
+                   (double)(int64_t)(hit.actual_ns - hit.requested_ns) / 1000.0);
+        }
+
+        if (period_ns == 0)
+            break;
+        ptrace(PTRACE_CONT, pid, NULL, NULL);
+        stopped = 0;
+    }
+
+    // 已停住的目标直接 detach；正在运行的须先 PTRACE_INTERRUPT 停住 (对已停住的目标会一直等不到停止事件)
+    if (attached)
+    {
+        if (stopped)
+            ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        else
+            fi_release(pid);
+    }
+
+    fi_trigger_report(&trig);
+    fi_trigger_close(&trig);
+    return injection_count;
+}
+
+// === 5. 系统调用边界注入 (seccomp 过滤的 ptrace 停止) ===
+// 目标由本工具启动：子进程安装只对选定调用返回 SECCOMP_RET_TRACE 的过滤器后 exec，
+// 未选中的系统调用完全在内核内执行，不产生任何 ptrace 停止。
+#define SYS_MAX_TRACEES 1024
+
+typedef struct
 {
-    uint64_t corrupted = original;
-    int bit1 = (user_specified_bit >= 0) ? user_specified_bit : rand_bit();
-    int bit2 = rand_bit();
-    uint64_t mask_low_8 = 0xFFFFFFFFFFFFFF00;
+    pid_t pid;
+    int pending; // 0=无, 1=等待返回时篡改返回值, 2=等待返回时写入 -errno
+    long nr;
+} SysTracee;
+
+static SysTracee sys_tracees[SYS_MAX_TRACEES];
 
-    switch (type)
+static SysTracee *sys_tracee(pid_t pid, int create)
+{
+    SysTracee *free_slot = NULL;
+    for (int i = 0; i < SYS_MAX_TRACEES; i++)
+    {
+        if (sys_tracees[i].pid == pid)
+            return &sys_tracees[i];
+        if (!free_slot && sys_tracees[i].pid == 0)
+            free_slot = &sys_tracees[i];
+    }
+    if (create && free_slot)
     {
-    case FAULT_1_BIT_FLIP:
-        corrupted ^= (1UL << bit1);
-        break;
-    case FAULT_2_BIT_FLIP:
-        corrupted ^= (1UL << bit1);
-        corrupted ^= (1UL << bit2);
-        break;
-    case FAULT_1_BIT_0:
-        corrupted &= ~(1UL << bit1);
-        break;
-    case FAULT_2_BIT_0:
-        corrupted &= ~(1UL << bit1);
-        corrupted &= ~(1UL << bit2);
-        break;
-    case FAULT_1_BIT_1:
-        corrupted |= (1UL << bit1);
-        break;
-    case FAULT_2_BIT_1:
-        corrupted |= (1UL << bit1);
-        corrupted |= (1UL << bit2);
-        break;
-    case FAULT_8_LOW_0:
-        corrupted &= mask_low_8;
-        break;
-    case FAULT_8_LOW_1:
-        corrupted |= 0xFF;
-        break;
-    case FAULT_8_LOW_ERROR:
-        corrupted ^= (my_rand() & 0xFF);
-        break;
-    case FAULT_PLUS_1:
-        corrupted += 1;
-        break;
-    case FAULT_PLUS_2:
-        corrupted += 2;
-        break;
-    case FAULT_PLUS_3:
-        corrupted += 3;
-        break;
-    case FAULT_PLUS_4:
-        corrupted += 4;
-        break;
-    case FAULT_PLUS_5:
-        corrupted += 5;
-        break;
-    default:
-        break;
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->pid = pid;
     }
-    return corrupted;
+    return create ? free_slot : NULL;
+}
+
+void print_syscall_usage(const char *prog)
+{
+    printf("用法: %s sys <Syscalls> <Where> [Type] [Bit] [选项] -- <命令> [参数...]\n", prog);
+    printf("参数:\n");
+    printf("  Syscalls        逗号分隔的系统调用名或号 (如 read,fsync)\n");
+    printf("  Where           arg0-arg5 (篡改入口参数) | ret (篡改返回值) | err:<ERRNO> (跳过调用并返回错误)\n");
+    printf("  Type/Bit        同寄存器注入 (flip1/zero1/add1...)，err 模式无需指定\n");
+    printf("选项:\n");
+    printf("  -n <N>          从第 N 次命中开始注入 (默认1)\n");
+    printf("  -l <count>      注入次数 (默认1, 0=不限)\n");
+    printf("  -p <percent>    每次命中的注入概率 (默认100)\n");
+    printf("示例:\n");
+    printf("  %s sys read arg2 flip1 4 -- ./target_res\n", prog);
+    printf("  %s sys fsync err:EIO -l 0 -- ./app --flag\n", prog);
+}
+
+int run_syscall_mode(int argc, char *argv[])
+{
+    int sep = -1;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            sep = i;
+            break;
+        }
+    }
+    if (sep < 0 || sep < 4 || sep + 1 >= argc)
+    {
+        print_syscall_usage(argv[0]);
+        return 1;
+    }
+
+    int nrs[FI_SYS_MAX_FILTER];
+    int nsys = fi_sys_parse_list(argv[2], nrs, FI_SYS_MAX_FILTER);
+    if (nsys <= 0)
+        return 1;
+
+    const char *where = argv[3];
+    int arg_idx = -1, err_val = 0;
+    if (strncmp(where, "arg", 3) == 0 && where[3] >= '0' && where[3] <= '5' && where[4] == '\0')
+        arg_idx = where[3] - '0';
+    else if (strncmp(where, "err:", 4) == 0)
+    {
+        err_val = fi_errno_lookup(where + 4);
+        if (err_val <= 0)
+        {
+            printf(" 无效 errno: %s\n", where + 4);
+            return 1;
+        }
+    }
+    else if (strcmp(where, "ret") != 0)
+    {
+        print_syscall_usage(argv[0]);
+        return 1;
+    }
+
+    FaultType type = FAULT_1_BIT_FLIP;
+    int bit = -1, nth = 1, count = 1, prob = 100;
+    int i = 4;
+    if (!err_val && i < sep && argv[i][0] != '-')
+        type = fi_fault_parse(argv[i++]);
+    for (; i < sep; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < sep)
+            nth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < sep)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < sep)
+            prob = atoi(argv[++i]);
+        else
+            bit = atoi(argv[i]);
+    }
+
+    printf("=== 系统调用边界注入 ===\n");
+    printf(" 系统调用: %s, 位置: %s, 从第 %d 次命中开始, 次数: %d%s\n",
+           argv[2], where, nth, count, count == 0 ? " (不限)" : "");
+
+    pid_t child = fork();
+    if (child < 0)
+        die("fork failed");
+    if (child == 0)
+    {
+        // 先进入被跟踪状态，待父进程设置好选项后再安装过滤器，
+        // 否则命中的系统调用会因为没有 tracer 而返回 ENOSYS
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        if (fi_seccomp_install(nrs, nsys, SECCOMP_RET_TRACE, 0) < 0)
+        {
+            perror("seccomp install failed");
+            _exit(127);
+        }
+        execvp(argv[sep + 1], &argv[sep + 1]);
+        perror("execvp failed");
+        _exit(127);
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+    long opts = PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL |
+                PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC;
+    if (ptrace(PTRACE_SETOPTIONS, child, NULL, (void *)opts) < 0)
+        die("PTRACE_SETOPTIONS failed");
+    sys_tracee(child, 1);
+    ptrace(PTRACE_CONT, child, NULL, NULL);
+
+    printf(" 目标已启动 (PID: %d)\n", child);
+
+    long matched = 0, injected = 0;
+    int child_status = 0;
+
+    while (1)
+    {
+        pid_t pid = waitpid(-1, &status, __WALL);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break; // ECHILD: 所有被跟踪进程都已退出
+        }
+
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+        {
+            SysTracee *t = sys_tracee(pid, 0);
+            if (t)
+                t->pid = 0;
+            if (pid == child)
+                child_status = status;
+            continue;
+        }
+        if (!WIFSTOPPED(status))
+            continue;
+
+        int sig = WSTOPSIG(status);
+        int event = status >> 16;
+        SysTracee *t = sys_tracee(pid, 0);
+
+        // 自动跟踪的新线程/子进程以 SIGSTOP 开始，吞掉这一次
+        if (!t)
+        {
+            sys_tracee(pid, 1);
+            ptrace(PTRACE_CONT, pid, NULL, (void *)(long)(sig == SIGSTOP ? 0 : sig));
+            continue;
+        }
+
+        if (event == PTRACE_EVENT_SECCOMP)
+        {
+            fi_regs_t regs;
+            if (fi_get_regs(pid, &regs) < 0)
+            {
+                ptrace(PTRACE_CONT, pid, NULL, NULL);
+                continue;
+            }
+            long nr = (long)FI_REG_SYSNO(&regs);
+            matched++;
+
+            int fire = matched >= nth &&
+                       (count == 0 || injected < count) &&
+                       (prob >= 100 || rand() % 100 < prob);
+            if (!fire)
+            {
+                ptrace(PTRACE_CONT, pid, NULL, NULL);
+                continue;
+            }
+
+            if (arg_idx >= 0)
+            {
+                uint64_t *arg = fi_sys_arg(&regs, arg_idx);
+                uint64_t old_val = *arg;
+                *arg = fi_fault_apply(old_val, type, bit);
+                fi_set_regs(pid, &regs);
+                injected++;
+                printf("[注入 #%ld] PID %d %s() arg%d: 0x%lx -> 0x%lx\n",
+                       injected, pid, fi_sys_name(nr), arg_idx, old_val, *arg);
+                char site[64];
+                snprintf(site, sizeof(site), "sys:%s:arg%d", fi_sys_name(nr), arg_idx);
+                record_injection(pid, site, fi_fault_name(type), bit, old_val, *arg);
+                ptrace(PTRACE_CONT, pid, NULL, NULL);
+            }
+            else
+            {
+                // 返回值/错误注入需要再停一次在系统调用出口
+                if (err_val)
+                {
+                    fi_set_sysno(pid, &regs, -1);
+                    fi_set_regs(pid, &regs);
+                }
+                t->pending = err_val ? 2 : 1;
+                t->nr = nr;
+                ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+            }
+            continue;
+        }
+
+        if (sig == (SIGTRAP | 0x80))
+        {
+            // 系统调用出口停止
+            if (t->pending)
+            {
+                fi_regs_t regs;
+                if (fi_get_regs(pid, &regs) == 0)
+                {
+                    uint64_t old_val = FI_REG_RET(&regs);
+                    if (t->pending == 2)
+                        FI_REG_RET(&regs) = (uint64_t)(-(long)err_val);
+                    else
+                        FI_REG_RET(&regs) = fi_fault_apply(old_val, type, bit);
+                    fi_set_regs(pid, &regs);
+                    injected++;
+                    char site[64], model[32];
+                    snprintf(site, sizeof(site), "sys:%s:ret", fi_sys_name(t->nr));
+                    snprintf(model, sizeof(model), "err:%d", err_val);
+                    record_injection(pid, site, t->pending == 2 ? model : fi_fault_name(type), bit,
+                                     old_val, FI_REG_RET(&regs));
+                    if (t->pending == 2)
+                        printf("[注入 #%ld] PID %d %s() 跳过并返回 -%d\n",
+                               injected, pid, fi_sys_name(t->nr), err_val);
+                    else
+                        printf("[注入 #%ld] PID %d %s() 返回值: %ld -> %ld\n",
+                               injected, pid, fi_sys_name(t->nr), (long)old_val, (long)FI_REG_RET(&regs));
+                }
+                t->pending = 0;
+            }
+            ptrace(PTRACE_CONT, pid, NULL, NULL);
+            continue;
+        }
+
+        if (event == PTRACE_EVENT_CLONE || event == PTRACE_EVENT_FORK ||
+            event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_EXEC)
+        {
+            ptrace(PTRACE_CONT, pid, NULL, NULL);
+            continue;
+        }
+
+        // 信号投递停止：原样转交；group-stop (无 siginfo) 直接继续
+        siginfo_t si;
+        if (ptrace(PTRACE_GETSIGINFO, pid, NULL, &si) < 0)
+            sig = 0;
+        ptrace(PTRACE_CONT, pid, NULL, (void *)(long)sig);
+    }
+
+    printf(" 完成: 命中 %ld 次, 注入 %ld 次\n", matched, injected);
+    if (WIFEXITED(child_status))
+        printf(" 目标退出码: %d\n", WEXITSTATUS(child_status));
+    else if (WIFSIGNALED(child_status))
+        printf(" 目标被信号终止: %d (%s)\n", WTERMSIG(child_status), strsignal(WTERMSIG(child_status)));
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
-    // 参数解析：支持 -w 和 -l 选项
+    results = fi_results_open_env("reg_injector");
+    atexit(close_results);
+
+    if (argc >= 2 && strcmp(argv[1], "sys") == 0)
+        return run_syscall_mode(argc, argv);
+
+    // 参数解析：支持 -w/-W/-P/-T 和 -l 选项
     if (argc < 4)
     {
         printf("用法: %s <PID> <Register> <Type> [Bit] [-w <usec>] [-l <loop_count>]\n", argv[0]);
         printf("选项:\n");
         printf("  -w <usec>       延时触发 (微秒)\n");
+        printf("  -W <epoch秒>    绝对时刻触发 (date +%%s.%%N 格式的墙钟时间)\n");
+        printf("  -P <usec>       周期触发 (微秒)，配合 -l 指定次数\n");
+        printf("  -T <file>       记录每次触发的请求/实际时刻 (CSV)\n");
         printf("  -l <count>      循环注入次数 (0=无限, Ctrl+C停止)\n");
         printf("  -i <interval>   循环间隔 (毫秒, 默认50)\n");
         printf("示例:\n");
         printf("  %s 1234 X0 flip1 -1         # 单次注入\n", argv[0]);
         printf("  %s 1234 X0 flip1 -1 -l 100  # 循环100次\n", argv[0]);
         printf("  %s 1234 X0 add1 -1 -l 0     # 无限循环直到Ctrl+C\n", argv[0]);
+        printf("  %s 1234 X0 flip1 -1 -w 500000 -P 10000 -l 50 -T trig.csv\n", argv[0]);
+        printf("系统调用模式: %s sys ... (不带参数查看帮助)\n", argv[0]);
         return 1;
     }
 
     srand(time(NULL));
-    signal(SIGINT, sigint_handler);
+    // 不设 SA_RESTART：Ctrl+C 要能打断 timerfd 的 read
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigaction(SIGINT, &sa, NULL);
 
     pid_t pid = atoi(argv[1]);
     char *reg_name = argv[2];
     char *type_str = argv[3];
     int bit = -1;
-    int wait_usec = 0;
+    long wait_usec = 0;
+    double abs_deadline = 0;
+    long period_usec = 0;
+    const char *csv_path = NULL;
     int loop_count = 1;     // 默认单次
     int loop_interval = 50; // 默认50ms间隔
 
@@ -185,7 +573,22 @@ int main(int argc, char *argv[])
     {
         if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
         {
-            wait_usec = atoi(argv[i + 1]);
+            wait_usec = atol(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc)
+        {
+            abs_deadline = atof(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+        {
+            period_usec = atol(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+        {
+            csv_path = argv[i + 1];
             i++;
         }
         else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
@@ -204,34 +607,7 @@ int main(int argc, char *argv[])
         }
     }
 
-    // 解析故障类型
-    FaultType type = FAULT_1_BIT_FLIP;
-    if (strcmp(type_str, "flip2") == 0)
-        type = FAULT_2_BIT_FLIP;
-    else if (strcmp(type_str, "zero1") == 0)
-        type = FAULT_1_BIT_0;
-    else if (strcmp(type_str, "zero2") == 0)
-        type = FAULT_2_BIT_0;
-    else if (strcmp(type_str, "set1") == 0)
-        type = FAULT_1_BIT_1;
-    else if (strcmp(type_str, "set2") == 0)
-        type = FAULT_2_BIT_1;
-    else if (strcmp(type_str, "low0") == 0)
-        type = FAULT_8_LOW_0;
-    else if (strcmp(type_str, "low1") == 0)
-        type = FAULT_8_LOW_1;
-    else if (strcmp(type_str, "lowerr") == 0)
-        type = FAULT_8_LOW_ERROR;
-    else if (strcmp(type_str, "add1") == 0)
-        type = FAULT_PLUS_1;
-    else if (strcmp(type_str, "add2") == 0)
-        type = FAULT_PLUS_2;
-    else if (strcmp(type_str, "add3") == 0)
-        type = FAULT_PLUS_3;
-    else if (strcmp(type_str, "add4") == 0)
-        type = FAULT_PLUS_4;
-    else if (strcmp(type_str, "add5") == 0)
-        type = FAULT_PLUS_5;
+    FaultType type = fi_fault_parse(type_str);
 
     printf("=== ARM64 寄存器注入器 (PID: %d) ===\n", pid);
 
@@ -239,6 +615,27 @@ int main(int argc, char *argv[])
     int is_loop_mode = (loop_count != 1);
     int infinite_loop = (loop_count == 0);
 
+    // ========== 定时触发 (-w / -W / -P) ==========
+    if (wait_usec > 0 || abs_deadline > 0 || period_usec > 0)
+    {
+        uint64_t deadline_ns;
+        if (abs_deadline > 0)
+            deadline_ns = fi_realtime_to_mono(abs_deadline);
+        else
+            deadline_ns = fi_now_ns() + (uint64_t)wait_usec * 1000ULL;
+
+        // 循环模式未指定周期时，沿用 -i 间隔作为周期
+        uint64_t period_ns = (uint64_t)period_usec * 1000ULL;
+        if (period_ns == 0 && is_loop_mode)
+            period_ns = (uint64_t)loop_interval * 1000000ULL;
+
+        int n = run_timed(pid, reg_name, type, bit, deadline_ns, period_ns, loop_count, csv_path);
+        if (n < 0)
+            return 1;
+        printf(" 完成，共注入 %d 次\n", n);
+        return 0;
+    }
+
     if (is_loop_mode)
     {
         if (infinite_loop)
@@ -252,6 +649,8 @@ int main(int argc, char *argv[])
     }
 
     int injection_count = 0;
+    char site[32];
+    snprintf(site, sizeof(site), "reg:%s", reg_name);
 
     // ========== 循环注入 ==========
     while (keep_running && (infinite_loop || injection_count < loop_count))
@@ -268,73 +667,27 @@ int main(int argc, char *argv[])
             usleep(loop_interval * 1000);
             continue;
         }
-        waitpid(pid, NULL, 0);
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+            ;
 
-        // 2. 处理延时逻辑 (如果有 -w 参数)
-        if (wait_usec > 0 && injection_count == 0)
+        // 2. 获取寄存器并应用故障
+        uint64_t old_val, new_val;
+        int r = inject_stopped(pid, reg_name, type, bit, &old_val, &new_val);
+        if (r == -2)
         {
-            printf(" 延时模式: 目标将继续运行 %.2f 秒...\n", wait_usec / 1000000.0);
-
-            signal(SIGALRM, alarm_handler);
-            global_target_pid = pid;
-            ualarm(wait_usec, 0);
-
-            if (ptrace(PTRACE_CONT, pid, NULL, NULL) < 0)
-            {
-                perror("PTRACE_CONT failed");
-                ptrace(PTRACE_DETACH, pid, NULL, NULL);
-                break;
-            }
-
-            int status;
-            waitpid(pid, &status, 0);
-
-            if (!WIFSTOPPED(status))
-            {
-                printf(" 警告: 目标在等待期间异常退出。\n");
-                break;
-            }
+            printf(" 无效寄存器\n");
+            ptrace(PTRACE_DETACH, pid, NULL, NULL);
+            return 1;
         }
-
-        // 3. 获取寄存器
-        struct user_pt_regs regs;
-        struct iovec iov;
-        iov.iov_base = &regs;
-        iov.iov_len = sizeof(regs);
-        if (ptrace(PTRACE_GETREGSET, pid, NT_PRSTATUS, &iov) < 0)
+        if (r < 0)
         {
-            perror("GETREGSET failed");
             ptrace(PTRACE_DETACH, pid, NULL, NULL);
             usleep(loop_interval * 1000);
             continue;
         }
 
-        // 4. 定位寄存器指针
-        uint64_t *target_ptr = NULL;
-        if (strcasecmp(reg_name, "PC") == 0)
-            target_ptr = &regs.pc;
-        else if (strcasecmp(reg_name, "SP") == 0)
-            target_ptr = &regs.sp;
-        else if (reg_name[0] == 'X' || reg_name[0] == 'x')
-        {
-            int idx = atoi(reg_name + 1);
-            if (idx >= 0 && idx <= 30)
-                target_ptr = &regs.regs[idx];
-        }
-
-        if (!target_ptr)
-        {
-            printf(" 无效寄存器\n");
-            ptrace(PTRACE_DETACH, pid, NULL, NULL);
-            return 1;
-        }
-
-        // 5. 应用故障
-        uint64_t old_val = *target_ptr;
-        uint64_t new_val = apply_fault(old_val, type, bit);
-        *target_ptr = new_val;
-
         injection_count++;
+        record_injection(pid, site, fi_fault_name(type), bit, old_val, new_val);
 
         if (is_loop_mode)
         {
@@ -349,11 +702,7 @@ int main(int argc, char *argv[])
             printf("[注入] %s: 0x%lx -> 0x%lx\n", reg_name, old_val, new_val);
         }
 
-        // 6. 写回并恢复
-        if (ptrace(PTRACE_SETREGSET, pid, NT_PRSTATUS, &iov) < 0)
-        {
-            perror("SETREGSET failed");
-        }
+        // 3. 恢复
         ptrace(PTRACE_DETACH, pid, NULL, NULL);
 
         // 循环模式下等待间隔
@@ -365,4 +714,4 @@ int main(int argc, char *argv[])
 
     printf(" 完成，共注入 %d 次\n", injection_count);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,278 @@
+/*
+ * res_injector.c - 进程内资源破坏注入器
+ * 功能：借助 fi_remote 远程系统调用引擎，在目标进程上下文中执行：
+ *       关闭/复制文件描述符、mprotect 堆页、munmap 区域、修改套接字缓冲区。
+ *       一条命令中的多个操作共享一次停止，停顿时间为微秒级。
+ * 编译：gcc -o res_injector res_injector.c fi_remote.c fi_sys.c fi_trigger.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "fi_remote.h"
+
+#define MAX_OPS 32
+
+// === 操作类型 ===
+typedef enum
+{
+    OP_CLOSE,    // close(fd)
+    OP_DUP,      // dup3(oldfd, newfd): newfd 被悄悄替换
+    OP_MPROTECT, // mprotect(addr, len, prot)
+    OP_MUNMAP,   // munmap(addr, len)
+    OP_RCVBUF,   // setsockopt(fd, SO_RCVBUF)
+    OP_SNDBUF    // setsockopt(fd, SO_SNDBUF)
+} ResOp;
+
+typedef struct
+{
+    ResOp op;
+    long a, b, c;
+    char desc[96];
+} ResFault;
+
+void print_help(const char *prog)
+{
+    printf("用法: %s <PID> <操作> [参数] [+ <操作> [参数] ...]\n", prog);
+    printf("操作:\n");
+    printf("  close <fd>                      关闭目标的文件描述符\n");
+    printf("  dup <oldfd> <newfd>             用 oldfd 的副本顶替 newfd\n");
+    printf("  mprotect <addr|heap|stack> <len> <none|r|rw|rx|rwx>  修改页保护\n");
+    printf("  munmap <addr|heap> <len>        解除映射\n");
+    printf("  rcvbuf <fd> <bytes>             设置 SO_RCVBUF\n");
+    printf("  sndbuf <fd> <bytes>             设置 SO_SNDBUF\n");
+    printf("说明: 用 + 连接多个操作，它们在同一次停止内批量执行\n");
+    printf("示例:\n");
+    printf("  %s 1234 close 5\n", prog);
+    printf("  %s 1234 mprotect heap 4096 r\n", prog);
+    printf("  %s 1234 rcvbuf 7 4096 + close 9\n", prog);
+}
+
+// 解析 heap/stack 关键字或十六进制地址
+long resolve_addr(pid_t pid, const char *spec)
+{
+    if (strcmp(spec, "heap") != 0 && strcmp(spec, "stack") != 0)
+        return strtol(spec, NULL, 16);
+
+    char path[64], line[512];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    char tag[16];
+    snprintf(tag, sizeof(tag), "[%s]", spec);
+    long addr = -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long start, end;
+        if (strstr(line, tag) && sscanf(line, "%lx-%lx", &start, &end) == 2)
+        {
+            addr = (long)start;
+            break;
+        }
+    }
+    fclose(fp);
+    return addr;
+}
+
+int parse_prot(const char *s)
+{
+    if (strcmp(s, "none") == 0)
+        return PROT_NONE;
+    int prot = 0;
+    for (; *s; s++)
+    {
+        if (*s == 'r')
+            prot |= PROT_READ;
+        else if (*s == 'w')
+            prot |= PROT_WRITE;
+        else if (*s == 'x')
+            prot |= PROT_EXEC;
+        else
+            return -1;
+    }
+    return prot;
+}
+
+// 解析一个操作，返回消耗的参数个数，失败返回 -1
+int parse_op(pid_t pid, char **argv, int argc, ResFault *f)
+{
+    const char *op = argv[0];
+    memset(f, 0, sizeof(*f));
+
+    if (strcmp(op, "close") == 0 && argc >= 2)
+    {
+        f->op = OP_CLOSE;
+        f->a = atol(argv[1]);
+        snprintf(f->desc, sizeof(f->desc), "close(%ld)", f->a);
+        return 2;
+    }
+    if (strcmp(op, "dup") == 0 && argc >= 3)
+    {
+        f->op = OP_DUP;
+        f->a = atol(argv[1]);
+        f->b = atol(argv[2]);
+        snprintf(f->desc, sizeof(f->desc), "dup3(%ld, %ld)", f->a, f->b);
+        return 3;
+    }
+    if (strcmp(op, "mprotect") == 0 && argc >= 4)
+    {
+        f->op = OP_MPROTECT;
+        f->a = resolve_addr(pid, argv[1]);
+        f->b = atol(argv[2]);
+        f->c = parse_prot(argv[3]);
+        if (f->a < 0 || f->c < 0)
+            return -1;
+        snprintf(f->desc, sizeof(f->desc), "mprotect(0x%lx, %ld, %s)", f->a, f->b, argv[3]);
+        return 4;
+    }
+    if (strcmp(op, "munmap") == 0 && argc >= 3)
+    {
+        f->op = OP_MUNMAP;
+        f->a = resolve_addr(pid, argv[1]);
+        f->b = atol(argv[2]);
+        if (f->a < 0)
+            return -1;
+        snprintf(f->desc, sizeof(f->desc), "munmap(0x%lx, %ld)", f->a, f->b);
+        return 3;
+    }
+    if ((strcmp(op, "rcvbuf") == 0 || strcmp(op, "sndbuf") == 0) && argc >= 3)
+    {
+        f->op = (op[0] == 'r') ? OP_RCVBUF : OP_SNDBUF;
+        f->a = atol(argv[1]);
+        f->b = atol(argv[2]);
+        snprintf(f->desc, sizeof(f->desc), "setsockopt(%ld, %s, %ld)",
+                 f->a, f->op == OP_RCVBUF ? "SO_RCVBUF" : "SO_SNDBUF", f->b);
+        return 3;
+    }
+    return -1;
+}
+
+// 把操作翻译为远程系统调用 (setsockopt 需要把参数写入目标临时内存)
+// 整批调用执行前参数都已写好，因此每个调用在临时内存中各占一格 (slot)，互不覆盖
+int build_call(FiRemote *rc, const ResFault *f, int slot, FiRemoteCall *call)
+{
+    memset(call, 0, sizeof(*call));
+    switch (f->op)
+    {
+    case OP_CLOSE:
+        call->nr = SYS_close;
+        call->args[0] = f->a;
+        break;
+    case OP_DUP:
+        call->nr = SYS_dup3;
+        call->args[0] = f->a;
+        call->args[1] = f->b;
+        break;
+    case OP_MPROTECT:
+        call->nr = SYS_mprotect;
+        call->args[0] = f->a;
+        call->args[1] = f->b;
+        call->args[2] = f->c;
+        break;
+    case OP_MUNMAP:
+        call->nr = SYS_munmap;
+        call->args[0] = f->a;
+        call->args[1] = f->b;
+        break;
+    case OP_RCVBUF:
+    case OP_SNDBUF:
+    {
+        uint64_t buf = fi_remote_scratch(rc, 4096);
+        int val = (int)f->b;
+        if (!buf)
+            return -1;
+        buf += (uint64_t)slot * sizeof(uint64_t);
+        if (fi_remote_write(rc, buf, &val, sizeof(val)) < 0)
+            return -1;
+        call->nr = SYS_setsockopt;
+        call->args[0] = f->a;
+        call->args[1] = SOL_SOCKET;
+        call->args[2] = (f->op == OP_RCVBUF) ? SO_RCVBUF : SO_SNDBUF;
+        call->args[3] = buf;
+        call->args[4] = sizeof(int);
+        break;
+    }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    pid_t pid = atoi(argv[1]);
+    ResFault faults[MAX_OPS];
+    int nfaults = 0;
+
+    for (int i = 2; i < argc;)
+    {
+        if (strcmp(argv[i], "+") == 0)
+        {
+            i++;
+            continue;
+        }
+        if (nfaults >= MAX_OPS)
+        {
+            fprintf(stderr, "[-] 操作过多 (最多 %d 个)\n", MAX_OPS);
+            return 1;
+        }
+        int used = parse_op(pid, &argv[i], argc - i, &faults[nfaults]);
+        if (used < 0)
+        {
+            fprintf(stderr, "[-] 无法解析操作: %s\n", argv[i]);
+            print_help(argv[0]);
+            return 1;
+        }
+        nfaults++;
+        i += used;
+    }
+
+    printf("=== 进程内资源破坏注入器 (PID: %d) ===\n", pid);
+
+    FiRemote rc;
+    if (fi_remote_attach(&rc, pid) < 0)
+        return 1;
+    printf("[*] 已冻结 %d 个线程, 桩代码位于 0x%lx\n", rc.ntids, (unsigned long)rc.stub_addr);
+
+    // 先准备全部调用 (可能需要临时内存)，再一次性批量执行
+    FiRemoteCall calls[MAX_OPS];
+    int ncalls = 0;
+    for (int i = 0; i < nfaults; i++)
+    {
+        if (build_call(&rc, &faults[i], ncalls, &calls[ncalls]) < 0)
+        {
+            fprintf(stderr, "[-] 准备 %s 失败\n", faults[i].desc);
+            break;
+        }
+        ncalls++;
+    }
+
+    int done = fi_remote_batch(&rc, calls, ncalls);
+    uint64_t stop_ns = fi_remote_detach(&rc);
+
+    for (int i = 0; i < done; i++)
+    {
+        if (calls[i].ret < 0 && calls[i].ret > -4096)
+            printf("[注入] %-40s -> 失败: %s\n", faults[i].desc, strerror((int)-calls[i].ret));
+        else
+            printf("[注入] %-40s -> %ld\n", faults[i].desc, calls[i].ret);
+    }
+    if (done < ncalls)
+        printf("[!] 目标在执行期间退出，%d 个操作未执行\n", ncalls - done);
+
+    printf("[+] 完成: %d 个操作, 目标停顿 %.1f µs\n", done, stop_ns / 1000.0);
+    return (done == nfaults) ? 0 : 1;
+}
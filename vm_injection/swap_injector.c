@@ -0,0 +1,467 @@
+/*
+ * swap_injector.c - 目标进程强制换出注入器
+ * 功能：通过 pidfd + process_madvise(MADV_PAGEOUT / MADV_COLD) 把目标匿名内存的指定比例或地址区间
+ *       直接推入 swap，目标再次访问即产生主缺页；只有目标承受缺页延迟，整机空闲内存不受影响，
+ *       比用 mem_leak 吃满内存间接触发换出代价小且精确。按周期重复，逐秒报告换出页数、
+ *       目标 VmSwap / RssAnon 与 /proc/<pid>/stat 中 majflt 的变化。
+ * 依赖：Linux >= 5.10 (process_madvise)，需要 CAP_SYS_NICE 与对目标的 ptrace 权限；系统须有 swap 或 zram
+ * 编译：gcc -o swap_injector swap_injector.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+#define WIN_BYTES (2UL << 20) // 按比例挑选的粒度：以 2MB 窗口均匀散布在整个匿名地址空间
+#define MAX_RANGES 16
+#define MAX_SEGS 65536
+#define SEG_BYTES (1UL << 30)     // 相邻窗口合并成的单段上限
+#define CALL_BYTES 0x7fe00000UL   // 单次 process_madvise 的总字节上限 (内核在 MAX_RW_COUNT=0x7ffff000 处截断)
+#define BATCH_IOVS 1024
+
+volatile int keep_running = 1;
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+// === 1. 选取目标区域 ===
+
+typedef struct
+{
+    uintptr_t start, end;
+} Range;
+
+static Range ranges[MAX_RANGES]; // -r 指定的地址区间，空为整个匿名空间
+static int nranges = 0;
+
+static struct iovec segs[MAX_SEGS];
+static int nsegs = 0;
+
+static int parse_range(const char *spec)
+{
+    unsigned long long a, b;
+    if (nranges >= MAX_RANGES || sscanf(spec, "%llx-%llx", &a, &b) != 2 || a >= b)
+        return -1;
+    ranges[nranges].start = a;
+    ranges[nranges].end = b;
+    nranges++;
+    return 0;
+}
+
+// 私有可写、无文件背景的映射：堆、栈、匿名 mmap (qemu 客户机内存、JVM 堆)
+static int is_anon(const char *perms, unsigned long inode, const char *path)
+{
+    if (perms[1] != 'w' || perms[3] != 'p' || inode != 0)
+        return 0;
+    if (path[0] == '\0')
+        return 1;
+    return strcmp(path, "[heap]") == 0 || strcmp(path, "[stack]") == 0 || strncmp(path, "[anon:", 6) == 0;
+}
+
+static void add_seg(uintptr_t start, uintptr_t end)
+{
+    if (nsegs > 0 && (uintptr_t)segs[nsegs - 1].iov_base + segs[nsegs - 1].iov_len == start &&
+        segs[nsegs - 1].iov_len + (end - start) <= SEG_BYTES)
+        segs[nsegs - 1].iov_len += end - start;
+    else if (nsegs < MAX_SEGS)
+    {
+        segs[nsegs].iov_base = (void *)start;
+        segs[nsegs].iov_len = end - start;
+        nsegs++;
+    }
+}
+
+// 重新读取 maps 生成本轮的 iovec 列表 (堆增长、新映射都会被纳入)；返回匿名总量，selected 为选中量
+static unsigned long long collect_segments(pid_t pid, double frac, unsigned long long *selected)
+{
+    char path[64], line[512];
+    unsigned long long total = 0;
+    unsigned long long k = 0; // 全局窗口序号，按比例均匀挑选
+
+    nsegs = 0;
+    *selected = 0;
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long long s, e, off;
+        unsigned long inode;
+        char perms[8], dev[16], name[256] = "";
+        if (sscanf(line, "%llx-%llx %7s %llx %15s %lu %255[^\n]", &s, &e, perms, &off, dev, &inode, name) < 6)
+            continue;
+        if (!is_anon(perms, inode, name))
+            continue;
+
+        for (int r = 0; r < (nranges ? nranges : 1); r++)
+        {
+            uintptr_t a = s, b = e;
+            if (nranges)
+            {
+                a = a > ranges[r].start ? a : ranges[r].start;
+                b = b < ranges[r].end ? b : ranges[r].end;
+                if (a >= b)
+                    continue;
+            }
+            total += b - a;
+            for (uintptr_t w = a; w < b; k++)
+            {
+                uintptr_t we = (w & ~(WIN_BYTES - 1)) + WIN_BYTES;
+                if (we > b)
+                    we = b;
+                if ((unsigned long long)((k + 1) * frac) > (unsigned long long)(k * frac))
+                {
+                    add_seg(w, we);
+                    *selected += we - w;
+                }
+                w = we;
+            }
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+// === 2. 换出 ===
+
+// 对 segs 执行 advice，返回内核确认的字节数。每批不超过 CALL_BYTES；内核只处理了一部分 (含中途出错) 时
+// 从返回的偏移处继续，紧接着的调用在原地失败则跳过该段。
+// 权限、内核不支持、目标退出等整体错误返回 -1 并保留 errno
+static long long advise_segments(int pidfd, int advice, int *skipped)
+{
+    static struct iovec batch[BATCH_IOVS];
+    long long done = 0;
+    int iov_max = (int)sysconf(_SC_IOV_MAX);
+    if (iov_max <= 0 || iov_max > BATCH_IOVS)
+        iov_max = BATCH_IOVS;
+
+    *skipped = 0;
+    int i = 0;
+    size_t off = 0; // segs[i] 中已处理的字节数
+    while (i < nsegs && keep_running)
+    {
+        int n = 0;
+        size_t want = 0;
+        for (int j = i; j < nsegs && n < iov_max; j++)
+        {
+            size_t o = (j == i) ? off : 0;
+            size_t len = segs[j].iov_len - o;
+            if (n > 0 && want + len > CALL_BYTES)
+                break;
+            batch[n].iov_base = (char *)segs[j].iov_base + o;
+            batch[n].iov_len = len;
+            want += len;
+            n++;
+        }
+
+        long ret = syscall(SYS_process_madvise, pidfd, batch, (size_t)n, advice, 0U);
+        if (ret < 0 && (errno == EPERM || errno == ENOSYS || errno == ESRCH))
+            return -1;
+        if (ret <= 0)
+        {
+            // 在本批起点即失败 (映射已消失等)：跳过该段
+            (*skipped)++;
+            i++;
+            off = 0;
+            continue;
+        }
+        done += ret;
+        for (size_t adv = (size_t)ret; adv > 0 && i < nsegs;)
+        {
+            size_t left = segs[i].iov_len - off;
+            if (adv < left)
+            {
+                off += adv;
+                break;
+            }
+            adv -= left;
+            i++;
+            off = 0;
+        }
+    }
+    return done;
+}
+
+// === 3. 计量 ===
+
+typedef struct
+{
+    long long swap_kb;    // VmSwap
+    long long anon_kb;    // RssAnon
+    unsigned long majflt; // /proc/<pid>/stat 第 12 项
+} TargetStat;
+
+static int read_target(pid_t pid, TargetStat *t)
+{
+    char path[64], line[1024];
+    FILE *fp;
+
+    t->swap_kb = t->anon_kb = 0;
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    if (!(fp = fopen(path, "r")))
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, "VmSwap:", 7) == 0)
+            t->swap_kb = atoll(line + 7);
+        else if (strncmp(line, "RssAnon:", 8) == 0)
+            t->anon_kb = atoll(line + 8);
+    }
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    if (!(fp = fopen(path, "r")))
+        return -1;
+    if (!fgets(line, sizeof(line), fp))
+        line[0] = '\0';
+    fclose(fp);
+    // comm 可能含空格与括号，从最后一个 ')' 之后数：state ppid pgrp session tty tpgid flags minflt cminflt majflt
+    char *p = strrchr(line, ')');
+    t->majflt = 0;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %lu", &t->majflt) != 1)
+        return -1;
+    return 0;
+}
+
+static long long swap_total_kb(void)
+{
+    char line[256];
+    long long v = -1;
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+        if (strncmp(line, "SwapTotal:", 10) == 0)
+            v = atoll(line + 10);
+    fclose(fp);
+    return v;
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// === 4. 主流程 ===
+
+int main(int argc, char *argv[])
+{
+    double pct = 100;
+    int advice = MADV_PAGEOUT, interval_ms = 5000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+f:r:ci:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            pct = atof(optarg);
+            break;
+        case 'r':
+            if (parse_range(optarg) < 0)
+            {
+                printf("[错误] 无法解析地址区间: %s (格式 起始-结束，十六进制，最多 %d 个)\n", optarg, MAX_RANGES);
+                return 1;
+            }
+            break;
+        case 'c':
+            advice = MADV_COLD;
+            break;
+        case 'i':
+            interval_ms = atoi(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    if (argc < 3)
+    {
+        printf("用法: %s [-f 比例%%] [-r 起始-结束]... [-c] [-i 周期ms] <PID> <Duration_Sec>\n", argv[0]);
+        printf("  -f 比例   换出匿名内存的百分比，按 2MB 窗口均匀散布 (默认 100)\n");
+        printf("  -r 区间   只处理该地址区间 (十六进制，可多次指定)，与 -f 叠加\n");
+        printf("  -c        MADV_COLD：只移到非活跃 LRU 尾部，由内存回收决定何时换出 (默认 MADV_PAGEOUT 立即换出)\n");
+        printf("  -i 周期   重复换出的周期 (默认 5000ms)\n");
+        printf("  Duration  总时长，0 为只换出一次\n");
+        printf("示例: sudo %s -f 30 $(pidof qemu-system-aarch64) 60\n", argv[0]);
+        printf("      sudo %s -r 7f3a00000000-7f3a40000000 -i 1000 1234 30\n", argv[0]);
+        return 1;
+    }
+
+    pid_t pid = atoi(argv[1]);
+    int duration = atoi(argv[2]);
+    if (pid <= 0 || pct <= 0 || pct > 100 || interval_ms < 100 || duration < 0)
+    {
+        printf("[错误] 比例需在 (0,100]，周期不少于 100ms，时长不能为负\n");
+        return 1;
+    }
+    if (swap_total_kb() == 0)
+    {
+        printf("[错误] 系统没有 swap，匿名页无法换出 (可用 zram 或 swapon 一个交换文件)\n");
+        return 1;
+    }
+
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0)
+    {
+        printf("[错误] pidfd_open(%d) 失败: %s\n", pid, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    unsigned long long sel;
+    unsigned long long total = collect_segments(pid, pct / 100.0, &sel);
+    printf("=== 目标进程强制换出注入器 ===\n");
+    printf("目标 PID: %d，%s，匿名内存 %.0f MB%s，选中 %.1f%% (%.0f MB，%d 段)\n", pid,
+           advice == MADV_PAGEOUT ? "MADV_PAGEOUT" : "MADV_COLD", total / 1048576.0,
+           nranges ? " (限定区间内)" : "", pct, sel / 1048576.0, nsegs);
+    if (duration > 0)
+        printf("每 %d ms 重复一次，持续 %d 秒\n", interval_ms, duration);
+    printf("\n  秒   建议MB   换出页   换入页  VmSwap MB  RssAnon MB   majflt/s   majflt累计\n");
+
+    TargetStat t0, prev, cur;
+    if (read_target(pid, &t0) < 0)
+    {
+        printf("[错误] 无法读取 /proc/%d\n", pid);
+        return 1;
+    }
+    prev = t0;
+
+    long long start = now_ms(), next_round = start, end = start + duration * 1000LL;
+    long long advised_total = 0, evicted_total = 0, swapin_total = 0;
+    long long sec_advised = -1, sec_evicted = 0; // 本秒内各轮累计 (周期短于 1 秒时一秒有多轮)
+    unsigned long peak_flt = 0;
+    int rounds = 0, sec = 0, gone = 0;
+    long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+    while (keep_running)
+    {
+        long long now = now_ms();
+        if (now >= next_round)
+        {
+            TargetStat b, a;
+            int skipped;
+            if (rounds > 0)
+                collect_segments(pid, pct / 100.0, &sel);
+            // 换出页数取调用前后 VmSwap 之差：MADV_PAGEOUT 同步回收，窗口内的换入可忽略
+            read_target(pid, &b);
+            long long advised = advise_segments(pidfd, advice, &skipped);
+            if (advised < 0)
+            {
+                if (errno == ESRCH)
+                    gone = 1;
+                else if (errno == ENOSYS)
+                    printf("[错误] 内核不支持 process_madvise (需要 5.10+)\n");
+                else if (errno == EPERM)
+                    printf("[错误] 权限不足：需要 CAP_SYS_NICE 与对目标的 ptrace 权限 (以 root 运行)\n");
+                else
+                    printf("[错误] process_madvise 失败: %s\n", strerror(errno));
+                break;
+            }
+            if (read_target(pid, &a) < 0)
+            {
+                gone = 1;
+                break;
+            }
+            if (skipped)
+                printf("[提示] %d 段映射已变化或不支持该操作，已跳过\n", skipped);
+            long long ev = a.swap_kb > b.swap_kb ? (a.swap_kb - b.swap_kb) / page_kb : 0;
+            sec_advised = (sec_advised < 0 ? 0 : sec_advised) + advised;
+            sec_evicted += ev;
+            advised_total += advised;
+            evicted_total += ev;
+            rounds++;
+            while (next_round <= now_ms())
+                next_round += interval_ms;
+            if (duration == 0)
+            {
+                printf("%4d %8.1f %8lld %8s %10.1f %11.1f %10s %12lu\n", 0, advised / 1048576.0, ev, "-",
+                       a.swap_kb / 1024.0, a.anon_kb / 1024.0, "-", a.majflt - t0.majflt);
+                prev = a;
+                break;
+            }
+            continue;
+        }
+
+        long long wake = start + (sec + 1) * 1000LL;
+        if (now < wake)
+        {
+            usleep(((wake < next_round ? wake : next_round) - now) * 1000);
+            continue;
+        }
+
+        // 逐秒报告
+        sec++;
+        if (read_target(pid, &cur) < 0)
+        {
+            gone = 1;
+            break;
+        }
+        // 换入页：VmSwap 中扣除本秒换出后减少的部分。被换出的页在 swap cache 中命中、
+        // 或由 swap 预读带回时只计为次缺页，majflt 因此低于实际换入量
+        long long in = (prev.swap_kb + sec_evicted * page_kb - cur.swap_kb) / page_kb;
+        if (in < 0)
+            in = 0;
+        swapin_total += in;
+        unsigned long flt = cur.majflt - prev.majflt;
+        if (flt > peak_flt)
+            peak_flt = flt;
+        printf("%4d ", sec);
+        if (sec_advised >= 0)
+            printf("%8.1f %8lld", sec_advised / 1048576.0, sec_evicted);
+        else
+            printf("%8s %8s", "-", "-");
+        printf(" %8lld %10.1f %11.1f %10lu %12lu\n", in, cur.swap_kb / 1024.0, cur.anon_kb / 1024.0, flt, cur.majflt - t0.majflt);
+        fflush(stdout);
+        sec_advised = -1;
+        sec_evicted = 0;
+        prev = cur;
+        if (now >= end)
+            break;
+    }
+
+    if (gone)
+        printf("[提示] 目标进程 %d 已退出\n", pid);
+    close(pidfd);
+    printf("\n[结果] 共 %d 轮，建议 %.1f MB，换出 %lld 页 (%.1f MB)，换入 %lld 页，目标主缺页 %lu 次",
+           rounds, advised_total / 1048576.0, evicted_total, evicted_total * page_kb / 1024.0, swapin_total, prev.majflt - t0.majflt);
+    if (sec > 0)
+        printf("，平均 %.1f 次/秒，峰值 %lu 次/秒", (prev.majflt - t0.majflt) / (double)sec, peak_flt);
+    printf("\n");
+    if (advice == MADV_COLD)
+        printf("MADV_COLD 只调整 LRU 位置，换出页数取决于此后的内存回收。\n");
+    return 0;
+}
@@ -0,0 +1,519 @@
+/*
+ * sys_injector.c - 系统调用故障/延迟注入器 (seccomp 用户态通知)
+ * 功能：启动目标并为选定系统调用安装 SECCOMP_RET_USER_NOTIF 过滤器，
+ *       由本进程 (监督者) 处理通知：注入延迟、返回错误、读写短计数。
+ *       未选中的系统调用完全在内核内执行，无任何额外开销；无需 root，也不依赖 kprobe。
+ * 依赖：Linux >= 5.6 (SECCOMP_USER_NOTIF_FLAG_CONTINUE, pidfd_getfd)
+ * 编译：gcc -o sys_injector sys_injector.c fi_sys.c -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <linux/seccomp.h>
+
+#include "fi_sys.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_getfd
+#define SYS_pidfd_getfd 438
+#endif
+
+// === 故障动作 ===
+typedef enum
+{
+    ACT_DELAY, // 延迟后放行
+    ACT_ERROR, // 直接返回 -errno
+    ACT_SHORT  // 读写只完成一部分
+} SysAction;
+
+typedef struct
+{
+    SysAction action;
+    int delay_ms;
+    int err;
+    int short_pct;
+    int prob;       // 注入概率 (%)
+    long nth;       // 从第 N 次命中开始
+    long every;     // 每 N 次注入一次
+    long count;     // 最多注入次数 (0=不限)
+    long start_ms;  // 调度窗口起点
+    long dur_ms;    // 调度窗口长度 (0=不限)
+} SysPlan;
+
+// 交给工作线程处理的通知
+typedef struct
+{
+    int listener;
+    struct seccomp_notif req;
+    SysAction action;
+} SysJob;
+
+static SysPlan plan;
+static volatile long stat_seen = 0, stat_injected = 0, stat_failed = 0;
+static pthread_mutex_t stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// 发送响应；CONTINUE 表示让内核照常执行该调用
+static void respond(int listener, uint64_t id, long val, int error, int cont)
+{
+    struct seccomp_notif_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.id = id;
+    resp.val = val;
+    resp.error = error;
+    resp.flags = cont ? SECCOMP_USER_NOTIF_FLAG_CONTINUE : 0;
+    // 目标线程可能已被信号打断，ENOENT 属于正常情况
+    ioctl(listener, SECCOMP_IOCTL_NOTIF_SEND, &resp);
+}
+
+// 取得目标线程的某个 fd 的副本 (共享同一文件描述，偏移一致)
+static int grab_fd(pid_t tid, int fd)
+{
+    char path[64], line[128];
+    pid_t tgid = tid;
+    snprintf(path, sizeof(path), "/proc/%d/status", tid);
+    FILE *fp = fopen(path, "r");
+    if (fp)
+    {
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (sscanf(line, "Tgid: %d", &tgid) == 1)
+                break;
+        }
+        fclose(fp);
+    }
+
+    int pidfd = (int)syscall(SYS_pidfd_open, tgid, 0);
+    if (pidfd < 0)
+        return -1;
+    int dup_fd = (int)syscall(SYS_pidfd_getfd, pidfd, fd, 0);
+    close(pidfd);
+    return dup_fd;
+}
+
+// 短计数读写：监督者代替目标执行，只完成请求长度的一部分
+static void do_short_io(const SysJob *job)
+{
+    const struct seccomp_notif *req = &job->req;
+    long nr = req->data.nr;
+    int is_read = (nr == SYS_read || nr == SYS_pread64 || nr == SYS_recvfrom);
+    int has_off = (nr == SYS_pread64 || nr == SYS_pwrite64);
+    int is_sock = (nr == SYS_recvfrom || nr == SYS_sendto);
+
+    // recvfrom/sendto 带地址参数时不处理
+    if (is_sock && req->data.args[4] != 0)
+    {
+        respond(job->listener, req->id, 0, 0, 1);
+        return;
+    }
+
+    size_t want = req->data.args[2];
+    size_t n = want * plan.short_pct / 100;
+    if (n == 0 && want > 0)
+        n = 1;
+    if (want == 0)
+    {
+        respond(job->listener, req->id, 0, 0, 1);
+        return;
+    }
+
+    int fd = grab_fd(req->pid, (int)req->data.args[0]);
+    char *buf = malloc(n);
+    if (fd < 0 || !buf)
+    {
+        if (fd >= 0)
+            close(fd);
+        free(buf);
+        respond(job->listener, req->id, 0, 0, 1);
+        __sync_fetch_and_add(&stat_failed, 1);
+        return;
+    }
+
+    struct iovec local = {buf, n};
+    struct iovec remote = {(void *)req->data.args[1], n};
+    ssize_t r;
+
+    if (is_read)
+    {
+        if (has_off)
+            r = pread(fd, buf, n, (off_t)req->data.args[3]);
+        else if (is_sock)
+            r = recv(fd, buf, n, (int)req->data.args[3]);
+        else
+            r = read(fd, buf, n);
+
+        // 写回前确认目标仍在等待这次调用 (防止 pid 复用)
+        if (r > 0 && ioctl(job->listener, SECCOMP_IOCTL_NOTIF_ID_VALID, &req->id) == 0)
+        {
+            local.iov_len = remote.iov_len = (size_t)r;
+            if (process_vm_writev(req->pid, &local, 1, &remote, 1, 0) != r)
+                r = -1;
+        }
+    }
+    else
+    {
+        r = process_vm_readv(req->pid, &local, 1, &remote, 1, 0);
+        if (r > 0)
+        {
+            size_t len = (size_t)r;
+            if (has_off)
+                r = pwrite(fd, buf, len, (off_t)req->data.args[3]);
+            else if (is_sock)
+                r = send(fd, buf, len, (int)req->data.args[3]);
+            else
+                r = write(fd, buf, len);
+        }
+    }
+
+    if (r < 0)
+        respond(job->listener, req->id, 0, -errno, 0);
+    else
+        respond(job->listener, req->id, r, 0, 0);
+
+    close(fd);
+    free(buf);
+}
+
+static void *job_worker(void *arg)
+{
+    SysJob *job = arg;
+    if (job->action == ACT_DELAY)
+    {
+        struct timespec ts = {plan.delay_ms / 1000, (plan.delay_ms % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+        respond(job->listener, job->req.id, 0, 0, 1);
+    }
+    else
+    {
+        do_short_io(job);
+    }
+    free(job);
+    return NULL;
+}
+
+// 按概率与调度决定本次命中是否注入
+static int should_inject(long seen, long start)
+{
+    long t = now_ms() - start;
+    if (t < plan.start_ms)
+        return 0;
+    if (plan.dur_ms > 0 && t >= plan.start_ms + plan.dur_ms)
+        return 0;
+    if (seen < plan.nth)
+        return 0;
+    if (plan.every > 1 && (seen - plan.nth) % plan.every != 0)
+        return 0;
+    if (plan.count > 0 && stat_injected >= plan.count)
+        return 0;
+    if (plan.prob < 100 && rand() % 100 >= plan.prob)
+        return 0;
+    return 1;
+}
+
+static int is_rw_syscall(long nr)
+{
+    return nr == SYS_read || nr == SYS_write || nr == SYS_pread64 || nr == SYS_pwrite64 ||
+           nr == SYS_recvfrom || nr == SYS_sendto;
+}
+
+void print_help(const char *prog)
+{
+    printf("用法: %s -s <Syscalls> -a <动作> [选项] -- <命令> [参数...]\n", prog);
+    printf("动作:\n");
+    printf("  delay:<ms>      延迟后放行\n");
+    printf("  err:<ERRNO>     直接返回错误 (如 err:EIO)\n");
+    printf("  short:<percent> 读写只完成请求长度的百分比 (read/write/pread64/pwrite64/recvfrom/sendto)\n");
+    printf("选项:\n");
+    printf("  -p <percent>    注入概率 (默认100)\n");
+    printf("  -n <N>          从第 N 次命中开始 (默认1)\n");
+    printf("  -e <N>          每 N 次命中注入一次\n");
+    printf("  -l <count>      最多注入次数 (默认0=不限)\n");
+    printf("  -t <ms>         启动后延迟多少毫秒开始注入\n");
+    printf("  -d <ms>         注入窗口长度 (默认0=一直)\n");
+    printf("示例:\n");
+    printf("  %s -s fsync -a err:EIO -p 30 -- ./target_res\n", prog);
+    printf("  %s -s recvfrom,sendto -a delay:200 -t 5000 -d 10000 -- ./target_net\n", prog);
+    printf("  %s -s read -a short:50 -e 10 -- hdfs --daemon start datanode\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int sep = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            sep = i;
+            break;
+        }
+    }
+    if (sep < 0 || sep + 1 >= argc)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    memset(&plan, 0, sizeof(plan));
+    plan.prob = 100;
+    plan.nth = 1;
+    const char *sys_spec = NULL, *act_spec = NULL;
+
+    for (int i = 1; i < sep; i += 2)
+    {
+        if (i + 1 >= sep)
+        {
+            fprintf(stderr, "[-] 选项 %s 缺少参数\n", argv[i]);
+            return 1;
+        }
+        const char *opt = argv[i], *val = argv[i + 1];
+        if (strcmp(opt, "-s") == 0)
+            sys_spec = val;
+        else if (strcmp(opt, "-a") == 0)
+            act_spec = val;
+        else if (strcmp(opt, "-p") == 0)
+            plan.prob = atoi(val);
+        else if (strcmp(opt, "-n") == 0)
+            plan.nth = atol(val);
+        else if (strcmp(opt, "-e") == 0)
+            plan.every = atol(val);
+        else if (strcmp(opt, "-l") == 0)
+            plan.count = atol(val);
+        else if (strcmp(opt, "-t") == 0)
+            plan.start_ms = atol(val);
+        else if (strcmp(opt, "-d") == 0)
+            plan.dur_ms = atol(val);
+        else
+        {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    if (!sys_spec || !act_spec)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    if (strncmp(act_spec, "delay:", 6) == 0)
+    {
+        plan.action = ACT_DELAY;
+        plan.delay_ms = atoi(act_spec + 6);
+    }
+    else if (strncmp(act_spec, "err:", 4) == 0)
+    {
+        plan.action = ACT_ERROR;
+        plan.err = fi_errno_lookup(act_spec + 4);
+        if (plan.err <= 0)
+        {
+            fprintf(stderr, "[-] 无效 errno: %s\n", act_spec + 4);
+            return 1;
+        }
+    }
+    else if (strncmp(act_spec, "short:", 6) == 0)
+    {
+        plan.action = ACT_SHORT;
+        plan.short_pct = atoi(act_spec + 6);
+        if (plan.short_pct <= 0 || plan.short_pct >= 100)
+        {
+            fprintf(stderr, "[-] short 百分比须在 1-99 之间\n");
+            return 1;
+        }
+    }
+    else
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    int nrs[FI_SYS_MAX_FILTER];
+    int nsys = fi_sys_parse_list(sys_spec, nrs, FI_SYS_MAX_FILTER);
+    if (nsys <= 0)
+        return 1;
+    if (plan.action == ACT_SHORT)
+    {
+        for (int i = 0; i < nsys; i++)
+        {
+            if (!is_rw_syscall(nrs[i]))
+                printf("[!] %s 不支持短计数，将原样放行\n", fi_sys_name(nrs[i]));
+        }
+    }
+
+    srand(time(NULL));
+    signal(SIGPIPE, SIG_IGN);
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        perror("socketpair");
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    // 过滤器装上之后子进程的任何系统调用 (含 sendmsg/close/execve) 都可能变成通知，
+    // 因此子进程不主动传递 listener：先报告 listener 将占用的 fd 号 (最小空闲 fd)，装好过滤器后等待，
+    // 监督者用 pidfd_getfd 取走 listener 再放行；exec 之前的通知一律照常放行
+    if (child == 0)
+    {
+        close(sv[0]);
+        int fdnr = fcntl(sv[1], F_DUPFD, 0);
+        close(fdnr);
+        if (write(sv[1], &fdnr, sizeof(fdnr)) != sizeof(fdnr))
+            _exit(127);
+        int listener = fi_seccomp_install(nrs, nsys, SECCOMP_RET_USER_NOTIF, SECCOMP_FILTER_FLAG_NEW_LISTENER);
+        if (listener != fdnr)
+        {
+            perror("seccomp install failed");
+            _exit(127);
+        }
+        char go;
+        if (read(sv[1], &go, 1) != 1)
+            _exit(127);
+        execvp(argv[sep + 1], &argv[sep + 1]); // listener 与 sv[1] 均为 CLOEXEC，exec 成功即关闭
+        perror("execvp failed");
+        _exit(127);
+    }
+
+    close(sv[1]);
+    int fdnr = -1, listener = -1, status = 0;
+    if (read(sv[0], &fdnr, sizeof(fdnr)) == sizeof(fdnr))
+    {
+        while ((listener = grab_fd(child, fdnr)) < 0 && errno == EBADF && waitpid(child, &status, WNOHANG) == 0)
+            usleep(100);
+    }
+    if (listener < 0 || write(sv[0], "G", 1) != 1)
+    {
+        fprintf(stderr, "[-] 未取得通知 fd (内核是否支持 SECCOMP_RET_USER_NOTIF 与 pidfd_getfd?)\n");
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+        return 1;
+    }
+    int pre_exec = 1; // sv[0] 读到 EOF 表示子进程已 exec (或已退出)
+
+    printf("=== 系统调用故障注入器 (seccomp 用户态通知) ===\n");
+    printf(" 目标 PID: %d, 系统调用: %s, 动作: %s, 概率: %d%%\n", child, sys_spec, act_spec, plan.prob);
+
+    long start = now_ms();
+
+    while (1)
+    {
+        struct pollfd pfds[2] = {{listener, POLLIN, 0}, {sv[0], POLLIN, 0}};
+        struct pollfd *pfd = &pfds[0];
+        int pr = poll(pfds, pre_exec ? 2 : 1, 500);
+        if (pr < 0 && errno != EINTR)
+            break;
+
+        // 先处理 exec：子进程阻塞在通知中时不可能已经 exec，同时就绪的通知必然来自新程序
+        if (pr > 0 && pre_exec && pfds[1].revents)
+        {
+            char c;
+            if (read(sv[0], &c, 1) <= 0)
+            {
+                pre_exec = 0;
+                close(sv[0]);
+                start = now_ms();
+            }
+        }
+
+        if (pr > 0 && (pfd->revents & POLLIN))
+        {
+            struct seccomp_notif req;
+            memset(&req, 0, sizeof(req));
+            if (ioctl(listener, SECCOMP_IOCTL_NOTIF_RECV, &req) < 0)
+                continue; // 目标线程在我们接收前被打断
+            if (pre_exec)
+            {
+                respond(listener, req.id, 0, 0, 1);
+                continue;
+            }
+
+            long seen = __sync_add_and_fetch(&stat_seen, 1);
+            pthread_mutex_lock(&stat_lock);
+            int fire = should_inject(seen, start);
+            if (fire)
+                stat_injected++;
+            pthread_mutex_unlock(&stat_lock);
+
+            if (!fire || (plan.action == ACT_SHORT && !is_rw_syscall(req.data.nr)))
+            {
+                respond(listener, req.id, 0, 0, 1);
+                continue;
+            }
+
+            if (plan.action == ACT_ERROR)
+            {
+                respond(listener, req.id, 0, -plan.err, 0);
+                printf("[注入 #%ld] TID %d %s() -> -%d\n", stat_injected, req.pid, fi_sys_name(req.data.nr), plan.err);
+                continue;
+            }
+
+            // 延迟与短计数可能阻塞，交给独立线程，监督者继续处理其它通知
+            SysJob *job = malloc(sizeof(*job));
+            pthread_t th;
+            pthread_attr_t attr;
+            if (!job)
+            {
+                respond(listener, req.id, 0, 0, 1);
+                continue;
+            }
+            job->listener = listener;
+            job->req = req;
+            job->action = plan.action;
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            if (pthread_create(&th, &attr, job_worker, job) != 0)
+            {
+                respond(listener, req.id, 0, 0, 1);
+                free(job);
+            }
+            pthread_attr_destroy(&attr);
+            continue;
+        }
+
+        // 所有使用该过滤器的任务退出 (并被回收) 后，listener 才上报 POLLHUP。
+        // 启动进程退出只记录状态：守护化的后代仍带着过滤器，没有监督者时被过滤的调用全部返回 ENOSYS
+        if (pr > 0 && (pfd->revents & (POLLHUP | POLLERR)))
+            break;
+        if (child > 0 && waitpid(child, &status, WNOHANG) == child)
+        {
+            child = -1;
+            printf(" 启动进程已退出，继续处理其后代的通知直到全部退出\n");
+        }
+    }
+
+    if (child > 0)
+        waitpid(child, &status, 0);
+
+    printf(" 完成: 命中 %ld 次, 注入 %ld 次, 处理失败 %ld 次\n", stat_seen, stat_injected, stat_failed);
+    if (WIFEXITED(status))
+        printf(" 启动进程退出码: %d\n", WEXITSTATUS(status));
+    else if (WIFSIGNALED(status))
+        printf(" 启动进程被信号终止: %d (%s)\n", WTERMSIG(status), strsignal(WTERMSIG(status)));
+    return 0;
+}
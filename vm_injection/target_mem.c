@@ -1,7 +1,9 @@
 /*
  * target_mem.c - 内存故障注入测试靶场
  * 测试: mem_injector (内存篡改)
- * 编译: gcc -o target_mem target_mem.c -lpthread
+ * 编译: gcc -o target_mem target_mem.c fi_target.c -lpthread
+ * fork-server: trial_injector 启动时在诱饵部署完成处停在检查点，
+ *              每个试验子进程检查若干轮后退出 (发现篡改 = detected)
  */
 
 #include <stdio.h>
@@ -12,11 +14,22 @@
 #include <signal.h>
 #include <pthread.h>
 
+#include "fi_target.h"
+
 // 特征值 - 与 mem_injector 默认扫描值匹配
 // mem_injector 默认搜索 "deadbeefcafebabe" (16进制)
 #define CANARY_64 0xDEADBEEFCAFEBABEULL
 #define CANARY_32 0xDEADBEEFU
 
+// 堆/栈诱饵块的字数：占 [heap]/[stack] 映射的大部分，mem:heap / mem:stack 的随机注入才会落在诱饵上。
+// 堆块须小于 glibc 的 mmap 阈值 (128KB)，才会从 [heap] 分配
+#define HEAP_CANARY_WORDS (96 * 1024 / 8)
+#define STACK_CANARY_WORDS (96 * 1024 / 8)
+
+// 试验模式下的检查轮数与间隔
+#define TRIAL_ROUNDS 10
+#define TRIAL_INTERVAL_US 1000
+
 volatile int keep_running = 1;
 
 // ==================== 全局诱饵区 ====================
@@ -29,7 +42,7 @@ volatile uint64_t g_canary_4 __attribute__((aligned(8))) = CANARY_64;
 // 诱饵数组
 volatile uint64_t g_canary_array[16] __attribute__((aligned(8)));
 
-// 堆上诱饵
+// 堆上诱饵 (主线程分配，位于 [heap])
 volatile uint64_t *g_heap_canary = NULL;
 
 void sig_handler(int sig)
@@ -54,48 +67,40 @@ void print_hex_diff(uint64_t expected, uint64_t actual)
     printf("\n");
 }
 
-void *mem_watcher(void *arg)
+// 试验模式：统计被篡改的诱饵数，并把全部诱饵折叠成结果摘要
+int trial_check(volatile uint64_t *stack_canary, uint64_t *digest)
 {
-    // 初始化全局数组
+    int bad = 0;
+    uint64_t h = 0;
+    volatile uint64_t *globals[] = {&g_canary_1, &g_canary_2, &g_canary_3, &g_canary_4};
+
+    for (int i = 0; i < 4; i++)
+    {
+        bad += (*globals[i] != CANARY_64);
+        h = h * 31 + *globals[i];
+    }
     for (int i = 0; i < 16; i++)
     {
-        g_canary_array[i] = CANARY_64;
+        bad += (g_canary_array[i] != CANARY_64);
+        h = h * 31 + g_canary_array[i];
     }
-
-    // 分配堆内存诱饵
-    g_heap_canary = (volatile uint64_t *)aligned_alloc(8, sizeof(uint64_t) * 32);
-    if (!g_heap_canary)
+    for (int i = 0; i < HEAP_CANARY_WORDS; i++)
     {
-        perror("aligned_alloc");
-        return NULL;
+        bad += (g_heap_canary[i] != CANARY_64);
+        h = h * 31 + g_heap_canary[i];
     }
-    for (int i = 0; i < 32; i++)
+    for (int i = 0; i < STACK_CANARY_WORDS; i++)
     {
-        g_heap_canary[i] = CANARY_64;
+        bad += (stack_canary[i] != CANARY_64);
+        h = h * 31 + stack_canary[i];
     }
+    *digest = h;
+    return bad;
+}
 
-    // 栈上诱饵
-    volatile uint64_t stack_canary_1 __attribute__((aligned(8))) = CANARY_64;
-    volatile uint64_t stack_canary_2 __attribute__((aligned(8))) = CANARY_64;
-
-    printf("\n[MEM] 诱饵部署完成:\n");
-    printf("----------------------------------------\n");
-    printf("  全局变量:\n");
-    printf("    g_canary_1: %p\n", (void *)&g_canary_1);
-    printf("    g_canary_2: %p\n", (void *)&g_canary_2);
-    printf("    g_canary_3: %p\n", (void *)&g_canary_3);
-    printf("    g_canary_4: %p\n", (void *)&g_canary_4);
-    printf("  堆区 (32个): %p - %p\n",
-           (void *)g_heap_canary,
-           (void *)(g_heap_canary + 31));
-    printf("  栈区:\n");
-    printf("    stack_1: %p\n", (void *)&stack_canary_1);
-    printf("    stack_2: %p\n", (void *)&stack_canary_2);
-    printf("----------------------------------------\n");
-    printf("  特征值: 0x%016llX\n", (unsigned long long)CANARY_64);
-    printf("  (mem_injector 用 'deadbeefcafebabe' 扫描)\n");
-    printf("----------------------------------------\n\n");
-
+void *mem_watcher(void *arg)
+{
+    volatile uint64_t *stack_canary = arg;
     int check_count = 0;
     int total_corruptions = 0;
 
@@ -131,7 +136,7 @@ void *mem_watcher(void *arg)
         }
 
         // 检查堆
-        for (int i = 0; i < 32; i++)
+        for (int i = 0; i < HEAP_CANARY_WORDS; i++)
         {
             if (g_heap_canary[i] != CANARY_64)
             {
@@ -156,22 +161,17 @@ void *mem_watcher(void *arg)
             }
         }
 
-        // 检查栈
-        if (stack_canary_1 != CANARY_64)
-        {
-            printf("\n\033[31m[MEM] #### stack_1 被篡改!\033[0m\n");
-            print_hex_diff(CANARY_64, stack_canary_1);
-            stack_canary_1 = CANARY_64;
-            found_this_round++;
-            total_corruptions++;
-        }
-        if (stack_canary_2 != CANARY_64)
+        // 检查栈 (主线程栈上的诱饵块)
+        for (int i = 0; i < STACK_CANARY_WORDS; i++)
         {
-            printf("\n\033[31m[MEM] #### stack_2 被篡改!\033[0m\n");
-            print_hex_diff(CANARY_64, stack_canary_2);
-            stack_canary_2 = CANARY_64;
-            found_this_round++;
-            total_corruptions++;
+            if (stack_canary[i] != CANARY_64)
+            {
+                printf("\n\033[31m[MEM] #### stack[%d] 被篡改!\033[0m\n", i);
+                print_hex_diff(CANARY_64, stack_canary[i]);
+                stack_canary[i] = CANARY_64;
+                found_this_round++;
+                total_corruptions++;
+            }
         }
 
         // 定期状态报告
@@ -192,7 +192,6 @@ void *mem_watcher(void *arg)
         sleep(1);
     }
 
-    free((void *)g_heap_canary);
     return NULL;
 }
 
@@ -220,13 +219,68 @@ int main()
     printf("|  * 显示被篡改的位                             |\n");
     printf("+===============================================+\n");
 
+    // 诱饵与检查点都在主线程上：堆诱饵位于主 arena 的 [heap]，栈诱饵位于 [stack]，
+    // 试验子进程由主线程 fork，同样运行在 [stack] 上
+    for (int i = 0; i < 16; i++)
+    {
+        g_canary_array[i] = CANARY_64;
+    }
+
+    g_heap_canary = (volatile uint64_t *)malloc(sizeof(uint64_t) * HEAP_CANARY_WORDS);
+    if (!g_heap_canary)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (int i = 0; i < HEAP_CANARY_WORDS; i++)
+    {
+        g_heap_canary[i] = CANARY_64;
+    }
+
+    volatile uint64_t stack_canary[STACK_CANARY_WORDS] __attribute__((aligned(8)));
+    for (int i = 0; i < STACK_CANARY_WORDS; i++)
+    {
+        stack_canary[i] = CANARY_64;
+    }
+
+    printf("\n[MEM] 诱饵部署完成:\n");
+    printf("----------------------------------------\n");
+    printf("  全局变量:\n");
+    printf("    g_canary_1: %p\n", (void *)&g_canary_1);
+    printf("    g_canary_2: %p\n", (void *)&g_canary_2);
+    printf("    g_canary_3: %p\n", (void *)&g_canary_3);
+    printf("    g_canary_4: %p\n", (void *)&g_canary_4);
+    printf("  堆区 (%d个): mem:%p+%zu\n", HEAP_CANARY_WORDS, (void *)g_heap_canary,
+           sizeof(uint64_t) * HEAP_CANARY_WORDS);
+    printf("  栈区 (%d个): mem:%p+%zu\n", STACK_CANARY_WORDS, (void *)stack_canary,
+           sizeof(uint64_t) * STACK_CANARY_WORDS);
+    printf("----------------------------------------\n");
+    printf("  特征值: 0x%016llX\n", (unsigned long long)CANARY_64);
+    printf("  (mem_injector 用 'deadbeefcafebabe' 扫描)\n");
+    printf("----------------------------------------\n\n");
+
+    // fork-server 模式：只有试验子进程会从这里返回
+    if (fi_target_checkpoint())
+    {
+        uint64_t digest = 0;
+        int detected = 0;
+        for (int r = 0; r < TRIAL_ROUNDS && !detected; r++)
+        {
+            usleep(TRIAL_INTERVAL_US);
+            fi_target_heartbeat();
+            detected = trial_check(stack_canary, &digest) > 0;
+        }
+        fi_target_finish(digest, detected);
+    }
+
     pthread_t th;
-    pthread_create(&th, NULL, mem_watcher, NULL);
+    pthread_create(&th, NULL, mem_watcher, (void *)stack_canary);
 
     while (keep_running)
         sleep(1);
 
     pthread_join(th, NULL);
+    free((void *)g_heap_canary);
     printf("[Main] 结束\n");
     return 0;
 }
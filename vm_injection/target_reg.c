@@ -1,6 +1,6 @@
 /*
  * target_reg.c - 寄存器故障注入测试靶场 (v5 - 最终修正版)
- * 编译: gcc -O0 -o target_reg target_reg.c -lpthread
+ * 编译: gcc -O0 -o target_reg target_reg.c fi_target.c -lpthread
  *
  * 三层门槛：采样掩码、500ms间隔、连续3次才 ALERT
  *
@@ -14,6 +14,10 @@
  * 1. 编译: make target_reg
  * 2. 运行: ./target_reg
  * 3. 注入: sudo ./reg_injector <PID> X19 add1 -1 -l 0
+ *
+ * fork-server 模式 (trial_injector):
+ *    每个试验子进程累加 TRIAL_ITERS 次后退出，计数器与影子偏差超过 1000 视为检出，
+ *    否则以最终计数作为结果摘要 (小幅扰动即为 SDC)。
  */
 #include <stdio.h>
 #include <stdint.h>
@@ -22,6 +26,8 @@
 #include <signal.h>
 #include <stdlib.h>
 
+#include "fi_target.h"
+
 // 计数器仍在 x19 寄存器中操作
 volatile register uint64_t counter asm("x19");
 
@@ -31,6 +37,9 @@ volatile uint64_t g_shared_counter = 0;
 // 影子计数器（内存中），用于和寄存器值做一致性校验
 volatile uint64_t g_shadow_counter = 0;
 
+// 试验模式下每个子进程的累加次数
+#define TRIAL_ITERS (1UL << 22)
+
 // 线程控制标志
 volatile int running = 1;
 
@@ -66,6 +75,21 @@ int main()
     g_shared_counter = 0;
     g_shadow_counter = 0;
 
+    // fork-server 模式：只有试验子进程会从这里返回
+    if (fi_target_checkpoint())
+    {
+        for (uint64_t i = 0; i < TRIAL_ITERS; i++)
+        {
+            if ((i & 0xFFFF) == 0)
+                fi_target_heartbeat();
+            counter++;
+            g_shadow_counter++;
+            g_shared_counter = counter;
+        }
+        uint64_t value = g_shared_counter;
+        fi_target_finish(value, llabs((long long)(value - g_shadow_counter)) > 1000);
+    }
+
     uint64_t last_counter_value = 0;
     int mismatch_count = 0;
     uint64_t last_report_ns = now_ns();
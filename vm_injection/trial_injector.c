@@ -0,0 +1,257 @@
+/*
+ * trial_injector.c - fork-server 高吞吐注入试验
+ * 功能：靶子只初始化一次并停在检查点 (fi_target_checkpoint)，
+ *       每次试验 fork 一个写时复制子进程、按延时注入一次、回收并分类结果。
+ *       -j 启动多个 fork-server，每个绑定一个 CPU、由独立线程驱动。
+ *       设置 FI_RESULTS 时每次试验追加到结果库 (每个工作线程一个写端，互不加锁)。
+ * 编译：gcc -o trial_injector trial_injector.c fi_forksrv.c fi_monitor.c fi_target.c fi_fault.c fi_trigger.c fi_sys.c fi_results.c fi_trace.c -lpthread
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "fi_forksrv.h"
+#include "fi_trigger.h"
+#include "fi_results.h"
+
+#define MAX_WORKERS 256
+
+typedef struct
+{
+    int id;
+    int cpu;
+    pthread_t thread;
+    FiForkServer fs;
+    FiTrialResult golden;
+    int ok;
+} TrialWorker;
+
+// 试验配置 (所有工作线程共享，只读)
+static const char *loc_spec;
+static FaultType fault_type;
+static int fault_bit = -1;
+static long delay_us = 0;
+static long jitter_us = 0;
+static int timeout_ms = 1000;
+static int verbose = 0;
+static int quiet = 1;
+static char **target_argv;
+
+static volatile int keep_running = 1;
+static long total_trials = 100;
+static long next_trial = 0;
+static long outcome_count[FI_OUT_COUNT];
+static uint64_t trial_ns_sum = 0;
+static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void sigint_handler(int sig)
+{
+    keep_running = 0;
+}
+
+void print_help(const char *prog)
+{
+    printf("用法: %s [选项] <位置> <Type> [Bit] -- <靶子> [参数...]\n", prog);
+    printf("位置:\n");
+    printf("  reg:<名称>           寄存器 (ARM64: X0-X30/SP/PC, x86_64: rax..r15/rip/rsp)\n");
+    printf("  mem:heap | mem:stack 区间内随机一个 8 字节字\n");
+    printf("  mem:<addr>[+len]     指定地址 (十六进制)\n");
+    printf("选项:\n");
+    printf("  -n <trials>   试验次数 (默认100)\n");
+    printf("  -j <workers>  fork-server 个数 (默认1，每个绑定一个 CPU)\n");
+    printf("  -d <usec>     fork 后多久注入 (默认0)\n");
+    printf("  -r <usec>     在 -d 基础上随机增加 0~usec\n");
+    printf("  -t <ms>       单次试验超时，超时判定为 hang (默认1000)\n");
+    printf("  -v            逐次输出试验结果\n");
+    printf("  -o            保留靶子输出\n");
+    printf("说明: 靶子须链接 fi_target.c 并在初始化后调用 fi_target_checkpoint()\n");
+    printf("示例:\n");
+    printf("  %s -n 1000 -j 4 -d 2000 -r 8000 reg:X19 add1 -- ./target_reg\n", prog);
+    printf("  %s -n 500 mem:heap flip1 -- ./target_mem\n", prog);
+}
+
+static void *worker_main(void *arg)
+{
+    TrialWorker *w = arg;
+    FiTrialSpec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.timeout_ms = timeout_ms;
+
+    if (fi_forksrv_start(&w->fs, target_argv, w->cpu, quiet) < 0)
+        return NULL;
+
+    // 位置按各自 server 解析 (ASLR 下各实例的堆/栈地址不同)
+    if (fi_fault_parse_loc(loc_spec, w->fs.server, &spec.loc) < 0)
+    {
+        fprintf(stderr, "[-] 无法解析位置: %s\n", loc_spec);
+        fi_forksrv_stop(&w->fs);
+        return NULL;
+    }
+    spec.type = fault_type;
+    spec.bit = fault_bit;
+
+    // 黄金运行
+    if (fi_forksrv_trial(&w->fs, &spec, &w->golden) < 0 || w->golden.hang ||
+        !WIFEXITED(w->golden.status) || WEXITSTATUS(w->golden.status) != FI_EXIT_OK)
+    {
+        fprintf(stderr, "[-] 工作线程 %d: 黄金运行失败\n", w->id);
+        fi_forksrv_stop(&w->fs);
+        return NULL;
+    }
+    w->ok = 1;
+    spec.inject = 1;
+    FiResults *results = fi_results_open_env("trial_injector");
+
+    while (keep_running)
+    {
+        long seq = __sync_fetch_and_add(&next_trial, 1);
+        if (seq >= total_trials)
+            break;
+
+        spec.delay_ns = (uint64_t)delay_us * 1000ULL;
+        if (jitter_us > 0)
+            spec.delay_ns += (uint64_t)(rand() % jitter_us) * 1000ULL;
+
+        FiTrialResult res;
+        if (fi_forksrv_trial(&w->fs, &spec, &res) < 0)
+        {
+            fprintf(stderr, "[-] 工作线程 %d: fork-server 失效\n", w->id);
+            break;
+        }
+        FiOutcome out = fi_forksrv_classify(&res, &w->golden);
+
+        FiResultRow row = {0};
+        row.dur_ns = res.elapsed_ns;
+        row.target = target_argv[0];
+        row.site = loc_spec;
+        row.model = fi_fault_name(fault_type);
+        row.outcome = fi_outcome_name(out);
+        row.bit = fault_bit;
+        row.addr = res.addr;
+        row.old_val = res.old_val;
+        row.new_val = res.new_val;
+        row.signal = WIFSIGNALED(res.status) ? WTERMSIG(res.status) : res.fatal_sig;
+        fi_results_add(results, &row);
+
+        pthread_mutex_lock(&count_lock);
+        outcome_count[out]++;
+        trial_ns_sum += res.elapsed_ns;
+        pthread_mutex_unlock(&count_lock);
+
+        if (verbose)
+        {
+            printf("[#%ld] w%d PID %d +%.3f ms 0x%lx: 0x%lx -> 0x%lx  %s\n",
+                   seq + 1, w->id, res.pid, spec.delay_ns / 1e6,
+                   (unsigned long)res.addr, (unsigned long)res.old_val,
+                   (unsigned long)res.new_val, fi_outcome_name(out));
+        }
+    }
+
+    fi_results_close(results);
+    fi_forksrv_stop(&w->fs);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int nworkers = 1;
+    int sep = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            sep = i;
+            break;
+        }
+    }
+    if (sep < 0 || sep + 1 >= argc)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    const char *type_str = NULL;
+    for (int i = 1; i < sep; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < sep)
+            total_trials = atol(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < sep)
+            nworkers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < sep)
+            delay_us = atol(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < sep)
+            jitter_us = atol(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < sep)
+            timeout_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = 1;
+        else if (strcmp(argv[i], "-o") == 0)
+            quiet = 0;
+        else if (!loc_spec)
+            loc_spec = argv[i];
+        else if (!type_str)
+            type_str = argv[i];
+        else
+            fault_bit = atoi(argv[i]);
+    }
+    if (!loc_spec || !type_str || nworkers < 1 || nworkers > MAX_WORKERS)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+    fault_type = fi_fault_parse(type_str);
+    target_argv = &argv[sep + 1];
+
+    srand(time(NULL));
+    signal(SIGINT, sigint_handler);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("=== fork-server 注入试验 ===\n");
+    printf(" 靶子: %s, 位置: %s, 故障: %s, 试验: %ld 次, fork-server: %d 个\n",
+           target_argv[0], loc_spec, fi_fault_name(fault_type), total_trials, nworkers);
+
+    static TrialWorker workers[MAX_WORKERS];
+    uint64_t start_ns = fi_now_ns();
+    for (int i = 0; i < nworkers; i++)
+    {
+        workers[i].id = i;
+        workers[i].cpu = (int)(i % ncpu);
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    int alive = 0;
+    for (int i = 0; i < nworkers; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        alive += workers[i].ok;
+    }
+    double secs = (fi_now_ns() - start_ns) / 1e9;
+
+    if (alive == 0)
+    {
+        printf("[-] 没有可用的 fork-server\n");
+        return 1;
+    }
+
+    long done = 0;
+    for (int i = 0; i < FI_OUT_COUNT; i++)
+        done += outcome_count[i];
+
+    printf("----------------------------------------\n");
+    for (int i = 0; i < FI_OUT_COUNT; i++)
+    {
+        printf(" %-10s %8ld  (%5.1f%%)\n", fi_outcome_name((FiOutcome)i), outcome_count[i],
+               done ? 100.0 * outcome_count[i] / done : 0.0);
+    }
+    printf("----------------------------------------\n");
+    printf(" 完成 %ld 次试验, 用时 %.2f 秒, %.1f 次/秒, 平均每次 %.2f ms\n",
+           done, secs, done / secs, done ? trial_ns_sum / 1e6 / done : 0.0);
+    return 0;
+}
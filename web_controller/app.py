@@ -1,16 +1,18 @@
 from __future__ import annotations
 
 import json
+import mmap
 import os
 import re
 import shlex
+import struct
 import subprocess
 import sys
 import time
 from pathlib import Path
 from typing import Any, Dict, List, Optional
 
-from fastapi import FastAPI, HTTPException
+from fastapi import FastAPI, HTTPException, Query
 from fastapi.responses import FileResponse, JSONResponse
 from fastapi.staticfiles import StaticFiles
 from pydantic import BaseModel
@@ -1406,6 +1408,116 @@ def _build_kvm_soft_cmd(ctx: Dict[str, Any], params: Dict[str, Any]) -> List[Lis
     return [cmd]
 
 
+# ---------------------------------------------------------------------------
+#  Results store (vm_injection/fi_results.h 的块格式)
+# ---------------------------------------------------------------------------
+
+RESULTS_MAGIC = 0x42524946  # "FIRB"
+RESULTS_VERSION = 1
+RESULTS_NCOLS = 13
+_RESULTS_HDR = struct.Struct("<IHHIIIIII")
+_RESULTS_U64 = ("id", "ts_ns", "dur_ns", "addr", "old", "new")
+_RESULTS_STR = ("tool", "target", "site", "model", "outcome")
+_RESULTS_I16 = ("bit", "signal")
+RESULTS_GROUP_COLUMNS = _RESULTS_STR + _RESULTS_I16 + ("pid",)
+
+
+def _align8(n: int) -> int:
+    return (n + 7) & ~7
+
+
+def results_path(cfg: Dict[str, Any]) -> Path:
+    return Path(cfg.get("vm", {}).get("results") or VM_DIR / "results.fir")
+
+
+def parse_result_filters(specs: List[str]) -> List[tuple]:
+    """把 "列=值" / "列!=值" 解析为 (列, 值, 是否取反)。"""
+    filters = []
+    for spec in specs:
+        name, sep, value = spec.partition("=")
+        negate = name.endswith("!")
+        name = name.rstrip("!")
+        if not sep or name not in RESULTS_GROUP_COLUMNS:
+            raise ValueError(f"无效过滤条件: {spec}")
+        filters.append((name, value, negate))
+    return filters
+
+
+def query_results(path: Path, group_by: List[str], filters: List[tuple]) -> Dict[str, Any]:
+    """mmap 结果库并按列分组统计，输出与 fi_query -j 相同。"""
+    for col in group_by:
+        if col not in RESULTS_GROUP_COLUMNS:
+            raise ValueError(f"无效分组列: {col}")
+
+    groups: Dict[tuple, List[int]] = {}
+    total = blocks = 0
+    size = path.stat().st_size
+    if size > 0:
+        with path.open("rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            off = 0
+            magic_bytes = struct.pack("<I", RESULTS_MAGIC)
+            while off + _RESULTS_HDR.size <= size:
+                magic, version, ncols, nrows, nstr, str_bytes, bsize, pid, _ = _RESULTS_HDR.unpack_from(mm, off)
+                expect = _RESULTS_HDR.size + 6 * _align8(nrows * 8) + 7 * _align8(nrows * 2) + _align8(str_bytes)
+                end = off + bsize
+                # 残块的块头是完整的，只有其后紧跟文件尾或下一个块头才算完整的块
+                if (magic != RESULTS_MAGIC or version != RESULTS_VERSION or ncols != RESULTS_NCOLS
+                        or bsize != expect or end > size
+                        or (end != size and mm[end:end + 4] != magic_bytes)):
+                    # 残块或损坏：向后找下一个块头的魔数重新同步
+                    nxt = mm.find(magic_bytes, off + 1)
+                    if nxt < 0:
+                        break
+                    off = nxt
+                    continue
+
+                p = off + _RESULTS_HDR.size
+                cols: Dict[str, Any] = {}
+                for name in _RESULTS_U64:
+                    cols[name] = struct.unpack_from(f"<{nrows}Q", mm, p)
+                    p += _align8(nrows * 8)
+                for name in _RESULTS_STR:
+                    cols[name] = struct.unpack_from(f"<{nrows}H", mm, p)
+                    p += _align8(nrows * 2)
+                for name in _RESULTS_I16:
+                    cols[name] = struct.unpack_from(f"<{nrows}h", mm, p)
+                    p += _align8(nrows * 2)
+                strings = [b.decode("utf-8", "replace") for b in mm[p:p + str_bytes].split(b"\0")[:nstr]]
+                blocks += 1
+                off += bsize
+
+                # 只展开用到的列：字符串列先按块内字符串表解码
+                def column(col: str) -> Any:
+                    if col == "pid":
+                        return (pid,) * nrows
+                    if col in _RESULTS_I16:
+                        return cols[col]
+                    return [strings[i] if i < len(strings) else "" for i in cols[col]]
+
+                keep = [True] * nrows
+                for col, want, negate in filters:
+                    values = column(col)
+                    wanted = want if col in _RESULTS_STR else int(want, 0)
+                    keep = [k and ((v == wanted) != negate) for k, v in zip(keep, values)]
+                keys = list(zip(*(column(col) for col in group_by))) if group_by else [()] * nrows
+                for k, key, dur in zip(keep, keys, cols["dur_ns"]):
+                    if not k:
+                        continue
+                    acc = groups.setdefault(key, [0, 0])
+                    acc[0] += 1
+                    acc[1] += dur
+                    total += 1
+
+    out = []
+    for key in sorted(groups):
+        count, dur_sum = groups[key]
+        row: Dict[str, Any] = dict(zip(group_by, key))
+        row["count"] = count
+        row["avg_ms"] = round(dur_sum / 1e6 / count, 3)
+        out.append(row)
+    return {"total": total, "blocks": blocks, "columns": list(group_by), "groups": out}
+
+
 @app.get("/")
 def index() -> FileResponse:
     return FileResponse(static_dir / "index.html")
@@ -1789,6 +1901,26 @@ def api_test() -> JSONResponse:
     return JSONResponse({"ok": all_passed, "tests": tests_out, "summary": summary})
 
 
+@app.get("/api/results")
+def api_results(
+    group: str = "target,outcome",
+    where: List[str] = Query(default=[]),
+) -> JSONResponse:
+    """按列分组统计注入结果库 (FI_RESULTS 写入的文件)。"""
+    cfg = load_config()
+    path = results_path(cfg)
+    if not path.exists():
+        raise HTTPException(status_code=404, detail="结果库不存在")
+    try:
+        filters = parse_result_filters(where)
+        data = query_results(path, [c for c in group.split(",") if c], filters)
+    except ValueError as exc:
+        raise HTTPException(status_code=400, detail=str(exc))
+    data["ok"] = True
+    data["path"] = str(path)
+    return JSONResponse(data)
+
+
 @app.get("/api/health")
 def api_health() -> JSONResponse:
     return JSONResponse({"ok": True})
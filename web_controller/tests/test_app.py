@@ -11,6 +11,7 @@ from __future__ import annotations
 
 import json
 import os
+import struct
 import sys
 import textwrap
 from pathlib import Path
@@ -40,6 +41,8 @@ from web_controller.app import (
     is_local_node,
     maybe_sudo,
     normalize_cmds,
+    parse_result_filters,
+    query_results,
     render_template,
     resolve_sudo,
     resolve_test_nodes,
@@ -733,3 +736,146 @@ class TestActionRequestModel:
         req = ActionRequest(action="a", params={"k": "v"}, tests={"kvm": True})
         assert req.params == {"k": "v"}
         assert req.tests == {"kvm": True}
+
+
+# ====================================================================
+# 10. 结果库 — parse_result_filters / query_results / /api/results
+# ====================================================================
+
+
+def _pack_results_block(rows: List[Dict[str, Any]], pid: int = 100) -> bytes:
+    """按 fi_results.h 的块格式打包一组行 (测试用写端)。"""
+    strings: List[str] = ["tool_x"]
+
+    def intern(s: str) -> int:
+        if s not in strings:
+            strings.append(s)
+        return strings.index(s)
+
+    def pad(b: bytes) -> bytes:
+        return b + b"\0" * (-len(b) % 8)
+
+    n = len(rows)
+    body = b""
+    for name in ("id", "ts_ns", "dur_ns", "addr", "old", "new"):
+        body += pad(struct.pack(f"<{n}Q", *[r.get(name, 0) for r in rows]))
+    for name in ("tool", "target", "site", "model", "outcome"):
+        body += pad(struct.pack(f"<{n}H", *[0 if name == "tool" else intern(r[name]) for r in rows]))
+    for name in ("bit", "signal"):
+        body += pad(struct.pack(f"<{n}h", *[r.get(name, 0) for r in rows]))
+    table = b"".join(s.encode() + b"\0" for s in strings)
+    body += pad(table)
+    hdr = struct.pack("<IHHIIIIII", 0x42524946, 1, 13, n, len(strings), len(table), 32 + len(body), pid, 0)
+    return hdr + body
+
+
+def _row(target: str, outcome: str, **kw: Any) -> Dict[str, Any]:
+    row = {"target": target, "site": "reg:X19", "model": "flip1", "outcome": outcome, "dur_ns": 2_000_000}
+    row.update(kw)
+    return row
+
+
+@pytest.fixture()
+def results_file(tmp_path: Path) -> Path:
+    path = tmp_path / "results.fir"
+    path.write_bytes(
+        _pack_results_block([_row("a", "masked"), _row("a", "sdc", bit=3), _row("b", "crash", signal=11)])
+        + _pack_results_block([_row("a", "masked", dur_ns=4_000_000)], pid=200)
+    )
+    return path
+
+
+class TestParseResultFilters:
+    """parse_result_filters: "列=值" / "列!=值"。"""
+
+    def test_equal_and_negate(self):
+        assert parse_result_filters(["outcome=sdc", "target!=a"]) == [
+            ("outcome", "sdc", False),
+            ("target", "a", True),
+        ]
+
+    def test_unknown_column(self):
+        with pytest.raises(ValueError):
+            parse_result_filters(["nope=1"])
+
+    def test_missing_value_separator(self):
+        with pytest.raises(ValueError):
+            parse_result_filters(["outcome"])
+
+
+class TestQueryResults:
+    """query_results: mmap 读取块并分组统计。"""
+
+    def test_group_by_target_outcome(self, results_file):
+        data = query_results(results_file, ["target", "outcome"], [])
+        assert data["total"] == 4
+        assert data["blocks"] == 2
+        counts = {(g["target"], g["outcome"]): g["count"] for g in data["groups"]}
+        assert counts == {("a", "masked"): 2, ("a", "sdc"): 1, ("b", "crash"): 1}
+
+    def test_average_duration(self, results_file):
+        data = query_results(results_file, ["outcome"], parse_result_filters(["outcome=masked"]))
+        assert data["groups"] == [{"outcome": "masked", "count": 2, "avg_ms": 3.0}]
+
+    def test_numeric_columns(self, results_file):
+        data = query_results(results_file, ["pid", "signal"], parse_result_filters(["outcome!=masked"]))
+        assert [(g["pid"], g["signal"], g["count"]) for g in data["groups"]] == [(100, 0, 1), (100, 11, 1)]
+
+    def test_truncated_tail_ignored(self, results_file):
+        raw = results_file.read_bytes()
+        results_file.write_bytes(raw + _pack_results_block([_row("c", "hang")])[:40])
+        assert query_results(results_file, ["target"], [])["total"] == 4
+
+    def test_torn_block_resync(self, results_file):
+        raw = results_file.read_bytes()
+        torn = _pack_results_block([_row("c", "hang")])[:40]
+        results_file.write_bytes(torn + raw + torn + _pack_results_block([_row("d", "sdc")]))
+        data = query_results(results_file, ["target"], [])
+        assert data["total"] == 5
+        assert data["blocks"] == 3
+
+    def test_empty_file(self, tmp_path):
+        path = tmp_path / "empty.fir"
+        path.write_bytes(b"")
+        assert query_results(path, ["target"], []) == {"total": 0, "blocks": 0, "columns": ["target"], "groups": []}
+
+    def test_invalid_group_column(self, results_file):
+        with pytest.raises(ValueError):
+            query_results(results_file, ["bogus"], [])
+
+
+class TestApiResults:
+    """GET /api/results: 读取配置中的结果库。"""
+
+    @pytest.fixture()
+    def results_client(self, results_file, mock_config, tmp_path, monkeypatch):
+        import importlib
+        import web_controller.app as app_module
+        from fastapi.testclient import TestClient
+
+        cfg = mock_config
+        cfg["vm"]["results"] = str(results_file)
+        cfg_path = tmp_path / "results_config.json"
+        cfg_path.write_text(json.dumps(cfg), encoding="utf-8")
+        monkeypatch.setenv("FI_CONTROLLER_CONFIG", str(cfg_path))
+        importlib.reload(app_module)
+        return TestClient(app_module.app, raise_server_exceptions=False)
+
+    def test_grouped_counts(self, results_client):
+        resp = results_client.get("/api/results", params={"group": "target"})
+        assert resp.status_code == 200
+        data = resp.json()
+        assert data["ok"] is True
+        assert [(g["target"], g["count"]) for g in data["groups"]] == [("a", 3), ("b", 1)]
+
+    def test_where_filter(self, results_client):
+        resp = results_client.get("/api/results", params={"group": "outcome", "where": ["target=a", "outcome!=masked"]})
+        assert resp.json()["groups"] == [{"outcome": "sdc", "count": 1, "avg_ms": 2.0}]
+
+    def test_bad_column(self, results_client):
+        resp = results_client.get("/api/results", params={"group": "bogus"})
+        assert resp.status_code == 400
+
+    def test_missing_file(self, client):
+        resp = client.get("/api/results")
+        assert resp.status_code == 404